@@ -0,0 +1,233 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// draws a grid of browser panels into an offscreen framebuffer, once with a
+// texture and a draw call per panel (what BrowserManager::render does by
+// default) and once from a texture atlas, and reports the CPU time to submit
+// a frame, the time for the frame to complete and the draw calls/binds used.
+// Also times resizing every panel, which forces the atlas to repack
+//
+//     atlas_bench [--frames <count>] [--panels <count>] [--page-size <texels>]
+
+#include "compositor.h"
+#include "texture_atlas.h"
+
+#include "bench_util.h"
+#include "headless_gl.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+    const int kTargetWidth = 1920;
+    const int kTargetHeight = 1080;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+std::vector<Rect> gridLayout(int panels)
+{
+    int columns = 1;
+    while (columns * columns < panels)
+    {
+        ++columns;
+    }
+    int rows = (panels + columns - 1) / columns;
+
+    std::vector<Rect> rects;
+    for (int i = 0; i < panels; ++i)
+    {
+        int column = i % columns;
+        int row = i / columns;
+        int x = column * kTargetWidth / columns;
+        int y = row * kTargetHeight / rows;
+        rects.push_back(Rect(x, y, (column + 1) * kTargetWidth / columns - x, (row + 1) * kTargetHeight / rows - y));
+    }
+    return rects;
+}
+
+void report(const char* name, int panels, Samples& submit_times, Samples& frame_times, size_t draw_calls, size_t binds, size_t memory)
+{
+    printf("%4d panels %-12s submit p50 %8.1f us p99 %8.1f us | frame p50 %8.1f us p99 %8.1f us | %4zu draw calls %4zu binds per frame | %7zu KB textures\n",
+           panels, name, submit_times.percentile(50), submit_times.percentile(99),
+           frame_times.percentile(50), frame_times.percentile(99), draw_calls, binds, memory / 1024);
+}
+
+void runPerSurface(int panels, int frames)
+{
+    std::vector<Rect> layout = gridLayout(panels);
+
+    std::vector<GLuint> textures(panels);
+    glGenTextures(panels, textures.data());
+    for (int i = 0; i < panels; ++i)
+    {
+        std::vector<unsigned char> pixels((size_t)layout[i].area() * kDepth);
+        fillPattern(pixels, i);
+
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, layout[i].width, layout[i].height, 0, GL_BGRA_EXT, GL_UNSIGNED_BYTE, pixels.data());
+    }
+    glFinish();
+
+    Samples submit_times;
+    Samples frame_times;
+    size_t memory = 0;
+    for (const Rect& rect : layout)
+    {
+        memory += rect.area() * kDepth;
+    }
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        double t0 = nowMicroseconds();
+        glClear(GL_COLOR_BUFFER_BIT);
+        for (int i = 0; i < panels; ++i)
+        {
+            const Rect& rect = layout[i];
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glBegin(GL_QUADS);
+            {
+                glTexCoord2f(1.0f, 0.0f);
+                glVertex2d(rect.x + rect.width, rect.y);
+                glTexCoord2f(0.0f, 0.0f);
+                glVertex2d(rect.x, rect.y);
+                glTexCoord2f(0.0f, 1.0f);
+                glVertex2d(rect.x, rect.y + rect.height);
+                glTexCoord2f(1.0f, 1.0f);
+                glVertex2d(rect.x + rect.width, rect.y + rect.height);
+            }
+            glEnd();
+        }
+        double t1 = nowMicroseconds();
+        glFinish();
+        double t2 = nowMicroseconds();
+
+        submit_times.add(t1 - t0);
+        frame_times.add(t2 - t0);
+    }
+
+    report("per-surface", panels, submit_times, frame_times, panels, panels, memory);
+
+    glDeleteTextures(panels, textures.data());
+}
+
+void runAtlas(int panels, int frames, int page_size)
+{
+    std::vector<Rect> layout = gridLayout(panels);
+
+    TextureAtlas atlas(page_size);
+    std::vector<AtlasUploadBackend*> backends;
+    for (int i = 0; i < panels; ++i)
+    {
+        backends.push_back(new AtlasUploadBackend(&atlas, layout[i].width, layout[i].height));
+
+        std::vector<unsigned char> pixels((size_t)layout[i].area() * kDepth);
+        fillPattern(pixels, i);
+        backends[i]->upload(Rect(0, 0, layout[i].width, layout[i].height), pixels.data(), layout[i].width);
+    }
+    glFinish();
+
+    Samples submit_times;
+    Samples frame_times;
+    size_t draw_calls_before = atlas.stats().drawCalls;
+
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        double t0 = nowMicroseconds();
+        glClear(GL_COLOR_BUFFER_BIT);
+        for (int i = 0; i < panels; ++i)
+        {
+            atlas.addQuad(backends[i]->handle(), layout[i]);
+        }
+        atlas.draw();
+        double t1 = nowMicroseconds();
+        glFinish();
+        double t2 = nowMicroseconds();
+
+        submit_times.add(t1 - t0);
+        frame_times.add(t2 - t0);
+    }
+
+    size_t draw_calls = (atlas.stats().drawCalls - draw_calls_before) / std::max(frames, 1);
+    report("atlas", panels, submit_times, frame_times, draw_calls, draw_calls, atlas.memoryUsage());
+
+    // every panel grows a little - the first few fit in the pages as they are, then the atlas has to repack
+    double t0 = nowMicroseconds();
+    for (int i = 0; i < panels; ++i)
+    {
+        backends[i]->resize(layout[i].width + 16, layout[i].height + 16);
+    }
+    glFinish();
+    printf("%4d panels %-12s resizing every panel took %8.1f us, %zu repacks, %zu pages\n",
+           panels, "atlas", nowMicroseconds() - t0, atlas.stats().repacks, atlas.numPages());
+
+    for (AtlasUploadBackend* backend : backends)
+    {
+        delete backend;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const int frames = atoi(getArg(argc, argv, "--frames", "100").c_str());
+    const int only_panels = atoi(getArg(argc, argv, "--panels", "0").c_str());
+    const int page_size = atoi(getArg(argc, argv, "--page-size", "2048").c_str());
+
+    if (! createHeadlessGLContext())
+    {
+        return 1;
+    }
+
+    if (! gGL.hasFramebuffers())
+    {
+        fprintf(stderr, "atlas_bench: framebuffer objects are needed to draw offscreen\n");
+        return 1;
+    }
+
+    // everything is drawn into an offscreen 1080p target
+    GLuint target = 0;
+    glGenTextures(1, &target);
+    glBindTexture(GL_TEXTURE_2D, target);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, kTargetWidth, kTargetHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+
+    GLuint framebuffer = 0;
+    gGL.genFramebuffers(1, &framebuffer);
+    gGL.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    gGL.framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+    if (gGL.checkFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        fprintf(stderr, "atlas_bench: offscreen framebuffer is incomplete\n");
+        return 1;
+    }
+
+    glViewport(0, 0, kTargetWidth, kTargetHeight);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0.0f, kTargetWidth, kTargetHeight, 0.0f, -1.0f, 1.0f);
+    glEnable(GL_TEXTURE_2D);
+    glColor3f(1.0f, 1.0f, 1.0f);
+
+    const int panel_counts[] = { 16, 64, 256 };
+    for (int panels : panel_counts)
+    {
+        if (only_panels != 0 && panels != only_panels)
+        {
+            continue;
+        }
+
+        runPerSurface(panels, frames);
+        runAtlas(panels, frames, page_size);
+    }
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+#ifndef _BENCH_UTIL_H_
+#define _BENCH_UTIL_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// bits and pieces shared by the headless benchmarks
+inline double nowMicroseconds()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// collects timings (in microseconds) so we can report percentiles at the end
+class Samples
+{
+    public:
+        void add(double value)
+        {
+            mValues.push_back(value);
+            mSorted = false;
+        }
+
+        size_t count() const
+        {
+            return mValues.size();
+        }
+
+        double total() const
+        {
+            double sum = 0.0;
+            for (double value : mValues)
+            {
+                sum += value;
+            }
+            return sum;
+        }
+
+        double mean() const
+        {
+            return mValues.empty() ? 0.0 : total() / mValues.size();
+        }
+
+        double percentile(double p)
+        {
+            if (mValues.empty())
+            {
+                return 0.0;
+            }
+
+            if (! mSorted)
+            {
+                std::sort(mValues.begin(), mValues.end());
+                mSorted = true;
+            }
+
+            size_t index = (size_t)(p / 100.0 * (mValues.size() - 1) + 0.5);
+            return mValues[std::min(index, mValues.size() - 1)];
+        }
+
+    private:
+        std::vector<double> mValues;
+        bool mSorted = false;
+};
+
+// a simple --name value command line
+inline std::string getArg(int argc, char* argv[], const std::string& name, const std::string& default_value)
+{
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (name == argv[i])
+        {
+            return argv[i + 1];
+        }
+    }
+    return default_value;
+}
+
+inline bool hasArg(int argc, char* argv[], const std::string& name)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (name == argv[i])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// fill a buffer with something that isn't all zeros so copies can't be optimized away
+inline void fillPattern(std::vector<unsigned char>& pixels, unsigned int seed)
+{
+    for (size_t i = 0; i < pixels.size(); ++i)
+    {
+        pixels[i] = (unsigned char)((i * 2654435761u + seed) >> 13);
+    }
+}
+
+#endif // _BENCH_UTIL_H_
@@ -0,0 +1,272 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// streams pages through VideoCapture (src/video_capture.h) to see what the
+// BGRA to I420 conversion costs and what capturing costs the thread that
+// paints. First a small capture to a file that's read back and checked - the
+// Y4M header, the number of frames and the pixels of each of them against the
+// scalar kernel. Then 1080p frames that all change, pushed through as fast
+// as they can go with 1, 2 ... worker threads, reporting frames per second
+// overall and per core of conversion. Last, two runs paced in real time - 60
+// frames per second where only every 4th frame changes (the rest should be
+// written as repeats without converting) and a 4K stream at 240 frames per
+// second that can't keep up, where frames should be dropped while the time
+// damage() and tick() take on the painting thread stays flat. Exits with 1 if
+// the check fails
+//
+//     capture_bench [--frames <frames per throughput run>] [--workers <most workers to try>] [--seconds <per paced run>]
+
+#include "video_capture.h"
+#include "pixel_kernels.h"
+
+#include "bench_util.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+#ifdef _WIN32
+    const char* kNullDevice = "NUL";
+#else
+    const char* kNullDevice = "/dev/null";
+#endif
+
+    // the first tick starts the clock - the rest land half way between frames so rounding can't move them
+    double tickTime(int frame, double frame_rate)
+    {
+        return frame == 0 ? 0.0 : (frame + 0.5) * 1000.0 / frame_rate;
+    }
+
+    double nowMilliseconds()
+    {
+        return nowMicroseconds() / 1000.0;
+    }
+
+    // a block that moves about the page each frame, over a pattern that changes every 60th frame
+    void changePage(std::vector<unsigned char>& page, int width, int height, int frame, RectList& dirty)
+    {
+        dirty.clear();
+        if (frame % 60 == 0)
+        {
+            fillPattern(page, frame);
+            dirty.push_back(Rect(0, 0, width, height));
+            return;
+        }
+
+        const int block = 128 < height / 2 ? 128 : height / 2;
+        Rect rect((frame * 197) % (width - block + 1), (frame * 89) % (height - block + 1), block, block);
+        for (int y = rect.y; y < rect.y + rect.height; ++y)
+        {
+            memset(&page[((size_t)y * width + rect.x) * kDepth], frame & 0xff, (size_t)rect.width * kDepth);
+        }
+        dirty.push_back(rect);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+// the scalar kernel over a whole page
+std::vector<unsigned char> convertScalar(const std::vector<unsigned char>& page, int width, int height)
+{
+    const int chroma_width = (width + 1) / 2;
+    const int chroma_height = (height + 1) / 2;
+    std::vector<unsigned char> i420((size_t)width * height + (size_t)chroma_width * chroma_height * 2);
+    unsigned char* y = i420.data();
+    unsigned char* u = y + (size_t)width * height;
+    unsigned char* v = u + (size_t)chroma_width * chroma_height;
+    for (int row = 0; row < height; row += 2)
+    {
+        int next = row + 1 < height ? row + 1 : row;
+        bgraToI420RowScalar(&page[(size_t)row * width * kDepth], &page[(size_t)next * width * kDepth],
+                            y + (size_t)row * width, y + (size_t)next * width,
+                            u + (size_t)(row / 2) * chroma_width, v + (size_t)(row / 2) * chroma_width, width);
+    }
+    return i420;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+// odd sizes on purpose - the last row and column have nothing to pair with. Some
+// frames change a block and the rest don't, with a pause after each tick so the
+// workers hand their snapshot buffers back and get them again with only the
+// blocks copied in
+bool checkOutput()
+{
+    const int width = 63;
+    const int height = 47;
+    const int frames = 12;
+    const char* path = "capture_bench_check.y4m";
+
+    std::vector<unsigned char> page((size_t)width * height * kDepth);
+    fillPattern(page, 7);
+
+    VideoCaptureSettings settings;
+    settings.frameRate = 30.0;
+    settings.workers = 2;
+    settings.maxQueuedFrames = 64;
+
+    VideoCapture capture(settings);
+    if (! capture.open(path))
+    {
+        printf("unable to open %s\n", path);
+        return false;
+    }
+
+    std::vector<std::vector<unsigned char> > expected;
+    RectList dirty(1, Rect(0, 0, width, height));
+    size_t changes = 0;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        if (frame > 0 && frame % 3 != 1)
+        {
+            changePage(page, width, height, frame, dirty);
+        }
+        if (! dirty.empty())
+        {
+            capture.damage(page.data(), width, height, dirty);
+            dirty.clear();
+            ++changes;
+        }
+        capture.tick(tickTime(frame, settings.frameRate));
+        expected.push_back(convertScalar(page, width, height));
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    capture.close();
+    VideoCaptureStats stats = capture.stats();
+
+    std::vector<unsigned char> file;
+    FILE* input = fopen(path, "rb");
+    if (input != nullptr)
+    {
+        unsigned char chunk[4096];
+        size_t read = 0;
+        while ((read = fread(chunk, 1, sizeof(chunk), input)) > 0)
+        {
+            file.insert(file.end(), chunk, chunk + read);
+        }
+        fclose(input);
+    }
+    remove(path);
+
+    const size_t frame_bytes = expected[0].size();
+    std::string header = "YUV4MPEG2 W63 H47 F30000:1000 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n";
+    bool ok = file.size() == header.size() + frames * (6 + frame_bytes) && memcmp(file.data(), header.data(), header.size()) == 0;
+    for (int frame = 0; ok && frame < frames; ++frame)
+    {
+        const unsigned char* data = file.data() + header.size() + frame * (6 + frame_bytes);
+        ok = memcmp(data, "FRAME\n", 6) == 0 && memcmp(data + 6, expected[frame].data(), frame_bytes) == 0;
+    }
+    ok = ok && stats.framesWritten == (size_t)frames && stats.converted == changes &&
+         stats.duplicated == frames - changes && stats.dropped == 0;
+
+    printf("check: %dx%d, %zu frames written (%zu converted, %zu repeats), %zu bytes - %s\n", width, height,
+           stats.framesWritten, stats.converted, stats.duplicated, file.size(), ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+// every frame changes and every tick is due straight away - the painting thread
+// runs flat out, so anything the workers can't take is dropped
+void runThroughput(int width, int height, int frames, int workers)
+{
+    std::vector<unsigned char> page((size_t)width * height * kDepth);
+    fillPattern(page, 1);
+
+    VideoCaptureSettings settings;
+    settings.frameRate = 60.0;
+    settings.workers = workers;
+    settings.maxQueuedFrames = (size_t)workers * 2;
+
+    VideoCapture capture(settings);
+    capture.open(kNullDevice);
+
+    RectList dirty(1, Rect(0, 0, width, height));
+    double start = nowMicroseconds();
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        capture.damage(page.data(), width, height, dirty);
+        capture.tick(tickTime(frame, settings.frameRate));
+        // the painting thread would be off doing other things
+        std::this_thread::yield();
+    }
+    capture.close();
+    double seconds = (nowMicroseconds() - start) / 1.0e6;
+
+    VideoCaptureStats stats = capture.stats();
+    double per_core = stats.convertSeconds > 0.0 ? stats.converted / stats.convertSeconds : 0.0;
+    printf("  %d worker%s: %5zu converted, %5zu dropped, %7.1f frames/s overall, %7.1f frames/s (%6.1f Mpixels/s) per core\n",
+           workers, workers == 1 ? " " : "s", stats.converted, stats.dropped, stats.converted / seconds,
+           per_core, per_core * width * height / 1.0e6);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+// frames arrive in real time - how long capturing holds up the painting thread
+void runPaced(const char* label, int width, int height, double frame_rate, int change_every, double seconds)
+{
+    std::vector<unsigned char> page((size_t)width * height * kDepth);
+    fillPattern(page, 1);
+
+    VideoCaptureSettings settings;
+    settings.frameRate = frame_rate;
+    settings.workers = 1;
+    settings.maxQueuedFrames = 4;
+
+    VideoCapture capture(settings);
+    capture.open(kNullDevice);
+
+    Samples ui_times;
+    RectList dirty;
+    const double interval = 1000.0 / frame_rate;
+    double start = nowMilliseconds();
+    for (int frame = 0; nowMilliseconds() - start < seconds * 1000.0; ++frame)
+    {
+        double ui_start = nowMicroseconds();
+        if (frame % change_every == 0)
+        {
+            changePage(page, width, height, frame, dirty);
+            capture.damage(page.data(), width, height, dirty);
+        }
+        capture.tick(nowMilliseconds());
+        ui_times.add(nowMicroseconds() - ui_start);
+
+        double wait = capture.timeUntilFrame(nowMilliseconds());
+        std::this_thread::sleep_for(std::chrono::microseconds((int)((wait < interval ? wait : interval) * 1000.0)));
+    }
+    capture.close();
+
+    VideoCaptureStats stats = capture.stats();
+    printf("  %-28s %5zu written, %5zu converted, %5zu repeats, %5zu dropped, damage+tick p50 %7.1f us p99 %7.1f us max %7.1f us\n",
+           label, stats.framesWritten, stats.converted, stats.duplicated, stats.dropped,
+           ui_times.percentile(50), ui_times.percentile(99), ui_times.percentile(100));
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const int frames = atoi(getArg(argc, argv, "--frames", "600").c_str());
+    const int cores = (int)std::thread::hardware_concurrency();
+    const int max_workers = atoi(getArg(argc, argv, "--workers", std::to_string(cores > 2 ? cores : 2)).c_str());
+    const double seconds = atof(getArg(argc, argv, "--seconds", "3").c_str());
+
+    printf("capture_bench: %s kernels, %d cores\n", pixelKernels().name, cores);
+
+    bool ok = checkOutput();
+
+    printf("1920x1080, every frame changed, as fast as possible\n");
+    for (int workers = 1; workers <= max_workers; workers *= 2)
+    {
+        runThroughput(1920, 1080, frames, workers);
+    }
+
+    printf("paced in real time, 1 worker, 4 frames queued at most\n");
+    runPaced("1080p 60fps, 1 in 4 changed", 1920, 1080, 60.0, 4, seconds);
+    runPaced("4K 240fps, all changed", 3840, 2160, 240.0, 1, seconds);
+
+    return ok ? 0 : 1;
+}
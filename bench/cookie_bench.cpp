@@ -0,0 +1,468 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// how long it takes to restore a big cookie file (10,000 cookies by default)
+// into a cookie store that works the way CEF's does - every call is queued to
+// a thread of its own (CEF's IO thread) and a flush writes whatever has changed
+// to disk and syncs it. The thread that starts the import (CEF's UI thread in
+// the apps) runs the tasks posted back to it, like the apps' message loop does.
+//
+//   one by one  what the apps used to do - set a cookie and flush the store
+//               for every cookie, without waiting to hear back
+//   batch N     importCookies() (src/cookie_store.h) N cookies at a time with
+//               one flush per batch
+//
+// Writes out how long each took, cookies per second, flushes, and how much of
+// it was spent on the thread that started it. Checks the store ends up with
+// every cookie in the file, that a line that isn't a cookie is skipped, and
+// that exporting the store and importing it again gives the same cookies -
+// exits with 1 if anything doesn't match
+//
+//     cookie_bench [--cookies <count>] [--flush-latency <milliseconds per flush>]
+
+#include "cookie_store.h"
+
+#include "bench_util.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // runs tasks on a thread - the store's "IO thread" or, with run(), the thread that calls it
+    class TaskQueue
+    {
+        public:
+            void post(const std::function<void()>& task)
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mTasks.push_back(task);
+                mCondition.notify_one();
+            }
+
+            // until stop() is called
+            void run()
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                while (true)
+                {
+                    mCondition.wait(lock, [this]()
+                    {
+                        return mStop || ! mTasks.empty();
+                    });
+                    if (mTasks.empty())
+                    {
+                        mStop = false;
+                        return;
+                    }
+
+                    std::function<void()> task = mTasks.front();
+                    mTasks.pop_front();
+                    lock.unlock();
+                    task();
+                    lock.lock();
+                }
+            }
+
+            // once the tasks already queued have run
+            void stop()
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mStop = true;
+                mCondition.notify_one();
+            }
+
+        private:
+            std::mutex mMutex;
+            std::condition_variable mCondition;
+            std::deque<std::function<void()>> mTasks;
+            bool mStop = false;
+    };
+
+    /////////////////////////////////////////////////////////////////////////////////
+    // a cookie store with a thread of its own that writes what's changed at every flush
+    class SimulatedCookieStore :
+        public CookieStore
+    {
+        public:
+            SimulatedCookieStore(const std::string& file_name, double flush_latency) :
+                mFlushLatency(flush_latency),
+                mFlushes(0)
+            {
+                mFile = fopen(file_name.c_str(), "wb");
+                mThread = std::thread([this]()
+                {
+                    mQueue.run();
+                });
+            }
+
+            ~SimulatedCookieStore()
+            {
+                mQueue.stop();
+                mThread.join();
+                if (mFile != nullptr)
+                {
+                    fclose(mFile);
+                }
+            }
+
+            void setCookie(const CookieRecord& cookie, const std::function<void(bool success)>& done) override
+            {
+                mQueue.post([this, cookie, done]()
+                {
+                    bool ok = ! cookie.name.empty() && ! cookie.domain.empty();
+                    if (ok)
+                    {
+                        mCookies[key(cookie)] = cookie;
+                        mDirty.push_back(cookie);
+                    }
+                    if (done)
+                    {
+                        done(ok);
+                    }
+                });
+            }
+
+            void flush(const std::function<void()>& done) override
+            {
+                mQueue.post([this, done]()
+                {
+                    for (const CookieRecord& cookie : mDirty)
+                    {
+                        std::string line = cookieToJson(cookie);
+                        line += '\n';
+                        fwrite(line.data(), 1, line.size(), mFile);
+                    }
+                    mDirty.clear();
+                    fflush(mFile);
+#ifdef _WIN32
+                    _commit(_fileno(mFile));
+#else
+                    fsync(fileno(mFile));
+#endif
+                    if (mFlushLatency > 0.0)
+                    {
+                        std::this_thread::sleep_for(std::chrono::microseconds((long long)(mFlushLatency * 1000.0)));
+                    }
+                    ++mFlushes;
+
+                    if (done)
+                    {
+                        done();
+                    }
+                });
+            }
+
+            bool visitAll(const std::function<void(const CookieRecord& cookie)>& visit, const std::function<void()>& done) override
+            {
+                mQueue.post([this, visit, done]()
+                {
+                    for (const auto& entry : mCookies)
+                    {
+                        visit(entry.second);
+                    }
+                    done();
+                });
+                return true;
+            }
+
+            // once everything queued so far has been done
+            std::map<std::tuple<std::string, std::string, std::string>, CookieRecord> cookies()
+            {
+                std::mutex mutex;
+                std::condition_variable condition;
+                bool drained = false;
+                mQueue.post([&]()
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    drained = true;
+                    condition.notify_one();
+                });
+
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&]()
+                {
+                    return drained;
+                });
+                return mCookies;
+            }
+
+            size_t flushes() const
+            {
+                return mFlushes;
+            }
+
+        private:
+            static std::tuple<std::string, std::string, std::string> key(const CookieRecord& cookie)
+            {
+                return std::make_tuple(cookie.domain, cookie.path, cookie.name);
+            }
+
+            double mFlushLatency;
+            FILE* mFile;
+            std::map<std::tuple<std::string, std::string, std::string>, CookieRecord> mCookies;
+            std::vector<CookieRecord> mDirty;
+            std::atomic<size_t> mFlushes;
+
+            TaskQueue mQueue;
+            std::thread mThread;
+    };
+
+    // session and persistent cookies spread over a few hundred sites, like a long lived profile
+    std::vector<CookieRecord> makeCookies(size_t count)
+    {
+        std::vector<CookieRecord> cookies;
+        for (size_t i = 0; i < count; ++i)
+        {
+            CookieRecord cookie;
+            cookie.name = "cookie_" + std::to_string(i);
+            cookie.value = std::string(16 + (i * 37) % 200, (char)('a' + i % 26));
+            cookie.domain = ".site" + std::to_string(i % 300) + ".example.com";
+            cookie.path = (i % 5 == 0) ? "/account" : "/";
+            cookie.secure = (i % 2) == 0;
+            cookie.httpOnly = (i % 3) == 0;
+            cookie.hasExpires = (i % 4) != 0;
+            cookie.expires = cookie.hasExpires ? 1700000000.0 + (double)i * 60.0 : 0.0;
+            cookie.creation = 1546300800.0 + (double)i;
+            cookie.lastAccess = cookie.creation + 3600.0;
+            cookies.push_back(cookie);
+        }
+        if (! cookies.empty())
+        {
+            // something that needs escaping
+            cookies[0].value = "quote \" backslash \\ tab \t";
+        }
+        return cookies;
+    }
+
+    bool writeCookies(const std::string& file_name, const std::vector<CookieRecord>& cookies, const char* extra_line)
+    {
+        CookieWriter writer;
+        if (! writer.open(file_name))
+        {
+            return false;
+        }
+        for (size_t i = 0; i < cookies.size(); ++i)
+        {
+            writer.write(cookies[i]);
+        }
+        bool ok = writer.close();
+
+        if (ok && extra_line != nullptr)
+        {
+            FILE* file = fopen(file_name.c_str(), "ab");
+            ok = file != nullptr && fputs(extra_line, file) >= 0;
+            if (file != nullptr)
+            {
+                fclose(file);
+            }
+        }
+        return ok;
+    }
+
+    bool sameCookies(SimulatedCookieStore& store, const std::vector<CookieRecord>& cookies)
+    {
+        std::map<std::tuple<std::string, std::string, std::string>, CookieRecord> stored = store.cookies();
+        if (stored.size() != cookies.size())
+        {
+            return false;
+        }
+        for (const CookieRecord& cookie : cookies)
+        {
+            auto found = stored.find(std::make_tuple(cookie.domain, cookie.path, cookie.name));
+            if (found == stored.end() || ! (found->second == cookie))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    struct Result
+    {
+        double milliseconds;
+        double ownerMilliseconds;
+        size_t flushes;
+        size_t skipped;
+        bool ok;
+    };
+
+    // the thread this is called on is the owner - it runs what's posted to it until the import is done
+    Result importBatched(const std::string& file_name, const std::string& store_file, double flush_latency,
+                         size_t batch_size, const std::vector<CookieRecord>& cookies)
+    {
+        Result result = Result();
+        SimulatedCookieStore store(store_file, flush_latency);
+        TaskQueue owner;
+
+        CookieTransferSettings settings;
+        settings.batchSize = batch_size;
+        settings.post = [&owner](const std::function<void()>& task)
+        {
+            owner.post(task);
+        };
+        settings.done = [&owner, &result](const CookieTransferStats& stats)
+        {
+            result.milliseconds = stats.milliseconds;
+            result.ownerMilliseconds = stats.ownerMilliseconds;
+            result.skipped = stats.skipped;
+            owner.stop();
+        };
+
+        if (! importCookies(file_name, store, settings))
+        {
+            return result;
+        }
+        owner.run();
+
+        result.flushes = store.flushes();
+        result.ok = sameCookies(store, cookies);
+        return result;
+    }
+
+    // the apps' old setCookie() - a flush for every cookie and no callbacks, so it's only finished once
+    // the store has got through everything it was sent
+    Result importOneByOne(const std::string& file_name, const std::string& store_file, double flush_latency,
+                          const std::vector<CookieRecord>& cookies)
+    {
+        Result result = Result();
+        SimulatedCookieStore store(store_file, flush_latency);
+
+        double start = nowMicroseconds();
+        CookieReader reader;
+        if (! reader.open(file_name))
+        {
+            return result;
+        }
+        std::vector<CookieRecord> batch;
+        while (reader.read(batch, 1) != 0)
+        {
+            store.setCookie(batch.back(), nullptr);
+            store.flush(nullptr);
+            batch.clear();
+        }
+        result.skipped = reader.skipped();
+        result.ownerMilliseconds = (nowMicroseconds() - start) / 1000.0;
+
+        result.ok = sameCookies(store, cookies);
+        result.milliseconds = (nowMicroseconds() - start) / 1000.0;
+        result.flushes = store.flushes();
+        return result;
+    }
+
+    void report(const char* name, const Result& result, size_t count)
+    {
+        printf("  %-11s %9.1f ms %10.0f cookies/s %6zu flushes %9.1f ms on the owner's thread%s\n", name, result.milliseconds,
+               result.milliseconds > 0.0 ? count / (result.milliseconds / 1000.0) : 0.0, result.flushes, result.ownerMilliseconds,
+               result.ok ? "" : "  WRONG");
+    }
+
+    // export everything in the store and import it into a fresh one
+    bool roundTrip(const std::string& import_file, const std::string& export_file, const std::string& store_file,
+                   const std::vector<CookieRecord>& cookies)
+    {
+        SimulatedCookieStore store(store_file, 0.0);
+        TaskQueue owner;
+        CookieTransferSettings settings;
+        settings.batchSize = 1000;
+        settings.post = [&owner](const std::function<void()>& task)
+        {
+            owner.post(task);
+        };
+        bool ok = true;
+        settings.done = [&owner, &ok](const CookieTransferStats& stats)
+        {
+            ok = ok && stats.ok && stats.finished;
+            owner.stop();
+        };
+
+        if (! importCookies(import_file, store, settings))
+        {
+            return false;
+        }
+        owner.run();
+
+        if (! exportCookies(export_file, store, settings))
+        {
+            return false;
+        }
+        owner.run();
+
+        Result again = importBatched(export_file, store_file, 0.0, 1000, cookies);
+        return ok && again.ok && again.skipped == 0;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    size_t count = (size_t)atoi(getArg(argc, argv, "--cookies", "10000").c_str());
+    double flush_latency = atof(getArg(argc, argv, "--flush-latency", "0").c_str());
+
+    const std::string import_file = "cookie_bench_import.jsonl";
+    const std::string export_file = "cookie_bench_export.jsonl";
+    const std::string store_file = "cookie_bench_store.jsonl";
+
+    printf("cookie_bench: %zu cookies, %.1f ms added to every flush\n", count, flush_latency);
+
+    std::vector<CookieRecord> cookies = makeCookies(count);
+    if (! writeCookies(import_file, cookies, "{\"name\": \"not a cookie\"\n"))
+    {
+        printf("  unable to write %s\n", import_file.c_str());
+        return 1;
+    }
+
+    bool ok = true;
+
+    Result one_by_one = importOneByOne(import_file, store_file, flush_latency, cookies);
+    report("one by one", one_by_one, count);
+    ok = ok && one_by_one.ok;
+
+    const size_t batch_sizes[] = { 1, 100, 1000, 10000 };
+    for (size_t batch_size : batch_sizes)
+    {
+        Result batched = importBatched(import_file, store_file, flush_latency, batch_size, cookies);
+        char name[32];
+        snprintf(name, sizeof(name), "batch %zu", batch_size);
+        report(name, batched, count);
+        ok = ok && batched.ok;
+
+        if (batched.skipped != 1)
+        {
+            printf("  %zu lines skipped, expected the 1 that isn't a cookie\n", batched.skipped);
+            ok = false;
+        }
+    }
+
+    if (! roundTrip(import_file, export_file, store_file, cookies))
+    {
+        printf("  exported cookies didn't import back the same\n");
+        ok = false;
+    }
+
+    printf("  check: %s\n", ok ? "every cookie was imported, and exported and imported again" : "FAILED");
+
+    remove(import_file.c_str());
+    remove(export_file.c_str());
+    remove(store_file.c_str());
+
+    return ok ? 0 : 1;
+}
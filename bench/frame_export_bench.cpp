@@ -0,0 +1,301 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// publishes 1080p frames into a shared memory frame ring (src/frame_ring.h)
+// while another process reads them - once at 60 frames/s, the rate the apps
+// paint at, with a reader that keeps up, and once as fast as it can with a
+// reader that takes longer per frame than the writer does. Each frame moves a block about the page, every 60th changes all of it
+// and the first row carries the frame's sequence number and, every 16th
+// frame, a checksum of the rest of the page. The reader checks frames arrive
+// in order, that the frames it read and found still valid have the right
+// sequence number and checksum (so the partial copies into each slot are
+// right) and reports what it received, dropped and lost to being overwritten
+// mid read, along with publish to read latency. The writer never waits for
+// the reader. Exits with 1 if anything arrived out of order or didn't match,
+// or if the reader that keeps up missed a single frame
+//
+//     frame_export_bench [--frames <frames>] [--paced-frames <frames at 60/s>] [--slots <ring slots>]
+//                        [--slow-read <ms per frame>]
+//     frame_export_bench --reader <name> [--every-frame]    (what the child process runs)
+
+#include "frame_ring.h"
+
+#include "bench_util.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const int kWidth = 1920;
+    const int kHeight = 1080;
+    const int kBlockSize = 128;
+
+    uint64_t nowNanoseconds()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // everything below the first row
+    uint64_t frameChecksum(const unsigned char* pixels, int width, int height, int stride_bytes)
+    {
+        uint64_t hash = 1469598103934665603ull;
+        for (int y = 1; y < height; ++y)
+        {
+            const uint64_t* row = (const uint64_t*)(pixels + (size_t)y * stride_bytes);
+            for (int x = 0; x < width * kFrameRingDepth / 8; ++x)
+            {
+                hash = (hash ^ row[x]) * 1099511628211ull;
+            }
+        }
+        return hash;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+// the child process - every_frame fails it if a single frame was dropped or overwritten
+int runReader(const std::string& name, double read_cost, bool every_frame)
+{
+    FrameRingReader reader;
+    if (! reader.open(name))
+    {
+        printf("reader: unable to open %s\n", name.c_str());
+        return 1;
+    }
+
+    size_t received = 0;
+    size_t torn = 0;
+    size_t out_of_order = 0;
+    size_t mismatched = 0;
+    size_t checksums = 0;
+    uint64_t last_sequence = 0;
+    Samples latency;
+
+    FrameView view;
+    for (;;)
+    {
+        if (! reader.next(view))
+        {
+            if (reader.writerClosed())
+            {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+
+        latency.add((nowNanoseconds() - view.timestamp) / 1000.0);
+        if (view.sequence <= last_sequence)
+        {
+            ++out_of_order;
+        }
+        last_sequence = view.sequence;
+
+        // use the pixels where they are
+        uint64_t stamp[2];
+        memcpy(stamp, view.pixels, sizeof(stamp));
+        uint64_t checksum = stamp[1] != 0 ? frameChecksum(view.pixels, view.width, view.height, view.stride) : 0;
+
+        if (read_cost > 0.0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds((int)(read_cost * 1000.0)));
+        }
+
+        // only a frame that's still there afterwards has to be right
+        if (! reader.valid(view))
+        {
+            ++torn;
+            continue;
+        }
+
+        ++received;
+        if (stamp[0] != view.sequence || (stamp[1] != 0 && checksum != stamp[1]))
+        {
+            ++mismatched;
+        }
+        checksums += stamp[1] != 0 ? 1 : 0;
+    }
+
+    bool ok = out_of_order == 0 && mismatched == 0 && received > 0;
+    bool all = reader.dropped() == 0 && torn == 0;
+    printf("  reader:  %6zu frames received (%zu checksummed), %6llu dropped, %4zu overwritten while reading, latency p50 %8.1f us p99 %8.1f us, %s%s\n",
+           received, checksums, (unsigned long long)reader.dropped(), torn, latency.percentile(50), latency.percentile(99),
+           ok ? "in order and intact" : "OUT OF ORDER OR CORRUPT", every_frame && ! all ? " - BUT FRAMES WERE MISSED" : "");
+    ok = ok && (all || ! every_frame);
+    fflush(stdout);
+    return ok ? 0 : 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+// start this program again as the reader
+class ReaderProcess
+{
+    public:
+        bool start(const char* program, const std::string& name, double read_cost, bool every_frame)
+        {
+            std::string cost = std::to_string(read_cost);
+#ifdef _WIN32
+            std::string command_line = std::string("\"") + program + "\" --reader " + name + " --slow-read " + cost + (every_frame ? " --every-frame" : "");
+            STARTUPINFOA startup_info;
+            memset(&startup_info, 0, sizeof(startup_info));
+            startup_info.cb = sizeof(startup_info);
+            return CreateProcessA(NULL, &command_line[0], NULL, NULL, FALSE, 0, NULL, NULL, &startup_info, &mProcess) != 0;
+#else
+            fflush(stdout);
+            mPid = fork();
+            if (mPid == 0)
+            {
+                execl(program, program, "--reader", name.c_str(), "--slow-read", cost.c_str(), every_frame ? "--every-frame" : (char*)nullptr, (char*)nullptr);
+                _exit(1);
+            }
+            return mPid > 0;
+#endif
+        }
+
+        // the reader's exit code
+        int wait()
+        {
+#ifdef _WIN32
+            WaitForSingleObject(mProcess.hProcess, INFINITE);
+            DWORD exit_code = 1;
+            GetExitCodeProcess(mProcess.hProcess, &exit_code);
+            CloseHandle(mProcess.hProcess);
+            CloseHandle(mProcess.hThread);
+            return (int)exit_code;
+#else
+            int status = 0;
+            waitpid(mPid, &status, 0);
+            return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+#endif
+        }
+
+    private:
+#ifdef _WIN32
+        PROCESS_INFORMATION mProcess;
+#else
+        pid_t mPid;
+#endif
+};
+
+// frame_rate 0 publishes as fast as it can, otherwise the reader has to get every frame
+bool runWriter(const char* program, int frames, int slots, double frame_rate, double read_cost)
+{
+    std::string name = "cef_opengl_frame_bench_" + std::to_string(nowNanoseconds() % 1000000);
+
+    FrameRingWriter* writer = new FrameRingWriter;
+    if (! writer->create(name, kWidth, kHeight, slots))
+    {
+        printf("unable to create shared memory %s\n", name.c_str());
+        delete writer;
+        return false;
+    }
+
+    std::vector<unsigned char> page((size_t)kWidth * kHeight * kFrameRingDepth);
+    fillPattern(page, 1);
+
+    ReaderProcess reader;
+    if (! reader.start(program, name, read_cost, frame_rate > 0.0))
+    {
+        printf("unable to start the reader\n");
+        delete writer;
+        return false;
+    }
+
+    // give the reader a moment to map the ring
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    Samples publish_times;
+    double start = nowMicroseconds();
+    const std::chrono::steady_clock::time_point paced_start = std::chrono::steady_clock::now();
+    for (int frame = 1; frame <= frames; ++frame)
+    {
+        if (frame_rate > 0.0)
+        {
+            std::this_thread::sleep_until(paced_start + std::chrono::microseconds((long long)((frame - 1) * 1.0e6 / frame_rate)));
+        }
+
+        std::vector<FrameRect> dirty;
+        if (frame % 60 == 0)
+        {
+            fillPattern(page, frame);
+            FrameRect whole = { 0, 0, kWidth, kHeight };
+            dirty.push_back(whole);
+        }
+        else
+        {
+            // a block somewhere new each frame - slots that are a few frames behind need all of them
+            FrameRect block = { (frame * 197) % (kWidth - kBlockSize), 1 + (frame * 89) % (kHeight - kBlockSize - 1), kBlockSize, kBlockSize };
+            for (int y = block.y; y < block.y + block.height; ++y)
+            {
+                memset(&page[((size_t)y * kWidth + block.x) * kFrameRingDepth], frame & 0xff, (size_t)block.width * kFrameRingDepth);
+            }
+            dirty.push_back(block);
+        }
+
+        // the sequence number this frame will get and every so often a checksum of the page
+        uint64_t stamp[2] = { (uint64_t)frame, frame % 16 == 0 ? frameChecksum(page.data(), kWidth, kHeight, kWidth * kFrameRingDepth) : 0 };
+        memcpy(page.data(), stamp, sizeof(stamp));
+        FrameRect stamp_rect = { 0, 0, 4, 1 };
+        dirty.push_back(stamp_rect);
+
+        double publish_start = nowMicroseconds();
+        writer->publish(page.data(), kWidth, kHeight, kWidth, dirty.data(), dirty.size(), nowNanoseconds());
+        publish_times.add(nowMicroseconds() - publish_start);
+    }
+    double seconds = (nowMicroseconds() - start) / 1.0e6;
+
+    const FrameRingWriterStats& stats = writer->stats();
+    printf("  writer:  %6zu frames at %7.0f frames/s, publish p50 %7.1f us p99 %7.1f us, %.1f MB/frame copied into the ring\n",
+           stats.published, stats.published / seconds, publish_times.percentile(50), publish_times.percentile(99),
+           stats.bytesCopied / (double)stats.published / (1024.0 * 1024.0));
+    fflush(stdout);
+
+    // tells the reader there's nothing more coming
+    delete writer;
+
+    return reader.wait() == 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const double read_cost = atof(getArg(argc, argv, "--slow-read", "0").c_str());
+
+    std::string reader_name = getArg(argc, argv, "--reader", "");
+    if (! reader_name.empty())
+    {
+        return runReader(reader_name, read_cost, hasArg(argc, argv, "--every-frame"));
+    }
+
+    const int frames = atoi(getArg(argc, argv, "--frames", "3000").c_str());
+    const int paced_frames = atoi(getArg(argc, argv, "--paced-frames", "600").c_str());
+    const int slots = atoi(getArg(argc, argv, "--slots", "4").c_str());
+    const double slow_read = hasArg(argc, argv, "--slow-read") ? read_cost : 5.0;
+
+    printf("frame_export_bench: %d %dx%d frames through a %d slot ring\n", frames, kWidth, kHeight, slots);
+
+    bool ok = true;
+    printf("reader keeping up with %d frames at 60 frames/s\n", paced_frames);
+    ok = runWriter(argv[0], paced_frames, slots, 60.0, 0.0) && ok;
+    printf("reader taking %.1f ms per frame, writer flat out\n", slow_read);
+    ok = runWriter(argv[0], frames, slots, 0.0, slow_read) && ok;
+
+    return ok ? 0 : 1;
+}
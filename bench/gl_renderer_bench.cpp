@@ -0,0 +1,320 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// draws a grid of browser panels into an offscreen 1080p framebuffer - a
+// texture per panel plus a translucent popup hanging off every fourth panel,
+// clipped to it - with the immediate mode renderer and with the shader and
+// instancing one (see src/gl_renderer.h), its vertex buffer orphaned every
+// frame and persistently mapped. Each gets textures in the layout it wants.
+// Then the same panels in a texture atlas, drawn with TextureAtlas::draw() and
+// with the modern renderer. Reports the time to upload every panel, the CPU
+// time to submit a frame, the time for the frame to complete and the draw
+// calls used. The frames are read back and have to match the immediate mode
+// ones - exits with 1 if they don't
+//
+//     gl_renderer_bench [--frames <count>] [--panels <count>] [--page-size <texels>]
+
+#include "compositor.h"
+#include "gl_renderer.h"
+#include "texture_atlas.h"
+
+#include "bench_util.h"
+#include "headless_gl.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+
+namespace
+{
+    const int kTargetWidth = 1920;
+    const int kTargetHeight = 1080;
+    const int kPopupWidth = 160;
+    const int kPopupHeight = 120;
+    // how far two frames' channels can be apart and still count as the same
+    const int kTolerance = 1;
+
+    struct Result
+    {
+        double upload;
+        double submit;
+        double frame;
+        size_t drawCalls;
+    };
+
+    std::vector<Rect> gridLayout(int panels)
+    {
+        int columns = 1;
+        while (columns * columns < panels)
+        {
+            ++columns;
+        }
+        int rows = (panels + columns - 1) / columns;
+
+        std::vector<Rect> rects;
+        for (int i = 0; i < panels; ++i)
+        {
+            int column = i % columns;
+            int row = i / columns;
+            int x = column * kTargetWidth / columns;
+            int y = row * kTargetHeight / rows;
+            rects.push_back(Rect(x, y, (column + 1) * kTargetWidth / columns - x, (row + 1) * kTargetHeight / rows - y));
+        }
+        return rects;
+    }
+
+    // CEF's pixels are premultiplied - keep the pattern that way so blending it means something
+    void fillPremultiplied(std::vector<unsigned char>& pixels, unsigned int seed)
+    {
+        fillPattern(pixels, seed);
+        for (size_t i = 0; i < pixels.size(); i += kDepth)
+        {
+            for (size_t c = 0; c < 3; ++c)
+            {
+                pixels[i + c] = (unsigned char)(pixels[i + c] * pixels[i + 3] / 255);
+            }
+        }
+    }
+
+    void upload(GLuint texture, TextureLayout layout, const Rect& rect, const std::vector<unsigned char>& pixels)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, rect.width, rect.height, pageUploadFormat(layout), GL_UNSIGNED_BYTE, pixels.data());
+    }
+
+    void report(const char* name, int panels, const Result& result)
+    {
+        printf("%5d panels %-17s upload %8.1f us | submit p50 %8.1f us | frame p50 %8.1f us | %5zu draw calls per frame\n",
+               panels, name, result.upload, result.submit, result.frame, result.drawCalls);
+    }
+
+    // the biggest difference between two frames in any channel
+    int compare(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b)
+    {
+        if (a.size() != b.size())
+        {
+            return 256;
+        }
+
+        int worst = 0;
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            int difference = abs((int)a[i] - (int)b[i]);
+            worst = (difference > worst) ? difference : worst;
+        }
+        return worst;
+    }
+
+    // a texture per panel and the popups - what BrowserManager::render() draws without an atlas
+    Result runPanels(QuadRenderer& renderer, EGLRenderSurface& surface, int panels, int frames, std::vector<unsigned char>& image)
+    {
+        const TextureLayout layout = renderer.layout();
+        std::vector<Rect> grid = gridLayout(panels);
+
+        std::vector<std::vector<unsigned char> > pixels(panels);
+        std::vector<GLuint> textures(panels);
+        for (int i = 0; i < panels; ++i)
+        {
+            pixels[i].resize((size_t)grid[i].area() * kDepth);
+            fillPremultiplied(pixels[i], i + 1);
+            textures[i] = createPageTexture(grid[i].width, grid[i].height, layout);
+        }
+
+        std::vector<unsigned char> popup_pixels((size_t)kPopupWidth * kPopupHeight * kDepth);
+        fillPremultiplied(popup_pixels, 12345);
+        GLuint popup = createPageTexture(kPopupWidth, kPopupHeight, layout);
+        upload(popup, layout, Rect(0, 0, kPopupWidth, kPopupHeight), popup_pixels);
+
+        // a full repaint of every panel - what the layout changes on the way in and out of the texture
+        Samples upload_times;
+        for (int repeat = 0; repeat < 5; ++repeat)
+        {
+            double t0 = nowMicroseconds();
+            for (int i = 0; i < panels; ++i)
+            {
+                upload(textures[i], layout, grid[i], pixels[i]);
+            }
+            glFinish();
+            upload_times.add(nowMicroseconds() - t0);
+        }
+
+        Samples submit_times;
+        Samples frame_times;
+        size_t draw_calls = renderer.stats().drawCalls;
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            double t0 = nowMicroseconds();
+            surface.makeCurrent();
+            glClear(GL_COLOR_BUFFER_BIT);
+            renderer.begin(kTargetWidth, kTargetHeight);
+            for (int i = 0; i < panels; ++i)
+            {
+                renderer.add(TexturedQuad(textures[i], grid[i], 0.0f, 0.0f, 1.0f, 1.0f));
+
+                // hangs off the right of the panel and gets clipped to it
+                if (i % 4 == 0)
+                {
+                    TexturedQuad quad(popup, Rect(grid[i].x + grid[i].width - kPopupWidth / 2, grid[i].y + 4, kPopupWidth, kPopupHeight), 0.0f, 0.0f, 1.0f, 1.0f);
+                    quad.clip = grid[i];
+                    quad.blend = true;
+                    renderer.add(quad);
+                }
+            }
+            renderer.end();
+            double t1 = nowMicroseconds();
+            surface.present();
+            double t2 = nowMicroseconds();
+
+            submit_times.add(t1 - t0);
+            frame_times.add(t2 - t0);
+        }
+
+        Result result;
+        result.upload = upload_times.percentile(50);
+        result.submit = submit_times.percentile(50);
+        result.frame = frame_times.percentile(50);
+        result.drawCalls = (renderer.stats().drawCalls - draw_calls) / (frames > 0 ? frames : 1);
+
+        surface.readPixels(image);
+        glDeleteTextures(panels, textures.data());
+        glDeleteTextures(1, &popup);
+        return result;
+    }
+
+    // every panel in an atlas - drawn by the atlas itself when there is no renderer
+    Result runAtlas(QuadRenderer* renderer, EGLRenderSurface& surface, int panels, int frames, int page_size, std::vector<unsigned char>& image)
+    {
+        TextureAtlas atlas(page_size, renderer ? renderer->layout() : TEXTURE_BGRA);
+        std::vector<Rect> grid = gridLayout(panels);
+
+        std::vector<std::unique_ptr<AtlasUploadBackend> > backends;
+        std::vector<std::vector<unsigned char> > pixels(panels);
+        for (int i = 0; i < panels; ++i)
+        {
+            backends.push_back(std::unique_ptr<AtlasUploadBackend>(new AtlasUploadBackend(&atlas, grid[i].width, grid[i].height)));
+            pixels[i].resize((size_t)grid[i].area() * kDepth);
+            fillPremultiplied(pixels[i], i + 1);
+        }
+
+        Samples upload_times;
+        for (int repeat = 0; repeat < 5; ++repeat)
+        {
+            double t0 = nowMicroseconds();
+            for (int i = 0; i < panels; ++i)
+            {
+                backends[i]->upload(Rect(0, 0, grid[i].width, grid[i].height), pixels[i].data(), grid[i].width);
+            }
+            glFinish();
+            upload_times.add(nowMicroseconds() - t0);
+        }
+
+        Samples submit_times;
+        Samples frame_times;
+        size_t draw_calls = renderer ? renderer->stats().drawCalls : atlas.stats().drawCalls;
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            double t0 = nowMicroseconds();
+            surface.makeCurrent();
+            glClear(GL_COLOR_BUFFER_BIT);
+            if (renderer)
+            {
+                renderer->begin(kTargetWidth, kTargetHeight);
+                for (int i = 0; i < panels; ++i)
+                {
+                    renderer->add(atlas.quad(backends[i]->handle(), grid[i]));
+                }
+                renderer->end();
+            }
+            else
+            {
+                glColor3f(1.0f, 1.0f, 1.0f);
+                for (int i = 0; i < panels; ++i)
+                {
+                    atlas.addQuad(backends[i]->handle(), grid[i]);
+                }
+                atlas.draw();
+            }
+            double t1 = nowMicroseconds();
+            surface.present();
+            double t2 = nowMicroseconds();
+
+            submit_times.add(t1 - t0);
+            frame_times.add(t2 - t0);
+        }
+
+        Result result;
+        result.upload = upload_times.percentile(50);
+        result.submit = submit_times.percentile(50);
+        result.frame = frame_times.percentile(50);
+        result.drawCalls = ((renderer ? renderer->stats().drawCalls : atlas.stats().drawCalls) - draw_calls) / (frames > 0 ? frames : 1);
+
+        surface.readPixels(image);
+        return result;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const int frames = atoi(getArg(argc, argv, "--frames", "30").c_str());
+    const int only_panels = atoi(getArg(argc, argv, "--panels", "0").c_str());
+    const int page_size = atoi(getArg(argc, argv, "--page-size", "2048").c_str());
+
+    EGLRenderSurface surface;
+    if (! surface.create(kTargetWidth, kTargetHeight))
+    {
+        return 1;
+    }
+
+    LegacyQuadRenderer legacy;
+    ModernQuadRenderer modern;
+    ModernQuadRenderer persistent(true);
+    if (! modern.create() || ! persistent.create())
+    {
+        fprintf(stderr, "gl_renderer_bench: the context can't do the modern renderer\n");
+        return 1;
+    }
+
+    bool ok = true;
+    std::vector<unsigned char> legacy_image;
+    std::vector<unsigned char> modern_image;
+
+    const int panel_counts[] = { 16, 256, 1024 };
+    for (int panels : panel_counts)
+    {
+        if (only_panels != 0 && panels != only_panels)
+        {
+            continue;
+        }
+
+        report("legacy", panels, runPanels(legacy, surface, panels, frames, legacy_image));
+        report("modern", panels, runPanels(modern, surface, panels, frames, modern_image));
+        int difference = compare(legacy_image, modern_image);
+        report("modern persistent", panels, runPanels(persistent, surface, panels, frames, modern_image));
+        difference = std::max(difference, compare(legacy_image, modern_image));
+        if (difference > kTolerance)
+        {
+            printf("  frames differ by up to %d\n", difference);
+            ok = false;
+        }
+
+        report("legacy atlas", panels, runAtlas(nullptr, surface, panels, frames, page_size, legacy_image));
+        report("modern atlas", panels, runAtlas(&modern, surface, panels, frames, page_size, modern_image));
+        difference = compare(legacy_image, modern_image);
+        if (difference > kTolerance)
+        {
+            printf("  atlas frames differ by up to %d\n", difference);
+            ok = false;
+        }
+    }
+
+    printf("  modern persistent: %zu vertex buffer stalls\n", persistent.stats().bufferStalls);
+    printf("  check: %s\n", ok ? "both renderers draw the same frames" : "FAILED");
+    return ok ? 0 : 1;
+}
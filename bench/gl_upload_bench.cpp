@@ -0,0 +1,133 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// compares direct glTexSubImage2D uploads with the pixel buffer object ring on
+// a headless (EGL surfaceless) context. The number that matters is the time
+// spent on the calling thread - in the app that is the CEF UI thread, inside
+// OnPaint - so that is what is reported per frame, along with the overall
+// frame rate once everything has been flushed through
+//
+//     gl_upload_bench [--scenario all|full_frame|small_dirty|popup_scroll] [--frames <count>]
+
+#include "compositor.h"
+#include "gl_upload.h"
+
+#include "bench_util.h"
+#include "headless_gl.h"
+#include "paint_scenarios.h"
+
+#include <cstdlib>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+struct UploadConfig
+{
+    const char* name;
+    GLUploadBackend::Mode mode;
+    int numBuffers;
+    bool allowPersistent;
+};
+
+void run(const std::string& scenario_name, const std::vector<PaintEvent>& events, const UploadConfig& config)
+{
+    const int width = 800;
+    const int height = 1200;
+
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_BGRA_EXT, GL_UNSIGNED_BYTE, 0);
+
+    std::vector<unsigned char> buffer((size_t)width * height * kDepth);
+    fillPattern(buffer, 7);
+
+    Samples ui_times;
+    {
+        GLUploadBackend backend(width, height, config.mode, config.numBuffers, config.allowPersistent);
+        Compositor compositor(&backend);
+
+        double start = nowMicroseconds();
+        for (const PaintEvent& event : events)
+        {
+            if (event.type == PaintEvent::POPUP_SIZE)
+            {
+                compositor.popupSize(event.popupRect);
+                continue;
+            }
+            if (event.type == PaintEvent::POPUP_SHOW)
+            {
+                compositor.popupShow(event.show);
+                continue;
+            }
+
+            buffer[ui_times.count() % buffer.size()]++;
+
+            // everything the UI thread does in OnPaint
+            double t0 = nowMicroseconds();
+            RectList damage = (event.type == PaintEvent::VIEW) ?
+                              compositor.paintView(event.dirtyRects, buffer.data(), event.width, event.height) :
+                              compositor.paintPopup(event.dirtyRects, buffer.data(), event.width, event.height);
+            compositor.upload(damage);
+            compositor.endFrame();
+            ui_times.add(nowMicroseconds() - t0);
+
+            // stands in for the SwapBuffers at the end of each trip round the main loop
+            glFlush();
+        }
+        glFinish();
+        double elapsed = nowMicroseconds() - start;
+
+        const GLUploadStats& stats = backend.stats();
+        printf("%-13s %-22s UI thread mean %8.1f us p50 %8.1f us p99 %8.1f us | %8.1f frames/s | fence stalls %zu direct fallbacks %zu\n",
+               scenario_name.c_str(), config.name, ui_times.mean(), ui_times.percentile(50), ui_times.percentile(99),
+               ui_times.count() / (elapsed / 1e6), stats.fenceStalls, stats.directFallbacks);
+    }
+
+    glDeleteTextures(1, &texture);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const std::string scenario = getArg(argc, argv, "--scenario", "all");
+    const int frames = atoi(getArg(argc, argv, "--frames", "300").c_str());
+
+    if (! createHeadlessGLContext())
+    {
+        return 1;
+    }
+
+    const UploadConfig configs[] =
+    {
+        { "direct", GLUploadBackend::DIRECT, 0, false },
+        { "pbo mapped x2", GLUploadBackend::PBO_RING, 2, false },
+        { "pbo mapped x3", GLUploadBackend::PBO_RING, 3, false },
+        { "pbo persistent x2", GLUploadBackend::PBO_RING, 2, true },
+        { "pbo persistent x3", GLUploadBackend::PBO_RING, 3, true },
+        { "pbo persistent x4", GLUploadBackend::PBO_RING, 4, true },
+    };
+
+    for (const UploadConfig& config : configs)
+    {
+        if (scenario == "all" || scenario == "full_frame")
+        {
+            run("full_frame", fullFrameScenario(frames), config);
+        }
+        if (scenario == "all" || scenario == "small_dirty")
+        {
+            run("small_dirty", smallDirtyScenario(frames), config);
+        }
+        if (scenario == "all" || scenario == "popup_scroll")
+        {
+            run("popup_scroll", popupScrollScenario(frames), config);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,219 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// the paint and present path of the headless app (src/cef_opengl_headless.cpp)
+// without CEF - paint scenarios go through the compositor, are drawn onto each
+// render surface (see src/render_surface.h) and presented, to see how many
+// frames a CPU only machine manages per core. The null surface keeps the page
+// in memory and draws nothing, the EGL one uploads and draws it into an
+// offscreen framebuffer in a surfaceless context (llvmpipe with no GPU).
+// Frames per second per core is frames over the process CPU time, so llvmpipe's
+// own threads are counted. Afterwards the EGL surface is read back and checked
+// against the compositor's page - exits with 1 if it doesn't match. The EGL
+// surface draws with the app's default renderer (see src/gl_renderer.h) unless
+// it's told otherwise
+//
+//     headless_bench [--frames <frames per scenario>] [--surface null|egl|all] [--renderer modern|legacy]
+
+#include "compositor.h"
+#include "pump_scheduler.h"
+#include "render_surface.h"
+
+#ifdef HEADLESS_HAVE_EGL
+#include "egl_surface.h"
+#include "gl_renderer.h"
+#include "gl_upload.h"
+#endif
+
+#include "bench_util.h"
+#include "paint_scenarios.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+namespace
+{
+    const int kPageWidth = 800;
+    const int kPageHeight = 1200;
+}
+
+class QuadRenderer;
+
+/////////////////////////////////////////////////////////////////////////////////
+// the bits of the headless app's render handler and render() that matter here -
+// renderer is null when the surface has no GL
+class Page
+{
+    public:
+        Page(RenderSurface* surface, QuadRenderer* renderer) :
+            mSurface(surface),
+            mRenderer(renderer),
+            mTexture(0)
+        {
+#ifdef HEADLESS_HAVE_EGL
+            if (renderer != nullptr)
+            {
+                // the upload backend makes its own texture with TEXTURE_SWIZZLED
+                if (renderer->layout() == TEXTURE_BGRA)
+                {
+                    mTexture = createPageTexture(kPageWidth, kPageHeight, TEXTURE_BGRA);
+                }
+                mUploadBackend.reset(new GLUploadBackend(kPageWidth, kPageHeight, GLUploadBackend::DIRECT, 1, true, renderer->layout()));
+            }
+#endif
+            if (! mUploadBackend)
+            {
+                mUploadBackend.reset(new NullUploadBackend);
+            }
+            mCompositor.reset(new Compositor(mUploadBackend.get()));
+        }
+
+        ~Page()
+        {
+            mCompositor.reset();
+            mUploadBackend.reset();
+#ifdef HEADLESS_HAVE_EGL
+            if (mTexture != 0)
+            {
+                glDeleteTextures(1, &mTexture);
+            }
+#endif
+        }
+
+        void paint(const PaintEvent& event, const unsigned char* buffer)
+        {
+#ifdef HEADLESS_HAVE_EGL
+            if (mTexture != 0)
+            {
+                glBindTexture(GL_TEXTURE_2D, mTexture);
+            }
+#endif
+            RectList damage = mCompositor->paintView(event.dirtyRects, buffer, event.width, event.height);
+            mCompositor->upload(damage);
+            mCompositor->endFrame();
+        }
+
+        void draw()
+        {
+            mSurface->makeCurrent();
+#ifdef HEADLESS_HAVE_EGL
+            if (mRenderer != nullptr)
+            {
+                const GLUploadBackend* gl_backend = (const GLUploadBackend*)mUploadBackend.get();
+                float u = (float)gl_backend->width() / gl_backend->textureWidth();
+                float v = (float)gl_backend->height() / gl_backend->textureHeight();
+                GLuint texture = (mTexture != 0) ? mTexture : gl_backend->texture();
+
+                glClear(GL_COLOR_BUFFER_BIT);
+                mRenderer->begin(kPageWidth, kPageHeight);
+                mRenderer->add(TexturedQuad(texture, Rect(0, 0, kPageWidth, kPageHeight), 0.0f, 0.0f, u, v));
+                mRenderer->end();
+            }
+#endif
+            mSurface->present();
+        }
+
+        const Compositor& compositor() const
+        {
+            return *mCompositor;
+        }
+
+    private:
+        RenderSurface* mSurface;
+        QuadRenderer* mRenderer;
+        unsigned int mTexture;
+        std::unique_ptr<UploadBackend> mUploadBackend;
+        std::unique_ptr<Compositor> mCompositor;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+void run(const char* name, RenderSurface* surface, QuadRenderer* renderer, const std::vector<PaintEvent>& events)
+{
+    Page page(surface, renderer);
+
+    std::vector<unsigned char> buffer((size_t)kPageWidth * kPageHeight * kDepth);
+    fillPattern(buffer, 1);
+
+    Samples frame_times;
+    double cpu_start = processCpuTime();
+    double start = nowMicroseconds();
+    for (const PaintEvent& event : events)
+    {
+        // make the buffer look like it changed so nothing can be cached
+        buffer[frame_times.count() % buffer.size()]++;
+
+        double frame_start = nowMicroseconds();
+        page.paint(event, buffer.data());
+        page.draw();
+        frame_times.add(nowMicroseconds() - frame_start);
+    }
+    double seconds = (nowMicroseconds() - start) / 1.0e6;
+    double cpu_seconds = (processCpuTime() - cpu_start) / 1000.0;
+
+    printf("  %-5s %-12s %7.1f frames/s, CPU %5.0f%% of a core, %7.1f frames/s per core, frame p50 %8.1f us p99 %8.1f us\n",
+           surface->name(), name, events.size() / seconds, cpu_seconds / seconds * 100.0,
+           events.size() / cpu_seconds, frame_times.percentile(50), frame_times.percentile(99));
+}
+
+#ifdef HEADLESS_HAVE_EGL
+// what was drawn should be the page pixel for pixel
+bool checkReadback(EGLRenderSurface* surface, QuadRenderer* renderer)
+{
+    Page page(surface, renderer);
+
+    std::vector<unsigned char> buffer((size_t)kPageWidth * kPageHeight * kDepth);
+    fillPattern(buffer, 3);
+    page.paint(viewEvent(kPageWidth, kPageHeight, Rect(0, 0, kPageWidth, kPageHeight)), buffer.data());
+    page.draw();
+
+    std::vector<unsigned char> pixels;
+    surface->readPixels(pixels);
+
+    bool ok = pixels.size() == buffer.size() && memcmp(pixels.data(), page.compositor().pixels(), pixels.size()) == 0;
+    printf("  egl   readback     %s\n", ok ? "matches the page" : "DOESN'T MATCH THE PAGE");
+    return ok;
+}
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const int frames = atoi(getArg(argc, argv, "--frames", "300").c_str());
+    const std::string which = getArg(argc, argv, "--surface", "all");
+
+    printf("headless_bench: %d frames of %d x %d per scenario\n", frames, kPageWidth, kPageHeight);
+
+    bool ok = true;
+    if (which == "all" || which == "null")
+    {
+        NullRenderSurface surface(kPageWidth, kPageHeight);
+        run("full_frame", &surface, nullptr, fullFrameScenario(frames));
+        run("small_dirty", &surface, nullptr, smallDirtyScenario(frames));
+    }
+
+#ifdef HEADLESS_HAVE_EGL
+    if (which == "all" || which == "egl")
+    {
+        EGLRenderSurface surface;
+        if (! surface.create(kPageWidth, kPageHeight))
+        {
+            return 1;
+        }
+
+        std::unique_ptr<QuadRenderer> renderer(createQuadRenderer(getArg(argc, argv, "--renderer", "modern") == "modern"));
+        run("full_frame", &surface, renderer.get(), fullFrameScenario(frames));
+        run("small_dirty", &surface, renderer.get(), smallDirtyScenario(frames));
+        ok = checkReadback(&surface, renderer.get());
+    }
+#endif
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+#ifndef _HEADLESS_GL_H_
+#define _HEADLESS_GL_H_
+
+#include "egl_surface.h"
+
+/////////////////////////////////////////////////////////////////////////////////
+// an OpenGL context with no window or display (EGL_MESA_platform_surfaceless) -
+// with no GPU Mesa gives us llvmpipe, which is what the GL benchmarks run on.
+// The headless app uses the same context (see src/egl_surface.h)
+inline bool createHeadlessGLContext()
+{
+    return createSurfacelessGLContext();
+}
+
+#endif // _HEADLESS_GL_H_
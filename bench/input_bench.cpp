@@ -0,0 +1,259 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// replays a synthetic stream of window input - drags with a 1000Hz mouse,
+// hovering and fast wheel flicks - through the app's InputQueue into a
+// simulated renderer, once sending every event straight on (the way the app
+// used to) and once merging moves and wheel deltas to one per frame, and
+// reports input to paint latency for each kind of event. The simulation runs
+// on a virtual clock so it takes no time and gives the same answer every run.
+//
+// The renderer handles the events it is sent one at a time and paints on each
+// vsync it isn't busy for if anything changed - events it hasn't got to yet
+// wait for a later paint. Each event is matched to the first paint after the
+// renderer handled it. It also checks button presses and
+// releases arrive in order with the mouse where it was when they happened -
+// exits with 1 if not
+//
+//     input_bench [--seconds <virtual seconds>] [--event-cost <ms>] [--paint-cost <ms>]
+
+#include "input_queue.h"
+
+#include "bench_util.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+
+namespace
+{
+    const double kFrameInterval = 1000.0 / 60.0;
+    const double kStep = 0.05;
+
+    // the mouse reports every millisecond, the wheel every 8 while it's being flicked
+    const double kMouseInterval = 1.0;
+    const double kWheelInterval = 8.0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+// a second of input repeated: a 500ms drag, 300ms of hovering and a 200ms wheel flick
+std::vector<InputEvent> inputScript(double seconds)
+{
+    std::vector<InputEvent> script;
+
+    for (double cycle = 0.0; cycle < seconds * 1000.0; cycle += 1000.0)
+    {
+        auto add = [&script](InputEvent::Type type, double time, int x, int y)
+        {
+            InputEvent event;
+            event.type = type;
+            event.timestamp = time;
+            event.x = x;
+            event.y = y;
+            script.push_back(event);
+            return &script.back();
+        };
+
+        auto position = [](double time, int& x, int& y)
+        {
+            x = 400 + (int)(300.0 * std::cos(time / 200.0));
+            y = 300 + (int)(200.0 * std::sin(time / 150.0));
+        };
+
+        // move to where the drag starts first
+        int x, y;
+        position(cycle, x, y);
+        add(InputEvent::MOUSE_MOVE, cycle, x, y);
+        add(InputEvent::MOUSE_BUTTON, cycle, x, y)->isUp = false;
+
+        double time = cycle + kMouseInterval;
+        for (; time < cycle + 500.0; time += kMouseInterval)
+        {
+            position(time, x, y);
+            add(InputEvent::MOUSE_MOVE, time, x, y);
+        }
+
+        add(InputEvent::MOUSE_BUTTON, time, x, y)->isUp = true;
+
+        for (time += kMouseInterval; time < cycle + 800.0; time += kMouseInterval)
+        {
+            position(time, x, y);
+            add(InputEvent::MOUSE_MOVE, time, x, y);
+        }
+
+        for (; time < cycle + 1000.0; time += kWheelInterval)
+        {
+            add(InputEvent::MOUSE_WHEEL, time, x, y)->deltaY = -120;
+        }
+    }
+
+    return script;
+}
+
+struct ReplayResult
+{
+    size_t sent;
+    double rendererBusy;
+    double duration;
+    bool inOrder;
+};
+
+ReplayResult replay(const std::vector<InputEvent>& script, double interval, double event_cost, double paint_cost, InputLatencyMatcher& latency)
+{
+    const int kBrowserId = 1;
+
+    InputQueue queue(interval);
+    std::deque<InputEvent> renderer_queue;
+    std::vector<InputEvent> due;
+
+    // what the renderer saw - to check against the script
+    std::vector<InputEvent> buttons_seen;
+    int last_x = -1;
+    int last_y = -1;
+
+    double renderer_free_at = 0.0;
+    double renderer_busy = 0.0;
+    bool unpainted = false;
+    double next_vsync = 0.0;
+    double paint_done_at = -1.0;
+
+    // run until the renderer has caught up with everything
+    size_t next = 0;
+    double now = 0.0;
+    for (; next < script.size() || ! queue.empty() || ! renderer_queue.empty() || unpainted || now < renderer_free_at; now += kStep)
+    {
+        // the window
+        while (next < script.size() && script[next].timestamp <= now)
+        {
+            queue.push(script[next++]);
+        }
+
+        // the main loop
+        due.clear();
+        if (queue.take(now, due))
+        {
+            renderer_queue.insert(renderer_queue.end(), due.begin(), due.end());
+        }
+
+        // the renderer
+        if (now >= next_vsync)
+        {
+            next_vsync += kFrameInterval;
+
+            if (unpainted && now >= renderer_free_at)
+            {
+                renderer_free_at = now + paint_cost;
+                renderer_busy += paint_cost;
+                unpainted = false;
+
+                // the paint lands when it's finished
+                latency.painted(kBrowserId, renderer_free_at);
+                paint_done_at = renderer_free_at;
+            }
+        }
+
+        // OnPaint
+        if (paint_done_at >= 0.0 && now >= paint_done_at)
+        {
+            queue.painted();
+            paint_done_at = -1.0;
+        }
+
+        while (! renderer_queue.empty() && now >= renderer_free_at)
+        {
+            InputEvent event = renderer_queue.front();
+            renderer_queue.pop_front();
+
+            if (event.type == InputEvent::MOUSE_BUTTON)
+            {
+                // where the renderer thinks the mouse is must match where the button went
+                if (last_x >= 0 && (last_x != event.x || last_y != event.y))
+                {
+                    event.count = 0;
+                }
+                buttons_seen.push_back(event);
+            }
+            else if (event.type == InputEvent::MOUSE_MOVE)
+            {
+                last_x = event.x;
+                last_y = event.y;
+            }
+
+            latency.sent(event, kBrowserId);
+            renderer_free_at = std::max(renderer_free_at, now) + event_cost;
+            renderer_busy += event_cost;
+            unpainted = true;
+        }
+    }
+
+    ReplayResult result;
+    result.sent = queue.stats().sent;
+    result.rendererBusy = renderer_busy / now * 100.0;
+    result.duration = now;
+
+    // every press and release, in order, with the mouse where it was
+    result.inOrder = true;
+    size_t seen = 0;
+    for (const InputEvent& event : script)
+    {
+        if (event.type != InputEvent::MOUSE_BUTTON)
+        {
+            continue;
+        }
+
+        if (seen >= buttons_seen.size() || buttons_seen[seen].isUp != event.isUp ||
+            buttons_seen[seen].timestamp != event.timestamp || buttons_seen[seen].count == 0)
+        {
+            result.inOrder = false;
+        }
+        ++seen;
+    }
+    if (seen != buttons_seen.size())
+    {
+        result.inOrder = false;
+    }
+
+    return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const double seconds = atof(getArg(argc, argv, "--seconds", "10").c_str());
+    const double event_cost = atof(getArg(argc, argv, "--event-cost", "1.5").c_str());
+    const double paint_cost = atof(getArg(argc, argv, "--paint-cost", "6").c_str());
+
+    std::vector<InputEvent> script = inputScript(seconds);
+    printf("input_bench: %zu window events over %.0f s, renderer takes %.1f ms per event and %.1f ms per paint\n",
+           script.size(), seconds, event_cost, paint_cost);
+
+    bool ok = true;
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        bool coalesce = (mode == 1);
+        InputLatencyMatcher latency(60000.0);
+        ReplayResult result = replay(script, coalesce ? kFrameInterval : 0.0, event_cost, paint_cost, latency);
+
+        printf("%-10s %7zu events sent, renderer %5.1f%% busy, caught up after %.1f s, buttons %s\n",
+               coalesce ? "coalesced" : "immediate", result.sent, std::min(result.rendererBusy, 100.0), result.duration / 1000.0,
+               result.inOrder ? "in order" : "OUT OF ORDER");
+
+        const InputEvent::Type types[] = { InputEvent::MOUSE_MOVE, InputEvent::MOUSE_BUTTON, InputEvent::MOUSE_WHEEL };
+        const char* names[] = { "move", "button", "wheel" };
+        for (int i = 0; i < 3; ++i)
+        {
+            printf("%-10s   %-6s to paint p50 %8.1f ms p99 %8.1f ms p100 %8.1f ms (%zu events)\n", "", names[i],
+                   latency.percentile(types[i], 50), latency.percentile(types[i], 99), latency.percentile(types[i], 100), latency.count(types[i]));
+        }
+
+        ok = ok && result.inOrder;
+    }
+
+    return ok ? 0 : 1;
+}
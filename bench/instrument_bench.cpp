@@ -0,0 +1,188 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// what the instrumentation costs - times a small piece of work with no timer
+// around it (the same as building with INSTRUMENTATION off), with a timer that
+// is switched off at runtime and with one that is recording, on one thread and
+// on several at once. Also times collecting the events and writing them out as
+// a Chrome trace
+//
+//     instrument_bench [--iterations <per thread>] [--threads <count>] [--trace <file>]
+
+#include "instrument.h"
+
+#include "bench_util.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+    // stands in for the code being timed - a few nanoseconds of work the compiler can't remove
+    inline uint32_t work(uint32_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            value = value * 2654435761u + 0x9e3779b9u;
+            value ^= value >> 15;
+        }
+        return value;
+    }
+
+    std::atomic<uint32_t> gSink(0);
+
+    enum Mode
+    {
+        NO_TIMER,
+        TIMER_DISABLED,
+        TIMER_ENABLED
+    };
+
+    // events a thread can record between collections without any being dropped
+    const size_t kBatch = 16384;
+
+    // returns nanoseconds per iteration - the events are collected (into summary) between
+    // batches, outside the timing, so the ring never fills
+    double run(Mode mode, size_t iterations, InstrumentSummary& summary, std::vector<InstrumentEvent>* trace)
+    {
+        setInstrumentEnabled(mode == TIMER_ENABLED);
+
+        std::vector<InstrumentEvent> events;
+        uint32_t value = 1;
+        double elapsed = 0.0;
+        for (size_t done = 0; done < iterations; done += kBatch)
+        {
+            size_t batch = std::min(kBatch, iterations - done);
+
+            double start = nowMicroseconds();
+            for (size_t i = 0; i < batch; ++i)
+            {
+                if (mode == NO_TIMER)
+                {
+                    value = work(value);
+                }
+                else
+                {
+                    INSTRUMENT_SCOPE("bench.work");
+                    value = work(value);
+                }
+            }
+            elapsed += nowMicroseconds() - start;
+
+            events.clear();
+            collectInstrumentEvents(events);
+            summary.add(events);
+            if (trace && trace->size() < 1000000)
+            {
+                trace->insert(trace->end(), events.begin(), events.end());
+            }
+        }
+
+        gSink += value;
+        return elapsed * 1000.0 / iterations;
+    }
+
+    // every thread records at once while this one collects - the way the app's main loop does
+    double runThreads(int threads, size_t iterations, InstrumentSummary& summary, double& collect_time)
+    {
+        setInstrumentEnabled(true);
+
+        std::atomic<int> running(threads);
+        std::vector<std::thread> workers;
+
+        double start = nowMicroseconds();
+        for (int t = 0; t < threads; ++t)
+        {
+            workers.push_back(std::thread([&running, iterations]()
+            {
+                setInstrumentThreadName("worker");
+
+                uint32_t value = 1;
+                for (size_t i = 0; i < iterations; ++i)
+                {
+                    INSTRUMENT_SCOPE("bench.thread_work");
+                    value = work(value);
+                }
+                gSink += value;
+                --running;
+            }));
+        }
+
+        std::vector<InstrumentEvent> events;
+        collect_time = 0.0;
+        while (running > 0)
+        {
+            double collect_start = nowMicroseconds();
+            events.clear();
+            collectInstrumentEvents(events);
+            summary.add(events);
+            collect_time += nowMicroseconds() - collect_start;
+
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        double elapsed = nowMicroseconds() - start;
+
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+        events.clear();
+        collectInstrumentEvents(events);
+        summary.add(events);
+
+        return elapsed * 1000.0 / iterations;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const size_t iterations = (size_t)atol(getArg(argc, argv, "--iterations", "5000000").c_str());
+    const int threads = atoi(getArg(argc, argv, "--threads", "4").c_str());
+    const std::string trace_file = getArg(argc, argv, "--trace", "");
+
+    printf("instrument_bench: %zu iterations, compiled %s\n", iterations, INSTRUMENTATION_ENABLED ? "in" : "out");
+
+    // warm up (and make this thread's ring)
+    InstrumentSummary summary;
+    run(TIMER_ENABLED, 100000, summary, nullptr);
+    summary.reset();
+
+    std::vector<InstrumentEvent> trace;
+    double base = run(NO_TIMER, iterations, summary, nullptr);
+    double disabled = run(TIMER_DISABLED, iterations, summary, nullptr);
+    double enabled = run(TIMER_ENABLED, iterations, summary, &trace);
+
+    printf("no timer           %7.2f ns/iteration\n", base);
+    printf("timer disabled     %7.2f ns/iteration (+%.2f ns)\n", disabled, disabled - base);
+    printf("timer enabled      %7.2f ns/iteration (+%.2f ns)\n", enabled, enabled - base);
+
+    size_t dropped = instrumentDroppedEvents();
+    double collect_time = 0.0;
+    double threaded = runThreads(threads, iterations / threads, summary, collect_time);
+    printf("%2d threads enabled %7.2f ns/iteration on each, %.1f ms collecting, %zu events dropped\n",
+           threads, threaded, collect_time / 1000.0, instrumentDroppedEvents() - dropped);
+
+    summary.write(std::cout);
+
+    if (! trace_file.empty())
+    {
+        double start = nowMicroseconds();
+        if (! writeChromeTrace(trace_file, trace))
+        {
+            std::cerr << "instrument_bench: unable to write trace " << trace_file << std::endl;
+            return 1;
+        }
+        printf("wrote %zu events to %s in %.1f ms\n", trace.size(), trace_file.c_str(), (nowMicroseconds() - start) / 1000.0);
+    }
+
+    return 0;
+}
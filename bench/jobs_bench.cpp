@@ -0,0 +1,188 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// how compositing scales across the JobSystem (src/job_system.h) from 1 to 32
+// threads, on synthetic OnPaint streams:
+//
+//   one_4k          one 3840 x 2160 browser repainting all of itself every frame -
+//                   each copy is split into bands of rows (Compositor::setJobSystem())
+//   16_browsers     16 browsers of 1280 x 720 all repainting everything at once (a
+//                   window resize) - one job per browser through a PaintBatch, and
+//                   each one splits its copy up further
+//   16_small_dirty  16 browsers with a caret and a status area changing - nothing is
+//                   big enough to split, so this is what the job system costs when
+//                   there's nothing for it to do
+//
+// Uploads go to a SoftwareUploadBackend per browser, one after another on the
+// calling thread the way they would on the GL thread. Reports frames per second,
+// the speedup over one thread and CPU time per frame. Every run's pages are
+// checked against compositing the same paints on one thread with no job system -
+// exits with 1 if they don't match
+//
+//     jobs_bench [--frames <frames per run>] [--threads <most threads to try>]
+
+#include "compositor.h"
+#include "job_system.h"
+#include "paint_batch.h"
+#include "pump_scheduler.h"
+
+#include "bench_util.h"
+#include "paint_scenarios.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+namespace
+{
+    struct Browser
+    {
+        std::unique_ptr<SoftwareUploadBackend> backend;
+        std::unique_ptr<Compositor> compositor;
+        std::vector<unsigned char> buffer;
+    };
+
+    // every browser paints the same stream, offset by one frame per browser so they aren't in lock step
+    std::vector<PaintEvent> scenario(const std::string& name, int frames)
+    {
+        if (name == "one_4k" || name == "16_browsers")
+        {
+            int width = (name == "one_4k") ? 3840 : 1280;
+            int height = (name == "one_4k") ? 2160 : 720;
+            std::vector<PaintEvent> events;
+            for (int i = 0; i < frames; ++i)
+            {
+                events.push_back(viewEvent(width, height, Rect(0, 0, width, height)));
+            }
+            return events;
+        }
+
+        // the caret and status area of smallDirtyScenario() on a 1280 x 720 page
+        std::vector<PaintEvent> events;
+        events.push_back(viewEvent(1280, 720, Rect(0, 0, 1280, 720)));
+        for (int i = 1; i < frames; ++i)
+        {
+            PaintEvent event = viewEvent(1280, 720, Rect(120, 340, 2, 18));
+            if (i % 4 == 0)
+            {
+                event.dirtyRects.push_back(Rect(600, 20, 160, 24));
+            }
+            events.push_back(event);
+        }
+        return events;
+    }
+
+    // runs the scenario and leaves the browsers' pages for checking - seconds and CPU milliseconds taken,
+    // not counting the first frame (the page buffers and textures being made)
+    void run(const std::vector<PaintEvent>& events, int num_browsers, JobSystem* jobs,
+             std::vector<Browser>& browsers, double& seconds, double& cpu)
+    {
+        browsers.clear();
+        browsers.resize(num_browsers);
+        for (int i = 0; i < num_browsers; ++i)
+        {
+            Browser& browser = browsers[i];
+            browser.backend.reset(new SoftwareUploadBackend);
+            browser.compositor.reset(new Compositor(browser.backend.get()));
+            browser.compositor->setJobSystem(jobs);
+            browser.buffer.resize((size_t)events[0].width * events[0].height * kDepth);
+            fillPattern(browser.buffer, i + 1);
+        }
+
+        PaintBatch batch;
+        double cpu_start = processCpuTime();
+        double start = nowMicroseconds();
+        for (size_t frame = 0; frame < events.size(); ++frame)
+        {
+            for (int i = 0; i < num_browsers; ++i)
+            {
+                Browser& browser = browsers[i];
+                const PaintEvent& event = events[(frame + i) % events.size()];
+
+                // make the page look like it changed where the paint says it did
+                for (const Rect& rect : event.dirtyRects)
+                {
+                    browser.buffer[((size_t)rect.y * event.width + rect.x) * kDepth] = (unsigned char)(frame + i);
+                }
+                batch.add(browser.compositor.get(), event, browser.buffer.data());
+            }
+
+            batch.composite(jobs);
+            batch.upload();
+
+            if (frame == 0)
+            {
+                cpu_start = processCpuTime();
+                start = nowMicroseconds();
+            }
+        }
+        seconds = (nowMicroseconds() - start) / 1.0e6;
+        cpu = processCpuTime() - cpu_start;
+    }
+
+    bool samePages(const std::vector<Browser>& a, const std::vector<Browser>& b)
+    {
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            const Compositor& x = *a[i].compositor;
+            const Compositor& y = *b[i].compositor;
+            if (x.width() != y.width() || x.height() != y.height() ||
+                memcmp(x.pixels(), y.pixels(), (size_t)x.width() * x.height() * kDepth) != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const int frames = atoi(getArg(argc, argv, "--frames", "60").c_str());
+    const int max_threads = atoi(getArg(argc, argv, "--threads", "32").c_str());
+
+    printf("jobs_bench: %d frames per run, %u cores\n", frames, std::thread::hardware_concurrency());
+
+    struct Scenario
+    {
+        const char* name;
+        int browsers;
+    };
+    const Scenario scenarios[] = { { "one_4k", 1 }, { "16_browsers", 16 }, { "16_small_dirty", 16 } };
+
+    bool ok = true;
+    for (const Scenario& scenario_info : scenarios)
+    {
+        std::vector<PaintEvent> events = scenario(scenario_info.name, frames);
+
+        // what everything should come out as
+        std::vector<Browser> reference;
+        double seconds, cpu;
+        run(events, scenario_info.browsers, nullptr, reference, seconds, cpu);
+        printf("  %-15s no jobs      %8.1f frames/s, %7.2f ms CPU per frame\n", scenario_info.name, (frames - 1) / seconds, cpu / (frames - 1));
+
+        double one_thread = 0.0;
+        for (int threads = 1; threads <= max_threads; threads *= 2)
+        {
+            JobSystem jobs(threads);
+            std::vector<Browser> browsers;
+            run(events, scenario_info.browsers, &jobs, browsers, seconds, cpu);
+
+            double fps = (frames - 1) / seconds;
+            one_thread = (threads == 1) ? fps : one_thread;
+            bool match = samePages(browsers, reference);
+            ok = ok && match;
+            printf("  %-15s %2d threads   %8.1f frames/s, %7.2f ms CPU per frame, %5.2fx one thread%s\n",
+                   scenario_info.name, threads, fps, cpu / (frames - 1), fps / one_thread, match ? "" : " - PAGES DON'T MATCH");
+        }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,329 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// the two ways the app can run CEF's message loop, without CEF. Single
+// threaded, one thread composites each paint and uploads it (OnPaint inside
+// CefDoMessageLoopWork() on the main thread). Multi-threaded, a paint thread
+// composites and publishes to a FrameMailbox (src/frame_mailbox.h) and a render
+// thread takes the newest frame and uploads it once per 60Hz refresh. Paints
+// are paced at --fps and each run reports how busy each thread was and, for
+// the mailbox, how long frames waited to be picked up and how many were
+// replaced before they were. Uploads go to a SoftwareUploadBackend - a memcpy
+// standing in for the driver's copy.
+//
+// First an unpaced stress check - random damage, resizes now and then, a
+// reader that falls behind - where every frame the reader takes and what it
+// has uploaded so far is compared against the frame that was published.
+// Exits with 1 if the check fails
+//
+//     mailbox_bench [--frames <frames per run>] [--fps <paint rate>]
+
+#include "compositor.h"
+#include "frame_mailbox.h"
+#include "pump_scheduler.h"
+
+#include "bench_util.h"
+#include "paint_scenarios.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    const double kRefreshInterval = 1000.0 / 60.0;
+
+    double nowMilliseconds()
+    {
+        return nowMicroseconds() / 1000.0;
+    }
+
+    void sleepUntil(double when)
+    {
+        double wait = when - nowMilliseconds();
+        if (wait > 0.0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds((long long)(wait * 1000.0)));
+        }
+    }
+
+    void uploadFrame(const MailboxFrame& frame, SoftwareUploadBackend& backend, int& width, int& height)
+    {
+        if (frame.width != width || frame.height != height)
+        {
+            backend.resize(frame.width, frame.height);
+            width = frame.width;
+            height = frame.height;
+        }
+
+        for (const Rect& rect : frame.damage)
+        {
+            backend.upload(rect, frame.pixels() + ((size_t)rect.y * frame.width + rect.x) * kDepth, frame.width);
+        }
+    }
+
+    bool samePixels(const unsigned char* a, int a_stride, const unsigned char* b, int b_stride, int width, int height)
+    {
+        for (int y = 0; y < height; ++y)
+        {
+            if (memcmp(a + (size_t)y * a_stride * kDepth, b + (size_t)y * b_stride * kDepth, (size_t)width * kDepth) != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+// the writer keeps a copy of every frame it publishes so the reader can check what it got - it's held
+// back if it gets more than kCheckFrames ahead of the reader so none of them are overwritten too soon
+bool checkMailbox(int frames)
+{
+    const int kCheckFrames = 32;
+
+    struct Reference
+    {
+        int width;
+        int height;
+        std::vector<unsigned char> pixels;
+    };
+    std::vector<Reference> references(kCheckFrames);
+    std::mutex references_mutex;
+
+    FrameMailbox mailbox;
+    std::atomic<uint64_t> last_checked(0);
+    std::atomic<bool> writer_done(false);
+
+    std::thread writer([&]()
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> page;
+        unsigned int seed = 1;
+        for (int frame = 1; frame <= frames; ++frame)
+        {
+            while (frame - (int)last_checked.load() >= kCheckFrames)
+            {
+                std::this_thread::yield();
+            }
+
+            RectList damage;
+            if (frame % 200 == 1)
+            {
+                width = 300 + (frame / 200) * 37 % 200;
+                height = 200 + (frame / 200) * 53 % 150;
+                page.resize((size_t)width * height * kDepth);
+                fillPattern(page, frame);
+                damage.push_back(Rect(0, 0, width, height));
+            }
+            else
+            {
+                int count = 1 + frame % 3;
+                for (int i = 0; i < count; ++i)
+                {
+                    seed = seed * 1103515245u + 12345u;
+                    int x = (int)((seed >> 8) % width);
+                    int y = (int)((seed >> 16) % height);
+                    Rect rect(x, y, 1 + (int)(seed % 61) % (width - x), 1 + (int)((seed >> 4) % 47) % (height - y));
+                    for (int row = rect.y; row < rect.y + rect.height; ++row)
+                    {
+                        memset(&page[((size_t)row * width + rect.x) * kDepth], (frame * 7 + i) & 0xff, (size_t)rect.width * kDepth);
+                    }
+                    damage.push_back(rect);
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(references_mutex);
+                Reference& reference = references[frame % kCheckFrames];
+                reference.width = width;
+                reference.height = height;
+                reference.pixels = page;
+            }
+            mailbox.publish(page.data(), width, height, damage, nowMilliseconds());
+        }
+        writer_done = true;
+    });
+
+    SoftwareUploadBackend backend;
+    int upload_width = 0;
+    int upload_height = 0;
+    size_t checked = 0;
+    bool ok = true;
+    uint64_t previous = 0;
+    while (ok)
+    {
+        bool done = writer_done.load();
+        const MailboxFrame* frame = mailbox.take();
+        if (frame == nullptr)
+        {
+            if (done)
+            {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+
+        uploadFrame(*frame, backend, upload_width, upload_height);
+
+        std::lock_guard<std::mutex> lock(references_mutex);
+        const Reference& reference = references[frame->sequence % kCheckFrames];
+        ok = frame->sequence > previous && frame->width == reference.width && frame->height == reference.height &&
+             samePixels(frame->pixels(), frame->width, reference.pixels.data(), reference.width, reference.width, reference.height) &&
+             samePixels(backend.pixels(), backend.capacityWidth(), reference.pixels.data(), reference.width, reference.width, reference.height);
+        if (! ok)
+        {
+            printf("  frame %llu (%d x %d) doesn't match what was published\n", (unsigned long long)frame->sequence, frame->width, frame->height);
+        }
+        previous = frame->sequence;
+        last_checked = frame->sequence;
+        ++checked;
+
+        // fall behind every so often so frames get replaced and their damage carried over
+        if (checked % 5 == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    last_checked = frames;
+    writer.join();
+
+    MailboxStats stats = mailbox.stats();
+    printf("  check: %zu of %zu frames taken and checked, %zu replaced before they were taken, %s\n",
+           checked, stats.published, stats.skipped, ok ? "every one matches" : "MISMATCH");
+    return ok;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+struct ThreadLoad
+{
+    ThreadLoad() : cpu(0.0), seconds(0.0) {}
+
+    double percent() const
+    {
+        return seconds > 0.0 ? cpu / (seconds * 1000.0) * 100.0 : 0.0;
+    }
+
+    double cpu;
+    double seconds;
+};
+
+// CefDoMessageLoopWork() on the main thread - paint and upload on the same thread
+void runSingleThreaded(const char* name, const std::vector<PaintEvent>& events, double fps)
+{
+    SoftwareUploadBackend backend;
+    Compositor compositor(&backend);
+
+    std::vector<unsigned char> buffer((size_t)events[0].width * events[0].height * kDepth);
+    fillPattern(buffer, 1);
+
+    ThreadLoad load;
+    double cpu_start = threadCpuTime();
+    double start = nowMilliseconds();
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        sleepUntil(start + i * 1000.0 / fps);
+
+        const PaintEvent& event = events[i];
+        buffer[i % buffer.size()]++;
+        RectList damage = compositor.paintView(event.dirtyRects, buffer.data(), event.width, event.height);
+        compositor.upload(damage);
+        compositor.endFrame();
+    }
+    load.cpu = threadCpuTime() - cpu_start;
+    load.seconds = (nowMilliseconds() - start) / 1000.0;
+
+    printf("  single  %-12s main thread %5.1f%% busy (paint and upload)\n", name, load.percent());
+}
+
+// MULTI_THREADED - CEF's thread composites and publishes, the render thread takes and uploads once a refresh
+void runMailbox(const char* name, const std::vector<PaintEvent>& events, double fps)
+{
+    NullUploadBackend null_backend;
+    Compositor compositor(&null_backend);
+    FrameMailbox mailbox;
+
+    std::vector<unsigned char> buffer((size_t)events[0].width * events[0].height * kDepth);
+    fillPattern(buffer, 1);
+
+    std::atomic<bool> painting_done(false);
+    ThreadLoad paint_load;
+    ThreadLoad render_load;
+    Samples waits;
+
+    std::thread render([&]()
+    {
+        SoftwareUploadBackend backend;
+        int upload_width = 0;
+        int upload_height = 0;
+
+        double cpu_start = threadCpuTime();
+        double start = nowMilliseconds();
+        for (int refresh = 1; ! painting_done.load(); ++refresh)
+        {
+            const MailboxFrame* frame = mailbox.take();
+            if (frame != nullptr)
+            {
+                waits.add((nowMilliseconds() - frame->time) * 1000.0);
+                uploadFrame(*frame, backend, upload_width, upload_height);
+            }
+            sleepUntil(start + refresh * kRefreshInterval);
+        }
+        render_load.cpu = threadCpuTime() - cpu_start;
+        render_load.seconds = (nowMilliseconds() - start) / 1000.0;
+    });
+
+    double cpu_start = threadCpuTime();
+    double start = nowMilliseconds();
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        sleepUntil(start + i * 1000.0 / fps);
+
+        const PaintEvent& event = events[i];
+        buffer[i % buffer.size()]++;
+        RectList damage = compositor.paintView(event.dirtyRects, buffer.data(), event.width, event.height);
+        compositor.upload(damage);
+        mailbox.publish(compositor.pixels(), compositor.width(), compositor.height(), damage, nowMilliseconds());
+        compositor.endFrame();
+    }
+    paint_load.cpu = threadCpuTime() - cpu_start;
+    paint_load.seconds = (nowMilliseconds() - start) / 1000.0;
+
+    painting_done = true;
+    render.join();
+
+    MailboxStats stats = mailbox.stats();
+    printf("  mailbox %-12s CEF thread %5.1f%% busy (paint and publish), render thread %5.1f%% busy (upload), "
+           "paint to pickup p50 %6.0f us p99 %6.0f us, %zu of %zu frames replaced\n",
+           name, paint_load.percent(), render_load.percent(), waits.percentile(50), waits.percentile(99), stats.skipped, stats.published);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const int frames = atoi(getArg(argc, argv, "--frames", "300").c_str());
+    const double fps = atof(getArg(argc, argv, "--fps", "60").c_str());
+
+    printf("mailbox_bench: %d frames per run painted at %.0f frames/s\n", frames, fps);
+
+    bool ok = checkMailbox(frames * 10);
+
+    runSingleThreaded("full_frame", fullFrameScenario(frames), fps);
+    runMailbox("full_frame", fullFrameScenario(frames), fps);
+    runSingleThreaded("small_dirty", smallDirtyScenario(frames), fps);
+    runMailbox("small_dirty", smallDirtyScenario(frames), fps);
+
+    return ok ? 0 : 1;
+}
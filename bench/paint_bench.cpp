@@ -0,0 +1,215 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// replays streams of OnPaint calls through the compositor and upload backend
+// with no CEF, GPU or network involved so we can track the cost of the paint
+// path from one commit to the next
+//
+//     paint_bench [--scenario all|full_frame|small_dirty|popup_scroll|popup_highlight|resize]
+//                 [--replay <paint trace file>] [--backend null|software]
+//                 [--frames <count>] [--layered] [--trace <chrome trace file>]
+//
+// --layered keeps the popup in a layer (and upload backend) of its own, the way
+// the app does with gLayeredPopups
+//
+// a paint trace can be recorded by the app by setting gPaintTraceFile
+//
+// --trace turns on the compositor's instrumentation and writes what it recorded
+// out as a Chrome trace (chrome://tracing) with a histogram of each stage
+
+#include "compositor.h"
+#include "instrument.h"
+#include "paint_trace.h"
+
+#include "bench_util.h"
+#include "paint_scenarios.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+UploadBackend* createBackend(const std::string& backend_name)
+{
+    if (backend_name == "software")
+    {
+        return new SoftwareUploadBackend();
+    }
+    return new NullUploadBackend();
+}
+
+void replay(const std::string& name, const std::vector<PaintEvent>& events, const std::string& backend_name, bool layered)
+{
+    std::unique_ptr<UploadBackend> backend(createBackend(backend_name));
+    std::unique_ptr<UploadBackend> popup_backend(createBackend(backend_name));
+
+    Compositor compositor(backend.get());
+    if (layered)
+    {
+        compositor.setPopupLayer(popup_backend.get());
+    }
+
+    // pixels CEF would have handed us - big enough for any event in the stream
+    size_t max_bytes = 0;
+    for (const PaintEvent& event : events)
+    {
+        max_bytes = std::max(max_bytes, (size_t)event.width * event.height * kDepth);
+    }
+    std::vector<unsigned char> buffer(max_bytes);
+    fillPattern(buffer, 1);
+
+    Samples composite_times;
+    Samples upload_times;
+    Samples frame_times;
+
+    double start = nowMicroseconds();
+    for (const PaintEvent& event : events)
+    {
+        switch (event.type)
+        {
+            case PaintEvent::VIEW:
+            case PaintEvent::POPUP:
+            {
+                // make the buffer look like it changed so nothing can be cached
+                buffer[composite_times.count() % buffer.size()]++;
+
+                double t0 = nowMicroseconds();
+                RectList damage = (event.type == PaintEvent::VIEW) ?
+                                  compositor.paintView(event.dirtyRects, buffer.data(), event.width, event.height) :
+                                  compositor.paintPopup(event.dirtyRects, buffer.data(), event.width, event.height);
+                double t1 = nowMicroseconds();
+                compositor.upload(damage);
+                double t2 = nowMicroseconds();
+                compositor.endFrame();
+
+                composite_times.add(t1 - t0);
+                upload_times.add(t2 - t1);
+                frame_times.add(t2 - t0);
+            }
+            break;
+
+            case PaintEvent::POPUP_SIZE:
+                compositor.popupSize(event.popupRect);
+                break;
+
+            case PaintEvent::POPUP_SHOW:
+                compositor.popupShow(event.show);
+                break;
+        }
+    }
+    double elapsed = nowMicroseconds() - start;
+
+    const CompositorStats& stats = compositor.stats();
+    size_t frames = std::max<size_t>(stats.frames, 1);
+
+    printf("%-14s %8zu frames %10.1f frames/s  copied %10.0f B/frame  uploaded %10.0f B/frame\n",
+           name.c_str(), stats.frames, stats.frames / (elapsed / 1e6),
+           (double)stats.totalBytesCopied / frames, (double)stats.totalBytesUploaded / frames);
+    printf("%-14s   composite p50 %8.1f us p99 %8.1f us | upload p50 %8.1f us p99 %8.1f us | frame p50 %8.1f us p99 %8.1f us\n",
+           "", composite_times.percentile(50), composite_times.percentile(99),
+           upload_times.percentile(50), upload_times.percentile(99),
+           frame_times.percentile(50), frame_times.percentile(99));
+}
+
+// the rings only hold so many events - empty them after each scenario
+void collectTrace(std::vector<InstrumentEvent>& trace_events)
+{
+    if (instrumentEnabled())
+    {
+        collectInstrumentEvents(trace_events);
+    }
+}
+
+int writeTrace(const std::string& trace_file, const std::vector<InstrumentEvent>& trace_events)
+{
+    if (trace_file.empty())
+    {
+        return 0;
+    }
+
+    InstrumentSummary summary;
+    summary.add(trace_events);
+    summary.write(std::cout);
+
+    if (! writeChromeTrace(trace_file, trace_events))
+    {
+        std::cerr << "paint_bench: unable to write trace " << trace_file << std::endl;
+        return 1;
+    }
+
+    printf("wrote %zu events to %s (%zu dropped)\n", trace_events.size(), trace_file.c_str(), instrumentDroppedEvents());
+    return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const std::string scenario = getArg(argc, argv, "--scenario", "all");
+    const std::string replay_file = getArg(argc, argv, "--replay", "");
+    const std::string backend = getArg(argc, argv, "--backend", "software");
+    const int frames = atoi(getArg(argc, argv, "--frames", "600").c_str());
+    const bool layered = hasArg(argc, argv, "--layered");
+    const std::string trace_file = getArg(argc, argv, "--trace", "");
+
+    setInstrumentEnabled(! trace_file.empty());
+    setInstrumentThreadName("paint_bench");
+    std::vector<InstrumentEvent> trace_events;
+
+    printf("paint_bench: backend %s, popup %s\n", backend.c_str(), layered ? "layered" : "composited");
+
+    if (! replay_file.empty())
+    {
+        PaintTraceReader reader;
+        if (! reader.open(replay_file))
+        {
+            std::cerr << "paint_bench: unable to open paint trace " << replay_file << std::endl;
+            return 1;
+        }
+
+        std::vector<PaintEvent> events;
+        PaintEvent event;
+        while (reader.read(event))
+        {
+            events.push_back(event);
+        }
+
+        replay("replay", events, backend, layered);
+        collectTrace(trace_events);
+        return writeTrace(trace_file, trace_events);
+    }
+
+    if (scenario == "all" || scenario == "full_frame")
+    {
+        replay("full_frame", fullFrameScenario(frames), backend, layered);
+        collectTrace(trace_events);
+    }
+    if (scenario == "all" || scenario == "small_dirty")
+    {
+        replay("small_dirty", smallDirtyScenario(frames), backend, layered);
+        collectTrace(trace_events);
+    }
+    if (scenario == "all" || scenario == "popup_scroll")
+    {
+        replay("popup_scroll", popupScrollScenario(frames), backend, layered);
+        collectTrace(trace_events);
+    }
+    if (scenario == "all" || scenario == "popup_highlight")
+    {
+        replay("popup_highlight", popupHighlightScenario(frames), backend, layered);
+        collectTrace(trace_events);
+    }
+    if (scenario == "all" || scenario == "resize")
+    {
+        replay("resize", resizeScenario(frames), backend, layered);
+        collectTrace(trace_events);
+    }
+
+    return writeTrace(trace_file, trace_events);
+}
@@ -0,0 +1,136 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+#include "paint_scenarios.h"
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+PaintEvent viewEvent(int width, int height, const Rect& dirty)
+{
+    PaintEvent event;
+    event.type = PaintEvent::VIEW;
+    event.width = width;
+    event.height = height;
+    event.dirtyRects.push_back(dirty);
+    return event;
+}
+
+PaintEvent popupEvent(int width, int height, const Rect& dirty)
+{
+    PaintEvent event = viewEvent(width, height, dirty);
+    event.type = PaintEvent::POPUP;
+    return event;
+}
+
+// every frame repaints the whole page (e.g. a video or a full page animation)
+std::vector<PaintEvent> fullFrameScenario(int frames)
+{
+    std::vector<PaintEvent> events;
+    for (int i = 0; i < frames; ++i)
+    {
+        events.push_back(viewEvent(800, 1200, Rect(0, 0, 800, 1200)));
+    }
+    return events;
+}
+
+// a blinking caret and a small status area - the common case for a mostly static page
+std::vector<PaintEvent> smallDirtyScenario(int frames)
+{
+    std::vector<PaintEvent> events;
+    events.push_back(viewEvent(800, 1200, Rect(0, 0, 800, 1200)));
+    for (int i = 1; i < frames; ++i)
+    {
+        PaintEvent event = viewEvent(800, 1200, Rect(120, 340, 2, 18));
+        if (i % 4 == 0)
+        {
+            event.dirtyRects.push_back(Rect(600, 20, 160, 24));
+        }
+        events.push_back(event);
+    }
+    return events;
+}
+
+// a <select> dropdown that is being scrolled - the popup repaints every frame and the page underneath
+// only occasionally
+std::vector<PaintEvent> popupScrollScenario(int frames)
+{
+    const Rect popup_rect(100, 200, 300, 400);
+
+    std::vector<PaintEvent> events;
+    events.push_back(viewEvent(800, 1200, Rect(0, 0, 800, 1200)));
+
+    PaintEvent size_event;
+    size_event.type = PaintEvent::POPUP_SIZE;
+    size_event.popupRect = popup_rect;
+    events.push_back(size_event);
+
+    PaintEvent show_event;
+    show_event.type = PaintEvent::POPUP_SHOW;
+    show_event.show = true;
+    events.push_back(show_event);
+
+    for (int i = 1; i < frames; ++i)
+    {
+        events.push_back(popupEvent(popup_rect.width, popup_rect.height, Rect(0, 0, popup_rect.width, popup_rect.height)));
+        if (i % 10 == 0)
+        {
+            events.push_back(viewEvent(800, 1200, Rect(0, 180, 800, 40)));
+        }
+    }
+
+    show_event.show = false;
+    events.push_back(show_event);
+    return events;
+}
+
+// the mouse moves down an open <select> dropdown - each paint is the old and new highlighted item
+std::vector<PaintEvent> popupHighlightScenario(int frames)
+{
+    const Rect popup_rect(100, 200, 300, 400);
+    const int item_height = 20;
+    const int num_items = popup_rect.height / item_height;
+
+    std::vector<PaintEvent> events;
+    events.push_back(viewEvent(800, 1200, Rect(0, 0, 800, 1200)));
+
+    PaintEvent size_event;
+    size_event.type = PaintEvent::POPUP_SIZE;
+    size_event.popupRect = popup_rect;
+    events.push_back(size_event);
+
+    PaintEvent show_event;
+    show_event.type = PaintEvent::POPUP_SHOW;
+    show_event.show = true;
+    events.push_back(show_event);
+
+    events.push_back(popupEvent(popup_rect.width, popup_rect.height, Rect(0, 0, popup_rect.width, popup_rect.height)));
+    for (int i = 1; i < frames; ++i)
+    {
+        PaintEvent event = popupEvent(popup_rect.width, popup_rect.height, Rect(0, ((i - 1) % num_items) * item_height, popup_rect.width, item_height));
+        event.dirtyRects.push_back(Rect(0, (i % num_items) * item_height, popup_rect.width, item_height));
+        events.push_back(event);
+    }
+
+    show_event.show = false;
+    events.push_back(show_event);
+    return events;
+}
+
+// the window is being resized - every size change is followed by a full repaint at the new size
+std::vector<PaintEvent> resizeScenario(int frames)
+{
+    const int sizes[][2] = { { 800, 1200 }, { 1024, 768 }, { 640, 480 }, { 1280, 1024 } };
+    const int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    std::vector<PaintEvent> events;
+    for (int i = 0; i < frames; ++i)
+    {
+        const int* size = sizes[(i / 30) % num_sizes];
+        events.push_back(viewEvent(size[0], size[1], Rect(0, 0, size[0], size[1])));
+    }
+    return events;
+}
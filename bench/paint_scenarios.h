@@ -0,0 +1,36 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+#ifndef _PAINT_SCENARIOS_H_
+#define _PAINT_SCENARIOS_H_
+
+#include "paint_trace.h"
+
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// synthetic streams of render handler calls shared by the benchmarks
+PaintEvent viewEvent(int width, int height, const Rect& dirty);
+PaintEvent popupEvent(int width, int height, const Rect& dirty);
+
+// every frame repaints the whole page (e.g. a video or a full page animation)
+std::vector<PaintEvent> fullFrameScenario(int frames);
+
+// a blinking caret and a small status area - the common case for a mostly static page
+std::vector<PaintEvent> smallDirtyScenario(int frames);
+
+// a <select> dropdown that is being scrolled - the popup repaints every frame and the page
+// underneath only occasionally
+std::vector<PaintEvent> popupScrollScenario(int frames);
+
+// the mouse moving down an open <select> dropdown - only the highlighted items in the popup change
+std::vector<PaintEvent> popupHighlightScenario(int frames);
+
+// the window is being resized - every size change is followed by a full repaint at the new size
+std::vector<PaintEvent> resizeScenario(int frames);
+
+#endif // _PAINT_SCENARIOS_H_
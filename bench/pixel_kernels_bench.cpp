@@ -0,0 +1,497 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// checks every SIMD version of the pixel kernels this CPU can run gives exactly
+// the same bytes as the scalar version - for every colour/alpha pair, random
+// pixels and every row length up to a few registers wide so the leftover pixels
+// at the end of a row are covered - then times each of them on 1080p frames.
+// The BGRA to I420 conversion is checked the same way, odd widths and the last
+// row of an odd height frame included, as is halving a frame for thumbnails, and
+// the tile hash gives the same lanes for every row length. Exits with 1 if
+// anything doesn't match
+//
+//     pixel_kernels_bench [--frames <count>]
+
+#include "pixel_kernels.h"
+
+#include "bench_util.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    const int kFrameWidth = 1920;
+    const int kFrameHeight = 1080;
+
+    typedef void (*RowKernel)(unsigned char* dst, const unsigned char* src, int pixels);
+
+    struct KernelInfo
+    {
+        const char* name;
+        RowKernel PixelKernels::*row;
+        // blend reads dst too, the rest can work in place
+        bool readsDst;
+    };
+
+    const KernelInfo kKernels[] =
+    {
+        { "blend", &PixelKernels::blendRow, true },
+        { "swizzle", &PixelKernels::swizzleRow, false },
+        { "premultiply", &PixelKernels::premultiplyRow, false },
+        { "unpremultiply", &PixelKernels::unpremultiplyRow, false }
+    };
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+// every colour value against every alpha value, plus random pixels
+std::vector<unsigned char> testPixels()
+{
+    std::vector<unsigned char> pixels;
+    for (int alpha = 0; alpha < 256; ++alpha)
+    {
+        for (int colour = 0; colour < 256; ++colour)
+        {
+            unsigned char pixel[] = { (unsigned char)colour, (unsigned char)(255 - colour), (unsigned char)(colour ^ alpha), (unsigned char)alpha };
+            pixels.insert(pixels.end(), pixel, pixel + kDepth);
+        }
+    }
+
+    std::vector<unsigned char> random(pixels.size());
+    fillPattern(random, 12345);
+    pixels.insert(pixels.end(), random.begin(), random.end());
+
+    return pixels;
+}
+
+bool checkKernel(const KernelInfo& info, const PixelKernels& kernels, const std::vector<unsigned char>& src, const std::vector<unsigned char>& dst)
+{
+    const PixelKernels& scalar = *pixelKernels(PIXEL_KERNELS_SCALAR);
+    const int pixels = (int)(src.size() / kDepth);
+
+    std::vector<unsigned char> expected = dst;
+    std::vector<unsigned char> actual = dst;
+
+    // whole buffer in one go
+    (scalar.*info.row)(expected.data(), src.data(), pixels);
+    (kernels.*info.row)(actual.data(), src.data(), pixels);
+    if (expected != actual)
+    {
+        printf("%-6s %-14s MISMATCH over %d pixels\n", kernels.name, info.name, pixels);
+        return false;
+    }
+
+    // every short row length at an awkward offset so the tails are used
+    for (int length = 1; length <= 67; ++length)
+    {
+        for (int offset = 0; offset + length <= pixels; offset += 997)
+        {
+            std::vector<unsigned char> short_expected(dst.begin() + offset * kDepth, dst.begin() + (offset + length) * kDepth);
+            std::vector<unsigned char> short_actual = short_expected;
+
+            (scalar.*info.row)(short_expected.data(), src.data() + offset * kDepth, length);
+            (kernels.*info.row)(short_actual.data(), src.data() + offset * kDepth, length);
+            if (short_expected != short_actual)
+            {
+                printf("%-6s %-14s MISMATCH for %d pixels at %d\n", kernels.name, info.name, length, offset);
+                return false;
+            }
+        }
+    }
+
+    // in place
+    if (! info.readsDst)
+    {
+        std::vector<unsigned char> in_place = src;
+        (kernels.*info.row)(in_place.data(), in_place.data(), pixels);
+
+        std::vector<unsigned char> out_of_place(src.size());
+        (scalar.*info.row)(out_of_place.data(), src.data(), pixels);
+        if (in_place != out_of_place)
+        {
+            printf("%-6s %-14s MISMATCH in place\n", kernels.name, info.name);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// two rows at a time from anywhere in src, for every short width, and the single row case
+bool checkI420(const PixelKernels& kernels, const std::vector<unsigned char>& src)
+{
+    const PixelKernels& scalar = *pixelKernels(PIXEL_KERNELS_SCALAR);
+    const int pixels = (int)(src.size() / kDepth);
+
+    auto convert = [](const PixelKernels& with, const unsigned char* row0, const unsigned char* row1, int width, std::vector<unsigned char>& out)
+    {
+        int chroma_width = (width + 1) / 2;
+        out.assign((size_t)width * 2 + chroma_width * 2, 0xcd);
+        unsigned char* y0 = &out[0];
+        unsigned char* y1 = row1 == row0 ? y0 : y0 + width;
+        with.bgraToI420Row(row0, row1, y0, y1, y0 + width * 2, y0 + width * 2 + chroma_width, width);
+    };
+
+    std::vector<unsigned char> expected, actual;
+    for (int width = 1; width <= 200; ++width)
+    {
+        for (int offset = 0; offset + width * 2 <= pixels; offset += 4099)
+        {
+            const unsigned char* row0 = src.data() + (size_t)offset * kDepth;
+            const unsigned char* row1 = row0 + (size_t)width * kDepth;
+
+            for (int single = 0; single < 2; ++single)
+            {
+                convert(scalar, row0, single ? row0 : row1, width, expected);
+                convert(kernels, row0, single ? row0 : row1, width, actual);
+                if (expected != actual)
+                {
+                    printf("%-6s %-14s MISMATCH for %d pixels at %d%s\n", kernels.name, "bgra to i420", width, offset, single ? " (single row)" : "");
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// two rows at a time from anywhere in src, for every short width, and the single row case
+bool checkDownsample(const PixelKernels& kernels, const std::vector<unsigned char>& src)
+{
+    const PixelKernels& scalar = *pixelKernels(PIXEL_KERNELS_SCALAR);
+    const int pixels = (int)(src.size() / kDepth);
+
+    std::vector<unsigned char> expected, actual;
+    for (int width = 1; width <= 200; ++width)
+    {
+        for (int offset = 0; offset + width * 2 <= pixels; offset += 4099)
+        {
+            const unsigned char* row0 = src.data() + (size_t)offset * kDepth;
+            const unsigned char* row1 = row0 + (size_t)width * kDepth;
+
+            for (int single = 0; single < 2; ++single)
+            {
+                // a pixel past the end to catch anything written there
+                expected.assign((size_t)((width + 1) / 2 + 1) * kDepth, 0xcd);
+                actual = expected;
+                scalar.downsampleRow(expected.data(), row0, single ? row0 : row1, width);
+                kernels.downsampleRow(actual.data(), row0, single ? row0 : row1, width);
+                if (expected != actual)
+                {
+                    printf("%-6s %-14s MISMATCH for %d pixels at %d%s\n", kernels.name, "downsample", width, offset, single ? " (single row)" : "");
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// a few rows of every short width from anywhere in src - the lanes carry on from row to row
+bool checkHash(const PixelKernels& kernels, const std::vector<unsigned char>& src)
+{
+    const PixelKernels& scalar = *pixelKernels(PIXEL_KERNELS_SCALAR);
+    const int pixels = (int)(src.size() / kDepth);
+
+    for (int width = 1; width <= 200; ++width)
+    {
+        for (int offset = 0; offset + width * 3 <= pixels; offset += 4099)
+        {
+            unsigned int expected[kHashLanes];
+            unsigned int actual[kHashLanes];
+            for (int lane = 0; lane < kHashLanes; ++lane)
+            {
+                expected[lane] = actual[lane] = (unsigned int)lane;
+            }
+
+            for (int row = 0; row < 3; ++row)
+            {
+                const unsigned char* row_pixels = src.data() + ((size_t)offset + (size_t)row * width) * kDepth;
+                scalar.hashRow(expected, row_pixels, width);
+                kernels.hashRow(actual, row_pixels, width);
+            }
+
+            if (memcmp(expected, actual, sizeof(expected)) != 0)
+            {
+                printf("%-6s %-14s MISMATCH for %d pixels at %d\n", kernels.name, "tile hash", width, offset);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// clipped blits against a pixel at a time reference, with rects hanging off every edge
+bool checkBlitRect()
+{
+    const int src_width = 37;
+    const int src_height = 23;
+    const int dst_width = 53;
+    const int dst_height = 29;
+
+    std::vector<unsigned char> src((size_t)src_width * src_height * kDepth);
+    fillPattern(src, 1);
+
+    for (int test = 0; test < 2000; ++test)
+    {
+        Rect src_rect((test * 7) % 50 - 10, (test * 11) % 40 - 10, (test * 13) % 45, (test * 17) % 35);
+        int dst_x = (test * 19) % 70 - 20;
+        int dst_y = (test * 23) % 45 - 10;
+
+        std::vector<unsigned char> expected((size_t)dst_width * dst_height * kDepth);
+        fillPattern(expected, test);
+        std::vector<unsigned char> actual = expected;
+
+        Rect expected_written;
+        for (int y = 0; y < src_rect.height; ++y)
+        {
+            for (int x = 0; x < src_rect.width; ++x)
+            {
+                int sx = src_rect.x + x;
+                int sy = src_rect.y + y;
+                int dx = dst_x + x;
+                int dy = dst_y + y;
+                if (sx >= 0 && sy >= 0 && sx < src_width && sy < src_height && dx >= 0 && dy >= 0 && dx < dst_width && dy < dst_height)
+                {
+                    memcpy(&expected[((size_t)dy * dst_width + dx) * kDepth], &src[((size_t)sy * src_width + sx) * kDepth], kDepth);
+                    expected_written = expected_written.isEmpty() ? Rect(dx, dy, 1, 1) : unionRect(expected_written, Rect(dx, dy, 1, 1));
+                }
+            }
+        }
+
+        Rect written = blitRect(src.data(), src_width, src_height, src_rect, actual.data(), dst_width, dst_height, dst_x, dst_y, BLIT_COPY);
+
+        bool same_rect = written.x == expected_written.x && written.y == expected_written.y &&
+                         written.width == expected_written.width && written.height == expected_written.height;
+        if (expected != actual || ! (same_rect || (written.isEmpty() && expected_written.isEmpty())))
+        {
+            printf("blitRect MISMATCH for %d,%d %dx%d at %d,%d\n", src_rect.x, src_rect.y, src_rect.width, src_rect.height, dst_x, dst_y);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+double timeKernel(const KernelInfo& info, const PixelKernels& kernels, int frames)
+{
+    std::vector<unsigned char> src((size_t)kFrameWidth * kFrameHeight * kDepth);
+    std::vector<unsigned char> dst(src.size());
+    fillPattern(src, 7);
+    fillPattern(dst, 8);
+
+    Samples times;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        double start = nowMicroseconds();
+        for (int row = 0; row < kFrameHeight; ++row)
+        {
+            size_t offset = (size_t)row * kFrameWidth * kDepth;
+            (kernels.*info.row)(dst.data() + offset, src.data() + offset, kFrameWidth);
+        }
+        times.add(nowMicroseconds() - start);
+    }
+
+    return times.percentile(50);
+}
+
+double timeI420(const PixelKernels& kernels, int frames)
+{
+    std::vector<unsigned char> src((size_t)kFrameWidth * kFrameHeight * kDepth);
+    std::vector<unsigned char> dst((size_t)kFrameWidth * kFrameHeight * 3 / 2);
+    fillPattern(src, 7);
+
+    unsigned char* y = dst.data();
+    unsigned char* u = y + kFrameWidth * kFrameHeight;
+    unsigned char* v = u + kFrameWidth * kFrameHeight / 4;
+
+    Samples times;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        double start = nowMicroseconds();
+        for (int row = 0; row < kFrameHeight; row += 2)
+        {
+            const unsigned char* row0 = src.data() + (size_t)row * kFrameWidth * kDepth;
+            kernels.bgraToI420Row(row0, row0 + kFrameWidth * kDepth, y + (size_t)row * kFrameWidth, y + (size_t)(row + 1) * kFrameWidth,
+                                  u + (size_t)row / 2 * kFrameWidth / 2, v + (size_t)row / 2 * kFrameWidth / 2, kFrameWidth);
+        }
+        times.add(nowMicroseconds() - start);
+    }
+
+    return times.percentile(50);
+}
+
+double timeDownsample(const PixelKernels& kernels, int frames)
+{
+    std::vector<unsigned char> src((size_t)kFrameWidth * kFrameHeight * kDepth);
+    std::vector<unsigned char> dst(src.size() / 4);
+    fillPattern(src, 7);
+
+    Samples times;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        double start = nowMicroseconds();
+        for (int row = 0; row < kFrameHeight; row += 2)
+        {
+            const unsigned char* row0 = src.data() + (size_t)row * kFrameWidth * kDepth;
+            kernels.downsampleRow(dst.data() + (size_t)row / 2 * kFrameWidth / 2 * kDepth, row0, row0 + kFrameWidth * kDepth, kFrameWidth);
+        }
+        times.add(nowMicroseconds() - start);
+    }
+
+    return times.percentile(50);
+}
+
+// the whole frame as rows of 64 pixels - the way tile_hasher.h hashes it
+double timeHash(const PixelKernels& kernels, int frames)
+{
+    std::vector<unsigned char> src((size_t)kFrameWidth * kFrameHeight * kDepth);
+    fillPattern(src, 7);
+
+    unsigned int lanes[kHashLanes] = {};
+    Samples times;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        double start = nowMicroseconds();
+        for (int row = 0; row < kFrameHeight; ++row)
+        {
+            for (int x = 0; x < kFrameWidth; x += 64)
+            {
+                kernels.hashRow(lanes, src.data() + ((size_t)row * kFrameWidth + x) * kDepth, 64);
+            }
+        }
+        times.add(nowMicroseconds() - start);
+    }
+
+    // so the work can't be thrown away
+    if (lanes[0] == 0x12345678u)
+    {
+        printf("\n");
+    }
+
+    return times.percentile(50);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const int frames = atoi(getArg(argc, argv, "--frames", "50").c_str());
+
+    printf("best pixel kernels for this CPU: %s\n", pixelKernels().name);
+
+    std::vector<unsigned char> src = testPixels();
+    std::vector<unsigned char> dst(src.size());
+    fillPattern(dst, 54321);
+
+    bool all_exact = checkBlitRect();
+    for (int level = PIXEL_KERNELS_SSE2; level < PIXEL_KERNELS_COUNT; ++level)
+    {
+        const PixelKernels* kernels = pixelKernels((PixelKernelLevel)level);
+        if (kernels == nullptr)
+        {
+            continue;
+        }
+
+        for (const KernelInfo& info : kKernels)
+        {
+            all_exact = checkKernel(info, *kernels, src, dst) && all_exact;
+        }
+        all_exact = checkI420(*kernels, src) && all_exact;
+        all_exact = checkDownsample(*kernels, src) && all_exact;
+        all_exact = checkHash(*kernels, src) && all_exact;
+    }
+    printf("bit exactness against scalar: %s\n\n", all_exact ? "passed" : "FAILED");
+
+    for (const KernelInfo& info : kKernels)
+    {
+        double scalar_time = 0.0;
+        for (int level = PIXEL_KERNELS_SCALAR; level < PIXEL_KERNELS_COUNT; ++level)
+        {
+            const PixelKernels* kernels = pixelKernels((PixelKernelLevel)level);
+            if (kernels == nullptr)
+            {
+                continue;
+            }
+
+            double time = timeKernel(info, *kernels, frames);
+            if (level == PIXEL_KERNELS_SCALAR)
+            {
+                scalar_time = time;
+            }
+
+            double megapixels = (double)kFrameWidth * kFrameHeight / 1.0e6;
+            printf("%-14s %-6s %8.1f us per 1080p frame %8.1f Mpixels/s %6.2fx scalar\n",
+                   info.name, kernels->name, time, megapixels / (time / 1.0e6), scalar_time / time);
+        }
+    }
+
+    double scalar_time = 0.0;
+    for (int level = PIXEL_KERNELS_SCALAR; level < PIXEL_KERNELS_COUNT; ++level)
+    {
+        const PixelKernels* kernels = pixelKernels((PixelKernelLevel)level);
+        if (kernels == nullptr)
+        {
+            continue;
+        }
+
+        double time = timeI420(*kernels, frames);
+        if (level == PIXEL_KERNELS_SCALAR)
+        {
+            scalar_time = time;
+        }
+
+        double megapixels = (double)kFrameWidth * kFrameHeight / 1.0e6;
+        printf("%-14s %-6s %8.1f us per 1080p frame %8.1f Mpixels/s %6.2fx scalar\n",
+               "bgra to i420", kernels->name, time, megapixels / (time / 1.0e6), scalar_time / time);
+    }
+
+    for (int level = PIXEL_KERNELS_SCALAR; level < PIXEL_KERNELS_COUNT; ++level)
+    {
+        const PixelKernels* kernels = pixelKernels((PixelKernelLevel)level);
+        if (kernels == nullptr)
+        {
+            continue;
+        }
+
+        double time = timeDownsample(*kernels, frames);
+        if (level == PIXEL_KERNELS_SCALAR)
+        {
+            scalar_time = time;
+        }
+
+        double megapixels = (double)kFrameWidth * kFrameHeight / 1.0e6;
+        printf("%-14s %-6s %8.1f us per 1080p frame %8.1f Mpixels/s %6.2fx scalar\n",
+               "downsample", kernels->name, time, megapixels / (time / 1.0e6), scalar_time / time);
+    }
+
+    for (int level = PIXEL_KERNELS_SCALAR; level < PIXEL_KERNELS_COUNT; ++level)
+    {
+        const PixelKernels* kernels = pixelKernels((PixelKernelLevel)level);
+        if (kernels == nullptr)
+        {
+            continue;
+        }
+
+        double time = timeHash(*kernels, frames);
+        if (level == PIXEL_KERNELS_SCALAR)
+        {
+            scalar_time = time;
+        }
+
+        double megapixels = (double)kFrameWidth * kFrameHeight / 1.0e6;
+        printf("%-14s %-6s %8.1f us per 1080p frame %8.1f Mpixels/s %6.2fx scalar\n",
+               "tile hash", kernels->name, time, megapixels / (time / 1.0e6), scalar_time / time);
+    }
+
+    return all_exact ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// what opening and closing <select> dropdowns costs in memory allocation. Each
+// cycle is an OnPopupSize (allocate and clear a popup buffer at one of a
+// handful of dropdown sizes), a paint into it and an OnPopupShow(false) (free
+// it) - once with new[]/delete[] the way RenderHandler used to, once from a
+// PixelPool, and then through the Compositor with a pool that caches nothing
+// and one that does. Last of all it times full 1080p frame copies into a
+// buffer from new[], from the pool and from the pool with huge pages to see
+// what page alignment and huge pages do for the copies every full repaint makes
+//
+//     popup_pool_bench [--cycles <popup open/close cycles>] [--frames <1080p frame copies>]
+
+#include "compositor.h"
+#include "pixel_pool.h"
+
+#include "bench_util.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    const int kPageWidth = 1920;
+    const int kPageHeight = 1080;
+
+    // dropdowns with 3 to 20 items, 150 to 400 pixels wide
+    Rect popupRect(size_t cycle)
+    {
+        int items = 3 + (int)(cycle * 7 % 18);
+        int width = 150 + (int)(cycle * 13 % 6) * 50;
+        return Rect(100, 200, width, items * 22);
+    }
+
+    void report(const char* name, Samples& times, size_t allocations, size_t cycles)
+    {
+        printf("%-28s p50 %8.0f ns p99 %8.0f ns mean %8.0f ns  %7zu system allocations for %zu cycles\n", name,
+               times.percentile(50) * 1000.0, times.percentile(99) * 1000.0, times.mean() * 1000.0, allocations, cycles);
+    }
+}
+
+// allocate, clear and fill a popup buffer, then free it
+void newDeleteCycles(size_t cycles, const std::vector<unsigned char>& cef_buffer)
+{
+    Samples times;
+    for (size_t cycle = 0; cycle < cycles; ++cycle)
+    {
+        Rect rect = popupRect(cycle);
+        size_t bytes = rect.area() * kDepth;
+
+        double start = nowMicroseconds();
+        unsigned char* pixels = new unsigned char[bytes];
+        memset(pixels, 0, bytes);
+        memcpy(pixels, cef_buffer.data(), bytes);
+        delete[] pixels;
+        times.add(nowMicroseconds() - start);
+    }
+    report("new[]/delete[]", times, cycles, cycles);
+}
+
+void poolCycles(size_t cycles, const std::vector<unsigned char>& cef_buffer)
+{
+    PixelPool pool;
+    Samples times;
+    for (size_t cycle = 0; cycle < cycles; ++cycle)
+    {
+        Rect rect = popupRect(cycle);
+        size_t bytes = rect.area() * kDepth;
+
+        double start = nowMicroseconds();
+        PixelBuffer pixels = pool.acquire(bytes);
+        memset(pixels.data(), 0, bytes);
+        memcpy(pixels.data(), cef_buffer.data(), bytes);
+        pixels.clear();
+        times.add(nowMicroseconds() - start);
+    }
+    report("PixelPool", times, pool.stats().allocations, cycles);
+}
+
+// the whole popup path - popupSize(), a full popup paint composited into the page and popupShow(false)
+void compositorCycles(size_t cycles, const std::vector<unsigned char>& cef_buffer, bool cached)
+{
+    PixelPool pool(cached ? 32 * 1024 * 1024 : 0);
+    NullUploadBackend backend;
+    Compositor compositor(&backend);
+    compositor.setPixelPool(&pool);
+
+    RectList damage = compositor.paintView(RectList(1, Rect(0, 0, kPageWidth, kPageHeight)), cef_buffer.data(), kPageWidth, kPageHeight);
+    compositor.upload(damage);
+
+    Samples times;
+    for (size_t cycle = 0; cycle < cycles; ++cycle)
+    {
+        Rect rect = popupRect(cycle);
+
+        double start = nowMicroseconds();
+        compositor.popupShow(true);
+        compositor.popupSize(rect);
+        damage = compositor.paintPopup(RectList(1, Rect(0, 0, rect.width, rect.height)), cef_buffer.data(), rect.width, rect.height);
+        compositor.upload(damage);
+        compositor.popupShow(false);
+        times.add(nowMicroseconds() - start);
+    }
+
+    // the page buffer was allocated before the timing started
+    report(cached ? "Compositor, pool" : "Compositor, no caching", times, pool.stats().allocations - 1, cycles);
+}
+
+// copy full frames into dst and time each one
+void frameCopies(const char* name, unsigned char* dst, const std::vector<unsigned char>& cef_buffer, int frames)
+{
+    Samples times;
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        double start = nowMicroseconds();
+        memcpy(dst, cef_buffer.data(), cef_buffer.size());
+        times.add(nowMicroseconds() - start);
+    }
+
+    printf("%-28s p50 %8.1f us p99 %8.1f us  %6.2f GB/s  (buffer at %p)\n", name, times.percentile(50), times.percentile(99),
+           cef_buffer.size() / (times.percentile(50) * 1000.0), (void*)dst);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const size_t cycles = (size_t)atoi(getArg(argc, argv, "--cycles", "200000").c_str());
+    const int frames = atoi(getArg(argc, argv, "--frames", "200").c_str());
+
+    std::vector<unsigned char> cef_buffer((size_t)kPageWidth * kPageHeight * kDepth);
+    fillPattern(cef_buffer, 3);
+
+    printf("popup_pool_bench: %zu popup open/close cycles\n", cycles);
+    newDeleteCycles(cycles, cef_buffer);
+    poolCycles(cycles, cef_buffer);
+    compositorCycles(cycles / 10, cef_buffer, false);
+    compositorCycles(cycles / 10, cef_buffer, true);
+
+    printf("\n%d full %dx%d frame copies\n", frames, kPageWidth, kPageHeight);
+    {
+        unsigned char* pixels = new unsigned char[cef_buffer.size()];
+        memset(pixels, 0, cef_buffer.size());
+        frameCopies("new[]", pixels, cef_buffer, frames);
+        delete[] pixels;
+    }
+
+    for (int huge = 0; huge < 2; ++huge)
+    {
+        PixelPool pool;
+        pool.setHugePages(huge == 1);
+        PixelBuffer pixels = pool.acquire(cef_buffer.size());
+        memset(pixels.data(), 0, pixels.size());
+        frameCopies(huge ? "PixelPool, huge pages" : "PixelPool", pixels.data(), cef_buffer, frames);
+        if (huge && pool.stats().hugePageAllocations == 0)
+        {
+            printf("%-28s (the system wouldn't give us huge pages)\n", "");
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,373 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// runs the app's main loop against a stand in for CEF, once calling
+// CefDoMessageLoopWork() as often as possible (the busy loop) and once with
+// the external message pump, and reports the CPU used while the page is idle
+// and while clicks are arriving, along with the click to paint latency. The
+// external pump runs twice - once redrawing every frame and once presenting
+// only when something painted (RenderScheduler), which also reports how many
+// presents there were and how long paints waited to be presented.
+//
+// The stand in keeps a page timer running (like a clock on the page) and
+// sends each click to a "renderer" thread which paints a couple of
+// milliseconds later and posts the paint back to the main thread - which is
+// when CEF would call OnScheduleMessagePumpWork from another thread
+//
+//     pump_bench [--seconds <per phase>] [--click-interval <ms>]
+
+#include "pump_scheduler.h"
+#include "render_scheduler.h"
+
+#include "bench_util.h"
+
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <thread>
+
+namespace
+{
+    const double kFrameInterval = 1000.0 / 60.0;
+    const double kMaxPumpDelay = 1000.0 / 30.0;
+
+    // how long the page's own timer waits between runs and how long the renderer takes to paint
+    const double kPageTimerInterval = 250.0;
+    const int kRenderMilliseconds = 2;
+
+    // what drawing and presenting the window costs the main thread
+    const double kDrawMilliseconds = 0.3;
+
+    enum LoopMode
+    {
+        BUSY_LOOP,
+        EXTERNAL_PUMP,
+        PRESENT_ON_DAMAGE
+    };
+
+    void draw()
+    {
+        double start = PumpScheduler::now();
+        while (PumpScheduler::now() - start < kDrawMilliseconds)
+        {
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+// a queue of things to run on the main thread when they're due - the part of CEF
+// that CefDoMessageLoopWork() drives
+class FakeCef
+{
+    public:
+        FakeCef(PumpScheduler* scheduler) :
+            mScheduler(scheduler)
+        {
+        }
+
+        // any thread
+        void post(double delay, const std::function<void()>& task)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mTasks.insert(std::make_pair(PumpScheduler::now() + delay, task));
+            }
+
+            if (mScheduler)
+            {
+                mScheduler->scheduleWork((int64_t)std::ceil(delay));
+            }
+        }
+
+        // CefDoMessageLoopWork() - main thread
+        void doWork()
+        {
+            double now = PumpScheduler::now();
+            while (true)
+            {
+                std::function<void()> task;
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    if (mTasks.empty() || mTasks.begin()->first > now)
+                    {
+                        break;
+                    }
+                    task = mTasks.begin()->second;
+                    mTasks.erase(mTasks.begin());
+                }
+                task();
+            }
+
+            // CEF tells us when it next needs pumping once it's done
+            if (mScheduler)
+            {
+                double next_due = -1.0;
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    if (! mTasks.empty())
+                    {
+                        next_due = mTasks.begin()->first;
+                    }
+                }
+
+                if (next_due >= 0.0)
+                {
+                    mScheduler->scheduleWork((int64_t)std::ceil(std::max(next_due - PumpScheduler::now(), 0.0)));
+                }
+            }
+        }
+
+    private:
+        PumpScheduler* mScheduler;
+        std::mutex mMutex;
+        std::multimap<double, std::function<void()>> mTasks;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// stands in for the Windows message queue - clicks arrive here from another thread
+class MessageQueue
+{
+    public:
+        MessageQueue() :
+            mWoken(false)
+        {
+        }
+
+        void postClick()
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mClicks.push_back(PumpScheduler::now());
+            mCondition.notify_one();
+        }
+
+        // PostMessage(WM_PUMP_WORK)
+        void wake()
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mWoken = true;
+            mCondition.notify_one();
+        }
+
+        // MsgWaitForMultipleObjectsEx()
+        void wait(double milliseconds)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait_for(lock, std::chrono::microseconds((long long)(milliseconds * 1000.0)), [this]()
+            {
+                return mWoken || ! mClicks.empty();
+            });
+            mWoken = false;
+        }
+
+        // PeekMessage()
+        bool takeClick()
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mClicks.empty())
+            {
+                return false;
+            }
+            mClicks.pop_front();
+            return true;
+        }
+
+    private:
+        std::mutex mMutex;
+        std::condition_variable mCondition;
+        std::deque<double> mClicks;
+        bool mWoken;
+};
+
+struct PhaseResult
+{
+    double cpuPercent;
+    double workCallsPerSecond;
+    double wakeupsPerSecond;
+    double latencyP50;
+    double latencyP99;
+    size_t clicks;
+    double presentsPerSecond;
+    size_t droppedFrames;
+    double paintToPresentP50;
+    double paintToPresentP99;
+};
+
+PhaseResult runPhase(LoopMode mode, double seconds, double click_interval)
+{
+    const bool external_pump = (mode != BUSY_LOOP);
+    const bool present_on_damage = (mode == PRESENT_ON_DAMAGE);
+
+    PumpScheduler scheduler(present_on_damage ? 0.0 : kFrameInterval, kMaxPumpDelay);
+    RenderScheduler render(kFrameInterval);
+    FakeCef cef(external_pump ? &scheduler : nullptr);
+    MessageQueue queue;
+    InputLatencyTracker latency;
+
+    scheduler.setWakeCallback([&queue]()
+    {
+        queue.wake();
+    });
+
+    // the page has a timer of its own that keeps going whether we click or not
+    std::function<void()> page_timer;
+    page_timer = [&]()
+    {
+        cef.post(kPageTimerInterval, page_timer);
+    };
+    cef.post(kPageTimerInterval, page_timer);
+
+    std::atomic<bool> running(true);
+
+    // clicks go off to the renderer, which paints and posts the result back from its own thread
+    std::mutex renderer_mutex;
+    std::condition_variable renderer_condition;
+    int renderer_pending = 0;
+    std::thread renderer([&]()
+    {
+        std::unique_lock<std::mutex> lock(renderer_mutex);
+        while (running)
+        {
+            renderer_condition.wait_for(lock, std::chrono::milliseconds(50), [&]()
+            {
+                return renderer_pending > 0 || ! running;
+            });
+
+            while (renderer_pending > 0)
+            {
+                --renderer_pending;
+                lock.unlock();
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(kRenderMilliseconds));
+                cef.post(0.0, [&latency, &render]()
+                {
+                    latency.painted(PumpScheduler::now());
+                    render.damage(PumpScheduler::now());
+                });
+
+                lock.lock();
+            }
+        }
+    });
+
+    std::thread clicker([&]()
+    {
+        if (click_interval <= 0.0)
+        {
+            return;
+        }
+
+        while (running)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds((long long)(click_interval * 1000.0)));
+            queue.postClick();
+        }
+    });
+
+    double start = PumpScheduler::now();
+    double cpu_start = processCpuTime();
+
+    while (PumpScheduler::now() - start < seconds * 1000.0)
+    {
+        while (queue.takeClick())
+        {
+            latency.inputSent(PumpScheduler::now());
+            cef.post(0.0, [&]()
+            {
+                std::lock_guard<std::mutex> lock(renderer_mutex);
+                ++renderer_pending;
+                renderer_condition.notify_one();
+            });
+        }
+
+        if (! external_pump || scheduler.workDue(PumpScheduler::now()))
+        {
+            scheduler.beginWork(PumpScheduler::now());
+            cef.doWork();
+            scheduler.endWork(PumpScheduler::now());
+        }
+
+        bool present = present_on_damage ? render.presentDue(PumpScheduler::now()) :
+                       (! external_pump || scheduler.frameDue(PumpScheduler::now()));
+        if (present)
+        {
+            draw();
+            scheduler.frameDone(PumpScheduler::now());
+            render.presented(PumpScheduler::now());
+        }
+
+        if (external_pump)
+        {
+            double timeout = scheduler.timeUntilDue(PumpScheduler::now());
+            if (present_on_damage)
+            {
+                timeout = std::min(timeout, render.timeUntilPresent(PumpScheduler::now()));
+            }
+            if (timeout > 0.0)
+            {
+                queue.wait(timeout);
+                scheduler.wokeUp();
+            }
+        }
+    }
+
+    double elapsed = PumpScheduler::now() - start;
+    double cpu = processCpuTime() - cpu_start;
+
+    running = false;
+    renderer_condition.notify_one();
+    clicker.join();
+    renderer.join();
+
+    PumpStats stats = scheduler.stats();
+
+    PhaseResult result;
+    result.cpuPercent = cpu / elapsed * 100.0;
+    result.workCallsPerSecond = stats.workCalls / (elapsed / 1000.0);
+    result.wakeupsPerSecond = stats.wakeups / (elapsed / 1000.0);
+    result.latencyP50 = latency.percentile(50);
+    result.latencyP99 = latency.percentile(99);
+    result.clicks = latency.count();
+    result.presentsPerSecond = render.stats().presents / (elapsed / 1000.0);
+    result.droppedFrames = render.stats().droppedFrames;
+    result.paintToPresentP50 = samplePercentile(render.stats().paintToPresent, 50);
+    result.paintToPresentP99 = samplePercentile(render.stats().paintToPresent, 99);
+    return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const double seconds = atof(getArg(argc, argv, "--seconds", "3").c_str());
+    const double click_interval = atof(getArg(argc, argv, "--click-interval", "30").c_str());
+
+    const LoopMode modes[] = { BUSY_LOOP, EXTERNAL_PUMP, PRESENT_ON_DAMAGE };
+    const char* names[] = { "busy loop", "external pump", "on damage" };
+
+    for (int i = 0; i < 3; ++i)
+    {
+        PhaseResult idle = runPhase(modes[i], seconds, 0.0);
+        printf("%-14s idle     CPU %6.1f%% of a core %10.0f work calls/s %8.0f wakeups/s %6.1f presents/s\n",
+               names[i], idle.cpuPercent, idle.workCallsPerSecond, idle.wakeupsPerSecond, idle.presentsPerSecond);
+
+        PhaseResult active = runPhase(modes[i], seconds, click_interval);
+        printf("%-14s clicking CPU %6.1f%% of a core %10.0f work calls/s %8.0f wakeups/s %6.1f presents/s | click to paint p50 %6.2f ms p99 %6.2f ms (%zu clicks)",
+               names[i], active.cpuPercent, active.workCallsPerSecond, active.wakeupsPerSecond, active.presentsPerSecond,
+               active.latencyP50, active.latencyP99, active.clicks);
+        if (modes[i] == PRESENT_ON_DAMAGE)
+        {
+            printf(" | paint to present p50 %5.2f ms p99 %5.2f ms, %zu dropped frames", active.paintToPresentP50, active.paintToPresentP99, active.droppedFrames);
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,218 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// a window edge being dragged back and forth between 640x480 and 1920x1080 with
+// a <select> dropdown opening and closing now and then, run through the
+// compositor twice: once the way the app used to do it - CEF told about every
+// WM_SIZE, page and popup buffers freed and allocated again at exactly the new
+// size and a texture reallocated on every size change - and once with the
+// pixel pool, geometric texture growth (growSurface()) and the resize
+// debouncer. Reports allocations, the most memory held at once and the time
+// each paint took. Window events and paints run on a virtual clock (WM_SIZE
+// every 8ms, CEF painting at 60Hz at whatever size it was last told about) and
+// only the paints themselves are timed
+//
+//     resize_bench [--seconds <virtual seconds>] [--pool-mb <most the pool keeps cached>]
+
+#include "compositor.h"
+#include "pixel_pool.h"
+#include "resize_debouncer.h"
+
+#include "bench_util.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    const double kFrameInterval = 1000.0 / 60.0;
+    const double kResizeInterval = 8.0;
+
+    const int kMinWidth = 640;
+    const int kMinHeight = 480;
+    const int kMaxWidth = 1920;
+    const int kMaxHeight = 1080;
+
+    // how the app reacted to size changes before the pool and debouncer
+    class ExactUploadBackend :
+        public UploadBackend
+    {
+        public:
+            ExactUploadBackend() : mWidth(0), mReallocations(0) {}
+
+            void resize(int width, int height) override
+            {
+                std::vector<unsigned char>((size_t)width * height * kDepth).swap(mPixels);
+                mWidth = width;
+                ++mReallocations;
+            }
+
+            void upload(const Rect& rect, const unsigned char* pixels, int stride) override
+            {
+                for (int y = 0; y < rect.height; ++y)
+                {
+                    memcpy(&mPixels[((size_t)(rect.y + y) * mWidth + rect.x) * kDepth], pixels + (size_t)y * stride * kDepth, (size_t)rect.width * kDepth);
+                }
+            }
+
+            size_t memoryUsage() const override
+            {
+                return mPixels.capacity();
+            }
+
+            size_t reallocations() const
+            {
+                return mReallocations;
+            }
+
+        private:
+            int mWidth;
+            size_t mReallocations;
+            std::vector<unsigned char> mPixels;
+    };
+}
+
+struct ResizeResult
+{
+    size_t paints;
+    size_t wasResized;
+    size_t acquires;
+    size_t allocations;
+    size_t textureReallocations;
+    size_t peakBytes;
+    Samples paintTimes;
+};
+
+// where the dragged edge is at a given time - one out and back every two seconds
+void windowSize(double time, int& width, int& height)
+{
+    double t = 0.5 - 0.5 * std::cos(time / 1000.0 * 3.14159265358979);
+    width = kMinWidth + (int)((kMaxWidth - kMinWidth) * t);
+    height = kMinHeight + (int)((kMaxHeight - kMinHeight) * t);
+}
+
+ResizeResult replay(double seconds, bool pooled, size_t pool_bytes)
+{
+    // nothing is cached in the naive run so every buffer comes from the system
+    PixelPool pool(pooled ? pool_bytes : 0);
+    SoftwareUploadBackend software_backend;
+    ExactUploadBackend exact_backend;
+    UploadBackend* backend = pooled ? (UploadBackend*)&software_backend : (UploadBackend*)&exact_backend;
+
+    Compositor compositor(backend);
+    compositor.setPixelPool(&pool);
+
+    ResizeDebouncer debouncer(pooled ? 50.0 : 0.0, pooled ? 100.0 : 0.0);
+
+    std::vector<unsigned char> cef_buffer((size_t)kMaxWidth * kMaxHeight * kDepth);
+    fillPattern(cef_buffer, 7);
+
+    ResizeResult result;
+    result.paints = 0;
+    result.wasResized = 0;
+    result.peakBytes = 0;
+
+    // the size CEF has been told about
+    int cef_width = kMinWidth;
+    int cef_height = kMinHeight;
+    bool popup_open = false;
+
+    double next_vsync = 0.0;
+    for (double now = 0.0; now < seconds * 1000.0; now += kResizeInterval)
+    {
+        // WM_SIZE
+        int width, height;
+        windowSize(now, width, height);
+        if (width != cef_width || height != cef_height)
+        {
+            debouncer.resized(now);
+        }
+
+        if (debouncer.due(now))
+        {
+            cef_width = width;
+            cef_height = height;
+            ++result.wasResized;
+            debouncer.done();
+        }
+
+        // a dropdown opens for 300ms in every 700, at a size that depends on where it opened
+        bool want_popup = fmod(now, 700.0) < 300.0;
+        if (want_popup != popup_open)
+        {
+            popup_open = want_popup;
+            compositor.popupShow(popup_open);
+            if (popup_open)
+            {
+                int items = 4 + (int)(now / 700.0) % 12;
+                compositor.popupSize(Rect(40, 60, 200 + items * 7, items * 20));
+            }
+        }
+
+        // CEF paints
+        if (now < next_vsync)
+        {
+            continue;
+        }
+        next_vsync += kFrameInterval;
+
+        double start = nowMicroseconds();
+        RectList damage = compositor.paintView(RectList(1, Rect(0, 0, cef_width, cef_height)), cef_buffer.data(), cef_width, cef_height);
+        compositor.upload(damage);
+        if (popup_open)
+        {
+            const Rect& popup = compositor.popupRect();
+            damage = compositor.paintPopup(RectList(1, Rect(0, 0, popup.width, popup.height)), cef_buffer.data(), popup.width, popup.height);
+            compositor.upload(damage);
+        }
+        compositor.endFrame();
+        result.paintTimes.add(nowMicroseconds() - start);
+        ++result.paints;
+
+        size_t bytes = compositor.memoryUsage() + backend->memoryUsage();
+        if (! pooled && bytes > result.peakBytes)
+        {
+            result.peakBytes = bytes;
+        }
+    }
+
+    PixelPoolStats stats = pool.stats();
+    result.acquires = stats.acquires;
+    result.allocations = stats.allocations;
+    result.textureReallocations = pooled ? software_backend.reallocations() : exact_backend.reallocations();
+    if (pooled)
+    {
+        // the pool's peak includes what it had cached
+        result.peakBytes = stats.peakBytes + backend->memoryUsage();
+    }
+    return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const double seconds = atof(getArg(argc, argv, "--seconds", "20").c_str());
+    const size_t pool_bytes = (size_t)atoi(getArg(argc, argv, "--pool-mb", "32").c_str()) * 1024 * 1024;
+
+    printf("resize_bench: %.0f s of dragging between %dx%d and %dx%d, WM_SIZE every %.0f ms\n",
+           seconds, kMinWidth, kMinHeight, kMaxWidth, kMaxHeight, kResizeInterval);
+
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        bool pooled = (mode == 1);
+        ResizeResult result = replay(seconds, pooled, pool_bytes);
+
+        printf("%-8s %5zu paints, %5zu WasResized, %5zu buffer allocations for %5zu buffers, %4zu texture reallocations, peak %6.1f MB, paint p50 %7.1f us p99 %7.1f us\n",
+               pooled ? "pooled" : "naive", result.paints, result.wasResized, result.allocations, result.acquires, result.textureReallocations,
+               result.peakBytes / (1024.0 * 1024.0), result.paintTimes.percentile(50), result.paintTimes.percentile(99));
+    }
+
+    return 0;
+}
@@ -0,0 +1,692 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// how long it takes to load a page's worth of resources (an HTML page, its
+// scripts, styles, images and a video - about 4MB in 32 files) from a local
+// HTTP server standing in for the network, compared with answering the same
+// requests from memory the way the apps' resource handler does (see
+// src/cef_resources.h):
+//
+//   network     every request goes to the server
+//   cache cold  an empty ResourceCache - everything is fetched and kept
+//   cache warm  everything comes out of the cache
+//   pack cold   the asset pack (src/asset_pack.h) mapped afresh for each load -
+//               the file itself is still in the OS's cache
+//   pack warm   the asset pack, mapped once
+//
+// Bodies are read out in 32KB pieces the way CEF reads them. --latency adds a
+// delay to each of the server's responses to look more like a real network.
+// Every body and a set of Range requests are checked against the files, and
+// the cache is checked to throw out the least recently used responses first -
+// exits with 1 if anything doesn't match. So are the cache's rules for what it
+// keeps and for how long (see cacheLifetime()), and that the headers a response
+// came with are sent again from the cache. Linux only (the server uses POSIX
+// sockets)
+//
+//     resource_bench [--loads <page loads per run>] [--latency <milliseconds per response>]
+
+#include "asset_pack.h"
+#include "resource_cache.h"
+
+#include "bench_util.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    const size_t kReadSize = 32 * 1024;
+
+    struct SiteFile
+    {
+        std::string path;
+        std::vector<unsigned char> data;
+    };
+
+    // sizes look like a small web app with a video on it
+    std::vector<SiteFile> makeSite()
+    {
+        struct Kind
+        {
+            const char* format;
+            int count;
+            size_t size;
+        };
+        const Kind kinds[] =
+        {
+            { "index.html", 1, 24 * 1024 },
+            { "js/module_%d.js", 10, 90 * 1024 },
+            { "css/style_%d.css", 5, 20 * 1024 },
+            { "images/image_%d.png", 15, 110 * 1024 },
+            { "media/intro.webm", 1, 3 * 1024 * 1024 },
+        };
+
+        std::vector<SiteFile> site;
+        for (const Kind& kind : kinds)
+        {
+            for (int i = 0; i < kind.count; ++i)
+            {
+                char path[64];
+                snprintf(path, sizeof(path), kind.format, i);
+
+                SiteFile file;
+                file.path = path;
+                // not all the same size
+                file.data.resize(kind.size / 2 + (kind.size * (size_t)(i * 37 % 10)) / 10 + 1);
+                for (size_t j = 0; j < file.data.size(); ++j)
+                {
+                    file.data[j] = (unsigned char)((j * 2654435761u + site.size() * 40503u) >> 11);
+                }
+                site.push_back(file);
+            }
+        }
+        return site;
+    }
+
+    bool writeSite(const std::string& directory, const std::vector<SiteFile>& site)
+    {
+        for (const SiteFile& file : site)
+        {
+            std::string name = directory + "/" + file.path;
+            size_t slash = name.find_last_of('/');
+            mkdir(name.substr(0, slash).c_str(), 0755);
+
+            FILE* out = fopen(name.c_str(), "wb");
+            if (out == nullptr)
+            {
+                return false;
+            }
+            bool ok = fwrite(file.data.data(), 1, file.data.size(), out) == file.data.size();
+            ok = (fclose(out) == 0) && ok;
+            if (! ok)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void removeSite(const std::string& directory, const std::vector<SiteFile>& site)
+    {
+        for (const SiteFile& file : site)
+        {
+            std::string name = directory + "/" + file.path;
+            unlink(name.c_str());
+            rmdir(name.substr(0, name.find_last_of('/')).c_str());
+        }
+        rmdir(directory.c_str());
+    }
+
+    bool sendAll(int fd, const void* data, size_t size)
+    {
+        const char* bytes = (const char*)data;
+        while (size > 0)
+        {
+            ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+            if (sent <= 0)
+            {
+                return false;
+            }
+            bytes += sent;
+            size -= (size_t)sent;
+        }
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////
+    // a minimal HTTP/1.1 server on 127.0.0.1 - GETs only, one connection per request
+    class HttpStandIn
+    {
+        public:
+            HttpStandIn(const std::vector<SiteFile>& site, double latency) :
+                mLatency(latency),
+                mQuit(false),
+                mListener(-1),
+                mPort(0)
+            {
+                for (const SiteFile& file : site)
+                {
+                    mFiles["/" + file.path] = &file;
+                }
+            }
+
+            ~HttpStandIn()
+            {
+                stop();
+            }
+
+            bool start()
+            {
+                mListener = socket(AF_INET, SOCK_STREAM, 0);
+                sockaddr_in address;
+                memset(&address, 0, sizeof(address));
+                address.sin_family = AF_INET;
+                address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                socklen_t length = sizeof(address);
+                if (mListener < 0 || bind(mListener, (sockaddr*)&address, sizeof(address)) != 0 ||
+                    listen(mListener, 64) != 0 || getsockname(mListener, (sockaddr*)&address, &length) != 0)
+                {
+                    return false;
+                }
+
+                mPort = ntohs(address.sin_port);
+                mThread = std::thread(&HttpStandIn::serve, this);
+                return true;
+            }
+
+            void stop()
+            {
+                if (mListener >= 0)
+                {
+                    mQuit = true;
+                    shutdown(mListener, SHUT_RDWR);
+                    if (mThread.joinable())
+                    {
+                        mThread.join();
+                    }
+                    close(mListener);
+                    mListener = -1;
+                }
+            }
+
+            std::string origin() const
+            {
+                return "http://127.0.0.1:" + std::to_string(mPort) + "/";
+            }
+
+            int port() const
+            {
+                return mPort;
+            }
+
+        private:
+            void serve()
+            {
+                while (! mQuit)
+                {
+                    int connection = accept(mListener, nullptr, nullptr);
+                    if (connection < 0)
+                    {
+                        continue;
+                    }
+
+                    std::string request;
+                    char buffer[4096];
+                    while (request.find("\r\n\r\n") == std::string::npos)
+                    {
+                        ssize_t received = recv(connection, buffer, sizeof(buffer), 0);
+                        if (received <= 0)
+                        {
+                            break;
+                        }
+                        request.append(buffer, (size_t)received);
+                    }
+
+                    // "GET /path HTTP/1.1"
+                    size_t path_start = request.find(' ') + 1;
+                    std::string path = request.substr(path_start, request.find(' ', path_start) - path_start);
+                    auto found = mFiles.find(path);
+
+                    if (mLatency > 0.0)
+                    {
+                        std::this_thread::sleep_for(std::chrono::microseconds((long long)(mLatency * 1000.0)));
+                    }
+
+                    std::string header;
+                    if (found == mFiles.end())
+                    {
+                        header = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+                        sendAll(connection, header.data(), header.size());
+                    }
+                    else
+                    {
+                        const SiteFile& file = *found->second;
+                        header = "HTTP/1.1 200 OK\r\nContent-Type: " + mimeTypeForPath(file.path) +
+                                 "\r\nCache-Control: public, max-age=3600\r\nAccess-Control-Allow-Origin: *" +
+                                 "\r\nContent-Length: " + std::to_string(file.data.size()) + "\r\nConnection: close\r\n\r\n";
+                        if (sendAll(connection, header.data(), header.size()))
+                        {
+                            sendAll(connection, file.data.data(), file.data.size());
+                        }
+                    }
+                    close(connection);
+                }
+            }
+
+            std::map<std::string, const SiteFile*> mFiles;
+            double mLatency;
+            std::atomic<bool> mQuit;
+            int mListener;
+            int mPort;
+            std::thread mThread;
+    };
+
+    // what a resource handler would have answered a request with
+    struct Fetched
+    {
+        int status;
+        std::string mimeType;
+        ResourceHeaders headers;
+        std::vector<unsigned char> body;
+    };
+
+    bool httpGet(int port, const std::string& path, Fetched& fetched)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons((uint16_t)port);
+        int no_delay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+        if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) != 0)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            return false;
+        }
+
+        std::string request = "GET /" + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n";
+        std::vector<unsigned char> response;
+        bool ok = sendAll(fd, request.data(), request.size());
+        unsigned char buffer[64 * 1024];
+        ssize_t received;
+        while (ok && (received = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+        {
+            response.insert(response.end(), buffer, buffer + received);
+        }
+        close(fd);
+
+        std::string text(response.begin(), response.end());
+        size_t body_start = text.find("\r\n\r\n");
+        if (! ok || body_start == std::string::npos || text.compare(0, 9, "HTTP/1.1 ") != 0)
+        {
+            return false;
+        }
+
+        fetched.status = atoi(text.c_str() + 9);
+        fetched.mimeType.clear();
+        fetched.headers.clear();
+        for (size_t line = text.find("\r\n") + 2; line < body_start; line = text.find("\r\n", line) + 2)
+        {
+            size_t colon = text.find(": ", line);
+            size_t end = text.find("\r\n", line);
+            if (colon < end)
+            {
+                fetched.headers.push_back(std::make_pair(text.substr(line, colon - line), text.substr(colon + 2, end - colon - 2)));
+            }
+        }
+        for (const auto& header : fetched.headers)
+        {
+            if (header.first == "Content-Type")
+            {
+                fetched.mimeType = header.second;
+            }
+        }
+        fetched.body.assign(response.begin() + body_start + 4, response.end());
+        return true;
+    }
+
+    // CEF reads a response a piece at a time into buffers of its own
+    void readOut(const LocalResponse& response, std::vector<unsigned char>& body)
+    {
+        body.resize((size_t)response.length);
+        for (uint64_t offset = 0; offset < response.length; offset += kReadSize)
+        {
+            uint64_t bytes = response.length - offset < kReadSize ? response.length - offset : kReadSize;
+            memcpy(body.data() + offset, response.data + offset, (size_t)bytes);
+        }
+    }
+
+    struct Run
+    {
+        Samples loads;
+        size_t bytes;
+        bool ok;
+    };
+
+    // one page load through resources (nullptr for straight to the network) - false if a body is wrong
+    bool loadPage(const std::vector<SiteFile>& site, const HttpStandIn& server, LocalResources* resources, size_t& bytes)
+    {
+        bool ok = true;
+        Fetched fetched;
+        LocalResponse response;
+        for (const SiteFile& file : site)
+        {
+            std::string url = server.origin() + file.path;
+            if (resources != nullptr && resources->find(url, "", response))
+            {
+                readOut(response, fetched.body);
+            }
+            else
+            {
+                ok = httpGet(server.port(), file.path, fetched) && fetched.status == 200 && ok;
+                double lifetime = 0.0;
+                if (resources != nullptr && cacheLifetime(fetched.headers, lifetime))
+                {
+                    std::vector<unsigned char> body(fetched.body);
+                    resources->store(url, fetched.mimeType, fetched.headers, lifetime, std::move(body));
+                }
+            }
+
+            ok = ok && fetched.body == file.data;
+            bytes += fetched.body.size();
+        }
+        return ok;
+    }
+
+    void report(const char* name, Run& run)
+    {
+        double seconds = run.loads.total() / 1.0e6;
+        printf("  %-11s p50 %8.2f ms  p99 %8.2f ms per page load, %8.0f MB/s%s\n", name, run.loads.percentile(50) / 1000.0,
+               run.loads.percentile(99) / 1000.0, seconds > 0.0 ? run.bytes / seconds / 1.0e6 : 0.0, run.ok ? "" : " - BODIES DON'T MATCH");
+    }
+
+    // Range requests against the pack and the cache, and the parsing on its own
+    bool checkRanges(const std::vector<SiteFile>& site, const HttpStandIn& server, LocalResources& packed, LocalResources& cached)
+    {
+        struct Case
+        {
+            const char* header;
+            ByteRangeResult result;
+            uint64_t first;
+            uint64_t length;
+        };
+        const Case cases[] =
+        {
+            { "bytes=0-99", RANGE_OK, 0, 100 },
+            { "bytes=100-", RANGE_OK, 100, 900 },
+            { "bytes=-10", RANGE_OK, 990, 10 },
+            { "bytes=-5000", RANGE_OK, 0, 1000 },
+            { "bytes=990-5000", RANGE_OK, 990, 10 },
+            { " bytes=5 - 9 ", RANGE_OK, 5, 5 },
+            { "bytes=1000-", RANGE_UNSATISFIABLE, 0, 0 },
+            { "bytes=-0", RANGE_UNSATISFIABLE, 0, 0 },
+            { "bytes=9-5", RANGE_NONE, 0, 0 },
+            { "bytes=0-1,5-9", RANGE_NONE, 0, 0 },
+            { "items=0-9", RANGE_NONE, 0, 0 },
+            { "bytes=x-9", RANGE_NONE, 0, 0 },
+        };
+
+        bool ok = true;
+        for (const Case& test : cases)
+        {
+            uint64_t first = 0;
+            uint64_t length = 0;
+            ByteRangeResult result = parseByteRange(test.header, 1000, first, length);
+            if (result != test.result || (result == RANGE_OK && (first != test.first || length != test.length)))
+            {
+                printf("  range \"%s\" came out wrong\n", test.header);
+                ok = false;
+            }
+        }
+
+        const SiteFile& video = site.back();
+        const uint64_t size = video.data.size();
+        const uint64_t first = size / 3;
+        const std::string header = "bytes=" + std::to_string(first) + "-" + std::to_string(first + 65535);
+        LocalResources* sources[] = { &packed, &cached };
+        for (LocalResources* resources : sources)
+        {
+            LocalResponse response;
+            std::string url = server.origin() + video.path;
+            bool found = resources->find(url, header, response);
+            bool good = found && response.status == 206 && response.length == 65536 && response.totalSize == size &&
+                        memcmp(response.data, video.data.data() + first, 65536) == 0 &&
+                        response.contentRange == "bytes " + std::to_string(first) + "-" + std::to_string(first + 65535) + "/" + std::to_string(size);
+
+            found = resources->find(url, "bytes=" + std::to_string(size) + "-", response);
+            good = good && found && response.status == 416 && response.length == 0 && response.contentRange == "bytes */" + std::to_string(size);
+
+            // a fragment is part of the same resource, a query isn't part of a file's path
+            found = resources->find(url + "#t=10", "bytes=-16", response);
+            good = good && found && response.status == 206 && memcmp(response.data, video.data.data() + size - 16, 16) == 0;
+            if (resources == &packed)
+            {
+                found = resources->find(url + "?v=2", "", response);
+                good = good && found && response.status == 200 && response.length == size && response.mimeType == "video/webm";
+            }
+
+            if (! good)
+            {
+                printf("  range requests from the %s came out wrong\n", resources == &packed ? "pack" : "cache");
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    // what's kept and for how long, that it's kept with its headers and that it goes when it's stale
+    bool checkCacheability(const HttpStandIn& server, LocalResources& cached)
+    {
+        struct Case
+        {
+            const char* name;
+            const char* value;
+            bool cacheable;
+            double seconds;
+        };
+        const Case cases[] =
+        {
+            { "Cache-Control", "public, max-age=600", true, 600.0 },
+            { "cache-control", "MAX-AGE=60, must-revalidate", true, 60.0 },
+            { "Cache-Control", "max-age=0", false, 0.0 },
+            { "Cache-Control", "no-store", false, 0.0 },
+            { "Cache-Control", "no-cache, max-age=600", false, 0.0 },
+            { "Cache-Control", "private, max-age=600", false, 0.0 },
+            { "Pragma", "no-cache", false, 0.0 },
+            { "Expires", "Thu, 01 Jan 1970 00:10:00 GMT", true, 600.0 },
+            { "Expires", "0", false, 0.0 },
+            { "Expires", "Wed, 31 Dec 1969 23:59:59 GMT", false, 0.0 },
+            { "Vary", "Accept-Encoding", true, 600.0 },
+            { "Vary", "Accept-Encoding, Cookie", false, 0.0 },
+            { "Set-Cookie", "session=1", false, 0.0 },
+            { "Content-Type", "text/html; charset=utf-8", false, 0.0 },
+        };
+
+        bool ok = true;
+        for (const Case& test : cases)
+        {
+            // a Date to go with Expires, and max-age to go with Vary and Set-Cookie so they're what stops it
+            ResourceHeaders headers;
+            headers.push_back(std::make_pair("Date", "Thu, 01 Jan 1970 00:00:00 GMT"));
+            headers.push_back(std::make_pair(test.name, test.value));
+            if (strcmp(test.name, "Vary") == 0 || strcmp(test.name, "Set-Cookie") == 0)
+            {
+                headers.push_back(std::make_pair("Cache-Control", "max-age=600"));
+            }
+            double seconds = 0.0;
+            bool cacheable = cacheLifetime(headers, seconds);
+            if (cacheable != test.cacheable || (test.cacheable && seconds != test.seconds))
+            {
+                printf("  \"%s: %s\" is wrongly %s\n", test.name, test.value, cacheable ? "cacheable" : "not cacheable");
+                ok = false;
+            }
+        }
+
+        int64_t date = 0;
+        ok = ok && parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT", date) && date == 784111777 && ! parseHttpDate("Sunday, 06-Nov-94 08:49:37 GMT", date);
+
+        // the cache sends the headers back, and doesn't keep anything outside its origin or past its time
+        LocalResponse response;
+        std::string url = server.origin() + "index.html";
+        bool replayed = false;
+        if (cached.find(url, "", response))
+        {
+            for (const auto& header : response.headers)
+            {
+                replayed = replayed || (header.first == "Access-Control-Allow-Origin" && header.second == "*");
+            }
+        }
+
+        LocalResources stale(1024 * 1024, 1024 * 1024);
+        stale.setCacheOrigin(server.origin());
+        stale.store(url, "text/html", ResourceHeaders(), 0.05, std::vector<unsigned char>(100));
+        stale.store("http://elsewhere.example/index.html", "text/html", ResourceHeaders(), 600.0, std::vector<unsigned char>(100));
+        bool kept = stale.find(url, "", response) && ! stale.find("http://elsewhere.example/index.html", "", response);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        bool expired = ! stale.find(url, "", response) && stale.stats().expired == 1;
+
+        if (! replayed || ! kept || ! expired)
+        {
+            printf("  the cache %s\n", ! replayed ? "didn't keep a response's headers" : ! kept ? "kept the wrong responses" : "served a stale response");
+            ok = false;
+        }
+        return ok;
+    }
+
+    // fill a small cache, use everything but one and make sure that's the one that goes
+    bool checkEviction()
+    {
+        ResourceCache cache(3000, 2000);
+        auto resource = [](size_t size)
+        {
+            std::shared_ptr<CachedResource> result = std::make_shared<CachedResource>();
+            result->data.resize(size);
+            return result;
+        };
+
+        bool ok = cache.insert("a", resource(1000)) && cache.insert("b", resource(1000)) && cache.insert("c", resource(1000));
+        std::shared_ptr<const CachedResource> held = cache.find("b");
+        ok = ok && cache.find("c") && cache.find("a") && cache.insert("d", resource(1000));
+        ok = ok && cache.find("a") && ! cache.find("b") && cache.find("c") && cache.find("d");
+        // what was handed out before it went is still good
+        ok = ok && held && held->data.size() == 1000;
+        // too big for one entry, and replacing an entry
+        ok = ok && ! cache.insert("e", resource(2001)) && cache.insert("c", resource(1500));
+        ResourceCacheStats stats = cache.stats();
+        ok = ok && stats.bytes <= 3000 && ! cache.find("e") && cache.find("c") && cache.find("c")->data.size() == 1500;
+        if (! ok)
+        {
+            printf("  the cache didn't keep the most recently used responses\n");
+        }
+        return ok;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const int loads = atoi(getArg(argc, argv, "--loads", "50").c_str());
+    const double latency = atof(getArg(argc, argv, "--latency", "0").c_str());
+
+    std::vector<SiteFile> site = makeSite();
+    size_t site_bytes = 0;
+    for (const SiteFile& file : site)
+    {
+        site_bytes += file.data.size();
+    }
+    printf("resource_bench: %d loads per run of %zu files (%.1f MB), %.1f ms server latency\n",
+           loads, site.size(), site_bytes / 1.0e6, latency);
+
+    const std::string directory = "resource_bench_site_" + std::to_string(getpid());
+    const std::string pack_file = directory + ".pack";
+    AssetPackWriter writer;
+    mkdir(directory.c_str(), 0755);
+    bool made = writeSite(directory, site) && writer.addDirectory(directory) && writer.write(pack_file);
+    removeSite(directory, site);
+    if (! made || writer.size() != site.size())
+    {
+        printf("  unable to make the asset pack\n");
+        unlink(pack_file.c_str());
+        return 1;
+    }
+
+    HttpStandIn server(site, latency);
+    if (! server.start())
+    {
+        printf("  unable to start the HTTP server\n");
+        unlink(pack_file.c_str());
+        return 1;
+    }
+
+    bool ok = true;
+    const char* names[] = { "network", "cache cold", "cache warm", "pack cold", "pack warm" };
+    LocalResources warm_cache(64 * 1024 * 1024, 8 * 1024 * 1024);
+    warm_cache.setCacheOrigin(server.origin());
+    LocalResources warm_pack(0, 0);
+    ok = warm_pack.openPack(pack_file, server.origin()) && ok;
+
+    for (int mode = 0; mode < 5; ++mode)
+    {
+        Run run;
+        run.bytes = 0;
+        run.ok = true;
+        for (int i = 0; i < loads; ++i)
+        {
+            std::unique_ptr<LocalResources> fresh;
+            LocalResources* resources = nullptr;
+            if (mode == 1 || mode == 3)
+            {
+                fresh.reset(new LocalResources(64 * 1024 * 1024, 8 * 1024 * 1024));
+                fresh->setCacheOrigin(server.origin());
+                resources = fresh.get();
+            }
+            else if (mode == 2)
+            {
+                resources = &warm_cache;
+            }
+            else if (mode == 4)
+            {
+                resources = &warm_pack;
+            }
+
+            // a warm cache is one that's been loaded once already
+            if (mode == 2 && i == 0)
+            {
+                size_t bytes = 0;
+                run.ok = loadPage(site, server, resources, bytes) && run.ok;
+            }
+
+            double start = nowMicroseconds();
+            if (mode == 3)
+            {
+                run.ok = resources->openPack(pack_file, server.origin()) && run.ok;
+            }
+            run.ok = loadPage(site, server, resources, run.bytes) && run.ok;
+            run.loads.add(nowMicroseconds() - start);
+        }
+        report(names[mode], run);
+        ok = ok && run.ok;
+    }
+
+    // nothing in the warm runs should have gone to the server
+    LocalResourceStats cache_stats = warm_cache.stats();
+    LocalResourceStats pack_stats = warm_pack.stats();
+    bool all_local = cache_stats.cache.misses == site.size() && pack_stats.packHits == site.size() * loads && pack_stats.cache.misses == 0;
+    printf("  cache warm: %zu hits, %zu fetched; pack warm: %zu from the pack, %zu fetched\n",
+           cache_stats.cache.hits, cache_stats.cache.misses, pack_stats.packHits, pack_stats.cache.misses);
+    if (! all_local)
+    {
+        printf("  warm loads went to the network\n");
+    }
+
+    ok = checkRanges(site, server, warm_pack, warm_cache) && ok;
+    ok = checkCacheability(server, warm_cache) && ok;
+    ok = checkEviction() && ok && all_local;
+    printf("  check: %s\n", ok ? "every body, range, cache rule and eviction is right" : "FAILED");
+
+    server.stop();
+    unlink(pack_file.c_str());
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,546 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// what making thumbnails (src/thumbnail_service.h) costs, and what painting at
+// a lower render scale (src/render_scale.h) saves:
+//
+//   levels      the time to halve an 800 x 1200 and a 1080p page three times
+//               on the worker, and to encode the smallest level as PNG and QOI
+//               (and how big that comes out)
+//   paint path  damage() and tick() for a browser painting flat out while the
+//               worker is kept busy encoding whole pages - neither waits for
+//               it, tick() takes no longer than copying the page and the
+//               browsers that are due while it's busy are deferred
+//   render scale  the size CEF paints an 800 x 1200 browser at, and the bytes
+//               in a full paint, for scales 1, 0.5 and 0.25 on normal and high
+//               DPI screens
+//
+// Every level is checked against the scalar box filter, the PNG is taken apart
+// (chunk CRCs, stored deflate blocks, Adler-32) and the QOI decoded to check
+// they hold exactly the unpremultiplied page, and a browser that's removed
+// while its thumbnail is being made doesn't get it - exits with 1 if anything
+// is wrong
+//
+//     thumbnail_bench [--frames <count>]
+
+#include "image_encoder.h"
+#include "pixel_kernels.h"
+#include "render_scale.h"
+#include "thumbnail_service.h"
+
+#include "bench_util.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+    // gaps between the times passed to tick() - longer than ThumbnailSettings' interval so every tick is due
+    const double kInterval = 1000.0;
+
+    // a page with runs of flat colour, a gradient and some noise - premultiplied like CEF's
+    std::vector<unsigned char> makePage(int width, int height, unsigned int seed)
+    {
+        std::vector<unsigned char> page((size_t)width * height * kDepth);
+        std::vector<unsigned char> noise(page.size());
+        fillPattern(noise, seed);
+
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                size_t offset = ((size_t)y * width + x) * kDepth;
+                unsigned char* pixel = &page[offset];
+                if (y < height / 3)
+                {
+                    pixel[0] = 240;
+                    pixel[1] = 240;
+                    pixel[2] = (x / 64) % 2 ? 240 : 200;
+                    pixel[3] = 255;
+                }
+                else if (y < height * 2 / 3)
+                {
+                    pixel[0] = (unsigned char)(x * 255 / width);
+                    pixel[1] = (unsigned char)(y * 255 / height);
+                    pixel[2] = (unsigned char)seed;
+                    pixel[3] = 255;
+                }
+                else
+                {
+                    unsigned char alpha = noise[offset + 3];
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        pixel[c] = (unsigned char)(noise[offset + c] * alpha / 255);
+                    }
+                    pixel[3] = alpha;
+                }
+            }
+        }
+        return page;
+    }
+
+    // waits for the worker to publish thumbnail sequence (or later) for id
+    std::shared_ptr<const Thumbnail> waitFor(const ThumbnailService& service, int id, uint64_t sequence)
+    {
+        while (true)
+        {
+            std::shared_ptr<const Thumbnail> thumbnail = service.latest(id);
+            if (thumbnail && thumbnail->sequence >= sequence)
+            {
+                return thumbnail;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    // waits for the worker to have made count thumbnails
+    void waitForCount(const ThumbnailService& service, size_t count)
+    {
+        while (service.stats().thumbnails < count)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    bool checkLevels(const Thumbnail& thumbnail, const std::vector<unsigned char>& page)
+    {
+        std::vector<unsigned char> src = page;
+        int width = thumbnail.width;
+        int height = thumbnail.height;
+        for (const ThumbnailLevel& level : thumbnail.levels)
+        {
+            std::vector<unsigned char> half((size_t)((width + 1) / 2) * ((height + 1) / 2) * kDepth);
+            for (int y = 0; y < (height + 1) / 2; ++y)
+            {
+                const unsigned char* row0 = &src[(size_t)y * 2 * width * kDepth];
+                const unsigned char* row1 = (y * 2 + 1 < height) ? row0 + (size_t)width * kDepth : row0;
+                downsampleRowScalar(&half[(size_t)y * ((width + 1) / 2) * kDepth], row0, row1, width);
+            }
+            width = (width + 1) / 2;
+            height = (height + 1) / 2;
+            if (level.width != width || level.height != height || level.pixels != half)
+            {
+                printf("  %d x %d level of a %d x %d page isn't the scalar box filter's\n", width, height, thumbnail.width, thumbnail.height);
+                return false;
+            }
+            src.swap(half);
+        }
+        return true;
+    }
+
+    // what both formats should hold - unpremultiplied RGBA
+    std::vector<unsigned char> referenceRGBA(const ThumbnailLevel& level)
+    {
+        std::vector<unsigned char> rgba(level.pixels.size());
+        for (int y = 0; y < level.height; ++y)
+        {
+            size_t offset = (size_t)y * level.width * kDepth;
+            unpremultiplyRowScalar(&rgba[offset], &level.pixels[offset], level.width);
+            swizzleRowScalar(&rgba[offset], &rgba[offset], level.width);
+        }
+        return rgba;
+    }
+
+    unsigned int readBigEndian(const unsigned char* data)
+    {
+        return (unsigned int)data[0] << 24 | (unsigned int)data[1] << 16 | (unsigned int)data[2] << 8 | data[3];
+    }
+
+    unsigned int referenceCrc32(const unsigned char* data, size_t size)
+    {
+        unsigned int crc = 0xffffffffu;
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc ^= data[i];
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                crc = (crc & 1) ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+            }
+        }
+        return ~crc;
+    }
+
+    bool checkPNG(const std::vector<unsigned char>& png, const ThumbnailLevel& level)
+    {
+        static const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        if (png.size() < sizeof(signature) || memcmp(png.data(), signature, sizeof(signature)) != 0)
+        {
+            printf("  PNG has no signature\n");
+            return false;
+        }
+
+        std::vector<unsigned char> zlib;
+        bool ended = false;
+        size_t offset = sizeof(signature);
+        while (offset + 12 <= png.size() && ! ended)
+        {
+            unsigned int length = readBigEndian(&png[offset]);
+            if (offset + 12 + length > png.size())
+            {
+                break;
+            }
+
+            const unsigned char* type = &png[offset + 4];
+            const unsigned char* data = type + 4;
+            if (readBigEndian(data + length) != referenceCrc32(type, length + 4))
+            {
+                printf("  PNG %.4s chunk has the wrong CRC\n", (const char*)type);
+                return false;
+            }
+
+            if (memcmp(type, "IHDR", 4) == 0 && (length != 13 || (int)readBigEndian(data) != level.width || (int)readBigEndian(data + 4) != level.height || data[8] != 8 || data[9] != 6))
+            {
+                printf("  PNG header isn't %d x %d 8 bit RGBA\n", level.width, level.height);
+                return false;
+            }
+            if (memcmp(type, "IDAT", 4) == 0)
+            {
+                zlib.insert(zlib.end(), data, data + length);
+            }
+            ended = (memcmp(type, "IEND", 4) == 0);
+            offset += 12 + length;
+        }
+
+        if (! ended || zlib.size() < 6 || ((zlib[0] << 8) | zlib[1]) % 31 != 0)
+        {
+            printf("  PNG is cut short or its zlib header is wrong\n");
+            return false;
+        }
+
+        // stored blocks only
+        std::vector<unsigned char> raw;
+        size_t position = 2;
+        bool last = false;
+        while (! last && position + 5 <= zlib.size())
+        {
+            last = (zlib[position] & 1) != 0;
+            unsigned int length = zlib[position + 1] | zlib[position + 2] << 8;
+            unsigned int inverse = zlib[position + 3] | zlib[position + 4] << 8;
+            if ((zlib[position] & 6) != 0 || (length ^ 0xffff) != inverse || position + 5 + length > zlib.size())
+            {
+                printf("  PNG deflate block at %zu is broken\n", position);
+                return false;
+            }
+            raw.insert(raw.end(), zlib.begin() + position + 5, zlib.begin() + position + 5 + length);
+            position += 5 + length;
+        }
+
+        unsigned int a = 1;
+        unsigned int b = 0;
+        for (unsigned char byte : raw)
+        {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        if (! last || position + 4 != zlib.size() || readBigEndian(&zlib[position]) != ((b << 16) | a))
+        {
+            printf("  PNG zlib stream doesn't end with the right Adler-32\n");
+            return false;
+        }
+
+        std::vector<unsigned char> rgba = referenceRGBA(level);
+        const size_t row_bytes = (size_t)level.width * kDepth;
+        if (raw.size() != (row_bytes + 1) * level.height)
+        {
+            printf("  PNG holds %zu bytes rather than %zu\n", raw.size(), (row_bytes + 1) * level.height);
+            return false;
+        }
+        for (int y = 0; y < level.height; ++y)
+        {
+            if (raw[y * (row_bytes + 1)] != 0 || memcmp(&raw[y * (row_bytes + 1) + 1], &rgba[y * row_bytes], row_bytes) != 0)
+            {
+                printf("  PNG row %d isn't the unpremultiplied level\n", y);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // the decoder from the QOI spec
+    bool decodeQOI(const std::vector<unsigned char>& qoi, int& width, int& height, std::vector<unsigned char>& rgba)
+    {
+        if (qoi.size() < 22 || memcmp(qoi.data(), "qoif", 4) != 0)
+        {
+            return false;
+        }
+        width = (int)readBigEndian(&qoi[4]);
+        height = (int)readBigEndian(&qoi[8]);
+        rgba.assign((size_t)width * height * kDepth, 0);
+
+        unsigned char index[64][4] = {};
+        unsigned char pixel[4] = { 0, 0, 0, 255 };
+        size_t position = 14;
+        const size_t end = qoi.size() - 8;
+        int run = 0;
+        for (size_t offset = 0; offset < rgba.size(); offset += kDepth)
+        {
+            if (run > 0)
+            {
+                --run;
+            }
+            else if (position < end)
+            {
+                unsigned char op = qoi[position++];
+                if (op == 0xfe)
+                {
+                    memcpy(pixel, &qoi[position], 3);
+                    position += 3;
+                }
+                else if (op == 0xff)
+                {
+                    memcpy(pixel, &qoi[position], 4);
+                    position += 4;
+                }
+                else if ((op & 0xc0) == 0x00)
+                {
+                    memcpy(pixel, index[op], 4);
+                }
+                else if ((op & 0xc0) == 0x40)
+                {
+                    pixel[0] += ((op >> 4) & 3) - 2;
+                    pixel[1] += ((op >> 2) & 3) - 2;
+                    pixel[2] += (op & 3) - 2;
+                }
+                else if ((op & 0xc0) == 0x80)
+                {
+                    unsigned char next = qoi[position++];
+                    int dg = (op & 0x3f) - 32;
+                    pixel[0] += dg - 8 + ((next >> 4) & 0x0f);
+                    pixel[1] += dg;
+                    pixel[2] += dg - 8 + (next & 0x0f);
+                }
+                else
+                {
+                    run = op & 0x3f;
+                }
+                memcpy(index[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64], pixel, 4);
+            }
+            memcpy(&rgba[offset], pixel, 4);
+        }
+
+        static const unsigned char padding[] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+        return position == end && memcmp(&qoi[end], padding, sizeof(padding)) == 0;
+    }
+
+    bool checkQOI(const std::vector<unsigned char>& qoi, const ThumbnailLevel& level)
+    {
+        int width = 0;
+        int height = 0;
+        std::vector<unsigned char> rgba;
+        if (! decodeQOI(qoi, width, height, rgba) || width != level.width || height != level.height)
+        {
+            printf("  QOI doesn't decode to a %d x %d image\n", level.width, level.height);
+            return false;
+        }
+        if (rgba != referenceRGBA(level))
+        {
+            printf("  QOI doesn't decode to the unpremultiplied level\n");
+            return false;
+        }
+        return true;
+    }
+
+    // makes frames thumbnails of a page one after the other and reports what they cost
+    bool runLevels(int width, int height, ImageFormat format, int frames)
+    {
+        ThumbnailSettings settings;
+        settings.format = format;
+        ThumbnailService service(settings);
+
+        std::vector<unsigned char> page = makePage(width, height, 7);
+        RectList dirty_rects(1, Rect(0, 0, width, height));
+
+        bool ok = true;
+        std::shared_ptr<const Thumbnail> thumbnail;
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            // a little of the page changes every time
+            page[((size_t)(frame * 7919) % ((size_t)width * height)) * kDepth] ^= 0x10;
+            service.damage(1, page.data(), width, height, dirty_rects);
+            service.tick((frame + 1) * kInterval);
+            thumbnail = waitFor(service, 1, frame);
+
+            if (frame == 0 || frame == frames - 1)
+            {
+                ok = checkLevels(*thumbnail, page) && ok;
+                if (format == IMAGE_PNG)
+                {
+                    ok = checkPNG(thumbnail->encoded, thumbnail->levels.back()) && ok;
+                }
+                else if (format == IMAGE_QOI)
+                {
+                    ok = checkQOI(thumbnail->encoded, thumbnail->levels.back()) && ok;
+                }
+            }
+        }
+
+        ThumbnailStats stats = service.stats();
+        const ThumbnailLevel& smallest = thumbnail->levels.back();
+        printf("  %4d x %-4d %-4s levels %6.2f ms (%6.0f Mpixels/s) | encode %d x %d %6.3f ms | %7zu bytes\n",
+               width, height, imageFormatName(format), stats.downsampleSeconds * 1000.0 / stats.thumbnails, stats.pixelsDownsampled / stats.downsampleSeconds / 1.0e6,
+               smallest.width, smallest.height, stats.encodeSeconds * 1000.0 / stats.thumbnails, thumbnail->encoded.size());
+        return ok;
+    }
+
+    // a browser painting as fast as it can while the worker is slow - whole pages encoded as PNG
+    void runPaintPath(int frames)
+    {
+        const int width = 800;
+        const int height = 1200;
+
+        ThumbnailSettings settings;
+        settings.format = IMAGE_PNG;
+        settings.encodeLevel = 0;
+        settings.interval = 0.0;
+        ThumbnailService service(settings);
+
+        std::vector<unsigned char> page = makePage(width, height, 3);
+        RectList dirty_rects(1, Rect(100, 100, 400, 300));
+
+        Samples damage_times;
+        Samples tick_times;
+        double start = nowMicroseconds();
+        for (int frame = 0; frame < frames; ++frame)
+        {
+            double before = nowMicroseconds();
+            service.damage(1, page.data(), width, height, dirty_rects);
+            double damaged = nowMicroseconds();
+            service.tick((nowMicroseconds() - start) / 1000.0);
+            double ticked = nowMicroseconds();
+
+            damage_times.add(damaged - before);
+            tick_times.add(ticked - damaged);
+        }
+
+        // the first snapshot went to the worker on the first tick()
+        waitForCount(service, 1);
+        ThumbnailStats stats = service.stats();
+        printf("  %d x %d painting flat out: %zu thumbnails, %zu deferred while the worker was busy (%.1f ms each) | damage p50 %6.1f us max %6.1f us | tick p50 %6.1f us max %6.1f us\n",
+               width, height, stats.thumbnails, stats.deferred, stats.thumbnails > 0 ? (stats.downsampleSeconds + stats.encodeSeconds) * 1000.0 / stats.thumbnails : 0.0,
+               damage_times.percentile(50), damage_times.percentile(100), tick_times.percentile(50), tick_times.percentile(100));
+    }
+
+    // a thumbnail that's being made when its browser is removed mustn't turn up afterwards
+    bool checkRemove()
+    {
+        ThumbnailSettings settings;
+        settings.format = IMAGE_PNG;
+        settings.encodeLevel = 0;
+        ThumbnailService service(settings);
+
+        std::vector<unsigned char> page = makePage(1920, 1080, 5);
+        RectList dirty_rects(1, Rect(0, 0, 1920, 1080));
+        service.damage(1, page.data(), 1920, 1080, dirty_rects);
+        service.tick(kInterval);
+        service.remove(1);
+        waitForCount(service, 1);
+
+        if (service.latest(1))
+        {
+            printf("  a removed browser got the thumbnail that was being made\n");
+            return false;
+        }
+
+        // and the same id can be used again
+        service.damage(1, page.data(), 1920, 1080, dirty_rects);
+        service.tick(kInterval * 2);
+        waitForCount(service, 2);
+        if (! service.latest(1))
+        {
+            printf("  a browser reusing a removed id didn't get a thumbnail\n");
+            return false;
+        }
+        return true;
+    }
+
+    bool runRenderScale()
+    {
+        const int shown_width = 800;
+        const int shown_height = 1200;
+        const float scales[] = { 1.0f, 0.5f, 0.25f };
+        const float device_scale_factors[] = { 1.0f, 2.0f };
+
+        bool ok = true;
+        for (float device_scale_factor : device_scale_factors)
+        {
+            for (int keep_layout = 0; keep_layout < 2; ++keep_layout)
+            {
+                for (float scale : scales)
+                {
+                    RenderScale render_scale(scale, device_scale_factor, keep_layout != 0);
+                    Rect view = render_scale.viewRect(shown_width, shown_height);
+                    int width = 0;
+                    int height = 0;
+                    render_scale.paintSize(shown_width, shown_height, width, height);
+
+                    printf("  scale %4.2f dsf %.0f %-12s view %4d x %-4d at %4.2f -> paints %4d x %-4d | %8zu bytes per full paint\n",
+                           scale, device_scale_factor, keep_layout ? "keep layout" : "smaller view", view.width, view.height,
+                           render_scale.screenScaleFactor(), width, height, (size_t)width * height * kDepth);
+
+                    // the shown size is in screen pixels so the paint is scale of it whatever the screen's DPI
+                    int expected_width = (int)(shown_width * scale + 0.5f);
+                    int expected_height = (int)(shown_height * scale + 0.5f);
+                    if (width != expected_width || height != expected_height)
+                    {
+                        printf("    expected it to paint %d x %d\n", expected_width, expected_height);
+                        ok = false;
+                    }
+
+                    // the far corner of the browser is the far corner of the view
+                    int view_x = 0;
+                    int view_y = 0;
+                    render_scale.toView(shown_width, shown_height, shown_width - 1, shown_height - 1, view_x, view_y);
+                    if (view_x != view.width - 1 || view_y != view.height - 1)
+                    {
+                        printf("    the bottom right of the browser is %d, %d in the view rather than %d, %d\n", view_x, view_y, view.width - 1, view.height - 1);
+                        ok = false;
+                    }
+
+                    // a popup the whole size of the view covers the whole paint
+                    Rect popup = render_scale.toPaint(view);
+                    if (popup.x != 0 || popup.y != 0 || popup.width != width || popup.height != height)
+                    {
+                        printf("    a popup over the whole view paints %d x %d rather than %d x %d\n", popup.width, popup.height, width, height);
+                        ok = false;
+                    }
+                }
+            }
+        }
+        return ok;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const int frames = atoi(getArg(argc, argv, "--frames", "30").c_str());
+
+    printf("thumbnail_bench: %s kernels\n", pixelKernels().name);
+
+    bool ok = true;
+    const ImageFormat formats[] = { IMAGE_NONE, IMAGE_PNG, IMAGE_QOI };
+    for (ImageFormat format : formats)
+    {
+        ok = runLevels(800, 1200, format, frames) && ok;
+        ok = runLevels(1920, 1080, format, frames) && ok;
+    }
+
+    // odd sizes all the way down, and a page smaller than the levels asked for
+    ok = runLevels(333, 77, IMAGE_QOI, 2) && ok;
+    ok = runLevels(3, 1, IMAGE_PNG, 2) && ok;
+
+    runPaintPath(frames * 4);
+    ok = checkRemove() && ok;
+    ok = runRenderScale() && ok;
+
+    printf("  check: %s\n", ok ? "every level, PNG and QOI matched and removed browsers kept no thumbnails" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,282 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// what hashing the page in tiles (src/tile_hasher.h) saves, and costs, on a
+// 1080p page painted through the compositor into memory:
+//
+//   paused animation  CEF keeps repainting a 640 x 360 animation that's paused
+//   cursor repaint    the whole page is dirty but nothing in it changed
+//   caret             a 2 x 20 caret blinks every 30 paints
+//   sprite            a 640 x 360 area is dirty and a 96 x 96 sprite in it moves
+//   single pixel      the whole page is dirty and one pixel somewhere changed
+//   video             every pixel changes every paint - hashing is all cost
+//
+// each without hashing and with 32, 64 and 128 pixel tiles. Reports the paints
+// that were skipped, the time to paint, the hashing part of it and the bytes
+// copied and uploaded per paint. Every paint checks that what was uploaded is
+// exactly CEF's page, popup layer or not, and a popup composited into the page
+// goes away when it closes or moves - exits with 1 if anything is wrong
+//
+//     tile_dedup_bench [--frames <count>]
+
+#include "compositor.h"
+#include "tile_hasher.h"
+
+#include "bench_util.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    const int kPageWidth = 1920;
+    const int kPageHeight = 1080;
+
+    enum Scenario
+    {
+        PAUSED_ANIMATION,
+        CURSOR_REPAINT,
+        CARET,
+        SPRITE,
+        SINGLE_PIXEL,
+        VIDEO,
+        SCENARIO_COUNT
+    };
+
+    const char* const kScenarioNames[] =
+    {
+        "paused animation",
+        "cursor repaint",
+        "caret",
+        "sprite",
+        "single pixel",
+        "video"
+    };
+
+    struct Result
+    {
+        double paint;
+        double hash;
+        double skipped;
+        size_t bytes;
+        bool exact;
+    };
+
+    // new pixels for a rect of the page that are different from the ones there on every frame
+    void repaint(std::vector<unsigned char>& page, const Rect& rect, int frame)
+    {
+        for (int y = rect.y; y < rect.y + rect.height; ++y)
+        {
+            unsigned char* pixel = &page[((size_t)y * kPageWidth + rect.x) * kDepth];
+            for (int x = rect.x; x < rect.x + rect.width; ++x, pixel += kDepth)
+            {
+                pixel[0] = (unsigned char)(x * 7 + frame * 29);
+                pixel[1] = (unsigned char)(y * 13 + frame * 29);
+                pixel[2] = (unsigned char)(x + y + frame * 29);
+                pixel[3] = 255;
+            }
+        }
+    }
+
+    // what CEF would hand OnPaint for this frame - the pixels in the page are changed to match
+    Rect nextFrame(Scenario scenario, int frame, std::vector<unsigned char>& page, const std::vector<unsigned char>& background)
+    {
+        const Rect animation(640, 360, 640, 360);
+        switch (scenario)
+        {
+            case PAUSED_ANIMATION:
+                return animation;
+
+            case CURSOR_REPAINT:
+                return Rect(0, 0, kPageWidth, kPageHeight);
+
+            case CARET:
+            {
+                Rect caret(300, 200, 2, 20);
+                if (frame % 30 == 0)
+                {
+                    repaint(page, caret, frame);
+                }
+                return caret;
+            }
+
+            case SPRITE:
+            {
+                // put back what was under it and draw it somewhere else
+                for (int y = animation.y; y < animation.y + animation.height; ++y)
+                {
+                    size_t offset = ((size_t)y * kPageWidth + animation.x) * kDepth;
+                    memcpy(&page[offset], &background[offset], (size_t)animation.width * kDepth);
+                }
+                repaint(page, Rect(animation.x + (frame * 8) % (animation.width - 96), animation.y + 100, 96, 96), frame);
+                return animation;
+            }
+
+            case SINGLE_PIXEL:
+            {
+                int x = (frame * 7919) % kPageWidth;
+                int y = (frame * 104729) % kPageHeight;
+                page[((size_t)y * kPageWidth + x) * kDepth + frame % kDepth] ^= 1;
+                return Rect(0, 0, kPageWidth, kPageHeight);
+            }
+
+            case VIDEO:
+            default:
+                repaint(page, Rect(0, 0, kPageWidth, kPageHeight), frame);
+                return Rect(0, 0, kPageWidth, kPageHeight);
+        }
+    }
+
+    bool sameAsPage(const SoftwareUploadBackend& backend, const std::vector<unsigned char>& page)
+    {
+        for (int y = 0; y < kPageHeight; ++y)
+        {
+            if (memcmp(backend.pixels() + (size_t)y * backend.capacityWidth() * kDepth, &page[(size_t)y * kPageWidth * kDepth], (size_t)kPageWidth * kDepth) != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Result run(Scenario scenario, int tile_size, bool layered, int frames)
+    {
+        std::vector<unsigned char> background((size_t)kPageWidth * kPageHeight * kDepth);
+        fillPattern(background, 1);
+        std::vector<unsigned char> page = background;
+
+        SoftwareUploadBackend backend;
+        SoftwareUploadBackend popup_backend;
+        Compositor compositor(&backend);
+        compositor.setTileHashing(tile_size);
+        if (layered)
+        {
+            compositor.setPopupLayer(&popup_backend);
+        }
+
+        // the first paint is the whole page and isn't counted
+        RectList dirty_rects(1, Rect(0, 0, kPageWidth, kPageHeight));
+        compositor.upload(compositor.paintView(dirty_rects, page.data(), kPageWidth, kPageHeight));
+        compositor.endFrame();
+
+        const TileHasherStats first_tiles = compositor.tileStats();
+        const CompositorStats first = compositor.stats();
+
+        Result result = Result();
+        result.exact = true;
+        Samples paint_times;
+        for (int frame = 1; frame <= frames; ++frame)
+        {
+            dirty_rects[0] = nextFrame(scenario, frame, page, background);
+
+            double start = nowMicroseconds();
+            compositor.upload(compositor.paintView(dirty_rects, page.data(), kPageWidth, kPageHeight));
+            compositor.endFrame();
+            paint_times.add(nowMicroseconds() - start);
+
+            if (result.exact && ! sameAsPage(backend, page))
+            {
+                printf("  %s with %d pixel tiles%s: frame %d wasn't uploaded properly\n", kScenarioNames[scenario], tile_size, layered ? " (layered)" : "", frame);
+                result.exact = false;
+            }
+        }
+
+        const TileHasherStats& tiles = compositor.tileStats();
+        const CompositorStats& stats = compositor.stats();
+        result.paint = paint_times.mean();
+        result.hash = (tiles.hashNanoseconds - first_tiles.hashNanoseconds) / 1000.0 / frames;
+        result.skipped = 100.0 * (tiles.skippedFrames - first_tiles.skippedFrames) / frames;
+        result.bytes = (stats.totalBytesCopied + stats.totalBytesUploaded - first.totalBytesCopied - first.totalBytesUploaded) / frames;
+        return result;
+    }
+
+    // a popup composited into the page has to come off it when it closes or moves, even though CEF's
+    // page pixels under it are the same as they ever were
+    bool checkPopup(int tile_size)
+    {
+        std::vector<unsigned char> page((size_t)kPageWidth * kPageHeight * kDepth);
+        fillPattern(page, 2);
+        std::vector<unsigned char> popup((size_t)200 * 300 * kDepth, 0xff);
+
+        SoftwareUploadBackend backend;
+        Compositor compositor(&backend);
+        compositor.setTileHashing(tile_size);
+
+        RectList dirty_rects(1, Rect(0, 0, kPageWidth, kPageHeight));
+        compositor.upload(compositor.paintView(dirty_rects, page.data(), kPageWidth, kPageHeight));
+        compositor.endFrame();
+
+        // opens, moves, and closes - CEF repaints the page where it was each time
+        const Rect places[] = { Rect(100, 100, 200, 300), Rect(150, 250, 200, 300) };
+        Rect previous;
+        compositor.popupShow(true);
+        for (const Rect& place : places)
+        {
+            compositor.popupSize(place);
+            RectList popup_dirty(1, Rect(0, 0, place.width, place.height));
+            compositor.upload(compositor.paintPopup(popup_dirty, popup.data(), place.width, place.height));
+            compositor.endFrame();
+
+            if (! previous.isEmpty())
+            {
+                dirty_rects[0] = previous;
+                compositor.upload(compositor.paintView(dirty_rects, page.data(), kPageWidth, kPageHeight));
+                compositor.endFrame();
+            }
+            previous = place;
+        }
+
+        compositor.popupShow(false);
+        dirty_rects[0] = previous;
+        compositor.upload(compositor.paintView(dirty_rects, page.data(), kPageWidth, kPageHeight));
+        compositor.endFrame();
+
+        if (! sameAsPage(backend, page))
+        {
+            printf("  with %d pixel tiles a closed popup was left on the page\n", tile_size);
+            return false;
+        }
+        return true;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    const int frames = atoi(getArg(argc, argv, "--frames", "120").c_str());
+    const int tile_sizes[] = { 0, 32, kDefaultTileSize, 128 };
+
+    printf("tile_dedup_bench: %d x %d page, %d paints per run\n", kPageWidth, kPageHeight, frames);
+
+    bool ok = true;
+    for (int scenario = 0; scenario < SCENARIO_COUNT; ++scenario)
+    {
+        for (int tile_size : tile_sizes)
+        {
+            Result result = run((Scenario)scenario, tile_size, false, frames);
+            ok = ok && result.exact;
+
+            char tiles[32];
+            snprintf(tiles, sizeof(tiles), tile_size > 0 ? "%d px tiles" : "no hashing", tile_size);
+            printf("  %-16s %-12s %5.1f%% skipped | paint %8.1f us (hashing %8.1f us) | %10zu bytes copied and uploaded per paint\n",
+                   kScenarioNames[scenario], tiles, result.skipped, result.paint, result.hash, result.bytes);
+        }
+
+        // a popup layer uploads straight from CEF's buffer - only checked, not reported
+        ok = run((Scenario)scenario, kDefaultTileSize, true, frames / 4 + 1).exact && ok;
+    }
+
+    for (int tile_size : tile_sizes)
+    {
+        ok = checkPopup(tile_size) && ok;
+    }
+
+    printf("  check: %s\n", ok ? "every paint uploaded exactly CEF's pixels" : "FAILED");
+    return ok ? 0 : 1;
+}
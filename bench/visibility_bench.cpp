@@ -0,0 +1,282 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// what throttling browsers that can't be seen (src/visibility_manager.h) saves
+// in a window showing 4 of 32 browsers - a grid of 4 x 8 browsers of 480 x 270,
+// each with an animation covering a quarter of its page, in a 1000 x 560 window.
+// The 4 in the corner are on screen, 5 more have a sliver showing and the rest
+// are off screen:
+//
+//   unthrottled  every browser paints at 60 frames per second
+//   throttled    the visibility manager's states - 4 visible at 60, 5 in the
+//                background at 5 and 23 hidden and not painting
+//   scrolling    throttled, while the window scrolls down the grid a row a
+//                second - browsers coming back from hidden repaint everything
+//
+// Every run starts with all of them visible and is measured from hiddenDelay
+// on, once the throttled browsers have had time to settle into their states.
+// Paints go through a compositor each and are uploaded to memory, stepping a
+// simulated clock a millisecond at a time as fast as it'll go. Reports paints
+// and paint bandwidth (bytes copied and uploaded) per second of simulated time
+// and the CPU it took as a share of a core. Checks the scene settles into the
+// states above, that a browser hovering about the edge of the window doesn't
+// flip between states and that a browser isn't hidden before hiddenDelay -
+// exits with 1 if anything is wrong
+//
+//     visibility_bench [--seconds <simulated seconds per run>]
+
+#include "compositor.h"
+#include "pump_scheduler.h"
+#include "visibility_manager.h"
+
+#include "bench_util.h"
+
+#include <cstdlib>
+#include <memory>
+
+namespace
+{
+    const int kColumns = 4;
+    const int kRows = 8;
+    const int kPageWidth = 480;
+    const int kPageHeight = 270;
+    const int kWindowWidth = 1000;
+    const int kWindowHeight = 560;
+    const int kUnthrottledFrameRate = 60;
+
+    struct Browser
+    {
+        std::unique_ptr<SoftwareUploadBackend> backend;
+        std::unique_ptr<Compositor> compositor;
+        std::vector<unsigned char> buffer;
+        double nextPaint;
+        bool repaintAll;
+    };
+
+    struct Result
+    {
+        size_t paints;
+        size_t bytes;
+        double cpu;
+        VisibilityStats visibility;
+    };
+
+    Rect gridRect(int index, int scroll)
+    {
+        return Rect((index % kColumns) * kPageWidth, (index / kColumns) * kPageHeight - scroll, kPageWidth, kPageHeight);
+    }
+
+    // scroll_speed is pixels per second down the grid - 0 stays put. Nothing is counted until every
+    // browser has had time to settle into its state
+    Result run(bool throttled, double scroll_speed, double seconds)
+    {
+        VisibilityManager visibility((VisibilitySettings()));
+        const double settle = visibility.settings().hiddenDelay;
+        const int max_scroll = kRows * kPageHeight - kWindowHeight;
+        visibility.setWindow(kWindowWidth, kWindowHeight, false, true);
+
+        std::vector<Browser> browsers(kColumns * kRows);
+        for (size_t i = 0; i < browsers.size(); ++i)
+        {
+            Browser& browser = browsers[i];
+            browser.backend.reset(new SoftwareUploadBackend);
+            browser.compositor.reset(new Compositor(browser.backend.get()));
+            browser.buffer.resize((size_t)kPageWidth * kPageHeight * kDepth);
+            fillPattern(browser.buffer, (unsigned int)i + 1);
+            browser.nextPaint = 0.0;
+            browser.repaintAll = true;
+            visibility.add((int)i, gridRect((int)i, 0));
+        }
+
+        Result result = Result();
+        Result settled = Result();
+        std::vector<VisibilityChange> changes;
+        double cpu_start = processCpuTime();
+        for (double now = 0.0; now < settle + seconds * 1000.0; now += 1.0)
+        {
+            if (now == settle)
+            {
+                settled.paints = result.paints;
+                for (const Browser& browser : browsers)
+                {
+                    settled.bytes += browser.compositor->stats().totalBytesCopied + browser.compositor->stats().totalBytesUploaded;
+                }
+                cpu_start = processCpuTime();
+            }
+
+            if (scroll_speed > 0.0 && now > settle)
+            {
+                int scroll = (int)((now - settle) / 1000.0 * scroll_speed);
+                scroll = (scroll < max_scroll) ? scroll : max_scroll;
+                for (size_t i = 0; i < browsers.size(); ++i)
+                {
+                    visibility.move((int)i, gridRect((int)i, scroll));
+                }
+            }
+
+            changes.clear();
+            visibility.update(now, changes);
+            for (const VisibilityChange& change : changes)
+            {
+                // CEF is asked for the whole page again when it's shown
+                if (change.from == VISIBILITY_HIDDEN)
+                {
+                    browsers[change.id].repaintAll = true;
+                    browsers[change.id].nextPaint = now;
+                }
+            }
+
+            for (size_t i = 0; i < browsers.size(); ++i)
+            {
+                Browser& browser = browsers[i];
+                int frame_rate = throttled ? visibility.frameRate(visibility.state((int)i)) : kUnthrottledFrameRate;
+                if (frame_rate == 0 || now < browser.nextPaint)
+                {
+                    continue;
+                }
+
+                // the animation in the middle of the page moves on a frame
+                Rect dirty = browser.repaintAll ? Rect(0, 0, kPageWidth, kPageHeight) : Rect(kPageWidth / 4, kPageHeight / 4, kPageWidth / 2, kPageHeight / 2);
+                browser.buffer[((size_t)dirty.y * kPageWidth + dirty.x) * kDepth] = (unsigned char)result.paints;
+                RectList dirty_rects;
+                dirty_rects.push_back(dirty);
+
+                RectList damage = browser.compositor->paintView(dirty_rects, browser.buffer.data(), kPageWidth, kPageHeight);
+                browser.compositor->upload(damage);
+                browser.compositor->endFrame();
+
+                browser.repaintAll = false;
+                browser.nextPaint += 1000.0 / frame_rate;
+                if (browser.nextPaint < now)
+                {
+                    browser.nextPaint = now + 1000.0 / frame_rate;
+                }
+                ++result.paints;
+            }
+        }
+        result.cpu = processCpuTime() - cpu_start;
+
+        for (const Browser& browser : browsers)
+        {
+            result.bytes += browser.compositor->stats().totalBytesCopied + browser.compositor->stats().totalBytesUploaded;
+        }
+        result.paints -= settled.paints;
+        result.bytes -= settled.bytes;
+        result.visibility = visibility.stats();
+        return result;
+    }
+
+    void report(const char* name, const Result& result, double seconds)
+    {
+        printf("  %-12s %7.0f paints/s %8.1f MB/s painted %6.1f%% of a core   %2zu visible %2zu background %2zu hidden %4zu changes\n",
+               name, result.paints / seconds, result.bytes / seconds / (1024.0 * 1024.0), result.cpu / (seconds * 1000.0) * 100.0,
+               result.visibility.visible, result.visibility.background, result.visibility.hidden, result.visibility.changes);
+    }
+
+    // a browser whose share of the screen wobbles about the edges of the visible band shouldn't change state,
+    // and one that goes off screen shouldn't be hidden until it's been gone hiddenDelay
+    bool checkHysteresis()
+    {
+        VisibilitySettings settings;
+        VisibilityManager visibility(settings);
+        visibility.setWindow(kWindowWidth, kWindowHeight, false, true);
+
+        // 0.25 and 0.35 of it on screen - inside the band so it stays visible
+        std::vector<VisibilityChange> changes;
+        visibility.add(1, Rect(kWindowWidth - 120, 0, 480, 100));
+        for (int i = 0; i < 100; ++i)
+        {
+            int showing = (i % 2 == 0) ? 120 : 168;
+            visibility.move(1, Rect(kWindowWidth - showing, 0, 480, 100));
+            visibility.update(i * 100.0, changes);
+        }
+        if (! changes.empty())
+        {
+            printf("  a browser inside the visible band changed state %zu times\n", changes.size());
+            return false;
+        }
+
+        // 0.1 and 0.4 on screen every 100ms - it never wants to be in the background for long enough
+        for (int i = 0; i < 100; ++i)
+        {
+            int showing = (i % 2 == 0) ? 48 : 192;
+            visibility.move(1, Rect(kWindowWidth - showing, 0, 480, 100));
+            visibility.update(10000.0 + i * 100.0, changes);
+        }
+        if (! changes.empty())
+        {
+            printf("  a browser flickering across the band changed state %zu times\n", changes.size());
+            return false;
+        }
+
+        // off screen - hidden at hiddenDelay, not before
+        visibility.move(1, Rect(kWindowWidth + 10, 0, 480, 100));
+        visibility.update(20000.0, changes);
+        visibility.update(20000.0 + settings.hiddenDelay - 1.0, changes);
+        if (! changes.empty())
+        {
+            printf("  a browser was hidden before hiddenDelay\n");
+            return false;
+        }
+        visibility.update(20000.0 + settings.hiddenDelay, changes);
+        if (changes.size() != 1 || changes[0].to != VISIBILITY_HIDDEN)
+        {
+            printf("  a browser off screen wasn't hidden after hiddenDelay\n");
+            return false;
+        }
+
+        // and back on screen straight away
+        changes.clear();
+        visibility.move(1, Rect(0, 0, 480, 100));
+        visibility.update(20000.0 + settings.hiddenDelay + 1.0, changes);
+        if (changes.size() != 1 || changes[0].to != VISIBILITY_VISIBLE)
+        {
+            printf("  a browser back on screen wasn't visible straight away\n");
+            return false;
+        }
+        return true;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    double seconds = atof(getArg(argc, argv, "--seconds", "5").c_str());
+
+    printf("visibility_bench: %d browsers of %d x %d in a %d x %d window, %.1f simulated seconds per run\n",
+           kColumns * kRows, kPageWidth, kPageHeight, kWindowWidth, kWindowHeight, seconds);
+
+    bool ok = true;
+
+    Result unthrottled = run(false, 0.0, seconds);
+    report("unthrottled", unthrottled, seconds);
+
+    Result throttled = run(true, 0.0, seconds);
+    report("throttled", throttled, seconds);
+    if (throttled.visibility.visible != 4 || throttled.visibility.background != 5 || throttled.visibility.hidden != 23)
+    {
+        printf("  expected 4 visible, 5 in the background and 23 hidden\n");
+        ok = false;
+    }
+
+    Result scrolling = run(true, kPageHeight, seconds);
+    report("scrolling", scrolling, seconds);
+
+    printf("  throttled paints %.1f%% of the bytes and uses %.1f%% of the CPU of unthrottled\n",
+           unthrottled.bytes > 0 ? 100.0 * throttled.bytes / unthrottled.bytes : 0.0,
+           unthrottled.cpu > 0.0 ? 100.0 * throttled.cpu / unthrottled.cpu : 0.0);
+
+    if (! checkHysteresis())
+    {
+        ok = false;
+    }
+
+    printf("  check: %s\n", ok ? "the scene settles, and states don't flip back and forth" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,481 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "asset_pack.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+// keep windows.h from defining min and max macros that break std::min/std::max
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    uint64_t alignUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    std::string lowerCase(std::string text)
+    {
+        for (char& c : text)
+        {
+            c = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+        }
+        return text;
+    }
+
+    bool readFile(const std::string& file_name, std::vector<unsigned char>& data)
+    {
+        FILE* file = fopen(file_name.c_str(), "rb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        data.clear();
+        unsigned char chunk[64 * 1024];
+        size_t read;
+        while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        {
+            data.insert(data.end(), chunk, chunk + read);
+        }
+        bool ok = ferror(file) == 0;
+        fclose(file);
+        return ok;
+    }
+
+    // every file under directory, with its path relative to the directory (and '/' between names)
+    bool listFiles(const std::string& directory, const std::string& prefix, std::vector<std::string>& paths)
+    {
+#ifdef _WIN32
+        WIN32_FIND_DATAA find_data;
+        HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &find_data);
+        if (find == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        bool ok = true;
+        do
+        {
+            std::string name = find_data.cFileName;
+            if (name == "." || name == "..")
+            {
+                continue;
+            }
+
+            if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                ok = listFiles(directory + "\\" + name, prefix + name + "/", paths) && ok;
+            }
+            else
+            {
+                paths.push_back(prefix + name);
+            }
+        }
+        while (FindNextFileA(find, &find_data));
+        FindClose(find);
+        return ok;
+#else
+        DIR* dir = opendir(directory.c_str());
+        if (dir == nullptr)
+        {
+            return false;
+        }
+
+        bool ok = true;
+        while (struct dirent* entry = readdir(dir))
+        {
+            std::string name = entry->d_name;
+            if (name == "." || name == "..")
+            {
+                continue;
+            }
+
+            struct stat info;
+            std::string full_name = directory + "/" + name;
+            if (stat(full_name.c_str(), &info) != 0)
+            {
+                ok = false;
+            }
+            else if (S_ISDIR(info.st_mode))
+            {
+                ok = listFiles(full_name, prefix + name + "/", paths) && ok;
+            }
+            else if (S_ISREG(info.st_mode))
+            {
+                paths.push_back(prefix + name);
+            }
+        }
+        closedir(dir);
+        return ok;
+#endif
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+uint64_t assetPathHash(const std::string& path)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : path)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string mimeTypeForPath(const std::string& path)
+{
+    static const char* const kTypes[][2] =
+    {
+        { "html", "text/html" },
+        { "htm", "text/html" },
+        { "js", "application/javascript" },
+        { "mjs", "application/javascript" },
+        { "css", "text/css" },
+        { "json", "application/json" },
+        { "txt", "text/plain" },
+        { "xml", "text/xml" },
+        { "svg", "image/svg+xml" },
+        { "png", "image/png" },
+        { "jpg", "image/jpeg" },
+        { "jpeg", "image/jpeg" },
+        { "gif", "image/gif" },
+        { "webp", "image/webp" },
+        { "ico", "image/x-icon" },
+        { "woff", "font/woff" },
+        { "woff2", "font/woff2" },
+        { "ttf", "font/ttf" },
+        { "mp3", "audio/mpeg" },
+        { "ogg", "audio/ogg" },
+        { "wav", "audio/wav" },
+        { "mp4", "video/mp4" },
+        { "webm", "video/webm" },
+        { "wasm", "application/wasm" },
+    };
+
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+    {
+        std::string extension = lowerCase(path.substr(dot + 1));
+        for (const auto& type : kTypes)
+        {
+            if (extension == type[0])
+            {
+                return type[1];
+            }
+        }
+    }
+    return "application/octet-stream";
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+AssetPack::AssetPack() :
+    mData(nullptr),
+    mSize(0),
+    mHeader(nullptr),
+    mBuckets(nullptr),
+    mEntries(nullptr),
+    mHandle(nullptr)
+{
+}
+
+AssetPack::~AssetPack()
+{
+    close();
+}
+
+bool AssetPack::open(const std::string& file_name)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart >= (LONGLONG)sizeof(AssetPackHeader))
+    {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    // the mapping keeps the file open
+    CloseHandle(file);
+    if (mapping == NULL)
+    {
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    mHandle = mapping;
+    mData = (const unsigned char*)data;
+    mSize = (size_t)file_size.QuadPart;
+#else
+    int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(AssetPackHeader))
+    {
+        data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    mData = (const unsigned char*)data;
+    mSize = (size_t)info.st_size;
+#endif
+
+    // everything the lookups rely on has to be inside the file
+    const AssetPackHeader* header = (const AssetPackHeader*)mData;
+    uint64_t bucket_bytes = (uint64_t)header->bucketCount * sizeof(uint32_t);
+    uint64_t entry_bytes = (uint64_t)header->entryCount * sizeof(AssetPackEntry);
+    bool ok = header->magic == kAssetPackMagic && header->version == kAssetPackVersion &&
+              header->fileSize == mSize &&
+              header->bucketCount > header->entryCount && (header->bucketCount & (header->bucketCount - 1)) == 0 &&
+              header->bucketOffset + bucket_bytes <= mSize && header->bucketOffset % sizeof(uint32_t) == 0 &&
+              header->entryOffset + entry_bytes <= mSize && header->entryOffset % sizeof(uint64_t) == 0 &&
+              header->stringOffset <= header->dataOffset && header->dataOffset <= mSize;
+    if (! ok)
+    {
+        close();
+        return false;
+    }
+
+    mHeader = header;
+    mBuckets = (const uint32_t*)(mData + header->bucketOffset);
+    mEntries = (const AssetPackEntry*)(mData + header->entryOffset);
+    for (uint32_t i = 0; i < header->entryCount; ++i)
+    {
+        const AssetPackEntry& entry = mEntries[i];
+        if (header->stringOffset + entry.pathOffset + entry.pathLength > header->dataOffset ||
+            header->stringOffset + entry.mimeOffset + entry.mimeLength > header->dataOffset ||
+            entry.dataOffset > mSize - header->dataOffset || entry.dataSize > mSize - header->dataOffset - entry.dataOffset)
+        {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void AssetPack::close()
+{
+    if (mData)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(mData);
+        CloseHandle((HANDLE)mHandle);
+#else
+        munmap((void*)mData, mSize);
+#endif
+    }
+
+    mData = nullptr;
+    mSize = 0;
+    mHeader = nullptr;
+    mBuckets = nullptr;
+    mEntries = nullptr;
+    mHandle = nullptr;
+}
+
+bool AssetPack::find(const std::string& path, Asset& asset) const
+{
+    if (mHeader == nullptr)
+    {
+        return false;
+    }
+
+    uint64_t hash = assetPathHash(path);
+    uint32_t mask = mHeader->bucketCount - 1;
+    const char* strings = (const char*)mData + mHeader->stringOffset;
+
+    // there's always an empty bucket so this stops
+    for (uint32_t bucket = (uint32_t)hash & mask; mBuckets[bucket] != 0; bucket = (bucket + 1) & mask)
+    {
+        uint32_t index = mBuckets[bucket] - 1;
+        if (index >= mHeader->entryCount)
+        {
+            return false;
+        }
+
+        const AssetPackEntry& entry = mEntries[index];
+        if (entry.hash == hash && entry.pathLength == path.size() &&
+            memcmp(strings + entry.pathOffset, path.data(), path.size()) == 0)
+        {
+            asset.data = mData + mHeader->dataOffset + entry.dataOffset;
+            asset.size = entry.dataSize;
+            asset.mimeType.assign(strings + entry.mimeOffset, entry.mimeLength);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string AssetPack::path(size_t index) const
+{
+    if (mHeader == nullptr || index >= mHeader->entryCount)
+    {
+        return std::string();
+    }
+
+    const AssetPackEntry& entry = mEntries[index];
+    return std::string((const char*)mData + mHeader->stringOffset + entry.pathOffset, entry.pathLength);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+void AssetPackWriter::add(const std::string& path, const std::vector<unsigned char>& data, const std::string& mime_type)
+{
+    File file;
+    file.path = path;
+    file.mimeType = mime_type.empty() ? mimeTypeForPath(path) : mime_type;
+    file.data = data;
+
+    for (File& existing : mFiles)
+    {
+        if (existing.path == path)
+        {
+            existing = file;
+            return;
+        }
+    }
+    mFiles.push_back(file);
+}
+
+bool AssetPackWriter::addDirectory(const std::string& directory)
+{
+    std::vector<std::string> paths;
+    if (! listFiles(directory, "", paths))
+    {
+        return false;
+    }
+
+    // the same pack whatever order the file system lists things in
+    std::sort(paths.begin(), paths.end());
+    for (const std::string& path : paths)
+    {
+        std::vector<unsigned char> data;
+        if (! readFile(directory + "/" + path, data))
+        {
+            return false;
+        }
+        add(path, data);
+    }
+    return true;
+}
+
+bool AssetPackWriter::write(const std::string& file_name) const
+{
+    // at most half full so probes stay short - and there's always an empty bucket to stop at
+    uint32_t bucket_count = 2;
+    while (bucket_count < mFiles.size() * 2)
+    {
+        bucket_count *= 2;
+    }
+
+    std::vector<uint32_t> buckets(bucket_count, 0);
+    std::vector<AssetPackEntry> entries(mFiles.size());
+    std::string strings;
+    uint64_t data_size = 0;
+    for (size_t i = 0; i < mFiles.size(); ++i)
+    {
+        const File& file = mFiles[i];
+        AssetPackEntry& entry = entries[i];
+        entry.hash = assetPathHash(file.path);
+        entry.dataOffset = data_size;
+        entry.dataSize = file.data.size();
+        entry.pathOffset = (uint32_t)strings.size();
+        entry.pathLength = (uint32_t)file.path.size();
+        strings += file.path;
+        entry.mimeOffset = (uint32_t)strings.size();
+        entry.mimeLength = (uint32_t)file.mimeType.size();
+        strings += file.mimeType;
+        data_size = alignUp(data_size + file.data.size(), kAssetPackAlignment);
+
+        uint32_t bucket = (uint32_t)entry.hash & (bucket_count - 1);
+        while (buckets[bucket] != 0)
+        {
+            bucket = (bucket + 1) & (bucket_count - 1);
+        }
+        buckets[bucket] = (uint32_t)i + 1;
+    }
+
+    AssetPackHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kAssetPackMagic;
+    header.version = kAssetPackVersion;
+    header.entryCount = (uint32_t)entries.size();
+    header.bucketCount = bucket_count;
+    header.bucketOffset = alignUp(sizeof(header), sizeof(uint64_t));
+    header.entryOffset = alignUp(header.bucketOffset + buckets.size() * sizeof(uint32_t), sizeof(uint64_t));
+    header.stringOffset = header.entryOffset + entries.size() * sizeof(AssetPackEntry);
+    header.dataOffset = alignUp(header.stringOffset + strings.size(), kAssetPackAlignment);
+    header.fileSize = header.dataOffset + data_size;
+
+    FILE* file = fopen(file_name.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    static const unsigned char kPadding[kAssetPackAlignment] = { 0 };
+    uint64_t written = 0;
+    auto put = [&](const void* data, uint64_t bytes, uint64_t offset) -> bool
+    {
+        bool ok = fwrite(kPadding, 1, (size_t)(offset - written), file) == offset - written &&
+                  (bytes == 0 || fwrite(data, 1, (size_t)bytes, file) == bytes);
+        written = offset + bytes;
+        return ok;
+    };
+
+    bool ok = put(&header, sizeof(header), 0) &&
+              put(buckets.data(), buckets.size() * sizeof(uint32_t), header.bucketOffset) &&
+              put(entries.data(), entries.size() * sizeof(AssetPackEntry), header.entryOffset) &&
+              put(strings.data(), strings.size(), header.stringOffset);
+    for (size_t i = 0; ok && i < mFiles.size(); ++i)
+    {
+        ok = put(mFiles[i].data.data(), mFiles[i].data.size(), header.dataOffset + entries[i].dataOffset);
+    }
+    ok = ok && put(nullptr, 0, header.fileSize);
+
+    return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,146 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _ASSET_PACK_H_
+#define _ASSET_PACK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// a read only pack of files (the HTML, JS and media our pages are made of) in
+// one file that's memory mapped and served from where it is - nothing is read
+// or copied until a request asks for it, and then only the pages it touches.
+// Files are found by path through a hash table in the pack itself, so opening
+// a pack is a map and a few checks however many files are in it.
+//
+// The layout, all little endian:
+//
+//   AssetPackHeader
+//   bucket table    bucketCount uint32s, an entry index + 1 or 0 for empty -
+//                   open addressing, linear probing from hash & (bucketCount - 1)
+//   entry table     entryCount AssetPackEntry
+//   strings         paths and MIME types, not terminated
+//   data            each file's bytes, kAssetPackAlignment aligned
+const uint32_t kAssetPackMagic = 0x4b504341;    // "ACPK"
+const uint32_t kAssetPackVersion = 1;
+const uint64_t kAssetPackAlignment = 16;
+
+struct AssetPackHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t bucketCount;
+    // from the start of the file
+    uint64_t bucketOffset;
+    uint64_t entryOffset;
+    uint64_t stringOffset;
+    uint64_t dataOffset;
+    uint64_t fileSize;
+};
+
+struct AssetPackEntry
+{
+    uint64_t hash;
+    // data from dataOffset, strings from stringOffset
+    uint64_t dataOffset;
+    uint64_t dataSize;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint32_t mimeOffset;
+    uint32_t mimeLength;
+};
+
+// one file in an open pack - data points into the mapping and is good until the pack is closed
+struct Asset
+{
+    const unsigned char* data;
+    uint64_t size;
+    std::string mimeType;
+};
+
+// 64 bit FNV-1a of a path - what the bucket table is keyed on
+uint64_t assetPathHash(const std::string& path);
+
+// a MIME type from the file extension - application/octet-stream if we don't know it
+std::string mimeTypeForPath(const std::string& path);
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+class AssetPack
+{
+    public:
+        AssetPack();
+        ~AssetPack();
+
+        // maps the pack and checks it's one - false if it can't be opened or doesn't look right
+        bool open(const std::string& file_name);
+        void close();
+
+        bool isOpen() const
+        {
+            return mData != nullptr;
+        }
+
+        size_t size() const
+        {
+            return mHeader ? mHeader->entryCount : 0;
+        }
+
+        // path is relative to the root of the pack with no leading '/' (e.g. "js/app.js")
+        bool find(const std::string& path, Asset& asset) const;
+
+        // the n'th file's path, in the order they were added
+        std::string path(size_t index) const;
+
+    private:
+        AssetPack(const AssetPack&);
+        AssetPack& operator=(const AssetPack&);
+
+        const unsigned char* mData;
+        size_t mSize;
+        const AssetPackHeader* mHeader;
+        const uint32_t* mBuckets;
+        const AssetPackEntry* mEntries;
+
+        // the file mapping (Windows) or file descriptor the mapping came from
+        void* mHandle;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// builds a pack - add everything then write it out
+class AssetPackWriter
+{
+    public:
+        // mime_type empty to guess from the extension - a path added twice replaces the first one
+        void add(const std::string& path, const std::vector<unsigned char>& data, const std::string& mime_type = "");
+
+        // every file under directory, with paths relative to it - false if it can't be read
+        bool addDirectory(const std::string& directory);
+
+        bool write(const std::string& file_name) const;
+
+        size_t size() const
+        {
+            return mFiles.size();
+        }
+
+    private:
+        struct File
+        {
+            std::string path;
+            std::string mimeType;
+            std::vector<unsigned char> data;
+        };
+
+        std::vector<File> mFiles;
+};
+
+#endif // _ASSET_PACK_H_
@@ -0,0 +1,132 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "atlas_packer.h"
+
+#include <algorithm>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+AtlasPacker::AtlasPacker(int width, int height) :
+    mWidth(width),
+    mHeight(height),
+    mUsedArea(0)
+{
+    reset();
+}
+
+void AtlasPacker::reset()
+{
+    mUsedArea = 0;
+    mSkyline.clear();
+
+    Node node = { 0, 0, mWidth };
+    mSkyline.push_back(node);
+}
+
+bool AtlasPacker::pack(int width, int height, int& x, int& y)
+{
+    if (width <= 0 || height <= 0)
+    {
+        return false;
+    }
+
+    // lowest position wins, ties go to the narrowest skyline segment so we leave wide gaps for wide rects
+    size_t best_index = mSkyline.size();
+    int best_y = mHeight;
+    int best_width = mWidth + 1;
+    for (size_t i = 0; i < mSkyline.size(); ++i)
+    {
+        int node_y = fit(i, width, height);
+        if (node_y >= 0 && (node_y < best_y || (node_y == best_y && mSkyline[i].width < best_width)))
+        {
+            best_index = i;
+            best_y = node_y;
+            best_width = mSkyline[i].width;
+        }
+    }
+
+    if (best_index == mSkyline.size())
+    {
+        return false;
+    }
+
+    x = mSkyline[best_index].x;
+    y = best_y;
+
+    // raise the skyline under the new rect
+    Node node = { x, y + height, width };
+    mSkyline.insert(mSkyline.begin() + best_index, node);
+
+    // and trim or remove the segments it now covers
+    for (size_t i = best_index + 1; i < mSkyline.size();)
+    {
+        const Node& previous = mSkyline[i - 1];
+        int previous_right = previous.x + previous.width;
+        if (mSkyline[i].x >= previous_right)
+        {
+            break;
+        }
+
+        int shrink = previous_right - mSkyline[i].x;
+        mSkyline[i].x += shrink;
+        mSkyline[i].width -= shrink;
+        if (mSkyline[i].width <= 0)
+        {
+            mSkyline.erase(mSkyline.begin() + i);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    // neighbours at the same height become one segment
+    for (size_t i = 0; i + 1 < mSkyline.size();)
+    {
+        if (mSkyline[i].y == mSkyline[i + 1].y)
+        {
+            mSkyline[i].width += mSkyline[i + 1].width;
+            mSkyline.erase(mSkyline.begin() + i + 1);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    mUsedArea += (size_t)width * height;
+    return true;
+}
+
+int AtlasPacker::fit(size_t index, int width, int height) const
+{
+    int x = mSkyline[index].x;
+    if (x + width > mWidth)
+    {
+        return -1;
+    }
+
+    int y = 0;
+    int remaining = width;
+    for (size_t i = index; remaining > 0; ++i)
+    {
+        if (i == mSkyline.size())
+        {
+            return -1;
+        }
+
+        y = std::max(y, mSkyline[i].y);
+        if (y + height > mHeight)
+        {
+            return -1;
+        }
+        remaining -= mSkyline[i].width;
+    }
+
+    return y;
+}
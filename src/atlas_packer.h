@@ -0,0 +1,61 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _ATLAS_PACKER_H_
+#define _ATLAS_PACKER_H_
+
+#include <cstddef>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// skyline (bottom left) rectangle packer - keeps track of the top edge of
+// everything placed so far and puts each new rect as low as it can go. There is
+// no way to remove a single rect: callers reset() and pack everything again
+class AtlasPacker
+{
+    public:
+        AtlasPacker(int width, int height);
+
+        // returns false if there is no room left for a width x height rect
+        bool pack(int width, int height, int& x, int& y);
+
+        void reset();
+
+        int width() const
+        {
+            return mWidth;
+        }
+
+        int height() const
+        {
+            return mHeight;
+        }
+
+        // fraction of the area that has been handed out
+        double occupancy() const
+        {
+            return (double)mUsedArea / ((double)mWidth * mHeight);
+        }
+
+    private:
+        struct Node
+        {
+            int x;
+            int y;
+            int width;
+        };
+
+        // lowest y a width x height rect can sit at if its left edge is at node index - -1 if it doesn't fit
+        int fit(size_t index, int width, int height) const;
+
+        int mWidth;
+        int mHeight;
+        size_t mUsedArea;
+        std::vector<Node> mSkyline;
+};
+
+#endif // _ATLAS_PACKER_H_
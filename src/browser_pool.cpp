@@ -0,0 +1,95 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "browser_pool.h"
+
+#include <algorithm>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+BrowserPool::BrowserPool(size_t size) :
+    mSize(size)
+{
+}
+
+size_t BrowserPool::wanted() const
+{
+    size_t have = mWarming.size() + mReady.size();
+    return (have < mSize) ? mSize - have : 0;
+}
+
+void BrowserPool::warming(int id)
+{
+    mWarming.push_back(id);
+    ++mStats.created;
+}
+
+void BrowserPool::ready(int id)
+{
+    std::vector<int>::iterator it = std::find(mWarming.begin(), mWarming.end(), id);
+    if (it != mWarming.end())
+    {
+        mWarming.erase(it);
+        mReady.push_back(id);
+    }
+}
+
+int BrowserPool::acquire()
+{
+    if (mReady.empty())
+    {
+        ++mStats.misses;
+        return 0;
+    }
+
+    int id = mReady.front();
+    mReady.pop_front();
+    ++mStats.hits;
+    return id;
+}
+
+bool BrowserPool::release(int id)
+{
+    if (wanted() == 0)
+    {
+        ++mStats.closed;
+        return false;
+    }
+
+    mWarming.push_back(id);
+    ++mStats.reused;
+    return true;
+}
+
+bool BrowserPool::contains(int id) const
+{
+    return std::find(mWarming.begin(), mWarming.end(), id) != mWarming.end() ||
+           std::find(mReady.begin(), mReady.end(), id) != mReady.end();
+}
+
+std::vector<int> BrowserPool::takeAll()
+{
+    std::vector<int> ids(mWarming);
+    ids.insert(ids.end(), mReady.begin(), mReady.end());
+    mWarming.clear();
+    mReady.clear();
+    return ids;
+}
+
+void BrowserPool::firstPaint(bool pooled, double milliseconds)
+{
+    if (pooled)
+    {
+        ++mStats.pooledFirstPaints;
+        mStats.pooledFirstPaintTime += milliseconds;
+    }
+    else
+    {
+        ++mStats.coldFirstPaints;
+        mStats.coldFirstPaintTime += milliseconds;
+    }
+}
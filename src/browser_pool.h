@@ -0,0 +1,97 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _BROWSER_POOL_H_
+#define _BROWSER_POOL_H_
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+struct BrowserPoolStats
+{
+    BrowserPoolStats() :
+        created(0),
+        hits(0),
+        misses(0),
+        reused(0),
+        closed(0),
+        coldFirstPaints(0),
+        coldFirstPaintTime(0.0),
+        pooledFirstPaints(0),
+        pooledFirstPaintTime(0.0)
+    {
+    }
+
+    // browsers created for the pool, acquire()s it could and couldn't answer, released browsers it took
+    // back and ones it was too full for
+    size_t created;
+    size_t hits;
+    size_t misses;
+    size_t reused;
+    size_t closed;
+
+    // from asking for a browser to the first paint of its page (milliseconds, added up) - cold ones
+    // had to be created first
+    size_t coldFirstPaints;
+    double coldFirstPaintTime;
+    size_t pooledFirstPaints;
+    double pooledFirstPaintTime;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// keeps a few browsers created ahead of time, hidden on about:blank, so a new
+// browser is a navigation and a resize instead of a renderer process starting
+// up from nothing - and browsers that are finished with go back in instead of
+// being closed. Just the bookkeeping: browsers are ids here and the apps'
+// BrowserManager does the creating, scrubbing and hiding. Main thread only
+class BrowserPool
+{
+    public:
+        explicit BrowserPool(size_t size);
+
+        size_t size() const
+        {
+            return mSize;
+        }
+
+        // how many to create now to get back up to size - the ones still warming up count
+        size_t wanted() const;
+
+        // a new browser on its way to about:blank - released ones are warming again from release()
+        void warming(int id);
+        // on about:blank and hidden - ready to hand out
+        void ready(int id);
+
+        // the browser that's been ready longest - 0 if none is, and the caller has to create one cold
+        int acquire();
+
+        // a browser that's finished with - true if the pool takes it back (it's warming again while it's
+        // scrubbed), false if the pool is full and it should be closed
+        bool release(int id);
+
+        bool contains(int id) const;
+
+        // every browser in the pool, warming or ready, and then none - for closing them at the end
+        std::vector<int> takeAll();
+
+        // the time from asking for a browser to its page's first paint
+        void firstPaint(bool pooled, double milliseconds);
+
+        const BrowserPoolStats& stats() const
+        {
+            return mStats;
+        }
+
+    private:
+        size_t mSize;
+        std::vector<int> mWarming;
+        std::deque<int> mReady;
+        BrowserPoolStats mStats;
+};
+
+#endif // _BROWSER_POOL_H_
@@ -0,0 +1,193 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "cef_cookies.h"
+#include "cef_offscreen.h"
+
+#include <iostream>
+
+namespace
+{
+    class SetCookieCallback :
+        public CefSetCookieCallback
+    {
+        public:
+            SetCookieCallback(const std::function<void(bool)>& done) :
+                mDone(done)
+            {
+            }
+
+            void OnComplete(bool success) override
+            {
+                mDone(success);
+            }
+
+            IMPLEMENT_REFCOUNTING(SetCookieCallback);
+
+        private:
+            std::function<void(bool)> mDone;
+    };
+
+    class FlushCallback :
+        public CefCompletionCallback
+    {
+        public:
+            FlushCallback(const std::function<void()>& done) :
+                mDone(done)
+            {
+            }
+
+            void OnComplete() override
+            {
+                mDone();
+            }
+
+            IMPLEMENT_REFCOUNTING(FlushCallback);
+
+        private:
+            std::function<void()> mDone;
+    };
+
+    // CEF lets go of the visitor when it has visited everything (or there was nothing to visit)
+    class CookieVisitor :
+        public CefCookieVisitor
+    {
+        public:
+            CookieVisitor(const std::function<void(const CookieRecord&)>& visit, const std::function<void()>& done) :
+                mVisit(visit),
+                mDone(done)
+            {
+            }
+
+            ~CookieVisitor()
+            {
+                if (mDone)
+                {
+                    mDone();
+                }
+            }
+
+            // it was never used
+            void cancel()
+            {
+                mDone = nullptr;
+            }
+
+            bool Visit(const CefCookie& cookie, int count, int total, bool& deleteCookie) override
+            {
+                mVisit(fromCefCookie(cookie));
+                return true;
+            }
+
+            IMPLEMENT_REFCOUNTING(CookieVisitor);
+
+        private:
+            std::function<void(const CookieRecord&)> mVisit;
+            std::function<void()> mDone;
+    };
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+void CefCookieStore::setCookie(const CookieRecord& cookie, const std::function<void(bool success)>& done)
+{
+    CefRefPtr<CefCookieManager> manager = CefCookieManager::GetGlobalManager(nullptr);
+    if (! manager || ! manager->SetCookie(cookieURL(cookie), toCefCookie(cookie), new SetCookieCallback(done)))
+    {
+        // an invalid URL - the callback won't be called
+        done(false);
+    }
+}
+
+void CefCookieStore::flush(const std::function<void()>& done)
+{
+    CefRefPtr<CefCookieManager> manager = CefCookieManager::GetGlobalManager(nullptr);
+    if (! manager || ! manager->FlushStore(new FlushCallback(done)))
+    {
+        done();
+    }
+}
+
+bool CefCookieStore::visitAll(const std::function<void(const CookieRecord& cookie)>& visit, const std::function<void()>& done)
+{
+    CefRefPtr<CefCookieManager> manager = CefCookieManager::GetGlobalManager(nullptr);
+    if (! manager)
+    {
+        return false;
+    }
+
+    CefRefPtr<CookieVisitor> visitor = new CookieVisitor(visit, done);
+    if (! manager->VisitAllCookies(visitor))
+    {
+        visitor->cancel();
+        return false;
+    }
+    return true;
+}
+
+CookieTransferSettings loggedCookieTransfer(const std::string& name, size_t batch_size,
+                                            const std::function<void(const CookieTransferStats&)>& done)
+{
+    CookieTransferSettings settings;
+    settings.batchSize = batch_size;
+    settings.post = runOnUIThread;
+    settings.progress = [name](const CookieTransferStats& stats)
+    {
+        std::cout << name << ": " << stats.cookies << " cookies in " << stats.milliseconds << " ms, " << stats.failed << " failed" << std::endl;
+    };
+    settings.done = [name, done](const CookieTransferStats& stats)
+    {
+        std::cout << name << ": finished - " << stats.cookies << " cookies (" << stats.failed << " failed, " << stats.skipped
+                  << " lines that weren't cookies) in " << stats.milliseconds << " ms, " << stats.batches << " batches, "
+                  << stats.flushes << " flushes, " << stats.ownerMilliseconds << " ms on the UI thread"
+                  << (stats.ok ? "" : " - UNABLE TO WRITE THE FILE") << std::endl;
+        if (done)
+        {
+            done(stats);
+        }
+    };
+    return settings;
+}
+
+CefCookie toCefCookie(const CookieRecord& cookie)
+{
+    CefCookie cef_cookie;
+    CefString(&cef_cookie.name) = cookie.name;
+    CefString(&cef_cookie.value) = cookie.value;
+    CefString(&cef_cookie.domain) = cookie.domain;
+    CefString(&cef_cookie.path) = cookie.path;
+    cef_cookie.secure = cookie.secure;
+    cef_cookie.httponly = cookie.httpOnly;
+    cef_cookie.has_expires = cookie.hasExpires;
+
+    CefTime expires;
+    CefTime creation;
+    CefTime last_access;
+    expires.SetDoubleT(cookie.expires);
+    creation.SetDoubleT(cookie.creation);
+    last_access.SetDoubleT(cookie.lastAccess);
+    cef_cookie.expires = expires;
+    cef_cookie.creation = creation;
+    cef_cookie.last_access = last_access;
+    return cef_cookie;
+}
+
+CookieRecord fromCefCookie(const CefCookie& cef_cookie)
+{
+    CookieRecord cookie;
+    cookie.name = CefString(&cef_cookie.name).ToString();
+    cookie.value = CefString(&cef_cookie.value).ToString();
+    cookie.domain = CefString(&cef_cookie.domain).ToString();
+    cookie.path = CefString(&cef_cookie.path).ToString();
+    cookie.secure = cef_cookie.secure != 0;
+    cookie.httpOnly = cef_cookie.httponly != 0;
+    cookie.hasExpires = cef_cookie.has_expires != 0;
+    cookie.expires = CefTime(cef_cookie.expires).GetDoubleT();
+    cookie.creation = CefTime(cef_cookie.creation).GetDoubleT();
+    cookie.lastAccess = CefTime(cef_cookie.last_access).GetDoubleT();
+    return cookie;
+}
@@ -0,0 +1,37 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _CEF_COOKIES_H_
+#define _CEF_COOKIES_H_
+
+#include "cef_client.h"
+
+#include "cookie_store.h"
+
+/////////////////////////////////////////////////////////////////////////////////
+// CEF's global cookie manager as a CookieStore, for importCookies() and
+// exportCookies(). The cookie manager calls back on CEF's IO thread, so the
+// apps post the transfer's work back to the UI thread (see runOnUIThread())
+class CefCookieStore :
+    public CookieStore
+{
+    public:
+        void setCookie(const CookieRecord& cookie, const std::function<void(bool success)>& done) override;
+        void flush(const std::function<void()>& done) override;
+        bool visitAll(const std::function<void(const CookieRecord& cookie)>& visit, const std::function<void()>& done) override;
+};
+
+// a transfer run on CEF's UI thread with its progress written out as "<name>: ..." lines - done (which
+// can be empty) is called when it's finished
+CookieTransferSettings loggedCookieTransfer(const std::string& name, size_t batch_size,
+                                            const std::function<void(const CookieTransferStats&)>& done);
+
+// the app's cookie files to CEF's cookies and back
+CefCookie toCefCookie(const CookieRecord& cookie);
+CookieRecord fromCefCookie(const CefCookie& cookie);
+
+#endif // _CEF_COOKIES_H_
@@ -0,0 +1,344 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "cef_offscreen.h"
+#include "cef_resources.h"
+#include "wrapper/cef_helpers.h"
+
+#include "instrument.h"
+#include "pump_scheduler.h"
+#include "tile_hasher.h"
+
+#include <future>
+#include <iostream>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+void initOffscreenSettings(CefSettings& settings, bool multi_threaded, bool external_pump, const std::string& log_file)
+{
+    settings.multi_threaded_message_loop = multi_threaded;
+    settings.external_message_pump = external_pump && ! multi_threaded;
+    settings.windowless_rendering_enabled = true;
+
+    CefString(&settings.log_file) = log_file;
+    settings.log_severity = LOGSEVERITY_DEFAULT;
+}
+
+void appendOffscreenSwitches(const CefString& process_type, CefRefPtr<CefCommandLine> command_line)
+{
+    if (process_type.empty())
+    {
+        command_line->AppendSwitch("disable-gpu");
+        command_line->AppendSwitch("disable-gpu-compositing");
+    }
+}
+
+void initOffscreenWindowInfo(CefWindowInfo& window_info)
+{
+    window_info.windowless_rendering_enabled = true;
+}
+
+CefBrowserSettings offscreenBrowserSettings(int frame_rate)
+{
+    CefBrowserSettings browser_settings;
+    browser_settings.windowless_frame_rate = frame_rate;
+    browser_settings.background_color = 0xffff0000;
+    return browser_settings;
+}
+
+namespace
+{
+    class FunctionTask :
+        public CefTask
+    {
+        public:
+            FunctionTask(const std::function<void()>& function) :
+                mFunction(function)
+            {
+            }
+
+            void Execute() override
+            {
+                mFunction();
+            }
+
+            IMPLEMENT_REFCOUNTING(FunctionTask);
+
+        private:
+            std::function<void()> mFunction;
+    };
+}
+
+void runOnUIThread(const std::function<void()>& task)
+{
+    if (CefCurrentlyOn(TID_UI))
+    {
+        task();
+    }
+    else
+    {
+        CefPostTask(TID_UI, new FunctionTask(task));
+    }
+}
+
+void runOnUIThreadAndWait(const std::function<void()>& task)
+{
+    if (CefCurrentlyOn(TID_UI))
+    {
+        task();
+        return;
+    }
+
+    std::promise<void> done;
+    CefPostTask(TID_UI, new FunctionTask([&task, &done]()
+    {
+        task();
+        done.set_value();
+    }));
+    done.get_future().wait();
+}
+
+::RectList toRectList(const CefRenderHandler::RectList& dirty_rects)
+{
+    ::RectList rects;
+    for (const CefRect& rect : dirty_rects)
+    {
+        rects.push_back(Rect(rect.x, rect.y, rect.width, rect.height));
+    }
+    return rects;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+OffscreenRenderHandler::OffscreenRenderHandler(int id, int width, int height, UploadBackend* upload_backend, bool upload_on_paint,
+                                               float render_scale, float device_scale_factor, bool render_scale_keeps_layout) :
+    mUploadBackend(upload_backend),
+    mCompositor(upload_on_paint ? upload_backend : &mNullUploadBackend),
+    mId(id),
+    mWidth(width),
+    mHeight(height),
+    mRenderScale(render_scale),
+    mDeviceScaleFactor(device_scale_factor),
+    mRenderScaleKeepsLayout(render_scale_keeps_layout),
+    mPaintStatsInterval(0),
+    mFirstPaintState(FIRST_PAINT_DONE),
+    mFirstPaintTime(0.0)
+{
+}
+
+void OffscreenRenderHandler::setSize(int width, int height)
+{
+    mWidth.store(width);
+    mHeight.store(height);
+}
+
+void OffscreenRenderHandler::setRenderScale(float scale)
+{
+    mRenderScale.store(scale);
+}
+
+float OffscreenRenderHandler::renderScale() const
+{
+    return mRenderScale.load();
+}
+
+void OffscreenRenderHandler::toView(int x, int y, int& view_x, int& view_y) const
+{
+    renderScaleNow().toView(mWidth.load(), mHeight.load(), x, y, view_x, view_y);
+}
+
+bool OffscreenRenderHandler::exportFrames(const std::string& name, int max_width, int max_height, int slots)
+{
+    return mFrameRing.create(name, max_width, max_height, slots);
+}
+
+void OffscreenRenderHandler::setPaintStatsInterval(size_t interval)
+{
+    mPaintStatsInterval = interval;
+}
+
+size_t OffscreenRenderHandler::paints() const
+{
+    return mCompositor.stats().frames;
+}
+
+size_t OffscreenRenderHandler::skippedPaints() const
+{
+    return mCompositor.tileStats().skippedFrames;
+}
+
+void OffscreenRenderHandler::expectFirstPaint()
+{
+    mFirstPaintState.store(FIRST_PAINT_WAITING_FOR_PAGE);
+}
+
+void OffscreenRenderHandler::pageStarted()
+{
+    int waiting = FIRST_PAINT_WAITING_FOR_PAGE;
+    mFirstPaintState.compare_exchange_strong(waiting, FIRST_PAINT_WAITING_FOR_PAINT);
+}
+
+bool OffscreenRenderHandler::takeFirstPaint(double& when)
+{
+    int painted = FIRST_PAINT_PAINTED;
+    if (! mFirstPaintState.compare_exchange_strong(painted, FIRST_PAINT_DONE))
+    {
+        return false;
+    }
+    when = mFirstPaintTime.load();
+    return true;
+}
+
+bool OffscreenRenderHandler::GetViewRect(CefRefPtr<CefBrowser> browser, CefRect& rect)
+{
+    CEF_REQUIRE_UI_THREAD();
+
+    Rect view = renderScaleNow().viewRect(mWidth.load(), mHeight.load());
+    rect = CefRect(view.x, view.y, view.width, view.height);
+    return true;
+}
+
+bool OffscreenRenderHandler::GetScreenInfo(CefRefPtr<CefBrowser> browser, CefScreenInfo& screen_info)
+{
+    CEF_REQUIRE_UI_THREAD();
+
+    RenderScale render_scale = renderScaleNow();
+    Rect view = render_scale.viewRect(mWidth.load(), mHeight.load());
+    screen_info.device_scale_factor = render_scale.screenScaleFactor();
+    screen_info.rect = CefRect(view.x, view.y, view.width, view.height);
+    screen_info.available_rect = screen_info.rect;
+    return true;
+}
+
+void OffscreenRenderHandler::OnPaint(CefRefPtr<CefBrowser> browser, PaintElementType type, const RectList& dirtyRects, const void* buffer, int width, int height)
+{
+    CEF_REQUIRE_UI_THREAD();
+    INSTRUMENT_SCOPE("OnPaint");
+
+    ::RectList dirty_rects = toRectList(dirtyRects);
+    paintStarted(type, dirty_rects, width, height);
+
+    // the upload backend (and a resize in the compositor) work on the bound texture
+    if (! bindTexture(type))
+    {
+        return;
+    }
+
+    // regions of the page (or the popup layer) that changed this frame
+    ::RectList damage;
+    if (type == PET_VIEW)
+    {
+        if (mFirstPaintState.load() == FIRST_PAINT_WAITING_FOR_PAINT)
+        {
+            mFirstPaintTime.store(PumpScheduler::now());
+            mFirstPaintState.store(FIRST_PAINT_PAINTED);
+        }
+        damage = mCompositor.paintView(dirty_rects, (const unsigned char*)buffer, width, height);
+    }
+    else if (type == PET_POPUP)
+    {
+        damage = mCompositor.paintPopup(dirty_rects, (const unsigned char*)buffer, width, height);
+    }
+
+    mCompositor.upload(damage);
+    if (! damage.empty())
+    {
+        // with a popup layer the page CEF painted is the page - the popup is drawn over it
+        const unsigned char* pixels = mCompositor.isLayered() ? (type == PET_VIEW ? (const unsigned char*)buffer : nullptr) : mCompositor.pixels();
+        exportFrame(pixels, damage);
+        painted(pixels, damage);
+    }
+
+    writePaintStats();
+    mCompositor.endFrame();
+}
+
+void OffscreenRenderHandler::OnPopupShow(CefRefPtr<CefBrowser> browser, bool show)
+{
+    CEF_REQUIRE_UI_THREAD();
+
+    mCompositor.popupShow(show);
+    popupShown(show);
+}
+
+void OffscreenRenderHandler::OnPopupSize(CefRefPtr<CefBrowser> browser, const CefRect& rect)
+{
+    CEF_REQUIRE_UI_THREAD();
+
+    // CEF gives it in DIPs and paints it in pixels
+    Rect popup_rect = renderScaleNow().toPaint(Rect(rect.x, rect.y, rect.width, rect.height));
+    mCompositor.popupSize(popup_rect);
+    popupSized(popup_rect);
+}
+
+RenderScale OffscreenRenderHandler::renderScaleNow() const
+{
+    return RenderScale(mRenderScale.load(), mDeviceScaleFactor, mRenderScaleKeepsLayout);
+}
+
+void OffscreenRenderHandler::exportFrame(const unsigned char* pixels, const ::RectList& damage)
+{
+    if (! mFrameRing.isOpen() || pixels == nullptr)
+    {
+        return;
+    }
+
+    INSTRUMENT_SCOPE("paint.export");
+    std::vector<FrameRect> dirty;
+    for (const Rect& rect : damage)
+    {
+        FrameRect frame_rect = { rect.x, rect.y, rect.width, rect.height };
+        dirty.push_back(frame_rect);
+    }
+    mFrameRing.publish(pixels, mCompositor.width(), mCompositor.height(), mCompositor.width(), dirty.data(), dirty.size(), instrumentNow());
+}
+
+void OffscreenRenderHandler::writePaintStats() const
+{
+    const CompositorStats& stats = mCompositor.stats();
+    if (mPaintStatsInterval == 0 || (stats.frames + 1) % mPaintStatsInterval != 0)
+    {
+        return;
+    }
+
+    std::cout << "PaintStats: browser " << mId << " frame " << stats.frames + 1 << " copied " << stats.frameBytesCopied << " bytes, uploaded " << stats.frameBytesUploaded << " bytes"
+              << " (average " << stats.totalBytesCopied / (stats.frames + 1) << " / " << stats.totalBytesUploaded / (stats.frames + 1) << " bytes per frame)";
+    const TileHasherStats& tile_stats = mCompositor.tileStats();
+    if (tile_stats.frames > 0)
+    {
+        std::cout << ", tile hashing skipped " << 100.0 * tile_stats.skippedFrames / tile_stats.frames << "% of page paints and "
+                  << 100.0 * (tile_stats.tilesHashed - tile_stats.tilesChanged) / (tile_stats.tilesHashed > 0 ? tile_stats.tilesHashed : 1) << "% of dirty tiles"
+                  << " for " << tile_stats.hashNanoseconds / 1000.0 / tile_stats.frames << " us of hashing per paint";
+    }
+    std::cout << std::endl;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+OffscreenClient::OffscreenClient(OffscreenRenderHandler* render_handler, LocalResources* resources) :
+    mRenderHandler(render_handler),
+    mResources(resources)
+{
+}
+
+CefRefPtr<CefRenderHandler> OffscreenClient::GetRenderHandler()
+{
+    return mRenderHandler.get();
+}
+
+CefRefPtr<CefRequestHandler> OffscreenClient::GetRequestHandler()
+{
+    return this;
+}
+
+CefRefPtr<CefResourceHandler> OffscreenClient::GetResourceHandler(CefRefPtr<CefBrowser> browser,
+                                                                  CefRefPtr<CefFrame> frame,
+                                                                  CefRefPtr<CefRequest> request)
+{
+    return localResourceHandler(mResources, request);
+}
@@ -0,0 +1,180 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _CEF_OFFSCREEN_H_
+#define _CEF_OFFSCREEN_H_
+
+#include "cef_app.h"
+#include "cef_client.h"
+#include "cef_task.h"
+
+#include "compositor.h"
+#include "frame_ring.h"
+#include "render_scale.h"
+#include "resource_cache.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+
+/////////////////////////////////////////////////////////////////////////////////
+// the windowless (off screen rendering) CEF setup the Windows app and the
+// headless Linux app share - CEF paints into memory through OnPaint and never
+// touches the GPU, so the same settings work on a desktop and on a server with
+// no display or GPU
+
+// single threaded message loop, pumped by us (see PumpScheduler) when external_pump is set - or, with
+// multi_threaded, CEF runs its own UI thread and our thread never calls into its message loop
+void initOffscreenSettings(CefSettings& settings, bool multi_threaded, bool external_pump, const std::string& log_file);
+
+// from CefApp::OnBeforeCommandLineProcessing() - turns the GPU process off in the browser process
+void appendOffscreenSwitches(const CefString& process_type, CefRefPtr<CefCommandLine> command_line);
+
+// a browser that paints through its render handler instead of into a window
+void initOffscreenWindowInfo(CefWindowInfo& window_info);
+CefBrowserSettings offscreenBrowserSettings(int frame_rate);
+
+// calls into a browser that have to be made on CEF's UI thread - with a single threaded message loop
+// that's our thread and task runs straight away, otherwise it's posted there
+void runOnUIThread(const std::function<void()>& task);
+// same but doesn't return until task has run - not for anything CEF's UI thread might be waiting on us for
+void runOnUIThreadAndWait(const std::function<void()>& task);
+
+// CEF's dirty rects to ours
+::RectList toRectList(const CefRenderHandler::RectList& dirty_rects);
+
+/////////////////////////////////////////////////////////////////////////////////
+// the render handler both apps give each browser - screen info at the browser's
+// render scale, CEF's paints and popups into a compositor and what changed out to
+// the frame ring. Nothing here touches GL - an app supplies the upload backend the
+// compositor writes into, binds its textures (bindTexture()) and sends the page
+// wherever else it goes (painted())
+class OffscreenRenderHandler :
+    public CefRenderHandler
+{
+    public:
+        // takes upload_backend - with upload_on_paint false the compositor only composites and the
+        // app uploads from painted() itself (on another thread, say)
+        OffscreenRenderHandler(int id, int width, int height, UploadBackend* upload_backend, bool upload_on_paint,
+                               float render_scale, float device_scale_factor, bool render_scale_keeps_layout);
+
+        int id() const
+        {
+            return mId;
+        }
+
+        // the size we tell CEF to render at - caller needs to call WasResized() after
+        void setSize(int width, int height);
+
+        // how much of that CEF paints - caller needs to call NotifyScreenInfoChanged() and WasResized() after
+        void setRenderScale(float scale);
+        float renderScale() const;
+
+        // a position in the browser, in pixels from its top left, as CEF wants it in a mouse event
+        void toView(int x, int y, int& view_x, int& view_y) const;
+
+        // publish the page to shared memory as name (see frame_ring.h) - no bigger than max_width x max_height
+        bool exportFrames(const std::string& name, int max_width, int max_height, int slots);
+
+        // write out what was copied and uploaded every interval paints - 0 to turn off
+        void setPaintStatsInterval(size_t interval);
+
+        size_t paints() const;
+
+        // page paints tile hashing found nothing new in
+        size_t skippedPaints() const;
+
+        // the browser's been asked to load a page - the first paint after it starts (see pageStarted())
+        // is its first paint, picked up with takeFirstPaint()
+        void expectFirstPaint();
+
+        // from OnLoadStart() on CEF's UI thread
+        void pageStarted();
+
+        // when the page first painted (PumpScheduler::now()) if it has since expectFirstPaint() - once only
+        bool takeFirstPaint(double& when);
+
+        bool GetViewRect(CefRefPtr<CefBrowser> browser, CefRect& rect) override;
+        bool GetScreenInfo(CefRefPtr<CefBrowser> browser, CefScreenInfo& screen_info) override;
+        void OnPaint(CefRefPtr<CefBrowser> browser, PaintElementType type, const RectList& dirtyRects, const void* buffer, int width, int height) override;
+        void OnPopupShow(CefRefPtr<CefBrowser> browser, bool show) override;
+        void OnPopupSize(CefRefPtr<CefBrowser> browser, const CefRect& rect) override;
+
+    protected:
+        // all on CEF's UI thread - every paint before the compositor has it, then the texture the upload
+        // backend works on for it (false drops the paint)
+        virtual void paintStarted(PaintElementType /*type*/, const ::RectList& /*dirty_rects*/, int /*width*/, int /*height*/) {}
+        virtual bool bindTexture(PaintElementType /*type*/)
+        {
+            return true;
+        }
+
+        // the page changed - pixels is the page as it is now (the composited page or, with a popup layer,
+        // the page CEF just painted - nullptr when it was the popup that painted)
+        virtual void painted(const unsigned char* /*pixels*/, const ::RectList& /*damage*/) {}
+
+        // a popup appeared or went away, or moved - rect is where it's painted
+        virtual void popupShown(bool /*show*/) {}
+        virtual void popupSized(const Rect& /*rect*/) {}
+
+        RenderScale renderScaleNow() const;
+
+        std::unique_ptr<UploadBackend> mUploadBackend;
+        // the compositor's when it doesn't upload
+        NullUploadBackend mNullUploadBackend;
+        Compositor mCompositor;
+
+    private:
+        void exportFrame(const unsigned char* pixels, const ::RectList& damage);
+        void writePaintStats() const;
+
+        int mId;
+        // read on CEF's thread, set on ours
+        std::atomic<int> mWidth;
+        std::atomic<int> mHeight;
+        std::atomic<float> mRenderScale;
+        float mDeviceScaleFactor;
+        bool mRenderScaleKeepsLayout;
+        FrameRingWriter mFrameRing;
+        size_t mPaintStatsInterval;
+
+        // set on our thread, moved along on CEF's
+        enum
+        {
+            FIRST_PAINT_WAITING_FOR_PAGE,
+            FIRST_PAINT_WAITING_FOR_PAINT,
+            FIRST_PAINT_PAINTED,
+            FIRST_PAINT_DONE
+        };
+        std::atomic<int> mFirstPaintState;
+        std::atomic<double> mFirstPaintTime;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// the client both apps give each browser - its render handler, and requests are
+// answered from resources (see cef_resources.h) when they can be
+class OffscreenClient :
+    public CefClient,
+    public CefRequestHandler
+{
+    public:
+        OffscreenClient(OffscreenRenderHandler* render_handler, LocalResources* resources);
+
+        CefRefPtr<CefRenderHandler> GetRenderHandler() override;
+        CefRefPtr<CefRequestHandler> GetRequestHandler() override;
+
+        CefRefPtr<CefResourceHandler> GetResourceHandler(CefRefPtr<CefBrowser> browser,
+                                                         CefRefPtr<CefFrame> frame,
+                                                         CefRefPtr<CefRequest> request) override;
+
+    protected:
+        CefRefPtr<OffscreenRenderHandler> mRenderHandler;
+        LocalResources* mResources;
+};
+
+#endif // _CEF_OFFSCREEN_H_
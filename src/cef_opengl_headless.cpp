@@ -0,0 +1,841 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// the app for Linux machines with no display and usually no GPU - the same
+// windowless CEF setup as the Windows app (see cef_offscreen.h) painting into
+// the same compositor, drawn into an offscreen framebuffer in a surfaceless EGL
+// context (llvmpipe without a GPU) or, with --surface null, not drawn at all
+// and kept in memory where the frame ring (--export) and video capture
+// (--capture) can get at them. Writes out paints and presents per second and
+// frames per second per core of CPU time every gStatsInterval seconds
+//
+//     cef_opengl_headless [--url <url>] [--size <width>x<height>] [--browsers <count>]
+//                         [--surface egl|null] [--seconds <run time>] [--export] [--capture <target>]
+//                         [--compositor-threads <threads>] [--asset-pack <pack> [--asset-origin <url>]]
+//                         [--resource-cache-mb <megabytes>] [--resource-cache-origin <url>]
+//                         [--import-cookies <file>] [--export-cookies <file>]
+//                         [--renderer modern|legacy] [--tile-hashing <tile size>]
+//                         [--render-scale <scale> [--keep-layout]] [--device-scale-factor <factor>]
+//                         [--thumbnails png|qoi]
+
+#include "cef_app.h"
+#include "cef_client.h"
+#include "wrapper/cef_helpers.h"
+
+#include "cef_cookies.h"
+#include "cef_offscreen.h"
+#include "compositor.h"
+#include "instrument.h"
+#include "job_system.h"
+#include "pump_scheduler.h"
+#include "render_scheduler.h"
+#include "render_surface.h"
+#include "resource_cache.h"
+#include "thumbnail_service.h"
+#include "tile_hasher.h"
+#include "video_capture.h"
+
+#ifdef HEADLESS_HAVE_EGL
+#include "egl_surface.h"
+#include "gl_renderer.h"
+#include "gl_upload.h"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+int gWidth = 1280;
+int gHeight = 720;
+int gNumBrowsers = 1;
+std::string gStartURL = "https://sl-viewer-media-system.s3-us-west-2.amazonaws.com/index.html";
+// "egl" draws the browsers into an offscreen framebuffer, "null" doesn't draw them at all
+std::string gSurfaceBackend = "egl";
+// how "egl" draws them - with a shader and instanced draws, or in immediate mode (see gl_renderer.h)
+std::string gRendererName = "modern";
+// how long to run for (seconds) - 0 runs until SIGINT or SIGTERM
+double gRunSeconds = 0.0;
+// how often (in seconds) to write out the frame stats - 0 to turn off
+double gStatsInterval = 5.0;
+// CEF expects to be pumped at least this often even if it doesn't ask (milliseconds)
+double gMaxPumpDelay = 1000.0 / 30.0;
+// no more than one present per gPresentInterval milliseconds, and only when a browser painted
+double gPresentInterval = 1000.0 / 60.0;
+RenderScheduler gRenderScheduler(gPresentInterval);
+// the sandbox needs chrome-sandbox installed setuid root, which containers often can't do - set this to
+// run the renderer processes without it there
+bool gNoSandbox = false;
+// publish each browser's frames to shared memory (see frame_ring.h and the Windows app's gFrameExport)
+bool gFrameExport = false;
+std::string gFrameExportName = "cef_opengl_frames";
+int gFrameExportSlots = 3;
+// stream the first browser to a Y4M video (see video_capture.h) - empty is off
+std::string gCaptureTarget = "";
+double gCaptureFrameRate = 30.0;
+VideoCapture* gVideoCapture = nullptr;
+
+// threads the compositors share big copies out to (see Compositor::setJobSystem()) - 0 for one per
+// core, 1 does them on CEF's thread
+int gCompositorThreads = 0;
+JobSystem* gJobSystem = nullptr;
+
+// only copy and upload the tiles of a page paint whose pixels changed (see the Windows app's gTileHashSize) - 0 is off
+int gTileHashSize = 0;
+
+// every browser paints gRenderScale of its size in each direction (see the Windows app's gRenderScale)
+float gRenderScale = 1.0f;
+float gDeviceScaleFactor = 1.0f;
+bool gRenderScaleKeepsLayout = false;
+
+// keep thumbnails of the browsers (see thumbnail_service.h), encoded as gThumbnailFormat - each browser's
+// last one is written to thumbnail_<id>.<format> at exit. IMAGE_NONE is off
+ImageFormat gThumbnailFormat = IMAGE_NONE;
+ThumbnailService* gThumbnailService = nullptr;
+
+// GETs answered from an asset pack and a cache of what's been fetched (see the Windows app's gAssetPackFile)
+std::string gAssetPackFile = "";
+std::string gAssetPackOrigin = "https://sl-viewer-media-system.s3-us-west-2.amazonaws.com/";
+std::string gResourceCacheOrigin = "https://sl-viewer-media-system.s3-us-west-2.amazonaws.com/";
+size_t gResourceCacheBytes = 64 * 1024 * 1024;
+size_t gMaxCachedResponse = 8 * 1024 * 1024;
+LocalResources* gLocalResources = nullptr;
+
+// cookies restored before the browsers are created and saved again before they're closed (see the Windows
+// app's gCookieImportFile) - empty for neither
+std::string gCookieImportFile = "";
+std::string gCookieExportFile = "";
+size_t gCookieBatchSize = 500;
+
+RenderSurface* gRenderSurface = nullptr;
+#ifdef HEADLESS_HAVE_EGL
+QuadRenderer* gQuadRenderer = nullptr;
+#endif
+bool gExitRequested = false;
+bool gExitFlag = false;
+std::atomic<bool> gSignalled(false);
+
+// the main loop sleeps on this until something is due or CEF wants work done sooner
+std::mutex gWakeMutex;
+std::condition_variable gWakeCondition;
+bool gWakeRequested = false;
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+class RenderHandler :
+    public OffscreenRenderHandler
+{
+    public:
+        RenderHandler(int id, int width, int height) :
+            OffscreenRenderHandler(id, width, height, createUploadBackend(width, height), true,
+                                   gRenderScale, gDeviceScaleFactor, gRenderScaleKeepsLayout),
+            mTexture(createTexture(width, height))
+        {
+            mCompositor.setJobSystem(gJobSystem);
+            mCompositor.setTileHashing(gTileHashSize);
+
+            if (gFrameExport)
+            {
+                std::string name = gFrameExportName + "_" + std::to_string(id);
+                if (exportFrames(name, width, height, gFrameExportSlots))
+                {
+                    std::cout << "RenderHandler: browser " << id << " frames are published to " << name << std::endl;
+                }
+            }
+        }
+
+        ~RenderHandler()
+        {
+#ifdef HEADLESS_HAVE_EGL
+            if (mTexture != 0)
+            {
+                glDeleteTextures(1, &mTexture);
+            }
+#endif
+        }
+
+        // the upload backend makes the texture with TEXTURE_SWIZZLED
+        unsigned int texture() const
+        {
+#ifdef HEADLESS_HAVE_EGL
+            if (mTexture == 0 && gRenderSurface->hasGL())
+            {
+                return ((const GLUploadBackend*)mUploadBackend.get())->texture();
+            }
+#endif
+            return mTexture;
+        }
+
+        // how much of the texture the page fills - it grows in steps so it can be bigger
+        void textureExtent(float& u, float& v) const
+        {
+            u = 1.0f;
+            v = 1.0f;
+#ifdef HEADLESS_HAVE_EGL
+            const GLUploadBackend* gl_backend = gRenderSurface->hasGL() ? (const GLUploadBackend*)mUploadBackend.get() : nullptr;
+            if (gl_backend && gl_backend->textureWidth() > 0 && gl_backend->textureHeight() > 0)
+            {
+                u = (float)gl_backend->width() / gl_backend->textureWidth();
+                v = (float)gl_backend->height() / gl_backend->textureHeight();
+            }
+#endif
+        }
+
+        IMPLEMENT_REFCOUNTING(RenderHandler);
+
+    protected:
+        bool bindTexture(PaintElementType /*type*/) override
+        {
+#ifdef HEADLESS_HAVE_EGL
+            if (mTexture != 0)
+            {
+                glBindTexture(GL_TEXTURE_2D, mTexture);
+            }
+#endif
+            return true;
+        }
+
+        // popups are always composited into the page here - there's no one to draw a layer for
+        void painted(const unsigned char* pixels, const ::RectList& damage) override
+        {
+            gRenderScheduler.damage(PumpScheduler::now());
+
+            if (gVideoCapture != nullptr && id() == 1)
+            {
+                gVideoCapture->damage(pixels, mCompositor.width(), mCompositor.height(), damage);
+            }
+
+            if (gThumbnailService != nullptr)
+            {
+                gThumbnailService->damage(id(), pixels, mCompositor.width(), mCompositor.height(), damage);
+            }
+        }
+
+        void popupShown(bool /*show*/) override
+        {
+            gRenderScheduler.invalidate();
+        }
+
+    private:
+        // nothing to upload to without GL, and the upload backend makes its own with TEXTURE_SWIZZLED
+        static unsigned int createTexture(int width, int height)
+        {
+            unsigned int texture = 0;
+#ifdef HEADLESS_HAVE_EGL
+            if (gRenderSurface->hasGL() && gQuadRenderer->layout() == TEXTURE_BGRA)
+            {
+                texture = createPageTexture(width, height, TEXTURE_BGRA);
+            }
+#endif
+            return texture;
+        }
+
+        // the page stays in the compositor's pixels whether it's uploaded anywhere or not
+        static UploadBackend* createUploadBackend(int width, int height)
+        {
+#ifdef HEADLESS_HAVE_EGL
+            if (gRenderSurface->hasGL())
+            {
+                return new GLUploadBackend(width, height, GLUploadBackend::DIRECT, 1, true, gQuadRenderer->layout());
+            }
+#endif
+            return new NullUploadBackend;
+        }
+
+        unsigned int mTexture;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+class LifeSpanHandler :
+    public CefLifeSpanHandler
+{
+    public:
+        bool OnBeforePopup(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame,
+                           const CefString& target_url, const CefString& target_frame_name,
+                           CefLifeSpanHandler::WindowOpenDisposition target_disposition,
+                           bool user_gesture, const CefPopupFeatures& popupFeatures,
+                           CefWindowInfo& windowInfo, CefRefPtr<CefClient>& client,
+                           CefBrowserSettings& settings, bool* no_javascript_access) override
+        {
+            CEF_REQUIRE_UI_THREAD();
+
+            std::cout << "Page wants to open a popup: " << std::string(target_url) << std::endl;
+
+            return true;
+        };
+
+        void OnAfterCreated(CefRefPtr<CefBrowser> browser) override
+        {
+            CEF_REQUIRE_UI_THREAD();
+
+            mBrowserList.push_back(browser);
+        }
+
+        void OnBeforeClose(CefRefPtr<CefBrowser> browser) override
+        {
+            CEF_REQUIRE_UI_THREAD();
+
+            for (BrowserList::iterator bit = mBrowserList.begin(); bit != mBrowserList.end(); ++bit)
+            {
+                if ((*bit)->IsSame(browser))
+                {
+                    mBrowserList.erase(bit);
+                    break;
+                }
+            }
+
+            if (mBrowserList.empty() && gExitRequested)
+            {
+                gExitFlag = true;
+            }
+        }
+
+        bool hasBrowsers() const
+        {
+            return ! mBrowserList.empty();
+        }
+
+        IMPLEMENT_REFCOUNTING(LifeSpanHandler);
+
+    private:
+        typedef std::list<CefRefPtr<CefBrowser>> BrowserList;
+        BrowserList mBrowserList;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+class BrowserClient :
+    public OffscreenClient
+{
+    public:
+        BrowserClient(RenderHandler* render_handler, LifeSpanHandler* life_span_handler) :
+            OffscreenClient(render_handler, gLocalResources),
+            mLifeSpanHandler(life_span_handler)
+        {
+        }
+
+        CefRefPtr<CefLifeSpanHandler> GetLifeSpanHandler() override
+        {
+            return mLifeSpanHandler;
+        }
+
+        IMPLEMENT_REFCOUNTING(BrowserClient);
+
+    private:
+        CefRefPtr<CefLifeSpanHandler> mLifeSpanHandler;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+class headlessImpl :
+    public CefApp,
+    public CefBrowserProcessHandler
+{
+    public:
+        headlessImpl() :
+            mPumpScheduler(0.0, gMaxPumpDelay)
+        {
+            mLifeSpanHandler = new LifeSpanHandler;
+        }
+
+        bool init(const CefMainArgs& args)
+        {
+            CefSettings settings;
+            initOffscreenSettings(settings, false, true, "cef_opengl_headless.log");
+            settings.no_sandbox = gNoSandbox;
+
+            if (! CefInitialize(args, settings, this, nullptr))
+            {
+                std::cout << "headlessImpl: unable to initialize" << std::endl;
+                return false;
+            }
+
+            // the first pages shouldn't load until their cookies are there - CEF's UI thread is this one
+            // so the import finishes in update()
+            if (! gCookieImportFile.empty())
+            {
+                std::cout << "CookieImport: restoring cookies from " << gCookieImportFile << std::endl;
+                if (importCookies(gCookieImportFile, mCookieStore, loggedCookieTransfer("CookieImport", gCookieBatchSize, [this](const CookieTransferStats& stats)
+                    {
+                        createStartBrowsers();
+                    })))
+                {
+                    return true;
+                }
+                std::cout << "CookieImport: unable to open " << gCookieImportFile << std::endl;
+            }
+
+            createStartBrowsers();
+            return true;
+        }
+
+        void createStartBrowsers()
+        {
+            if (gExitRequested)
+            {
+                return;
+            }
+
+            // the same grid the Windows app tiles its window with
+            int columns = 1;
+            while (columns * columns < gNumBrowsers)
+            {
+                ++columns;
+            }
+            int rows = (gNumBrowsers + columns - 1) / columns;
+
+            for (int i = 0; i < gNumBrowsers; ++i)
+            {
+                int x = (i % columns) * gWidth / columns;
+                int y = (i / columns) * gHeight / rows;
+                int right = (i % columns + 1) * gWidth / columns;
+                int bottom = (i / columns + 1) * gHeight / rows;
+                createBrowser(CefRect(x, y, right - x, bottom - y));
+            }
+
+            std::cout << "headlessImpl: " << gNumBrowsers << " browsers on a " << gWidth << " x " << gHeight << " " << gRenderSurface->name() << " surface" << std::endl;
+        }
+
+        void OnBeforeCommandLineProcessing(const CefString& process_type, CefRefPtr<CefCommandLine> command_line) override
+        {
+            appendOffscreenSwitches(process_type, command_line);
+        }
+
+        CefRefPtr<CefBrowserProcessHandler> GetBrowserProcessHandler() override
+        {
+            return this;
+        }
+
+        void OnScheduleMessagePumpWork(int64 delay_ms) override
+        {
+            mPumpScheduler.scheduleWork(delay_ms);
+        }
+
+        void update()
+        {
+            INSTRUMENT_SCOPE("loop.cef_work");
+
+            mPumpScheduler.beginWork(PumpScheduler::now());
+            CefDoMessageLoopWork();
+            mPumpScheduler.endWork(PumpScheduler::now());
+        }
+
+        PumpScheduler& pumpScheduler()
+        {
+            return mPumpScheduler;
+        }
+
+        // draw every browser where it sits in the grid
+        void render()
+        {
+            INSTRUMENT_SCOPE("frame.draw");
+            gRenderSurface->makeCurrent();
+
+#ifdef HEADLESS_HAVE_EGL
+            if (gRenderSurface->hasGL())
+            {
+                glClear(GL_COLOR_BUFFER_BIT);
+                gQuadRenderer->begin(gRenderSurface->width(), gRenderSurface->height());
+                for (const Browser& entry : mBrowsers)
+                {
+                    float u, v;
+                    entry.renderHandler->textureExtent(u, v);
+                    const CefRect& rect = entry.rect;
+                    gQuadRenderer->add(TexturedQuad(entry.renderHandler->texture(), Rect(rect.x, rect.y, rect.width, rect.height), 0.0f, 0.0f, u, v));
+                }
+                gQuadRenderer->end();
+            }
+#endif
+
+            gRenderSurface->present();
+        }
+
+        // pages CEF has painted across every browser
+        size_t paints() const
+        {
+            size_t total = 0;
+            for (const Browser& entry : mBrowsers)
+            {
+                total += entry.renderHandler->paints();
+            }
+            return total;
+        }
+
+        size_t skippedPaints() const
+        {
+            size_t total = 0;
+            for (const Browser& entry : mBrowsers)
+            {
+                total += entry.renderHandler->skippedPaints();
+            }
+            return total;
+        }
+
+        // the cookies are saved first, if they're wanted, while the browsers are still open
+        void requestExit()
+        {
+            gExitRequested = true;
+
+            if (! gCookieExportFile.empty())
+            {
+                std::cout << "CookieExport: saving cookies to " << gCookieExportFile << std::endl;
+                if (exportCookies(gCookieExportFile, mCookieStore, loggedCookieTransfer("CookieExport", gCookieBatchSize, [this](const CookieTransferStats& stats)
+                    {
+                        closeBrowsers();
+                    })))
+                {
+                    return;
+                }
+                std::cout << "CookieExport: unable to write " << gCookieExportFile << " or read the cookies" << std::endl;
+            }
+
+            closeBrowsers();
+        }
+
+        void closeBrowsers()
+        {
+            for (Browser& entry : mBrowsers)
+            {
+                if (entry.browser && entry.browser->GetHost())
+                {
+                    entry.browser->GetHost()->CloseBrowser(true);
+                }
+            }
+
+            if (! mLifeSpanHandler->hasBrowsers())
+            {
+                gExitFlag = true;
+            }
+        }
+
+        void shutdown()
+        {
+            mBrowsers.clear();
+
+            CefShutdown();
+        }
+
+        IMPLEMENT_REFCOUNTING(headlessImpl);
+
+    private:
+        struct Browser
+        {
+            CefRect rect;
+            CefRefPtr<RenderHandler> renderHandler;
+            CefRefPtr<BrowserClient> browserClient;
+            CefRefPtr<CefBrowser> browser;
+        };
+
+        void createBrowser(const CefRect& rect)
+        {
+            Browser entry;
+            entry.rect = rect;
+            entry.renderHandler = new RenderHandler((int)mBrowsers.size() + 1, rect.width, rect.height);
+            entry.browserClient = new BrowserClient(entry.renderHandler, mLifeSpanHandler);
+
+            CefWindowInfo window_info;
+            initOffscreenWindowInfo(window_info);
+            CefBrowserSettings browser_settings = offscreenBrowserSettings(60);
+
+            entry.browser = CefBrowserHost::CreateBrowserSync(window_info, entry.browserClient.get(), gStartURL, browser_settings, nullptr);
+            mBrowsers.push_back(entry);
+            gRenderScheduler.invalidate();
+        }
+
+        std::vector<Browser> mBrowsers;
+        CefRefPtr<LifeSpanHandler> mLifeSpanHandler;
+        PumpScheduler mPumpScheduler;
+        CefCookieStore mCookieStore;
+};
+
+CefRefPtr<headlessImpl> gHeadlessImpl;
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+// the main loop never sleeps for long so it notices soon enough
+void onSignal(int)
+{
+    gSignalled = true;
+}
+
+std::string argValue(int argc, char* argv[], const char* name, const std::string& default_value)
+{
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (strcmp(argv[i], name) == 0)
+        {
+            return argv[i + 1];
+        }
+    }
+    return default_value;
+}
+
+bool hasArg(int argc, char* argv[], const char* name)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+RenderSurface* createRenderSurface()
+{
+#ifdef HEADLESS_HAVE_EGL
+    if (gSurfaceBackend == "egl")
+    {
+        EGLRenderSurface* surface = new EGLRenderSurface;
+        if (surface->create(gWidth, gHeight))
+        {
+            gQuadRenderer = createQuadRenderer(gRendererName == "modern");
+            return surface;
+        }
+
+        std::cout << "No surfaceless EGL - falling back to the null surface" << std::endl;
+        delete surface;
+    }
+#endif
+    return new NullRenderSurface(gWidth, gHeight);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+int main(int argc, char* argv[])
+{
+    CefMainArgs main_args(argc, argv);
+    gHeadlessImpl = new headlessImpl();
+
+    // renderer, GPU and utility processes run this too and go no further
+    int exit_code = CefExecuteProcess(main_args, gHeadlessImpl.get(), nullptr);
+    if (exit_code >= 0)
+    {
+        return exit_code;
+    }
+
+    gStartURL = argValue(argc, argv, "--url", gStartURL);
+    gNumBrowsers = atoi(argValue(argc, argv, "--browsers", std::to_string(gNumBrowsers)).c_str());
+    gSurfaceBackend = argValue(argc, argv, "--surface", gSurfaceBackend);
+    gRendererName = argValue(argc, argv, "--renderer", gRendererName);
+    gRunSeconds = atof(argValue(argc, argv, "--seconds", std::to_string(gRunSeconds)).c_str());
+    gCaptureTarget = argValue(argc, argv, "--capture", gCaptureTarget);
+    gFrameExport = gFrameExport || hasArg(argc, argv, "--export");
+    gCompositorThreads = atoi(argValue(argc, argv, "--compositor-threads", std::to_string(gCompositorThreads)).c_str());
+    gTileHashSize = atoi(argValue(argc, argv, "--tile-hashing", std::to_string(gTileHashSize)).c_str());
+    gAssetPackFile = argValue(argc, argv, "--asset-pack", gAssetPackFile);
+    gAssetPackOrigin = argValue(argc, argv, "--asset-origin", gAssetPackOrigin);
+    gCookieImportFile = argValue(argc, argv, "--import-cookies", gCookieImportFile);
+    gCookieExportFile = argValue(argc, argv, "--export-cookies", gCookieExportFile);
+    gResourceCacheOrigin = argValue(argc, argv, "--resource-cache-origin", gResourceCacheOrigin);
+    gResourceCacheBytes = (size_t)atoi(argValue(argc, argv, "--resource-cache-mb", std::to_string(gResourceCacheBytes / (1024 * 1024))).c_str()) * 1024 * 1024;
+    gRenderScale = (float)atof(argValue(argc, argv, "--render-scale", std::to_string(gRenderScale)).c_str());
+    gDeviceScaleFactor = (float)atof(argValue(argc, argv, "--device-scale-factor", std::to_string(gDeviceScaleFactor)).c_str());
+    gRenderScaleKeepsLayout = gRenderScaleKeepsLayout || hasArg(argc, argv, "--keep-layout");
+    gThumbnailFormat = imageFormatFromName(argValue(argc, argv, "--thumbnails", imageFormatName(gThumbnailFormat)).c_str());
+    sscanf(argValue(argc, argv, "--size", "").c_str(), "%dx%d", &gWidth, &gHeight);
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    gRenderSurface = createRenderSurface();
+    gJobSystem = new JobSystem(gCompositorThreads);
+
+    gLocalResources = new LocalResources(gResourceCacheBytes, gMaxCachedResponse);
+    gLocalResources->setCacheOrigin(gResourceCacheOrigin);
+    if (! gAssetPackFile.empty() && ! gLocalResources->openPack(gAssetPackFile, gAssetPackOrigin))
+    {
+        std::cout << "Unable to open asset pack " << gAssetPackFile << std::endl;
+    }
+
+    if (! gCaptureTarget.empty())
+    {
+        VideoCaptureSettings capture_settings;
+        capture_settings.frameRate = gCaptureFrameRate;
+        gVideoCapture = new VideoCapture(capture_settings);
+        if (! gVideoCapture->open(gCaptureTarget))
+        {
+            std::cout << "Unable to open " << gCaptureTarget << " for video capture" << std::endl;
+            delete gVideoCapture;
+            gVideoCapture = nullptr;
+        }
+    }
+
+    if (gThumbnailFormat != IMAGE_NONE)
+    {
+        ThumbnailSettings thumbnail_settings;
+        thumbnail_settings.format = gThumbnailFormat;
+        gThumbnailService = new ThumbnailService(thumbnail_settings);
+    }
+
+    PumpScheduler& scheduler = gHeadlessImpl->pumpScheduler();
+    scheduler.setWakeCallback([]()
+    {
+        std::lock_guard<std::mutex> lock(gWakeMutex);
+        gWakeRequested = true;
+        gWakeCondition.notify_all();
+    });
+
+    if (! gHeadlessImpl->init(main_args))
+    {
+        return 1;
+    }
+
+    const double start = PumpScheduler::now();
+    double stats_start = start;
+    double stats_cpu_start = processCpuTime();
+    size_t stats_paints = 0;
+    size_t stats_skipped = 0;
+    size_t stats_presents = 0;
+
+    while (! gExitFlag)
+    {
+        double now = PumpScheduler::now();
+        if (! gExitRequested && (gSignalled || (gRunSeconds > 0.0 && now - start >= gRunSeconds * 1000.0)))
+        {
+            gHeadlessImpl->requestExit();
+        }
+
+        if (scheduler.workDue(now))
+        {
+            gHeadlessImpl->update();
+        }
+
+        if (gRenderScheduler.presentDue(PumpScheduler::now()))
+        {
+            gHeadlessImpl->render();
+            scheduler.frameDone(PumpScheduler::now());
+            gRenderScheduler.presented(PumpScheduler::now());
+        }
+
+        if (gVideoCapture != nullptr)
+        {
+            gVideoCapture->tick(PumpScheduler::now());
+        }
+
+        if (gThumbnailService != nullptr)
+        {
+            gThumbnailService->tick(PumpScheduler::now());
+        }
+
+        // sleep until CEF wants some work doing, a present, capture frame or thumbnail is due or we're signalled
+        now = PumpScheduler::now();
+        double wait = scheduler.timeUntilDue(now);
+        if (gRenderScheduler.timeUntilPresent(now) < wait)
+        {
+            wait = gRenderScheduler.timeUntilPresent(now);
+        }
+        if (gVideoCapture != nullptr && gVideoCapture->timeUntilFrame(now) < wait)
+        {
+            wait = gVideoCapture->timeUntilFrame(now);
+        }
+        if (gThumbnailService != nullptr && gThumbnailService->timeUntilDue(now) < wait)
+        {
+            wait = gThumbnailService->timeUntilDue(now);
+        }
+        wait = wait < gMaxPumpDelay ? wait : gMaxPumpDelay;
+        if (wait > 0.0)
+        {
+            std::unique_lock<std::mutex> lock(gWakeMutex);
+            gWakeCondition.wait_for(lock, std::chrono::microseconds((long long)(wait * 1000.0)), []()
+            {
+                return gWakeRequested;
+            });
+            gWakeRequested = false;
+            scheduler.wokeUp();
+        }
+
+        now = PumpScheduler::now();
+        if (gStatsInterval > 0.0 && now - stats_start >= gStatsInterval * 1000.0)
+        {
+            double seconds = (now - stats_start) / 1000.0;
+            double cpu_seconds = (processCpuTime() - stats_cpu_start) / 1000.0;
+            size_t paints = gHeadlessImpl->paints() - stats_paints;
+            size_t skipped = gHeadlessImpl->skippedPaints() - stats_skipped;
+            size_t presents = gRenderSurface->presents() - stats_presents;
+
+            // CPU time of this process only - CEF's renderer processes are on top
+            std::cout << "HeadlessStats: " << gRenderSurface->name() << " surface - " << paints / seconds << " paints/s, "
+                      << presents / seconds << " presents/s, CPU " << cpu_seconds / seconds * 100.0 << "% of a core, "
+                      << (cpu_seconds > 0.0 ? paints / cpu_seconds : 0.0) << " paints/s per core";
+            if (gTileHashSize > 0)
+            {
+                std::cout << ", " << (paints > 0 ? 100.0 * skipped / paints : 0.0) << "% of paints changed nothing";
+            }
+            std::cout << std::endl;
+
+            stats_start = now;
+            stats_cpu_start = processCpuTime();
+            stats_paints += paints;
+            stats_skipped += skipped;
+            stats_presents += presents;
+        }
+    }
+
+    if (gVideoCapture != nullptr)
+    {
+        gVideoCapture->close();
+        delete gVideoCapture;
+        gVideoCapture = nullptr;
+    }
+
+    if (gThumbnailService != nullptr)
+    {
+        for (int id = 1; id <= gNumBrowsers; ++id)
+        {
+            std::shared_ptr<const Thumbnail> thumbnail = gThumbnailService->latest(id);
+            if (thumbnail && thumbnail->format != IMAGE_NONE)
+            {
+                std::string file_name = "thumbnail_" + std::to_string(id) + "." + imageFormatName(thumbnail->format);
+                FILE* file = fopen(file_name.c_str(), "wb");
+                if (file != nullptr)
+                {
+                    fwrite(thumbnail->encoded.data(), 1, thumbnail->encoded.size(), file);
+                    fclose(file);
+                    std::cout << "Wrote browser " << id << "'s thumbnail to " << file_name << std::endl;
+                }
+            }
+        }
+
+        ThumbnailStats thumbnail_stats = gThumbnailService->stats();
+        std::cout << "ThumbnailStats: " << thumbnail_stats.thumbnails << " thumbnails made, " << thumbnail_stats.deferred << " deferred, "
+                  << (thumbnail_stats.downsampleSeconds > 0.0 ? thumbnail_stats.pixelsDownsampled / thumbnail_stats.downsampleSeconds / 1.0e6 : 0.0) << " Mpixels/s downsampled, "
+                  << (thumbnail_stats.encodeSeconds > 0.0 ? thumbnail_stats.thumbnails / thumbnail_stats.encodeSeconds : 0.0) << " encodes/s" << std::endl;
+        delete gThumbnailService;
+        gThumbnailService = nullptr;
+    }
+
+    gHeadlessImpl->shutdown();
+    gHeadlessImpl = nullptr;
+
+    delete gRenderSurface;
+    gRenderSurface = nullptr;
+
+    LocalResourceStats resource_stats = gLocalResources->stats();
+    std::cout << "ResourceStats: " << resource_stats.packHits << " from the asset pack, " << resource_stats.cache.hits - resource_stats.expired << " from the cache, "
+              << resource_stats.cache.misses + resource_stats.expired << " fetched (" << resource_stats.expired << " gone stale), " << resource_stats.rangeRequests << " range requests, "
+              << resource_stats.cache.entries << " cached (" << resource_stats.cache.bytes / 1024 << "KB), " << resource_stats.cache.evictions << " evicted" << std::endl;
+    delete gLocalResources;
+    gLocalResources = nullptr;
+
+    delete gJobSystem;
+    gJobSystem = nullptr;
+
+    return 0;
+}
@@ -31,124 +31,580 @@
 #include <windowsx.h>
 #include <gl\gl.h>
 
+#include "cef_cookies.h"
+#include "cef_offscreen.h"
+#include "browser_pool.h"
+#include "compositor.h"
+#include "frame_mailbox.h"
+#include "gl_renderer.h"
+#include "gl_upload.h"
+#include "input_queue.h"
+#include "instrument.h"
+#include "job_system.h"
+#include "paint_trace.h"
+#include "pixel_pool.h"
+#include "pump_scheduler.h"
+#include "render_scheduler.h"
+#include "render_surface.h"
+#include "resize_debouncer.h"
+#include "resource_cache.h"
+#include "texture_atlas.h"
+#include "thumbnail_service.h"
+#include "tile_hasher.h"
+#include "video_capture.h"
+#include "visibility_manager.h"
+
+#include <atomic>
+#include <cmath>
+#include <functional>
 #include <iostream>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 HGLRC hRC = 0;
 HDC hDC = 0;
 GLuint gWidth = 800;
 GLuint gHeight = 1200;
-GLuint gDepth = 4;
-CefRect gPopupRect;
-unsigned char* gPagePixels = nullptr;
-unsigned char* gPopupPixels = nullptr;
-bool gExitFlag = false;
-
-const int gNumBrowsers = 1;
+// set from CEF's UI thread when the last browser closes
+std::atomic<bool> gExitFlag(false);
+
+// dirty rects whose union is no more than this fraction bigger than the rects themselves are merged
+double gDamageMergeSlack = 0.25;
+// if there are still more dirty rects than this after merging, upload their bounding box instead
+size_t gMaxDamageRects = 8;
+// CEF often repaints the page with exactly the pixels it sent last time (a paused animation, a cursor change) -
+// hash the page in tiles of gTileHashSize x gTileHashSize and only copy and upload the ones that changed, skipping
+// a paint altogether if none did. Costs a pass over the dirty pixels every paint so it's off (0) by default - the
+// paint stats show how many paints it would skip and what the hashing costs, and tile_dedup_bench compares the two
+int gTileHashSize = 0;
+// keep popups (e.g. <select> dropdowns) in a texture of their own and draw them over the page instead
+// of compositing them into the page pixels - page and popup paints both upload straight from CEF's
+// buffer and a change in the popup only uploads the popup
+bool gLayeredPopups = true;
+// blend popups over the page instead of drawing them on top (in GL for popup layers, on the CPU
+// otherwise) - only needed for translucent popups
+bool gBlendPopups = false;
+// how often (in frames) to write out the paint stats - 0 to turn off
+size_t gPaintStatsInterval = 300;
+// DIRECT uploads to the texture synchronously in OnPaint, PBO_RING hands the pixels to the
+// GPU through a ring of gNumUploadBuffers pixel buffer objects so the transfer can overlap.
+// PBO_RING only pays off where the driver can DMA from the buffer - with a software renderer
+// (e.g. Mesa llvmpipe) it is an extra copy, see gl_upload_bench
+GLUploadBackend::Mode gUploadMode = GLUploadBackend::DIRECT;
+int gNumUploadBuffers = 3;
+// pack every browser into a few big textures and draw them all with one draw call per texture
+// instead of a texture and a draw call each - worth it with lots of small browsers
+bool gUseTextureAtlas = false;
+int gAtlasPageSize = 4096;
+TextureAtlas* gTextureAtlas = nullptr;
+// draw the browsers with a shader and instanced draws (see gl_renderer.h) instead of immediate mode - falls
+// back to immediate mode if the context can't. Textures then hold CEF's BGRA bytes as they are and the
+// shader swaps the channels back. gl_renderer_bench compares the two
+bool gModernRenderer = true;
+QuadRenderer* gQuadRenderer = nullptr;
+// big page copies and popup blits (512KB and up - a resize or a full repaint of a big browser) are split into
+// bands of rows and shared out over gCompositorThreads threads, counting CEF's (see job_system.h) - 0 for one
+// per core, 1 does them all on CEF's thread
+int gCompositorThreads = 0;
+JobSystem* gJobSystem = nullptr;
+// if set, every call CEF makes to the render handler is recorded here so it can be replayed by paint_bench
+std::string gPaintTraceFile = "";
+// publish every frame each browser paints to shared memory for other processes (see frame_ring.h) - browser
+// <id> goes to gFrameExportName_<id>. Frames bigger than gFrameExportMaxWidth x gFrameExportMaxHeight are
+// skipped and a reader that's more than gFrameExportSlots frames behind loses the oldest ones. Popup
+// layers aren't in the exported frames - turn off gLayeredPopups to have them composited into the page
+bool gFrameExport = false;
+std::string gFrameExportName = "cef_opengl_frames";
+int gFrameExportMaxWidth = 2560;
+int gFrameExportMaxHeight = 1600;
+int gFrameExportSlots = 3;
+// stream browser gCaptureBrowser to a Y4M video (see video_capture.h) - a file name, "-" for stdout or
+// "|command" to pipe it to an encoder, e.g. "|ffmpeg -y -i - capture.mp4". Empty is off. Frames where
+// nothing changed are written again without converting them and when the conversion workers fall
+// gCaptureMaxQueued frames behind, frames are dropped rather than holding up painting
+std::string gCaptureTarget = "";
+double gCaptureFrameRate = 30.0;
+int gCaptureWorkers = 0;
+int gCaptureMaxQueued = 4;
+int gCaptureBrowser = 1;
+VideoCapture* gVideoCapture = nullptr;
+// browsers paint gRenderScale of their size in each direction (see render_scale.h) - 0.5 is a quarter of the
+// pixels for a browser shown as a small tile. R cycles the focused browser through 1, 0.5 and 0.25.
+// gDeviceScaleFactor is the one we tell CEF the screen has and gRenderScaleKeepsLayout lowers that rather
+// than the size of the view, so the page lays out the same at any scale
+float gRenderScale = 1.0f;
+float gDeviceScaleFactor = 1.0f;
+bool gRenderScaleKeepsLayout = false;
+// keep a thumbnail of every browser (see thumbnail_service.h) - gThumbnailLevels halvings of the page at most
+// every gThumbnailInterval milliseconds, made on a worker thread. The smallest is encoded as gThumbnailFormat
+// and T writes the focused browser's to a file
+bool gThumbnails = false;
+int gThumbnailLevels = 3;
+double gThumbnailInterval = 250.0;
+ImageFormat gThumbnailFormat = IMAGE_PNG;
+ThumbnailService* gThumbnailService = nullptr;
+
+// EXTERNAL_PUMP sleeps until CEF asks for work (through OnScheduleMessagePumpWork) or the next frame
+// is due, BUSY_LOOP calls CefDoMessageLoopWork() as often as it can and keeps a core busy even when idle.
+// MULTI_THREADED leaves CEF to run its own UI thread - paints are copied into a FrameMailbox there and
+// this thread only uploads the newest frame of each browser and draws, input is posted over to CEF's
+// thread. Layered popups aren't supported (gLayeredPopups is ignored) - popups are composited into the
+// page on CEF's thread
+enum MessagePumpMode
+{
+    BUSY_LOOP,
+    EXTERNAL_PUMP,
+    MULTI_THREADED
+};
+MessagePumpMode gMessagePumpMode = EXTERNAL_PUMP;
+// how often the external pump redraws the window when it isn't presenting on damage (milliseconds)
+double gFrameInterval = 1000.0 / 60.0;
+// CEF expects to be pumped at least this often even if it doesn't ask (milliseconds)
+double gMaxPumpDelay = 1000.0 / 30.0;
+// only draw and present the window when a browser painted something or the window needs it, and no
+// more often than every gPresentInterval milliseconds - false redraws every frame whether anything changed or not
+bool gPresentOnDamage = true;
+double gPresentInterval = 1000.0 / 60.0;
+RenderScheduler gRenderScheduler(gPresentInterval);
+// how often (in seconds) to write out CPU usage, input to paint latency and frame stats - 0 to turn off
+double gPumpStatsInterval = 10.0;
+// posted to the window to wake up the main loop when CEF wants work done sooner than it expected, or
+// (MULTI_THREADED) when a browser has painted a frame
+const UINT WM_PUMP_WORK = WM_USER + 1;
+std::function<void()> gWakeMainLoop;
+// MULTI_THREADED - CPU time CEF's UI thread has used, sampled on that thread for the pump stats
+std::atomic<double> gCefThreadCpuTime(0.0);
+// mouse moves and wheel deltas are merged and sent to the browsers once a browser has painted since
+// the last lot, or after gInputInterval milliseconds if none has (button presses go straight away) -
+// 0 sends every event as it arrives
+double gInputInterval = 1000.0 / 60.0;
+InputQueue gInputQueue(gInputInterval);
+// time from input arriving at the window to the next paint of the browser it went to
+InputLatencyMatcher gInputLatency;
+
+// while the window is being resized a browser is only told its new size once it has stayed the same for
+// gResizeQuietTime milliseconds, or gResizeMaxDelay after the first change so a slow drag still repaints -
+// until then the old page is stretched to fit
+double gResizeQuietTime = 50.0;
+double gResizeMaxDelay = 100.0;
+// let the window be resized by dragging its edges
+bool gResizableWindow = true;
+// keeps the browsers going while Windows is busy resizing the window
+const UINT_PTR kResizeTimer = 1;
+// page buffers of 4MB and up ask for large pages (see PixelPool::setHugePages()) - Windows only hands
+// them out with the "Lock pages in memory" privilege, otherwise normal pages are used
+bool gHugePagePixels = false;
+
+// time the paint path, message loop, drawing and input handlers (see instrument.h) - the histograms
+// are written out with the pump stats and, if gInstrumentTraceFile is set, every event is kept and
+// written out as a Chrome trace (chrome://tracing) when the app exits
+bool gInstrumentation = true;
+std::string gInstrumentTraceFile = "";
+// how often (in milliseconds) to empty the per-thread event rings - they hold 32768 events each
+double gInstrumentCollectInterval = 250.0;
+// the trace stops growing after this many events
+size_t gMaxTraceEvents = 4 * 1024 * 1024;
+
+// browsers created at startup - more can be created and destroyed at runtime through BrowserManager
+int gNumBrowsers = 1;
+// set once we've been asked to quit - the main loop exits when the last browser has closed
+std::atomic<bool> gExitRequested(false);
 CefString gStartURL = "https://sl-viewer-media-system.s3-us-west-2.amazonaws.com/index.html";
 //CefString gStartURL = "http://community.secondlife.com/t5/Featured-News/bg-p/blog_feature_news";
+// GETs are answered from memory where we can (see cef_resources.h) - anything under gAssetPackOrigin from
+// the asset pack in gAssetPackFile (made with make_asset_pack, empty for none) and anything under
+// gResourceCacheOrigin from the last gResourceCacheBytes of responses fetched that said they could be kept,
+// none bigger than gMaxCachedResponse. An empty origin or 0 bytes turns the cache off
+std::string gAssetPackFile = "";
+std::string gAssetPackOrigin = "https://sl-viewer-media-system.s3-us-west-2.amazonaws.com/";
+std::string gResourceCacheOrigin = "https://sl-viewer-media-system.s3-us-west-2.amazonaws.com/";
+size_t gResourceCacheBytes = 64 * 1024 * 1024;
+size_t gMaxCachedResponse = 8 * 1024 * 1024;
+LocalResources* gLocalResources = nullptr;
+// cookies (JSON lines, see cookie_store.h) restored from gCookieImportFile before the first browsers are created
+// - empty for none - and saved to gCookieExportFile when E is pressed. The cookie store is flushed once every
+// gCookieBatchSize cookies rather than once per cookie
+std::string gCookieImportFile = "";
+std::string gCookieExportFile = "cookies.jsonl";
+size_t gCookieBatchSize = 500;
+// browsers created ahead of time and kept hidden on about:blank (see browser_pool.h) - a new browser is
+// taken from here if there's one ready, and a closed one that never went anywhere goes back in. 0 turns
+// the pool off and every browser is created from nothing
+int gBrowserPoolSize = 2;
+// when we started, for the time to the first browsers painting
+double gLaunchTime = 0.0;
+// browsers that are off screen or in a minimized window are suspended with WasHidden() and ones in a window
+// that's behind another, or mostly off screen, paint at gBackgroundFrameRate (see visibility_manager.h) -
+// false paints every browser at the full rate all the time
+bool gVisibilityThrottling = true;
+int gBackgroundFrameRate = 5;
+// set from the window's messages
+bool gWindowMinimized = false;
+bool gWindowActive = true;
 
 /////////////////////////////////////////////////////////////////////////////////
-//
-class RenderHandler :
-    public CefRenderHandler
+// the GL objects of browsers that have gone. CEF lets go of a RenderHandler on
+// whatever thread it likes - its own UI thread with MULTI_THREADED, where there
+// is no GL context - so the handler hands its textures and upload backends over
+// here and the main loop deletes them with release()
+class GLGarbage
 {
     public:
-        bool GetViewRect(CefRefPtr<CefBrowser> browser, CefRect& rect) override
+        void add(GLuint texture)
         {
-            CEF_REQUIRE_UI_THREAD();
+            if (texture != 0)
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mTextures.push_back(texture);
+            }
+        }
 
-            rect = CefRect(0, 0, gWidth, gHeight);
-            return true;
+        void add(std::unique_ptr<UploadBackend> backend)
+        {
+            if (backend)
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mBackends.push_back(std::move(backend));
+            }
         }
 
-        void OnPaint(CefRefPtr<CefBrowser> browser, PaintElementType type, const RectList& dirtyRects, const void* buffer, int width, int height) override
+        // main thread with the context current
+        void release()
         {
-            CEF_REQUIRE_UI_THREAD();
+            std::vector<GLuint> textures;
+            std::vector<std::unique_ptr<UploadBackend>> backends;
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                textures.swap(mTextures);
+                backends.swap(mBackends);
+            }
+
+            if (! textures.empty())
+            {
+                glDeleteTextures((GLsizei)textures.size(), textures.data());
+            }
+            // their destructors delete their textures and pixel buffers, or give back their space in the atlas
+            backends.clear();
+        }
+
+    private:
+        std::mutex mMutex;
+        std::vector<GLuint> mTextures;
+        std::vector<std::unique_ptr<UploadBackend>> mBackends;
+};
+GLGarbage gGLGarbage;
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+class RenderHandler :
+    public OffscreenRenderHandler
+{
+    public:
+        RenderHandler(int id, int width, int height) :
+            OffscreenRenderHandler(id, width, height, createUploadBackend(width, height), gMessagePumpMode != MULTI_THREADED,
+                                   gRenderScale, gDeviceScaleFactor, gRenderScaleKeepsLayout),
+            mTexture(gTextureAtlas || textureLayout() == TEXTURE_SWIZZLED ? 0 : createPageTexture(width, height, TEXTURE_BGRA)),
+            mPopupTexture(0),
+            mUploadWidth(width),
+            mUploadHeight(height)
+        {
+            mCompositor.setDamageMergeSlack(gDamageMergeSlack);
+            mCompositor.setMaxDamageRects(gMaxDamageRects);
+            mCompositor.setPopupBlending(gBlendPopups);
+            mCompositor.setJobSystem(gJobSystem);
+            mCompositor.setTileHashing(gTileHashSize);
+            setPaintStatsInterval(gPaintStatsInterval);
+
+            // popups are small and short lived - a texture that is sized when the popup first paints is plenty
+            if (gLayeredPopups && gMessagePumpMode != MULTI_THREADED)
+            {
+                mPopupTexture = (textureLayout() == TEXTURE_BGRA) ? createPageTexture(1, 1, TEXTURE_BGRA) : 0;
+                mPopupUploadBackend.reset(new GLUploadBackend(1, 1, GLUploadBackend::DIRECT, 1, true, textureLayout()));
+                mCompositor.setPopupLayer(mPopupUploadBackend.get());
+            }
 
-            // whole page was updated
-            if (type == PET_VIEW)
+            if (! gPaintTraceFile.empty())
             {
-                // make a buffer for whole page if not there already and copy in pixels
-                if (gPagePixels == nullptr)
+                mPaintTrace.open(gPaintTraceFile + "." + std::to_string(id));
+            }
+
+            if (gFrameExport)
+            {
+                std::string name = gFrameExportName + "_" + std::to_string(id);
+                if (exportFrames(name, gFrameExportMaxWidth, gFrameExportMaxHeight, gFrameExportSlots))
                 {
-                    gPagePixels = new unsigned char[width * height * gDepth];
+                    std::cout << "RenderHandler: browser " << id << " frames are published to " << name << std::endl;
                 }
-                memcpy(gPagePixels, buffer, width * height * gDepth);
-
-                // if there is still a popup open, write it into the page too (it's pixels will have been
-                // copied into it's buffer by a call to OnPaint with type of PET_POPUP earlier)
-                if (gPopupPixels != nullptr)
+                else
                 {
-                    unsigned char* dst = gPagePixels + gPopupRect.y * gWidth * gDepth + gPopupRect.x * gDepth;
-                    unsigned char* src = (unsigned char*)gPopupPixels;
-                    while (src < (unsigned char*)gPopupPixels + gPopupRect.width * gPopupRect.height * gDepth)
-                    {
-                        memcpy(dst, src, gPopupRect.width * gDepth);
-                        src += gPopupRect.width * gDepth;
-                        dst += gWidth * gDepth;
-                    }
+                    std::cout << "RenderHandler: unable to create shared memory " << name << " for browser " << id << std::endl;
                 }
+            }
+        }
+
+        // this can be on CEF's thread - nothing here touches GL (see GLGarbage)
+        ~RenderHandler()
+        {
+            gGLGarbage.add(mTexture);
+            gGLGarbage.add(mPopupTexture);
+            gGLGarbage.add(std::move(mUploadBackend));
+            gGLGarbage.add(std::move(mPopupUploadBackend));
+        }
+
+        // own texture when we're not in the atlas - the upload backend makes it with TEXTURE_SWIZZLED
+        GLuint texture() const
+        {
+            return mTexture != 0 ? mTexture : ((const GLUploadBackend*)mUploadBackend.get())->texture();
+        }
+
+        // where we are in the atlas when we are
+        int atlasHandle() const
+        {
+            return gTextureAtlas ? ((AtlasUploadBackend*)mUploadBackend.get())->handle() : -1;
+        }
+
+        // how much of our own texture the page fills - textures grow in steps so they can be bigger
+        void textureExtent(float& u, float& v) const
+        {
+            backendExtent(mUploadBackend.get(), u, v);
+        }
+
+        // the popup's texture, how much of it the popup fills and where it goes in the window if there
+        // is a popup layer to draw - page_rect is where the page is drawn, and the popup is scaled with it
+        bool popupLayer(const Rect& page_rect, GLuint& texture, Rect& rect, float& u, float& v) const
+        {
+            if (! mPopupUploadBackend || ! mCompositor.popupVisible() || mCompositor.popupRect().isEmpty() || mCompositor.width() <= 0 || mCompositor.height() <= 0)
+            {
+                return false;
+            }
+
+            texture = mPopupTexture != 0 ? mPopupTexture : ((const GLUploadBackend*)mPopupUploadBackend.get())->texture();
+            const Rect& popup_rect = mCompositor.popupRect();
+            const double scale_x = (double)page_rect.width / mCompositor.width();
+            const double scale_y = (double)page_rect.height / mCompositor.height();
+            rect = Rect(page_rect.x + (int)(popup_rect.x * scale_x), page_rect.y + (int)(popup_rect.y * scale_y), (int)std::ceil(popup_rect.width * scale_x), (int)std::ceil(popup_rect.height * scale_y));
+            backendExtent(mPopupUploadBackend.get(), u, v);
+            return true;
+        }
+
+        // everything this browser holds on to for rendering - CPU side pixels plus texture and pixel buffers
+        size_t memoryUsage() const
+        {
+            size_t bytes = mCompositor.memoryUsage() + mUploadBackend->memoryUsage() + mMailbox.memoryUsage();
+            if (mPopupUploadBackend)
+            {
+                bytes += mPopupUploadBackend->memoryUsage();
+            }
+            return bytes;
+        }
 
+        // MULTI_THREADED only - upload the newest frame CEF's thread has painted since the last call, if
+        // there is one, and do what painted() does on the main thread the rest of the time
+        bool takeFrame(double now)
+        {
+            const MailboxFrame* frame = mMailbox.take();
+            if (frame == nullptr)
+            {
+                return false;
             }
-            // popup was updated
-            else if (type == PET_POPUP)
+
+            INSTRUMENT_SCOPE("frame.take");
+            if (mTexture != 0)
             {
-                std::cout << "OnPaint() for popup: " << width << " x " << height << " at " << gPopupRect.x << " x " << gPopupRect.y << std::endl;
+                glBindTexture(GL_TEXTURE_2D, mTexture);
+            }
 
-                // copy over the popup pixels into it's buffer
-                // (popup buffer created in onPopupSize() as we know the size there)
-                memcpy(gPopupPixels, buffer, width * height * gDepth);
+            if (frame->width != mUploadWidth || frame->height != mUploadHeight)
+            {
+                mUploadBackend->resize(frame->width, frame->height);
+                mUploadWidth = frame->width;
+                mUploadHeight = frame->height;
+            }
 
-                // copy over popup pixels into page pixels. We need this for when popup is changing (e.g. highlighting or scrolling)
-                // when the containing page is not changing and therefore doesn't get an OnPaint update
-                unsigned char* src = (unsigned char*)gPopupPixels;
-                unsigned char* dst = gPagePixels + gPopupRect.y * gWidth * gDepth + gPopupRect.x * gDepth;
-                while (src < (unsigned char*)gPopupPixels + gPopupRect.width * gPopupRect.height * gDepth)
+            {
+                INSTRUMENT_SCOPE("paint.upload");
+                mUploadBackend->beginUpload();
+                for (const Rect& rect : frame->damage)
                 {
-                    memcpy(dst, src, gPopupRect.width * gDepth);
-                    src += gPopupRect.width * gDepth;
-                    dst += gWidth * gDepth;
+                    mUploadBackend->upload(rect, frame->pixels() + ((size_t)rect.y * frame->width + rect.x) * kDepth, frame->width);
                 }
+                mUploadBackend->endUpload();
             }
 
-            // write the final composited buffer into our OpenGL texture
-            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gWidth, gHeight, GL_BGRA_EXT, GL_UNSIGNED_BYTE, gPagePixels);
+            // latency is measured to us picking the frame up - a frame CEF painted before the input
+            // arrived can still be waiting here, and it's when we have it that counts for the screen
+            gInputLatency.painted(id(), now);
+            gInputQueue.painted();
+            frameReady(frame->pixels(), frame->width, frame->height, frame->damage, now);
+            return true;
+        }
+
+        MailboxStats mailboxStats() const
+        {
+            return mMailbox.stats();
         }
 
-        void OnPopupShow(CefRefPtr<CefBrowser> browser, bool show) override
+        IMPLEMENT_REFCOUNTING(RenderHandler);
+
+    protected:
+        void paintStarted(PaintElementType type, const ::RectList& dirty_rects, int width, int height) override
+        {
+            PaintEvent event;
+            event.type = (type == PET_VIEW) ? PaintEvent::VIEW : PaintEvent::POPUP;
+            event.width = width;
+            event.height = height;
+            event.dirtyRects = dirty_rects;
+            mPaintTrace.write(event);
+
+            // MULTI_THREADED - takeFrame() has it when the frame gets to the main thread
+            if (type == PET_VIEW && gMessagePumpMode != MULTI_THREADED)
+            {
+                gInputLatency.painted(id(), PumpScheduler::now());
+                gInputQueue.painted();
+            }
+        }
+
+        // MULTI_THREADED - there's no GL context on this thread, the compositor only composites and
+        // takeFrame() does the rest on the main thread. The atlas backend binds the right page itself.
+        // Paints are dropped once we're on our way out - nothing draws them
+        bool bindTexture(PaintElementType type) override
+        {
+            if (gExitRequested)
+            {
+                return false;
+            }
+
+            if (gMessagePumpMode == MULTI_THREADED)
+            {
+                return true;
+            }
+
+            if (type == PET_POPUP && mPopupTexture != 0)
+            {
+                glBindTexture(GL_TEXTURE_2D, mPopupTexture);
+            }
+            else if (mTexture != 0)
+            {
+                glBindTexture(GL_TEXTURE_2D, mTexture);
+            }
+            return true;
+        }
+
+        void painted(const unsigned char* pixels, const ::RectList& damage) override
+        {
+            if (gMessagePumpMode == MULTI_THREADED)
+            {
+                mMailbox.publish(pixels, mCompositor.width(), mCompositor.height(), damage, PumpScheduler::now());
+                gWakeMainLoop();
+            }
+            else
+            {
+                frameReady(pixels, mCompositor.width(), mCompositor.height(), damage, PumpScheduler::now());
+            }
+        }
+
+        void popupShown(bool show) override
         {
-            CEF_REQUIRE_UI_THREAD();
             std::cout << "CefRenderHandler::OnPopupShow(" << (show ? "true" : "false") << ")" << std::endl;
 
-            if (! show)
+            PaintEvent event;
+            event.type = PaintEvent::POPUP_SHOW;
+            event.show = show;
+            mPaintTrace.write(event);
+
+            // a popup layer appears or disappears without the page painting - with MULTI_THREADED there are
+            // no popup layers and the render scheduler isn't ours to touch from this thread
+            if (gMessagePumpMode != MULTI_THREADED)
             {
-                delete gPopupPixels;
-                gPopupPixels = nullptr;
-                gPopupRect.Reset();
+                gRenderScheduler.invalidate();
             }
         }
 
-        void OnPopupSize(CefRefPtr<CefBrowser> browser, const CefRect& rect) override
+        void popupSized(const Rect& rect) override
         {
-            CEF_REQUIRE_UI_THREAD();
             std::cout << "CefRenderHandler::OnPopupSize(" << rect.width << " x " << rect.height << ") at " << rect.x << ", " << rect.y << std::endl;
 
-            gPopupRect = rect;
+            PaintEvent event;
+            event.type = PaintEvent::POPUP_SIZE;
+            event.popupRect = rect;
+            mPaintTrace.write(event);
+        }
+
+    private:
+        // the page changed on the main thread - pixels is nullptr when only a popup layer did
+        void frameReady(const unsigned char* pixels, int width, int height, const ::RectList& damage, double now)
+        {
+            gRenderScheduler.damage(now);
+            if (pixels == nullptr)
+            {
+                return;
+            }
+            if (gVideoCapture != nullptr && id() == gCaptureBrowser)
+            {
+                gVideoCapture->damage(pixels, width, height, damage);
+            }
+            if (gThumbnailService != nullptr)
+            {
+                gThumbnailService->damage(id(), pixels, width, height, damage);
+            }
+        }
+
+        // the textures the renderer can draw
+        static TextureLayout textureLayout()
+        {
+            return gQuadRenderer ? gQuadRenderer->layout() : TEXTURE_BGRA;
+        }
 
-            if (gPopupPixels == nullptr)
+        static void backendExtent(const UploadBackend* backend, float& u, float& v)
+        {
+            const GLUploadBackend* gl_backend = (const GLUploadBackend*)backend;
+            u = 1.0f;
+            v = 1.0f;
+            if (gl_backend && gl_backend->textureWidth() > 0 && gl_backend->textureHeight() > 0)
             {
-                gPopupPixels = new unsigned char[rect.width * rect.height * gDepth];
+                u = (float)gl_backend->width() / gl_backend->textureWidth();
+                v = (float)gl_backend->height() / gl_backend->textureHeight();
             }
         }
 
-        IMPLEMENT_REFCOUNTING(RenderHandler);
+        static UploadBackend* createUploadBackend(int width, int height)
+        {
+            if (gTextureAtlas)
+            {
+                return new AtlasUploadBackend(gTextureAtlas, width, height);
+            }
+            return new GLUploadBackend(width, height, gUploadMode, gNumUploadBuffers, true, textureLayout());
+        }
+
+        GLuint mTexture;
+        GLuint mPopupTexture;
+        std::unique_ptr<UploadBackend> mPopupUploadBackend;
+        // MULTI_THREADED - frames CEF's thread composited on their way to takeFrame()
+        FrameMailbox mMailbox;
+        int mUploadWidth;
+        int mUploadHeight;
+        PaintTraceWriter mPaintTrace;
 };
 
 class LifeSpanHandler :
     public CefLifeSpanHandler
 {
     public:
+        LifeSpanHandler() :
+            mNumBrowsers(0),
+            mNumCreating(0)
+        {
+        }
+
+        // a browser's been asked for and CEF will create it soon (OnAfterCreated()) - any thread
+        void creating()
+        {
+            ++mNumCreating;
+        }
+
         bool OnBeforePopup(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame,
                            const CefString& target_url, const CefString& target_frame_name,
                            CefLifeSpanHandler::WindowOpenDisposition target_disposition,
@@ -168,6 +624,8 @@ class LifeSpanHandler :
             CEF_REQUIRE_UI_THREAD();
 
             mBrowserList.push_back(browser);
+            mNumBrowsers.store((int)mBrowserList.size());
+            --mNumCreating;
         }
 
         void OnBeforeClose(CefRefPtr<CefBrowser> browser) override
@@ -183,47 +641,89 @@ class LifeSpanHandler :
                     break;
                 }
             }
+            mNumBrowsers.store((int)mBrowserList.size());
 
-            if (mBrowserList.empty())
+            // browsers come and go at runtime - only quit once we've been asked to and the last one has gone
+            if (mBrowserList.empty() && mNumCreating.load() == 0 && gExitRequested)
             {
                 gExitFlag = true;
             }
         }
 
+        // any thread - ones on their way count
+        bool hasBrowsers() const
+        {
+            return mNumBrowsers.load() > 0 || mNumCreating.load() > 0;
+        }
+
         IMPLEMENT_REFCOUNTING(LifeSpanHandler);
 
     private:
         typedef std::list<CefRefPtr<CefBrowser>> BrowserList;
         BrowserList mBrowserList;
+        std::atomic<int> mNumBrowsers;
+        std::atomic<int> mNumCreating;
 };
 
 /////////////////////////////////////////////////////////////////////////////////
-//
+// browsers are created asynchronously - the client holds on to its browser when
+// CEF creates it and BrowserManager picks it up from the main thread
 class BrowserClient :
-    public CefClient,
-    public CefRequestHandler,
+    public OffscreenClient,
+    public CefLifeSpanHandler,
     public CefLoadHandler
 {
     public:
-        BrowserClient(RenderHandler* render_handler) :
-            mRenderHandler(render_handler)
+        BrowserClient(RenderHandler* render_handler, LifeSpanHandler* life_span_handler) :
+            OffscreenClient(render_handler, gLocalResources),
+            mLifeSpanHandler(life_span_handler),
+            mBlankLoaded(false)
         {
-            mLifeSpanHandler = new LifeSpanHandler;
         }
 
-        CefRefPtr<CefRenderHandler> GetRenderHandler() override
+        CefRefPtr<CefLifeSpanHandler> GetLifeSpanHandler() override
         {
-            return mRenderHandler;
+            return this;
         }
 
-        CefRefPtr<CefLifeSpanHandler> GetLifeSpanHandler() override
+        // the shared life span handler keeps track of every browser
+        bool OnBeforePopup(CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame,
+                           const CefString& target_url, const CefString& target_frame_name,
+                           CefLifeSpanHandler::WindowOpenDisposition target_disposition,
+                           bool user_gesture, const CefPopupFeatures& popupFeatures,
+                           CefWindowInfo& windowInfo, CefRefPtr<CefClient>& client,
+                           CefBrowserSettings& settings, bool* no_javascript_access) override
         {
-            return mLifeSpanHandler;
+            return mLifeSpanHandler->OnBeforePopup(browser, frame, target_url, target_frame_name, target_disposition, user_gesture,
+                                                   popupFeatures, windowInfo, client, settings, no_javascript_access);
         }
 
-        CefRefPtr<CefRequestHandler> GetRequestHandler() override
+        void OnAfterCreated(CefRefPtr<CefBrowser> browser) override
         {
-            return this;
+            mLifeSpanHandler->OnAfterCreated(browser);
+
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCreated = browser;
+        }
+
+        void OnBeforeClose(CefRefPtr<CefBrowser> browser) override
+        {
+            mLifeSpanHandler->OnBeforeClose(browser);
+        }
+
+        // the browser, once, after CEF has created it - main thread
+        CefRefPtr<CefBrowser> takeCreated()
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            CefRefPtr<CefBrowser> browser = mCreated;
+            mCreated = nullptr;
+            return browser;
+        }
+
+        // about:blank has finished loading since last time - main thread
+        bool takeBlankLoaded()
+        {
+            return mBlankLoaded.exchange(false);
         }
 
         bool OnOpenURLFromTab(CefRefPtr<CefBrowser> browser,
@@ -268,6 +768,11 @@ class BrowserClient :
             if (frame->IsMain())
             {
                 std::cout << "Loading started" << std::endl;
+
+                if (std::string(frame->GetURL()) != "about:blank")
+                {
+                    mRenderHandler->pageStarted();
+                }
             }
         }
 
@@ -282,207 +787,1051 @@ class BrowserClient :
                 const std::string url = frame->GetURL();
 
                 std::cout << "Load ended for URL: " << url << " with HTTP status code: " << httpStatusCode << std::endl;
+
+                if (url == "about:blank")
+                {
+                    mBlankLoaded.store(true);
+                }
             }
         }
 
         IMPLEMENT_REFCOUNTING(BrowserClient);
 
     private:
-        CefRefPtr<CefRenderHandler> mRenderHandler;
-        CefRefPtr<CefLifeSpanHandler> mLifeSpanHandler;
+        CefRefPtr<LifeSpanHandler> mLifeSpanHandler;
+
+        std::mutex mMutex;
+        CefRefPtr<CefBrowser> mCreated;
+        std::atomic<bool> mBlankLoaded;
 };
 
 /////////////////////////////////////////////////////////////////////////////////
-//
-class cefImpl :
-    public CefApp
+// owns every browser along with its render handler (and therefore its pixels
+// and texture) and where it is drawn in the window. Browsers can be created and
+// destroyed at any time - input is routed to whichever one is under the mouse.
+// CEF creates browsers asynchronously, so a new one can take a while to turn up
+// (see update()) - a few are kept ready in a pool, hidden on about:blank, and
+// handed out first
+class BrowserManager
 {
     public:
-        bool cefImpl::init()
+        BrowserManager() :
+            mNextId(1),
+            mFocusedId(0),
+            mCaptureId(0),
+            mPool(gBrowserPoolSize > 0 ? (size_t)gBrowserPoolSize : 0),
+            mVisibility(visibilitySettings())
         {
+            mLifeSpanHandler = new LifeSpanHandler;
+        }
 
-            CefMainArgs args(GetModuleHandle(NULL));
-
-            CefSettings settings;
-            settings.multi_threaded_message_loop = false;
-
-            CefString(&settings.log_file) = "cef_opengl_win.log";
-            settings.log_severity = LOGSEVERITY_DEFAULT;
-
-            if (CefInitialize(args, settings, this, NULL))
+        // returns the id used to refer to the browser from now on - rect is in window coordinates. A
+        // pooled browser only has to be shown, resized and pointed at url
+        int createBrowser(const std::string& url, const CefRect& rect)
+        {
+            Browser entry;
+            int pooled_id = mPool.acquire();
+            if (pooled_id != 0)
             {
-                std::cout << "cefImpl: initialized okay" << std::endl;
-
-                for (int i = 0; i < gNumBrowsers; ++i)
+                entry = takeParked(pooled_id);
+                entry.rect = rect;
+                entry.renderHandler->setSize(rect.width, rect.height);
+                entry.renderHandler->setRenderScale(gRenderScale);
+
+                CefRefPtr<CefBrowser> browser = entry.browser;
+                int frame_rate = mVisibility.frameRate(VISIBILITY_VISIBLE);
+                runOnUIThread([browser, url, frame_rate]()
                 {
-                    mRenderHandler[i] = new RenderHandler();
-
-                    mBrowserClient[i] = new BrowserClient(mRenderHandler[i]);
-
-                    CefWindowInfo window_info;
-                    window_info.windowless_rendering_enabled = true;
-
-                    CefBrowserSettings browser_settings;
-                    browser_settings.windowless_frame_rate = 60;
-                    browser_settings.background_color = 0xffff0000;
-
-                    mBrowser[i] = CefBrowserHost::CreateBrowserSync(window_info, mBrowserClient[i].get(), gStartURL, browser_settings, nullptr);
-                }
-
-                return true;
+                    browser->GetHost()->SetWindowlessFrameRate(frame_rate);
+                    browser->GetHost()->WasHidden(false);
+                    browser->GetHost()->NotifyScreenInfoChanged();
+                    browser->GetHost()->WasResized();
+                    browser->GetMainFrame()->LoadURL(url);
+                });
+            }
+            else
+            {
+                entry = newBrowser(url, rect);
             }
 
-            std::cout << "cefImpl: Unable to initialize" << std::endl;
-            return false;
-        }
+            entry.requested = PumpScheduler::now();
+            entry.pooled = (pooled_id != 0);
+            entry.painted = false;
+            entry.renderHandler->expectFirstPaint();
 
-        void OnBeforeCommandLineProcessing(const CefString& process_type, CefRefPtr<CefCommandLine> command_line) override
-        {
-            if (process_type.empty())
+            mBrowsers.push_back(entry);
+            mVisibility.add(entry.id, Rect(rect.x, rect.y, rect.width, rect.height));
+            gRenderScheduler.invalidate();
+            if (mFocusedId == 0)
             {
-                command_line->AppendSwitch("disable-gpu");
-                command_line->AppendSwitch("disable-gpu-compositing");
+                mFocusedId = entry.id;
             }
-        }
 
-        void update()
-        {
-            CefDoMessageLoopWork();
+            std::cout << "BrowserManager: " << (entry.pooled ? "took browser " : "creating browser ") << entry.id << (entry.pooled ? " from the pool" : "")
+                      << " (" << rect.width << " x " << rect.height << ")" << std::endl;
+            return entry.id;
         }
 
-        void mouseButton(int x, int y, bool is_up)
+        // CEF finishes closing the browser asynchronously - the render handler goes away when CEF lets go of
+        // it and its textures the next time round the main loop (see GLGarbage). If the pool has room and
+        // the browser has nothing of a page's to give away (see hasHistory()) it's scrubbed and kept instead
+        bool destroyBrowser(int id)
         {
-            if (mBrowser[0] && mBrowser[0]->GetHost())
+            for (std::vector<Browser>::iterator it = mBrowsers.begin(); it != mBrowsers.end(); ++it)
             {
-                mBrowser[0]->GetHost()->SendFocusEvent(true);
-
-                CefMouseEvent cef_mouse_event;
-                cef_mouse_event.x = x;
-                cef_mouse_event.y = y;
+                if (it->id == id)
+                {
+                    bool pooled = ! gExitRequested && it->browser && ! hasHistory(it->browser) && mPool.release(id);
+                    if (pooled)
+                    {
+                        scrub(*it);
+                    }
+                    else
+                    {
+                        close(*it);
+                    }
+                    mBrowsers.erase(it);
+                    mVisibility.remove(id);
+                    gRenderScheduler.invalidate();
+                    if (gThumbnailService != nullptr)
+                    {
+                        gThumbnailService->remove(id);
+                    }
 
-                CefBrowserHost::MouseButtonType btn_type = MBT_LEFT;
-                int last_click_count = 1;
+                    if (mFocusedId == id)
+                    {
+                        mFocusedId = mBrowsers.empty() ? 0 : mBrowsers.front().id;
+                    }
+                    if (mCaptureId == id)
+                    {
+                        mCaptureId = 0;
+                    }
 
-                mBrowser[0]->GetHost()->SendMouseClickEvent(cef_mouse_event, btn_type, is_up, last_click_count);
+                    std::cout << "BrowserManager: " << (pooled ? "put browser " : "destroyed browser ") << id << (pooled ? " back in the pool" : "") << std::endl;
+                    return true;
+                }
             }
+            return false;
         }
 
-        void mouseMove(int x, int y)
+        // the pooled browsers go as well
+        void destroyAll()
         {
-            if (mBrowser[0] && mBrowser[0]->GetHost())
+            while (! mBrowsers.empty())
             {
-                CefMouseEvent cef_mouse_event;
-                cef_mouse_event.x = x;
-                cef_mouse_event.y = y;
-
-                bool mouse_leave = false;
-                mBrowser[0]->GetHost()->SendMouseMoveEvent(cef_mouse_event, mouse_leave);
+                destroyBrowser(mBrowsers.back().id);
             }
-        }
 
-        void navigate(const std::string url)
-        {
-            if (mBrowser[0] && mBrowser[0]->GetHost())
+            std::vector<int> pooled = mPool.takeAll();
+            for (int id : pooled)
             {
-                mBrowser[0]->GetMainFrame()->LoadURL(url);
+                close(takeParked(id));
             }
         }
 
-        void setCookie()
+        // main thread, every time round the loop - picks up browsers CEF has created since last time, the
+        // pooled ones that have finished loading about:blank and first paints, throttles the browsers that
+        // can't be seen and tops the pool back up
+        void update(double now)
         {
-            CefRefPtr<CefCookieManager> manager = CefCookieManager::GetGlobalManager(nullptr);
-            if (manager)
+            if (gVisibilityThrottling)
             {
-                CefCookie cookie;
-                CefString(&cookie.name) = "Hobnob";
-                CefString(&cookie.value) = "chocolate";
-                CefString(&cookie.domain) = "id.callum.com";
-                CefString(&cookie.path) = "/";
-
-                // TODO set from input
-                cookie.httponly = true;
-                cookie.secure = true;
-                cookie.has_expires = true;
-                cookie.expires.year = 2064;
-                cookie.expires.month = 4;
-                cookie.expires.day_of_week = 5;
-                cookie.expires.day_of_month = 10;
-
-                const CefRefPtr<CefSetCookieCallback> set_cookie_callback = nullptr;
-                std::string url = "https://id.callum.com";
-                bool result = manager->SetCookie(url, cookie, set_cookie_callback);
-
-                const CefRefPtr<CefCompletionCallback> flush_store_callback = nullptr;
-                manager->FlushStore(flush_store_callback);
+                mVisibility.setWindow(gWidth, gHeight, gWindowMinimized, gWindowActive);
+                mVisibilityChanges.clear();
+                mVisibility.update(now, mVisibilityChanges);
+                for (const VisibilityChange& change : mVisibilityChanges)
+                {
+                    Browser* entry = find(change.id);
+                    if (entry != nullptr && entry->browser)
+                    {
+                        applyVisibility(*entry, change.from, change.to);
+                    }
+                    std::cout << "BrowserManager: browser " << change.id << " is " << visibilityName(change.to) << " (was " << visibilityName(change.from) << ")" << std::endl;
+                }
             }
-        }
 
-        void deleteAllCookies()
-        {
-            CefRefPtr<CefCookieManager> manager = CefCookieManager::GetGlobalManager(nullptr);
-            if (manager)
+            bool waiting = false;
+            for (Browser& entry : mBrowsers)
             {
-                // empty URL deletes all cookies for all domains
-                const CefString url("");
-                const CefString name("");
-                const CefRefPtr<CefDeleteCookiesCallback> callback = nullptr;
-                manager->DeleteCookies(url, name, callback);
-            }
-        }
-
-        class TestVisitor : public CefCookieVisitor
-        {
-            public:
-                TestVisitor(std::vector<CefCookie>* cookies)
-                    : cookies_(cookies)
+                // one that's changed state while CEF was still creating it catches up
+                if (! entry.browser && created(entry) && mVisibility.state(entry.id) != VISIBILITY_VISIBLE)
                 {
+                    applyVisibility(entry, VISIBILITY_VISIBLE, mVisibility.state(entry.id));
                 }
 
-                bool Visit(const CefCookie& cookie, int count, int total, bool& deleteCookie) override
+                double painted = 0.0;
+                if (! entry.painted && entry.renderHandler->takeFirstPaint(painted))
                 {
-                    std::cout << "Visiting all cookies - name is " << "mame" << std::endl;
-                    deleteCookie = true;
-                    return true;
+                    entry.painted = true;
+                    mPool.firstPaint(entry.pooled, painted - entry.requested);
+                    std::cout << "BrowserManager: browser " << entry.id << " painted its page " << painted - entry.requested << " ms after it was asked for ("
+                              << (entry.pooled ? "from the pool" : "created cold") << ")" << std::endl;
                 }
+                waiting = waiting || (! entry.painted && now - entry.requested < kFirstPaintWait);
+            }
 
-                std::vector<CefCookie>* cookies_;
+            for (Browser& entry : mParked)
+            {
+                created(entry);
 
-                IMPLEMENT_REFCOUNTING(TestVisitor);
-        };
+                if (entry.browser && entry.browserClient->takeBlankLoaded())
+                {
+                    CefRefPtr<CefBrowser> browser = entry.browser;
+                    runOnUIThread([browser]()
+                    {
+                        browser->GetHost()->WasHidden(true);
+                    });
+                    mPool.ready(entry.id);
+                }
+            }
 
-        void visitAllCookies()
-        {
-            std::vector<CefCookie> cookies;
+            for (std::vector<Browser>::iterator it = mClosing.begin(); it != mClosing.end();)
+            {
+                created(*it);
+                if (it->browser)
+                {
+                    close(*it);
+                    it = mClosing.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+
+            // new browsers for the pool wait until nothing is waiting on its first paint so they don't slow
+            // down pages someone is looking at
+            if (! waiting && ! gExitRequested)
+            {
+                while (mPool.wanted() > 0)
+                {
+                    Browser entry = newBrowser("about:blank", CefRect(0, 0, gWidth, gHeight));
+                    mPool.warming(entry.id);
+                    mParked.push_back(entry);
+                    std::cout << "BrowserManager: warming browser " << entry.id << " for the pool" << std::endl;
+                }
+            }
+        }
+
+        // how long until update() has a browser to throttle
+        double timeUntilUpdate(double now) const
+        {
+            return gVisibilityThrottling ? mVisibility.timeUntilUpdate(now) : std::numeric_limits<double>::infinity();
+        }
+
+        VisibilityStats visibilityStats() const
+        {
+            return mVisibility.stats();
+        }
+
+        // every browser has painted its first page (or given up waiting)
+        bool painted(double now) const
+        {
+            for (const Browser& entry : mBrowsers)
+            {
+                if (! entry.painted && now - entry.requested < kFirstPaintWait)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void resizeBrowser(int id, const CefRect& rect)
+        {
+            Browser* entry = find(id);
+            if (entry == nullptr)
+            {
+                return;
+            }
+
+            bool size_changed = (rect.width != entry->rect.width || rect.height != entry->rect.height);
+            entry->rect = rect;
+            mVisibility.move(id, Rect(rect.x, rect.y, rect.width, rect.height));
+            gRenderScheduler.invalidate();
+
+            // until CEF paints at the new size the page we have is stretched to fit
+            if (size_changed)
+            {
+                entry->resize.resized(PumpScheduler::now());
+            }
+        }
+
+        // paint a browser at scale of the size it's shown at (see render_scale.h) - it's still drawn the same size
+        void setRenderScale(int id, float scale)
+        {
+            Browser* entry = find(id);
+            if (entry == nullptr || scale <= 0.0f || scale == entry->renderHandler->renderScale())
+            {
+                return;
+            }
+
+            entry->renderHandler->setRenderScale(scale);
+            if (entry->browser && entry->browser->GetHost())
+            {
+                CefRefPtr<CefBrowserHost> host = entry->browser->GetHost();
+                runOnUIThread([host]()
+                {
+                    host->NotifyScreenInfoChanged();
+                    host->WasResized();
+                });
+            }
+
+            std::cout << "BrowserManager: browser " << id << " paints at " << scale << " of its size" << std::endl;
+        }
+
+        float renderScale(int id)
+        {
+            Browser* entry = find(id);
+            return entry ? entry->renderHandler->renderScale() : gRenderScale;
+        }
+
+        // the newest thumbnail of a browser - null when thumbnails are off or it hasn't been made yet. Never
+        // waits for the thumbnail worker, so it's fine to call every frame
+        std::shared_ptr<const Thumbnail> thumbnail(int id) const
+        {
+            return gThumbnailService ? gThumbnailService->latest(id) : std::shared_ptr<const Thumbnail>();
+        }
+
+        // write a browser's encoded thumbnail to thumbnail_<id>.<format>
+        bool saveThumbnail(int id) const
+        {
+            std::shared_ptr<const Thumbnail> latest = thumbnail(id);
+            if (! latest || latest->format == IMAGE_NONE)
+            {
+                std::cout << "BrowserManager: browser " << id << " doesn't have an encoded thumbnail" << std::endl;
+                return false;
+            }
+
+            std::string file_name = "thumbnail_" + std::to_string(id) + "." + imageFormatName(latest->format);
+            FILE* file = fopen(file_name.c_str(), "wb");
+            bool written = file != nullptr && fwrite(latest->encoded.data(), 1, latest->encoded.size(), file) == latest->encoded.size();
+            if (file != nullptr)
+            {
+                fclose(file);
+            }
+
+            // the smallest level is the one that's encoded
+            const ThumbnailLevel& level = latest->levels.back();
+            std::cout << "BrowserManager: " << (written ? "wrote " : "unable to write ") << file_name << " (" << level.width << " x " << level.height << ", " << latest->encoded.size() << " bytes)" << std::endl;
+            return written;
+        }
+
+        // tell CEF about the size changes that have settled down (or waited long enough)
+        void flushResizes(double now)
+        {
+            for (Browser& entry : mBrowsers)
+            {
+                if (entry.resize.due(now))
+                {
+                    entry.renderHandler->setSize(entry.rect.width, entry.rect.height);
+                    if (entry.browser && entry.browser->GetHost())
+                    {
+                        CefRefPtr<CefBrowserHost> host = entry.browser->GetHost();
+                        runOnUIThread([host]()
+                        {
+                            host->WasResized();
+                        });
+                    }
+                    entry.resize.done();
+                }
+            }
+        }
+
+        // how long until flushResizes() has something to do
+        double timeUntilResize(double now) const
+        {
+            double wait = std::numeric_limits<double>::infinity();
+            for (const Browser& entry : mBrowsers)
+            {
+                if (entry.resize.timeUntilDue(now) < wait)
+                {
+                    wait = entry.resize.timeUntilDue(now);
+                }
+            }
+            return wait;
+        }
+
+        // lay every browser out in a grid that fills the window
+        void tile(int width, int height)
+        {
+            if (mBrowsers.empty())
+            {
+                return;
+            }
+
+            int columns = 1;
+            while (columns * columns < (int)mBrowsers.size())
+            {
+                ++columns;
+            }
+            int rows = ((int)mBrowsers.size() + columns - 1) / columns;
+
+            for (size_t i = 0; i < mBrowsers.size(); ++i)
+            {
+                int column = (int)i % columns;
+                int row = (int)i / columns;
+                int x = column * width / columns;
+                int y = row * height / rows;
+                int right = (column + 1) * width / columns;
+                int bottom = (row + 1) * height / rows;
+
+                resizeBrowser(mBrowsers[i].id, CefRect(x, y, right - x, bottom - y));
+            }
+        }
+
+        // window position to the browser under it - 0 if there isn't one
+        int browserAt(int x, int y) const
+        {
+            for (const Browser& entry : mBrowsers)
+            {
+                if (x >= entry.rect.x && y >= entry.rect.y && x < entry.rect.x + entry.rect.width && y < entry.rect.y + entry.rect.height)
+                {
+                    return entry.id;
+                }
+            }
+            return 0;
+        }
+
+        // these return the browser the event went to - 0 if there wasn't one
+        int mouseButton(int x, int y, bool is_up)
+        {
+            // a button release goes to the browser that saw the press so drags that leave it still finish
+            int id = (is_up && mCaptureId != 0) ? mCaptureId : browserAt(x, y);
+            Browser* entry = find(id);
+            mCaptureId = is_up ? 0 : id;
+
+            if (entry && entry->browser && entry->browser->GetHost())
+            {
+                CefRefPtr<CefBrowserHost> previous_host;
+                if (mFocusedId != id)
+                {
+                    Browser* previous = find(mFocusedId);
+                    if (previous && previous->browser && previous->browser->GetHost())
+                    {
+                        previous_host = previous->browser->GetHost();
+                    }
+                    mFocusedId = id;
+                }
+
+                CefMouseEvent cef_mouse_event = mouseEvent(*entry, x, y);
+
+                CefBrowserHost::MouseButtonType btn_type = MBT_LEFT;
+                int last_click_count = 1;
+
+                // which browser it goes to is decided here, CEF gets it on its own thread
+                CefRefPtr<CefBrowserHost> host = entry->browser->GetHost();
+                runOnUIThread([host, previous_host, cef_mouse_event, btn_type, is_up, last_click_count]()
+                {
+                    if (previous_host)
+                    {
+                        previous_host->SendFocusEvent(false);
+                    }
+                    host->SendFocusEvent(true);
+                    host->SendMouseClickEvent(cef_mouse_event, btn_type, is_up, last_click_count);
+                });
+                return id;
+            }
+            return 0;
+        }
+
+        int mouseMove(int x, int y)
+        {
+            int id = (mCaptureId != 0) ? mCaptureId : browserAt(x, y);
+            Browser* entry = find(id);
+
+            if (entry && entry->browser && entry->browser->GetHost())
+            {
+                CefMouseEvent cef_mouse_event = mouseEvent(*entry, x, y);
+
+                bool mouse_leave = false;
+                CefRefPtr<CefBrowserHost> host = entry->browser->GetHost();
+                runOnUIThread([host, cef_mouse_event, mouse_leave]()
+                {
+                    host->SendMouseMoveEvent(cef_mouse_event, mouse_leave);
+                });
+                return id;
+            }
+            return 0;
+        }
+
+        int mouseWheel(int x, int y, int delta_x, int delta_y)
+        {
+            int id = browserAt(x, y);
+            Browser* entry = find(id);
+
+            if (entry && entry->browser && entry->browser->GetHost())
+            {
+                CefMouseEvent cef_mouse_event = mouseEvent(*entry, x, y);
+
+                CefRefPtr<CefBrowserHost> host = entry->browser->GetHost();
+                runOnUIThread([host, cef_mouse_event, delta_x, delta_y]()
+                {
+                    host->SendMouseWheelEvent(cef_mouse_event, delta_x, delta_y);
+                });
+                return id;
+            }
+            return 0;
+        }
+
+        // the browser that was last clicked in
+        int focusedBrowser() const
+        {
+            return mFocusedId;
+        }
+
+        CefRefPtr<CefBrowser> browser(int id)
+        {
+            Browser* entry = find(id);
+            return entry ? entry->browser : CefRefPtr<CefBrowser>();
+        }
+
+        size_t count() const
+        {
+            return mBrowsers.size();
+        }
+
+        // MULTI_THREADED - upload whatever the browsers have painted on CEF's thread since last time, until
+        // we're on our way out
+        bool takeFrames(double now)
+        {
+            if (gExitRequested)
+            {
+                return false;
+            }
+
+            bool taken = false;
+            for (Browser& entry : mBrowsers)
+            {
+                if (entry.renderHandler->takeFrame(now))
+                {
+                    taken = true;
+                }
+            }
+            // so a pooled browser has about:blank ready to show
+            for (Browser& entry : mParked)
+            {
+                entry.renderHandler->takeFrame(now);
+            }
+            return taken;
+        }
+
+        // all the browsers' mailboxes added together
+        MailboxStats mailboxStats() const
+        {
+            MailboxStats total;
+            for (const Browser& entry : mBrowsers)
+            {
+                MailboxStats stats = entry.renderHandler->mailboxStats();
+                total.published += stats.published;
+                total.taken += stats.taken;
+                total.skipped += stats.skipped;
+                total.bytesCopied += stats.bytesCopied;
+            }
+            return total;
+        }
+
+        // draw every browser's texture where it sits in the window, then any popup layers over the top
+        void render()
+        {
+            gQuadRenderer->begin(gWidth, gHeight);
+
+            // everything in the atlas goes in one batch per atlas page - the atlas draws its own batches when
+            // the renderer would draw them one at a time
+            if (gTextureAtlas && gQuadRenderer->layout() == TEXTURE_BGRA)
+            {
+                for (const Browser& entry : mBrowsers)
+                {
+                    gTextureAtlas->addQuad(entry.renderHandler->atlasHandle(), toRect(entry.rect));
+                }
+                gTextureAtlas->draw();
+            }
+            else
+            {
+                for (const Browser& entry : mBrowsers)
+                {
+                    if (gTextureAtlas)
+                    {
+                        gQuadRenderer->add(gTextureAtlas->quad(entry.renderHandler->atlasHandle(), toRect(entry.rect)));
+                        continue;
+                    }
+
+                    float u, v;
+                    entry.renderHandler->textureExtent(u, v);
+                    gQuadRenderer->add(TexturedQuad(entry.renderHandler->texture(), toRect(entry.rect), 0.0f, 0.0f, u, v));
+                }
+            }
+
+            for (const Browser& entry : mBrowsers)
+            {
+                GLuint popup_texture = 0;
+                Rect popup_rect;
+                float u, v;
+                if (entry.renderHandler->popupLayer(toRect(entry.rect), popup_texture, popup_rect, u, v))
+                {
+                    // a popup can hang off the edge of its browser - don't let it draw over the neighbours
+                    TexturedQuad quad(popup_texture, popup_rect, 0.0f, 0.0f, u, v);
+                    quad.clip = toRect(entry.rect);
+                    quad.blend = gBlendPopups;
+                    gQuadRenderer->add(quad);
+                }
+            }
+
+            gQuadRenderer->end();
+        }
+
+        void reportMemory() const
+        {
+            size_t total = 0;
+            for (const Browser& entry : mBrowsers)
+            {
+                size_t bytes = entry.renderHandler->memoryUsage();
+                total += bytes;
+
+                std::cout << "BrowserManager: browser " << entry.id << " (" << entry.rect.width << " x " << entry.rect.height << ") uses " << bytes / 1024 << " KB" << std::endl;
+            }
+            std::cout << "BrowserManager: " << mBrowsers.size() << " browsers use " << total / 1024 << " KB in total" << std::endl;
+
+            size_t pooled = 0;
+            for (const Browser& entry : mParked)
+            {
+                pooled += entry.renderHandler->memoryUsage();
+            }
+            std::cout << "BrowserManager: " << mParked.size() << " pooled browsers use " << pooled / 1024 << " KB" << std::endl;
+
+            if (gTextureAtlas)
+            {
+                std::cout << "BrowserManager: texture atlas has " << gTextureAtlas->numPages() << " pages using " << gTextureAtlas->memoryUsage() / 1024 << " KB" << std::endl;
+            }
+
+            PixelPoolStats pool = defaultPixelPool().stats();
+            std::cout << "BrowserManager: pixel pool has " << pool.liveBytes / 1024 << " KB in use, " << pool.cachedBytes / 1024 << " KB cached, "
+                      << "peak " << pool.peakBytes / 1024 << " KB - " << pool.allocations << " allocations (" << pool.hugePageAllocations << " with large pages) for "
+                      << pool.acquires << " buffers" << std::endl;
+        }
+
+        // CEF is still closing some browsers
+        bool hasOpenBrowsers() const
+        {
+            return mLifeSpanHandler->hasBrowsers();
+        }
+
+        void reportPool() const
+        {
+            const BrowserPoolStats& stats = mPool.stats();
+            std::cout << "BrowserPool: " << mPool.size() << " kept ready - " << stats.hits << " browsers taken from the pool, " << stats.misses << " created cold, "
+                      << stats.created << " created for the pool, " << stats.reused << " put back, " << stats.closed << " closed when it was full. First paint "
+                      << (stats.coldFirstPaints > 0 ? stats.coldFirstPaintTime / stats.coldFirstPaints : 0.0) << " ms cold (" << stats.coldFirstPaints << "), "
+                      << (stats.pooledFirstPaints > 0 ? stats.pooledFirstPaintTime / stats.pooledFirstPaints : 0.0) << " ms pooled (" << stats.pooledFirstPaints << ")" << std::endl;
+        }
+
+        // drop our references - only once CEF has closed them all
+        void clear()
+        {
+            mBrowsers.clear();
+            mParked.clear();
+            mClosing.clear();
+            mFocusedId = 0;
+            mCaptureId = 0;
+        }
+
+    private:
+        // a page that hasn't painted after this long (milliseconds) isn't waited for
+        static constexpr double kFirstPaintWait = 10000.0;
+
+        struct Browser
+        {
+            Browser() :
+                id(0),
+                resize(gResizeQuietTime, gResizeMaxDelay),
+                requested(0.0),
+                pooled(false),
+                painted(true)
+            {
+            }
+
+            int id;
+            CefRect rect;
+            // CEF is told about size changes a little later (see flushResizes())
+            ResizeDebouncer resize;
+            CefRefPtr<RenderHandler> renderHandler;
+            CefRefPtr<BrowserClient> browserClient;
+            // null until CEF has created it
+            CefRefPtr<CefBrowser> browser;
+
+            // when it was asked for, whether it came from the pool and whether it's painted its page since
+            double requested;
+            bool pooled;
+            bool painted;
+        };
+
+        // CEF creates it a little later on its UI thread
+        Browser newBrowser(const std::string& url, const CefRect& rect)
+        {
+            Browser entry;
+            entry.id = mNextId++;
+            entry.rect = rect;
+            entry.renderHandler = new RenderHandler(entry.id, rect.width, rect.height);
+            entry.browserClient = new BrowserClient(entry.renderHandler, mLifeSpanHandler);
+
+            CefWindowInfo window_info;
+            initOffscreenWindowInfo(window_info);
+            CefBrowserSettings browser_settings = offscreenBrowserSettings(60);
+
+            mLifeSpanHandler->creating();
+            CefRefPtr<BrowserClient> client = entry.browserClient;
+            runOnUIThread([window_info, client, url, browser_settings]()
+            {
+                CefBrowserHost::CreateBrowser(window_info, client.get(), url, browser_settings, nullptr);
+            });
+            return entry;
+        }
+
+        // true if CEF created it since last time
+        bool created(Browser& entry)
+        {
+            if (entry.browser)
+            {
+                return false;
+            }
+            entry.browser = entry.browserClient->takeCreated();
+            return entry.browser != nullptr;
+        }
+
+        // hidden browsers don't paint at all, and ask for a whole new page when they come back since they've
+        // missed everything in between
+        void applyVisibility(const Browser& entry, VisibilityState from, VisibilityState to)
+        {
+            CefRefPtr<CefBrowserHost> host = entry.browser->GetHost();
+            int frame_rate = mVisibility.frameRate(to);
+            runOnUIThread([host, from, to, frame_rate]()
+            {
+                if (to == VISIBILITY_HIDDEN)
+                {
+                    host->WasHidden(true);
+                    return;
+                }
+
+                host->SetWindowlessFrameRate(frame_rate);
+                if (from == VISIBILITY_HIDDEN)
+                {
+                    host->WasHidden(false);
+                    host->Invalidate(PET_VIEW);
+                }
+            });
+        }
+
+        static VisibilitySettings visibilitySettings()
+        {
+            VisibilitySettings settings;
+            settings.backgroundFrameRate = gBackgroundFrameRate;
+            return settings;
+        }
+
+        // a browser that's been anywhere but about:blank - CEF can't clear its back/forward list or the
+        // page's sessionStorage, so the next panel could go back to the page or read what it left there
+        static bool hasHistory(CefRefPtr<CefBrowser> browser)
+        {
+            CefRefPtr<CefFrame> frame = browser->GetMainFrame();
+            return browser->CanGoBack() || browser->CanGoForward() || ! frame || std::string(frame->GetURL()) != "about:blank";
+        }
+
+        // one that's only ever been on about:blank (see hasHistory()) back to how the pool had it - loading
+        // stopped, no focus, no zoom - then hidden once about:blank has loaded again (see update())
+        void scrub(Browser& entry)
+        {
+            entry.browserClient->takeBlankLoaded();
+
+            CefRefPtr<CefBrowser> browser = entry.browser;
+            runOnUIThread([browser]()
+            {
+                browser->StopLoad();
+                browser->GetHost()->SendFocusEvent(false);
+                browser->GetHost()->SetZoomLevel(0.0);
+                browser->GetMainFrame()->LoadURL("about:blank");
+            });
+            mParked.push_back(entry);
+        }
+
+        // ones CEF hasn't created yet are closed once it has
+        void close(const Browser& entry)
+        {
+            if (! entry.browser)
+            {
+                mClosing.push_back(entry);
+                return;
+            }
+
+            CefRefPtr<CefBrowserHost> host = entry.browser->GetHost();
+            if (host)
+            {
+                runOnUIThread([host]()
+                {
+                    host->CloseBrowser(true);
+                });
+            }
+        }
+
+        Browser takeParked(int id)
+        {
+            Browser entry;
+            for (std::vector<Browser>::iterator it = mParked.begin(); it != mParked.end(); ++it)
+            {
+                if (it->id == id)
+                {
+                    entry = *it;
+                    mParked.erase(it);
+                    break;
+                }
+            }
+            return entry;
+        }
+
+        // a window position as a mouse event for the browser - CEF wants it in the view's DIPs, which aren't
+        // window pixels when the browser paints at a different scale
+        static CefMouseEvent mouseEvent(const Browser& entry, int x, int y)
+        {
+            CefMouseEvent cef_mouse_event;
+            entry.renderHandler->toView(x - entry.rect.x, y - entry.rect.y, cef_mouse_event.x, cef_mouse_event.y);
+            return cef_mouse_event;
+        }
+
+        // CEF's rect as ours
+        static Rect toRect(const CefRect& rect)
+        {
+            return Rect(rect.x, rect.y, rect.width, rect.height);
+        }
+
+        Browser* find(int id)
+        {
+            for (Browser& entry : mBrowsers)
+            {
+                if (entry.id == id)
+                {
+                    return &entry;
+                }
+            }
+            return nullptr;
+        }
+
+        std::vector<Browser> mBrowsers;
+        CefRefPtr<LifeSpanHandler> mLifeSpanHandler;
+        int mNextId;
+        int mFocusedId;
+        int mCaptureId;
+
+        // the pool's browsers, warming up or ready, and ones that were closed before CEF had created them
+        BrowserPool mPool;
+        std::vector<Browser> mParked;
+        std::vector<Browser> mClosing;
+
+        VisibilityManager mVisibility;
+        std::vector<VisibilityChange> mVisibilityChanges;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+class cefImpl :
+    public CefApp,
+    public CefBrowserProcessHandler
+{
+    public:
+        // the pump doesn't need to wake up for frames when the render scheduler decides when to draw
+        cefImpl() :
+            mPumpScheduler(gPresentOnDamage ? 0.0 : gFrameInterval, gMaxPumpDelay),
+            mCookiesRestored(false),
+            mStartBrowsersCreated(false),
+            mInitTime(0.0),
+            mStartupReported(false)
+        {
+        }
+
+        bool cefImpl::init()
+        {
+            double start = PumpScheduler::now();
+
+            CefMainArgs args(GetModuleHandle(NULL));
+
+            CefSettings settings;
+            initOffscreenSettings(settings, gMessagePumpMode == MULTI_THREADED, gMessagePumpMode == EXTERNAL_PUMP, "cef_opengl_win.log");
+
+            if (CefInitialize(args, settings, this, NULL))
+            {
+                std::cout << "cefImpl: initialized okay" << std::endl;
+
+                // the first pages shouldn't load until their cookies are there
+                if (gCookieImportFile.empty() || ! importCookies(gCookieImportFile, [this](const CookieTransferStats& stats)
+                    {
+                        mCookiesRestored = true;
+                        if (gWakeMainLoop)
+                        {
+                            gWakeMainLoop();
+                        }
+                    }))
+                {
+                    mCookiesRestored = true;
+                }
+                createStartBrowsers();
+
+                // browsers are created asynchronously so this doesn't wait for any of them
+                mInitTime = PumpScheduler::now() - start;
+                return true;
+            }
+
+            std::cout << "cefImpl: Unable to initialize" << std::endl;
+            return false;
+        }
+
+        void OnBeforeCommandLineProcessing(const CefString& process_type, CefRefPtr<CefCommandLine> command_line) override
+        {
+            appendOffscreenSwitches(process_type, command_line);
+        }
+
+        CefRefPtr<CefBrowserProcessHandler> GetBrowserProcessHandler() override
+        {
+            return this;
+        }
+
+        // CEF wants CefDoMessageLoopWork() called in delay_ms - can be called on any thread, and from
+        // inside CefDoMessageLoopWork() itself
+        void OnScheduleMessagePumpWork(int64 delay_ms) override
+        {
+            mPumpScheduler.scheduleWork(delay_ms);
+        }
+
+        void update()
+        {
+            INSTRUMENT_SCOPE("loop.cef_work");
+
+            mPumpScheduler.beginWork(PumpScheduler::now());
+            CefDoMessageLoopWork();
+            mPumpScheduler.endWork(PumpScheduler::now());
+        }
+
+        PumpScheduler& pumpScheduler()
+        {
+            return mPumpScheduler;
+        }
+
+        // the browsers we start with, once the cookies they need have been restored - main thread
+        void createStartBrowsers()
+        {
+            if (mStartBrowsersCreated || ! mCookiesRestored)
+            {
+                return;
+            }
+
+            for (int i = 0; i < gNumBrowsers; ++i)
+            {
+                mBrowserManager.createBrowser(gStartURL, CefRect(0, 0, gWidth, gHeight));
+            }
+            mBrowserManager.tile(gWidth, gHeight);
+            mStartBrowsersCreated = true;
+        }
+
+        // once, when the browsers we start with have all painted
+        void reportStartup()
+        {
+            double now = PumpScheduler::now();
+            if (mStartupReported || ! mStartBrowsersCreated || ! mBrowserManager.painted(now))
+            {
+                return;
+            }
+
+            std::cout << "Startup: " << gNumBrowsers << " browsers painted " << now - gLaunchTime << " ms after launch (init() took " << mInitTime << " ms)" << std::endl;
+            mStartupReported = true;
+        }
+
+        BrowserManager& browsers()
+        {
+            return mBrowserManager;
+        }
+
+        // an event from gInputQueue
+        void sendInput(const InputEvent& event)
+        {
+            int id = 0;
+            switch (event.type)
+            {
+                case InputEvent::MOUSE_MOVE:
+                    id = mBrowserManager.mouseMove(event.x, event.y);
+                    break;
+
+                case InputEvent::MOUSE_BUTTON:
+                    id = mBrowserManager.mouseButton(event.x, event.y, event.isUp);
+                    break;
+
+                case InputEvent::MOUSE_WHEEL:
+                    id = mBrowserManager.mouseWheel(event.x, event.y, event.deltaX, event.deltaY);
+                    break;
+            }
+
+            if (id != 0)
+            {
+                gInputLatency.sent(event, id);
+            }
+        }
 
+        void navigate(const std::string url)
+        {
+            CefRefPtr<CefBrowser> browser = mBrowserManager.browser(mBrowserManager.focusedBrowser());
+            if (browser && browser->GetHost())
+            {
+                browser->GetMainFrame()->LoadURL(url);
+            }
+        }
+
+        void deleteAllCookies()
+        {
             CefRefPtr<CefCookieManager> manager = CefCookieManager::GetGlobalManager(nullptr);
             if (manager)
             {
-                manager->VisitAllCookies(new TestVisitor(&cookies));
-                manager->FlushStore(nullptr);
+                // empty URL deletes all cookies for all domains
+                const CefString url("");
+                const CefString name("");
+                const CefRefPtr<CefDeleteCookiesCallback> callback = nullptr;
+                manager->DeleteCookies(url, name, callback);
             }
         }
 
-        void requestExit()
+        // a batch at a time with progress written out as it goes (see cookie_store.h) - done is called on
+        // CEF's UI thread. False if the file can't be opened
+        bool importCookies(const std::string& file_name, const std::function<void(const CookieTransferStats&)>& done)
         {
-            for (int i = 0; i < gNumBrowsers; ++i)
+            std::cout << "CookieImport: restoring cookies from " << file_name << std::endl;
+            bool ok = ::importCookies(file_name, mCookieStore, loggedCookieTransfer("CookieImport", gCookieBatchSize, done));
+            if (! ok)
             {
-                if (mBrowser[i].get() && mBrowser[i]->GetHost())
-                {
-                    mBrowser[i]->GetHost()->CloseBrowser(true);
-                }
+                std::cout << "CookieImport: unable to open " << file_name << std::endl;
             }
+            return ok;
         }
 
-        void shutdown()
+        void exportCookies(const std::string& file_name)
         {
-            for (int i = 0; i < gNumBrowsers; ++i)
+            std::cout << "CookieExport: saving cookies to " << file_name << std::endl;
+            if (! ::exportCookies(file_name, mCookieStore, loggedCookieTransfer("CookieExport", gCookieBatchSize, nullptr)))
+            {
+                std::cout << "CookieExport: unable to write " << file_name << " or read the cookies" << std::endl;
+            }
+        }
+
+        void requestExit()
+        {
+            gExitRequested = true;
+            mBrowserManager.destroyAll();
+
+            // nothing left to wait for
+            if (! mBrowserManager.hasOpenBrowsers())
             {
-                mRenderHandler[i] = nullptr;
-                mBrowserClient[i] = nullptr;
-                mBrowser[i] = nullptr;
+                gExitFlag = true;
             }
+        }
 
-            gPagePixels = nullptr;
+        void shutdown()
+        {
+            mBrowserManager.reportPool();
+            mBrowserManager.clear();
 
             CefShutdown();
         }
@@ -490,15 +1839,105 @@ class cefImpl :
         IMPLEMENT_REFCOUNTING(cefImpl);
 
     private:
-        CefRefPtr<RenderHandler> mRenderHandler[gNumBrowsers];
-        CefRefPtr<BrowserClient> mBrowserClient[gNumBrowsers];
-        CefRefPtr<CefBrowser> mBrowser[gNumBrowsers];
+        BrowserManager mBrowserManager;
+        PumpScheduler mPumpScheduler;
+        CefCookieStore mCookieStore;
+        std::atomic<bool> mCookiesRestored;
+        bool mStartBrowsersCreated;
+        double mInitTime;
+        bool mStartupReported;
 };
 
 cefImpl* gCefImpl = nullptr;
 
 /////////////////////////////////////////////////////////////////////////////////
 //
+void* getGLProcAddress(const char* name)
+{
+    return (void*)wglGetProcAddress(name);
+}
+
+// the window and its WGL context (see render_surface.h) - the headless Linux app draws into EGLRenderSurface instead
+class WGLRenderSurface :
+    public RenderSurface
+{
+    public:
+        WGLRenderSurface() :
+            mWidth(0),
+            mHeight(0)
+        {
+        }
+
+        const char* name() const override
+        {
+            return "wgl";
+        }
+
+        bool hasGL() const override
+        {
+            return true;
+        }
+
+        void resize(int width, int height) override
+        {
+            mWidth = width;
+            mHeight = height;
+
+            glViewport(0, 0, width, height);
+            glLoadIdentity();
+            glOrtho(0.0f, width, height, 0.0f, -1.0f, 1.0f);
+        }
+
+        void makeCurrent() override
+        {
+            wglMakeCurrent(hDC, hRC);
+        }
+
+        void present() override
+        {
+            SwapBuffers(hDC);
+            ++mPresents;
+        }
+
+        int width() const override
+        {
+            return mWidth;
+        }
+
+        int height() const override
+        {
+            return mHeight;
+        }
+
+    private:
+        int mWidth;
+        int mHeight;
+};
+
+WGLRenderSurface gRenderSurface;
+
+// draw the browsers and swap - from the main loop, or the timer while Windows is busy resizing the window
+void drawFrame()
+{
+    // nothing worth drawing while the browsers close
+    if (! gExitRequested)
+    {
+        {
+            INSTRUMENT_SCOPE("frame.draw");
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            gCefImpl->browsers().render();
+        }
+
+        {
+            INSTRUMENT_SCOPE("frame.swap");
+            gRenderSurface.present();
+        }
+    }
+    gCefImpl->pumpScheduler().frameDone(PumpScheduler::now());
+    gRenderScheduler.presented(PumpScheduler::now());
+}
+
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 {
     static PIXELFORMATDESCRIPTOR pfd = { sizeof(PIXELFORMATDESCRIPTOR), 1,
@@ -515,54 +1954,91 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
             SetPixelFormat(hDC, pixel_format, &pfd);
             hRC = wglCreateContext(hDC);
             wglMakeCurrent(hDC, hRC);
+            loadGLFunctions(getGLProcAddress);
 
             RECT real_window_size;
             GetClientRect(hWnd, &real_window_size);
             gWidth = real_window_size.right + 1;
             gHeight = real_window_size.bottom + 1;
 
+            // each browser creates its own texture unless they're all sharing an atlas - either way in the
+            // layout the renderer draws
             glEnable(GL_TEXTURE_2D);
-            GLuint gAppTexture = 0;
-            glGenTextures(1, &gAppTexture);
-            glBindTexture(GL_TEXTURE_2D, gAppTexture);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, gWidth, gHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
-            glViewport(0, 0, gWidth, gHeight);
-            glOrtho(0.0f, gWidth, gHeight, 0.0f, -1.0f, 1.0f);
+            gQuadRenderer = createQuadRenderer(gModernRenderer);
+            if (gUseTextureAtlas)
+            {
+                gTextureAtlas = new TextureAtlas(gAtlasPageSize, gQuadRenderer->layout());
+            }
+            gRenderSurface.resize(gWidth, gHeight);
 
             gCefImpl = new cefImpl();
+            gWakeMainLoop = [hWnd]()
+            {
+                PostMessage(hWnd, WM_PUMP_WORK, 0, 0);
+            };
+            gCefImpl->pumpScheduler().setWakeCallback(gWakeMainLoop);
             gCefImpl->init();
         }
         break;
 
         case WM_MOUSEMOVE:
         {
+            INSTRUMENT_SCOPE("input.mouse_move");
             int x = GET_X_LPARAM(lParam);
             int y = GET_Y_LPARAM(lParam);
 
             if ((GLuint)x < gWidth && (GLuint)y < gHeight)
             {
-                gCefImpl->mouseMove(x, y);
+                InputEvent event;
+                event.type = InputEvent::MOUSE_MOVE;
+                event.x = x;
+                event.y = y;
+                event.timestamp = PumpScheduler::now();
+                gInputQueue.push(event);
             }
         }
         break;
 
         case WM_LBUTTONDOWN:
         {
-            int x = GET_X_LPARAM(lParam);
-            int y = GET_Y_LPARAM(lParam);
-            bool up = false;
-            gCefImpl->mouseButton(x, y, up);
+            INSTRUMENT_SCOPE("input.mouse_button");
+            InputEvent event;
+            event.type = InputEvent::MOUSE_BUTTON;
+            event.x = GET_X_LPARAM(lParam);
+            event.y = GET_Y_LPARAM(lParam);
+            event.isUp = false;
+            event.timestamp = PumpScheduler::now();
+            gInputQueue.push(event);
         }
         break;
 
         case WM_LBUTTONUP:
         {
-            int x = GET_X_LPARAM(lParam);
-            int y = GET_Y_LPARAM(lParam);
-            bool up = true;
-            gCefImpl->mouseButton(x, y, up);
+            INSTRUMENT_SCOPE("input.mouse_button");
+            InputEvent event;
+            event.type = InputEvent::MOUSE_BUTTON;
+            event.x = GET_X_LPARAM(lParam);
+            event.y = GET_Y_LPARAM(lParam);
+            event.isUp = true;
+            event.timestamp = PumpScheduler::now();
+            gInputQueue.push(event);
+        }
+        break;
+
+        // wheel positions are in screen coordinates
+        case WM_MOUSEWHEEL:
+        {
+            INSTRUMENT_SCOPE("input.mouse_wheel");
+            POINT point = { GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+            ScreenToClient(hWnd, &point);
+
+            InputEvent event;
+            event.type = InputEvent::MOUSE_WHEEL;
+            event.x = point.x;
+            event.y = point.y;
+            event.deltaY = GET_WHEEL_DELTA_WPARAM(wParam);
+            event.timestamp = PumpScheduler::now();
+            gInputQueue.push(event);
         }
         break;
 
@@ -574,29 +2050,131 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 
         case WM_KEYDOWN:
         {
+            INSTRUMENT_SCOPE("input.key");
             std::cout << "wParam is " << wParam << std::endl;
             if (wParam == 27)
             {
                 SendMessage(hWnd, WM_CLOSE, 0, 0);
             }
+            // cookies back from a file - gCookieImportFile, or what E saved if there isn't one
             else if (wParam == 67)
             {
-                gCefImpl->setCookie();
+                gCefImpl->importCookies(gCookieImportFile.empty() ? gCookieExportFile : gCookieImportFile, nullptr);
             }
             else if (wParam == 68)
             {
                 gCefImpl->deleteAllCookies();
             }
+            else if (wParam == 69)
+            {
+                gCefImpl->exportCookies(gCookieExportFile);
+            }
+            else if (wParam == 77)
+            {
+                gCefImpl->browsers().reportMemory();
+            }
+            else if (wParam == 78)
+            {
+                gCefImpl->browsers().createBrowser(gStartURL, CefRect(0, 0, gWidth, gHeight));
+                gCefImpl->browsers().tile(gWidth, gHeight);
+            }
+            else if (wParam == 82)
+            {
+                // full size, half and quarter
+                int id = gCefImpl->browsers().focusedBrowser();
+                float scale = gCefImpl->browsers().renderScale(id);
+                gCefImpl->browsers().setRenderScale(id, scale > 0.75f ? 0.5f : (scale > 0.375f ? 0.25f : 1.0f));
+            }
+            else if (wParam == 84)
+            {
+                gCefImpl->browsers().saveThumbnail(gCefImpl->browsers().focusedBrowser());
+            }
+            else if (wParam == 88)
+            {
+                gCefImpl->browsers().destroyBrowser(gCefImpl->browsers().focusedBrowser());
+                gCefImpl->browsers().tile(gWidth, gHeight);
+            }
+        }
+        break;
+
+        case WM_SIZE:
+        {
+            // the browsers are suspended while the window's minimized
+            gWindowMinimized = (wParam == SIZE_MINIMIZED);
+
+            // minimized, or before WM_CREATE has set things up
+            if (LOWORD(lParam) == 0 || HIWORD(lParam) == 0 || gCefImpl == nullptr)
+            {
+                break;
+            }
+
+            gWidth = LOWORD(lParam);
+            gHeight = HIWORD(lParam);
+
+            gRenderSurface.resize(gWidth, gHeight);
+
+            // the browsers get their new sizes now but CEF only hears about them once the drag settles down
+            gCefImpl->browsers().tile(gWidth, gHeight);
+            gRenderScheduler.invalidate();
         }
         break;
 
+        // another application is in front - the browsers drop to their background frame rate
+        case WM_ACTIVATEAPP:
+            gWindowActive = (wParam != FALSE);
+            break;
+
+        // Windows runs its own message loop while the window is being dragged or resized so ours
+        // doesn't get a look in - keep CEF going and the window drawn from a timer until it's done
+        case WM_ENTERSIZEMOVE:
+            SetTimer(hWnd, kResizeTimer, (UINT)gFrameInterval, NULL);
+            break;
+
+        case WM_TIMER:
+            if (wParam == kResizeTimer)
+            {
+                if (gMessagePumpMode == MULTI_THREADED)
+                {
+                    gCefImpl->browsers().takeFrames(PumpScheduler::now());
+                }
+                else
+                {
+                    gCefImpl->update();
+                }
+                gCefImpl->browsers().flushResizes(PumpScheduler::now());
+                if (gVideoCapture != nullptr)
+                {
+                    gVideoCapture->tick(PumpScheduler::now());
+                }
+                if (gThumbnailService != nullptr)
+                {
+                    gThumbnailService->tick(PumpScheduler::now());
+                }
+                if (gRenderScheduler.presentDue(PumpScheduler::now()))
+                {
+                    drawFrame();
+                }
+            }
+            break;
+
+        case WM_EXITSIZEMOVE:
+            KillTimer(hWnd, kResizeTimer);
+            break;
+
+        // the main loop does the drawing
+        case WM_PAINT:
+            ValidateRect(hWnd, NULL);
+            gRenderScheduler.invalidate();
+            break;
+
+        // the browsers close first and their textures go after (see GLGarbage) - the GL context lasts
+        // until the end of WinMain()
         case WM_DESTROY:
         case WM_CLOSE:
-            wglMakeCurrent(hDC, NULL);
-            wglDeleteContext(hRC);
-            ReleaseDC(hWnd, hDC);
-
-            gCefImpl->requestExit();
+            if (! gExitRequested)
+            {
+                gCefImpl->requestExit();
+            }
             break;
 
         default:
@@ -609,6 +2187,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 //
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
+    gLaunchTime = PumpScheduler::now();
     CefEnableHighDPISupport();
 
     // this will fire off requests to broweser, render, GPU processes etc.
@@ -619,11 +2198,21 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         return exit_code;
     }
 
+    defaultPixelPool().setHugePages(gHugePagePixels);
+    gJobSystem = new JobSystem(gCompositorThreads);
+
     AllocConsole();
     FILE* outputConsole;
     freopen_s(&outputConsole, "CON", "w", stdout);
     freopen_s(&outputConsole, "CON", "w", stderr);
 
+    gLocalResources = new LocalResources(gResourceCacheBytes, gMaxCachedResponse);
+    gLocalResources->setCacheOrigin(gResourceCacheOrigin);
+    if (! gAssetPackFile.empty() && ! gLocalResources->openPack(gAssetPackFile, gAssetPackOrigin))
+    {
+        std::cout << "Unable to open asset pack " << gAssetPackFile << std::endl;
+    }
+
     WNDCLASS wc;
     wc.style = CS_HREDRAW | CS_VREDRAW | CS_OWNDC;
     wc.lpfnWndProc = (WNDPROC)WndProc;
@@ -638,15 +2227,75 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
     RegisterClass(&wc);
 
+    DWORD style = WS_OVERLAPPED | WS_CLIPCHILDREN | WS_CLIPSIBLINGS;
+    if (gResizableWindow)
+    {
+        style |= WS_THICKFRAME;
+    }
+
     HWND hWnd = CreateWindow("OpenGLWindowClass", "CEF OpenGL Test",
-                             WS_OVERLAPPED | WS_CLIPCHILDREN | WS_CLIPSIBLINGS,
+                             style,
                              100, 0, gWidth, gHeight,
                              NULL, NULL, hInstance, NULL);
 
     ShowWindow(hWnd, SW_SHOW);
     UpdateWindow(hWnd);
     SetFocus(hWnd);
-    wglMakeCurrent(hDC, hRC);
+    gRenderSurface.makeCurrent();
+
+    // the default timer resolution (15.6ms) is too coarse to pace frames with when the loop sleeps
+    if (gMessagePumpMode != BUSY_LOOP)
+    {
+        timeBeginPeriod(1);
+    }
+
+    double stats_start = PumpScheduler::now();
+    double stats_cpu_start = processCpuTime();
+    double stats_thread_cpu_start = threadCpuTime();
+    PumpStats stats_previous = gCefImpl->pumpScheduler().stats();
+    QuadRendererStats renderer_previous = gQuadRenderer->stats();
+
+    // CEF's UI thread measures itself - ask it now and after each lot of stats
+    if (gMessagePumpMode == MULTI_THREADED)
+    {
+        runOnUIThread([]()
+        {
+            gCefThreadCpuTime.store(threadCpuTime());
+        });
+    }
+    double stats_cef_thread_cpu_start = gCefThreadCpuTime.load();
+
+    setInstrumentEnabled(gInstrumentation);
+    setInstrumentThreadName("main");
+    double instrument_collect_time = PumpScheduler::now();
+    std::vector<InstrumentEvent> instrument_events;
+    std::vector<InstrumentEvent> trace_events;
+    InstrumentSummary instrument_summary;
+    std::vector<InputEvent> input_events;
+
+    if (! gCaptureTarget.empty())
+    {
+        VideoCaptureSettings capture_settings;
+        capture_settings.frameRate = gCaptureFrameRate;
+        capture_settings.workers = gCaptureWorkers;
+        capture_settings.maxQueuedFrames = gCaptureMaxQueued;
+        gVideoCapture = new VideoCapture(capture_settings);
+        if (! gVideoCapture->open(gCaptureTarget))
+        {
+            std::cout << "Unable to open " << gCaptureTarget << " for video capture" << std::endl;
+            delete gVideoCapture;
+            gVideoCapture = nullptr;
+        }
+    }
+
+    if (gThumbnails)
+    {
+        ThumbnailSettings thumbnail_settings;
+        thumbnail_settings.levels = gThumbnailLevels;
+        thumbnail_settings.interval = gThumbnailInterval;
+        thumbnail_settings.format = gThumbnailFormat;
+        gThumbnailService = new ThumbnailService(thumbnail_settings);
+    }
 
     MSG msg;
     while (!gExitFlag)
@@ -664,28 +2313,244 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
             }
         }
 
-        gCefImpl->update();
+        PumpScheduler& scheduler = gCefImpl->pumpScheduler();
+
+        // send the input that's due (merged moves, button presses) before CEF does its work
+        input_events.clear();
+        if (gInputQueue.take(PumpScheduler::now(), input_events))
+        {
+            for (const InputEvent& event : input_events)
+            {
+                gCefImpl->sendInput(event);
+            }
+        }
+
+        gCefImpl->createStartBrowsers();
+
+        // CEF does its own work on its own thread - we just pick up what it painted
+        if (gMessagePumpMode == MULTI_THREADED)
+        {
+            gCefImpl->browsers().takeFrames(PumpScheduler::now());
+        }
+        else if (gMessagePumpMode == BUSY_LOOP || scheduler.workDue(PumpScheduler::now()))
+        {
+            gCefImpl->update();
+        }
+        gGLGarbage.release();
+
+        bool present = gPresentOnDamage ? gRenderScheduler.presentDue(PumpScheduler::now()) :
+                       (gMessagePumpMode == BUSY_LOOP || scheduler.frameDue(PumpScheduler::now()));
+        gCefImpl->browsers().flushResizes(PumpScheduler::now());
+        gCefImpl->browsers().update(PumpScheduler::now());
+        gCefImpl->reportStartup();
+        if (gVideoCapture != nullptr)
+        {
+            gVideoCapture->tick(PumpScheduler::now());
+        }
+        if (gThumbnailService != nullptr)
+        {
+            gThumbnailService->tick(PumpScheduler::now());
+        }
+
+        if (present)
+        {
+            drawFrame();
+        }
+
+        // sleep until CEF wants some work doing, the next frame is due or there is a window message - with
+        // MULTI_THREADED a browser painting posts a message, and we still wake up every gMaxPumpDelay for the stats
+        if (gMessagePumpMode != BUSY_LOOP)
+        {
+            double wait = scheduler.timeUntilDue(PumpScheduler::now());
+            if (gMessagePumpMode == MULTI_THREADED)
+            {
+                wait = gMaxPumpDelay;
+                if (! gPresentOnDamage && scheduler.timeUntilFrame(PumpScheduler::now()) < wait)
+                {
+                    wait = scheduler.timeUntilFrame(PumpScheduler::now());
+                }
+            }
+            if (gPresentOnDamage && gRenderScheduler.timeUntilPresent(PumpScheduler::now()) < wait)
+            {
+                wait = gRenderScheduler.timeUntilPresent(PumpScheduler::now());
+            }
+            if (gInputQueue.timeUntilDue(PumpScheduler::now()) < wait)
+            {
+                wait = gInputQueue.timeUntilDue(PumpScheduler::now());
+            }
+            if (gCefImpl->browsers().timeUntilResize(PumpScheduler::now()) < wait)
+            {
+                wait = gCefImpl->browsers().timeUntilResize(PumpScheduler::now());
+            }
+            if (gCefImpl->browsers().timeUntilUpdate(PumpScheduler::now()) < wait)
+            {
+                wait = gCefImpl->browsers().timeUntilUpdate(PumpScheduler::now());
+            }
+            if (gVideoCapture != nullptr && gVideoCapture->timeUntilFrame(PumpScheduler::now()) < wait)
+            {
+                wait = gVideoCapture->timeUntilFrame(PumpScheduler::now());
+            }
+            if (gThumbnailService != nullptr && gThumbnailService->timeUntilDue(PumpScheduler::now()) < wait)
+            {
+                wait = gThumbnailService->timeUntilDue(PumpScheduler::now());
+            }
+
+            DWORD timeout = (DWORD)std::ceil(wait);
+            if (timeout > 0)
+            {
+                MsgWaitForMultipleObjectsEx(0, NULL, timeout, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+                scheduler.wokeUp();
+            }
+        }
+
+        double now = PumpScheduler::now();
+        if (gInstrumentation && now - instrument_collect_time >= gInstrumentCollectInterval)
+        {
+            instrument_events.clear();
+            collectInstrumentEvents(instrument_events);
+            instrument_summary.add(instrument_events);
+            if (! gInstrumentTraceFile.empty() && trace_events.size() < gMaxTraceEvents)
+            {
+                trace_events.insert(trace_events.end(), instrument_events.begin(), instrument_events.end());
+            }
+            instrument_collect_time = now;
+        }
+
+        if (gPumpStatsInterval > 0.0 && now - stats_start >= gPumpStatsInterval * 1000.0)
+        {
+            double seconds = (now - stats_start) / 1000.0;
+            double cpu = processCpuTime();
+            PumpStats stats = scheduler.stats();
+
+            std::cout << "PumpStats: " << (gMessagePumpMode == EXTERNAL_PUMP ? "external pump" : gMessagePumpMode == BUSY_LOOP ? "busy loop" : "multi-threaded")
+                      << " - CPU " << (cpu - stats_cpu_start) / (now - stats_start) * 100.0 << "% of a core, "
+                      << (stats.workCalls - stats_previous.workCalls) / seconds << " CEF work calls/s, "
+                      << (stats.frames - stats_previous.frames) / seconds << " frames/s, "
+                      << (stats.wakeups - stats_previous.wakeups) / seconds << " wakeups/s, "
+                      << "click to paint p50 " << gInputLatency.percentile(InputEvent::MOUSE_BUTTON, 50) << " ms p99 " << gInputLatency.percentile(InputEvent::MOUSE_BUTTON, 99) << " ms"
+                      << " (" << gInputLatency.count(InputEvent::MOUSE_BUTTON) << " clicks)" << std::endl;
+
+            // how busy the thread that draws is and how busy CEF's UI thread is - with a single threaded loop they're
+            // the same thread, and CEF's share is the time spent in CefDoMessageLoopWork() (including painting)
+            double thread_cpu = threadCpuTime();
+            double render_thread_busy = thread_cpu - stats_thread_cpu_start;
+            double cef_thread_busy = stats.workTime - stats_previous.workTime;
+            if (gMessagePumpMode == MULTI_THREADED)
+            {
+                cef_thread_busy = gCefThreadCpuTime.load() - stats_cef_thread_cpu_start;
+                stats_cef_thread_cpu_start = gCefThreadCpuTime.load();
+                runOnUIThread([]()
+                {
+                    gCefThreadCpuTime.store(threadCpuTime());
+                });
+            }
+            else
+            {
+                render_thread_busy -= cef_thread_busy;
+            }
+            std::cout << "ThreadStats: render thread " << render_thread_busy / (now - stats_start) * 100.0 << "% busy, "
+                      << "CEF UI thread " << cef_thread_busy / (now - stats_start) * 100.0 << "% busy";
+            if (gMessagePumpMode == MULTI_THREADED)
+            {
+                MailboxStats mailbox_stats = gCefImpl->browsers().mailboxStats();
+                std::cout << ", " << mailbox_stats.published << " frames painted, " << mailbox_stats.taken << " drawn, "
+                          << mailbox_stats.skipped << " replaced before they were drawn so far";
+            }
+            std::cout << std::endl;
+
+            const InputQueueStats& input_stats = gInputQueue.stats();
+            std::cout << "InputStats: " << input_stats.received << " events from the window, " << input_stats.sent << " sent to CEF, "
+                      << "move to paint p50 " << gInputLatency.percentile(InputEvent::MOUSE_MOVE, 50) << " ms p99 " << gInputLatency.percentile(InputEvent::MOUSE_MOVE, 99) << " ms, "
+                      << "wheel to paint p50 " << gInputLatency.percentile(InputEvent::MOUSE_WHEEL, 50) << " ms p99 " << gInputLatency.percentile(InputEvent::MOUSE_WHEEL, 99) << " ms" << std::endl;
+
+            const RenderStats& render_stats = gRenderScheduler.stats();
+            const QuadRendererStats& renderer_stats = gQuadRenderer->stats();
+            size_t renderer_frames = renderer_stats.frames - renderer_previous.frames;
+            std::cout << "RenderStats: " << render_stats.presents / seconds << " presents/s, "
+                      << "present interval p50 " << samplePercentile(render_stats.presentIntervals, 50) << " ms p99 " << samplePercentile(render_stats.presentIntervals, 99) << " ms, "
+                      << render_stats.droppedFrames << " dropped frames, "
+                      << "paint to present p50 " << samplePercentile(render_stats.paintToPresent, 50) << " ms p99 " << samplePercentile(render_stats.paintToPresent, 99) << " ms, "
+                      << gQuadRenderer->name() << " renderer drew " << (renderer_frames ? (renderer_stats.quads - renderer_previous.quads) / renderer_frames : 0) << " quads in "
+                      << (renderer_frames ? (renderer_stats.drawCalls - renderer_previous.drawCalls) / renderer_frames : 0) << " draw calls a frame" << std::endl;
+
+            VisibilityStats visibility_stats = gCefImpl->browsers().visibilityStats();
+            std::cout << "VisibilityStats: " << visibility_stats.visible << " browsers visible, " << visibility_stats.background << " in the background, "
+                      << visibility_stats.hidden << " hidden, " << visibility_stats.changes << " changes so far" << std::endl;
+
+            if (gInstrumentation)
+            {
+                std::cout << "Instrumentation: (" << instrumentDroppedEvents() << " events dropped so far)" << std::endl;
+                instrument_summary.write(std::cout);
+                instrument_summary.reset();
+            }
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            stats_start = now;
+            stats_cpu_start = cpu;
+            stats_thread_cpu_start = thread_cpu;
+            stats_previous = stats;
+            renderer_previous = gQuadRenderer->stats();
+            gInputLatency.reset();
+            gInputQueue.resetStats();
+            gRenderScheduler.resetStats();
+        }
+    }
+
+    if (gMessagePumpMode != BUSY_LOOP)
+    {
+        timeEndPeriod(1);
+    }
 
-        glColor3f(1.0f, 1.0f, 1.0f);
-        glBegin(GL_QUADS);
+    if (! gInstrumentTraceFile.empty())
+    {
+        collectInstrumentEvents(trace_events);
+        if (writeChromeTrace(gInstrumentTraceFile, trace_events))
+        {
+            std::cout << "Wrote " << trace_events.size() << " events to " << gInstrumentTraceFile << std::endl;
+        }
+        else
         {
-            glTexCoord2f(1.0f, 0.0f);
-            glVertex2d(gWidth, 0);
-            glTexCoord2f(0.0f, 0.0f);
-            glVertex2d(0, 0);
-            glTexCoord2f(0.0f, 1.0f);
-            glVertex2d(0, gHeight);
-            glTexCoord2f(1.0f, 1.0f);
-            glVertex2d(gWidth, gHeight);
+            std::cout << "Unable to write trace to " << gInstrumentTraceFile << std::endl;
         }
-        glEnd();
+    }
+
+    if (gVideoCapture != nullptr)
+    {
+        gVideoCapture->close();
+        VideoCaptureStats capture_stats = gVideoCapture->stats();
+        std::cout << "CaptureStats: " << capture_stats.framesWritten << " frames written to " << gCaptureTarget << ", "
+                  << capture_stats.converted << " converted, " << capture_stats.duplicated << " repeated, " << capture_stats.dropped << " dropped, "
+                  << (capture_stats.convertSeconds > 0.0 ? capture_stats.pixelsConverted / capture_stats.convertSeconds / 1.0e6 : 0.0) << " Mpixels/s converted per core" << std::endl;
+        delete gVideoCapture;
+        gVideoCapture = nullptr;
+    }
 
-        SwapBuffers(hDC);
+    if (gThumbnailService != nullptr)
+    {
+        ThumbnailStats thumbnail_stats = gThumbnailService->stats();
+        std::cout << "ThumbnailStats: " << thumbnail_stats.thumbnails << " thumbnails made, " << thumbnail_stats.deferred << " deferred, "
+                  << (thumbnail_stats.downsampleSeconds > 0.0 ? thumbnail_stats.pixelsDownsampled / thumbnail_stats.downsampleSeconds / 1.0e6 : 0.0) << " Mpixels/s downsampled, "
+                  << thumbnail_stats.bytesEncoded / (thumbnail_stats.thumbnails > 0 ? thumbnail_stats.thumbnails : 1) << " bytes encoded per thumbnail in "
+                  << (thumbnail_stats.thumbnails > 0 ? thumbnail_stats.encodeSeconds * 1000.0 / thumbnail_stats.thumbnails : 0.0) << " ms" << std::endl;
+        delete gThumbnailService;
+        gThumbnailService = nullptr;
     }
 
     gCefImpl->shutdown();
+    gGLGarbage.release();
+
+    wglMakeCurrent(hDC, NULL);
+    wglDeleteContext(hRC);
+    ReleaseDC(hWnd, hDC);
+
+    LocalResourceStats resource_stats = gLocalResources->stats();
+    std::cout << "ResourceStats: " << resource_stats.packHits << " from the asset pack, " << resource_stats.cache.hits - resource_stats.expired << " from the cache, "
+              << resource_stats.cache.misses + resource_stats.expired << " fetched (" << resource_stats.expired << " gone stale), " << resource_stats.rangeRequests << " range requests, "
+              << resource_stats.cache.entries << " cached (" << resource_stats.cache.bytes / 1024 << "KB), " << resource_stats.cache.evictions << " evicted" << std::endl;
+    delete gLocalResources;
+    gLocalResources = nullptr;
+
+    delete gJobSystem;
+    gJobSystem = nullptr;
 
     fclose(outputConsole);
     FreeConsole();
@@ -0,0 +1,284 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "cef_resources.h"
+
+#include "cef_urlrequest.h"
+
+#include "instrument.h"
+
+#include <cstring>
+
+namespace
+{
+    bool sameHeaderName(const std::string& a, const char* b)
+    {
+        size_t length = strlen(b);
+        if (a.size() != length)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < length; ++i)
+        {
+            char c = (a[i] >= 'A' && a[i] <= 'Z') ? (char)(a[i] - 'A' + 'a') : a[i];
+            if (c != b[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // a response body in memory, a piece at a time
+    void readBody(const unsigned char* data, uint64_t length, uint64_t& offset, void* data_out, int bytes_to_read, int& bytes_read)
+    {
+        uint64_t remaining = length - offset;
+        bytes_read = (int)((remaining < (uint64_t)bytes_to_read) ? remaining : (uint64_t)bytes_to_read);
+        memcpy(data_out, data + offset, (size_t)bytes_read);
+        offset += bytes_read;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////
+    // something the asset pack or the cache had
+    class LocalHandler :
+        public CefResourceHandler
+    {
+        public:
+            LocalHandler(const LocalResponse& response) :
+                mResponse(response),
+                mOffset(0)
+            {
+            }
+
+            bool ProcessRequest(CefRefPtr<CefRequest> request, CefRefPtr<CefCallback> callback) override
+            {
+                callback->Continue();
+                return true;
+            }
+
+            void GetResponseHeaders(CefRefPtr<CefResponse> response, int64& response_length, CefString& redirectUrl) override
+            {
+                response->SetStatus(mResponse.status);
+                response->SetStatusText(mResponse.status == 200 ? "OK" : mResponse.status == 206 ? "Partial Content" : "Range Not Satisfiable");
+                response->SetMimeType(mResponse.mimeType);
+
+                // the headers the response was fetched with, less the ones that are about this answer's body
+                CefResponse::HeaderMap headers;
+                for (const auto& header : mResponse.headers)
+                {
+                    if (! sameHeaderName(header.first, "accept-ranges") && ! sameHeaderName(header.first, "content-range"))
+                    {
+                        headers.insert(std::make_pair(header.first, header.second));
+                    }
+                }
+                headers.insert(std::make_pair("Accept-Ranges", "bytes"));
+                if (! mResponse.contentRange.empty())
+                {
+                    headers.insert(std::make_pair("Content-Range", mResponse.contentRange));
+                }
+                response->SetHeaderMap(headers);
+
+                response_length = (int64)mResponse.length;
+            }
+
+            bool ReadResponse(void* data_out, int bytes_to_read, int& bytes_read, CefRefPtr<CefCallback> callback) override
+            {
+                if (mOffset >= mResponse.length)
+                {
+                    bytes_read = 0;
+                    return false;
+                }
+
+                readBody(mResponse.data, mResponse.length, mOffset, data_out, bytes_to_read, bytes_read);
+                return true;
+            }
+
+            void Cancel() override
+            {
+            }
+
+            IMPLEMENT_REFCOUNTING(LocalHandler);
+
+        private:
+            LocalResponse mResponse;
+            uint64_t mOffset;
+    };
+
+    /////////////////////////////////////////////////////////////////////////////////
+    // a GET under the cache's origin we didn't have - fetched whole from the network, then handed to CEF
+    // and kept if it says it can be
+    class FetchHandler :
+        public CefResourceHandler,
+        public CefURLRequestClient
+    {
+        public:
+            FetchHandler(LocalResources* resources) :
+                mResources(resources),
+                mStatus(0),
+                mOffset(0)
+            {
+            }
+
+            bool ProcessRequest(CefRefPtr<CefRequest> request, CefRefPtr<CefCallback> callback) override
+            {
+                // the request CEF gives us is read only
+                CefRefPtr<CefRequest> fetch = CefRequest::Create();
+                CefRequest::HeaderMap headers;
+                request->GetHeaderMap(headers);
+                fetch->Set(request->GetURL(), request->GetMethod(), nullptr, headers);
+                fetch->SetFlags(request->GetFlags());
+                fetch->SetFirstPartyForCookies(request->GetFirstPartyForCookies());
+
+                mURL = request->GetURL();
+                mCallback = callback;
+                mFetch = CefURLRequest::Create(fetch, this, nullptr);
+                return true;
+            }
+
+            void GetResponseHeaders(CefRefPtr<CefResponse> response, int64& response_length, CefString& redirectUrl) override
+            {
+                response->SetStatus(mStatus);
+                response->SetStatusText(mStatusText);
+                response->SetMimeType(mMimeType);
+                response->SetHeaderMap(mHeaders);
+                response_length = (int64)mBody.size();
+            }
+
+            bool ReadResponse(void* data_out, int bytes_to_read, int& bytes_read, CefRefPtr<CefCallback> callback) override
+            {
+                if (mOffset >= mBody.size())
+                {
+                    bytes_read = 0;
+                    return false;
+                }
+
+                readBody(mBody.data(), mBody.size(), mOffset, data_out, bytes_to_read, bytes_read);
+                return true;
+            }
+
+            void Cancel() override
+            {
+                if (mFetch)
+                {
+                    mFetch->Cancel();
+                }
+                mCallback = nullptr;
+            }
+
+            // CefURLRequestClient - all on the IO thread, like the handler
+            void OnRequestComplete(CefRefPtr<CefURLRequest> request) override
+            {
+                INSTRUMENT_SCOPE("resources.fetch_complete");
+
+                CefRefPtr<CefCallback> callback = mCallback;
+                mCallback = nullptr;
+                mFetch = nullptr;
+                if (! callback)
+                {
+                    return;
+                }
+
+                CefRefPtr<CefResponse> response = request->GetResponse();
+                if (request->GetRequestStatus() != UR_SUCCESS || ! response)
+                {
+                    callback->Cancel();
+                    return;
+                }
+
+                mStatus = response->GetStatus();
+                mStatusText = response->GetStatusText();
+                mMimeType = response->GetMimeType();
+
+                // the body we have is the whole of it, already decoded
+                CefResponse::HeaderMap headers;
+                response->GetHeaderMap(headers);
+                ResourceHeaders kept;
+                for (const auto& header : headers)
+                {
+                    std::string name = header.first;
+                    if (sameHeaderName(name, "content-length") || sameHeaderName(name, "content-encoding") ||
+                        sameHeaderName(name, "transfer-encoding"))
+                    {
+                        continue;
+                    }
+                    mHeaders.insert(header);
+                    kept.push_back(std::make_pair(name, header.second.ToString()));
+                }
+
+                double lifetime = 0.0;
+                if (mStatus == 200 && cacheLifetime(kept, lifetime))
+                {
+                    std::vector<unsigned char> body(mBody);
+                    mResources->store(mURL, mMimeType, kept, lifetime, std::move(body));
+                }
+
+                callback->Continue();
+            }
+
+            void OnUploadProgress(CefRefPtr<CefURLRequest> request, int64 current, int64 total) override
+            {
+            }
+
+            void OnDownloadProgress(CefRefPtr<CefURLRequest> request, int64 current, int64 total) override
+            {
+            }
+
+            void OnDownloadData(CefRefPtr<CefURLRequest> request, const void* data, size_t data_length) override
+            {
+                mBody.insert(mBody.end(), (const unsigned char*)data, (const unsigned char*)data + data_length);
+            }
+
+            bool GetAuthCredentials(bool isProxy, const CefString& host, int port, const CefString& realm,
+                                    const CefString& scheme, CefRefPtr<CefAuthCallback> callback) override
+            {
+                return false;
+            }
+
+            IMPLEMENT_REFCOUNTING(FetchHandler);
+
+        private:
+            LocalResources* mResources;
+            std::string mURL;
+            CefRefPtr<CefCallback> mCallback;
+            CefRefPtr<CefURLRequest> mFetch;
+
+            int mStatus;
+            CefString mStatusText;
+            CefString mMimeType;
+            CefResponse::HeaderMap mHeaders;
+            std::vector<unsigned char> mBody;
+            uint64_t mOffset;
+    };
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+CefRefPtr<CefResourceHandler> localResourceHandler(LocalResources* resources, CefRefPtr<CefRequest> request)
+{
+    if (resources == nullptr || request->GetMethod().ToString() != "GET")
+    {
+        return nullptr;
+    }
+
+    INSTRUMENT_SCOPE("resources.lookup");
+
+    std::string url = request->GetURL();
+    std::string range = request->GetHeaderByName("Range");
+    LocalResponse response;
+    if (resources->find(url, range, response))
+    {
+        return new LocalHandler(response);
+    }
+
+    // only what the cache is for - anything else might be a stream or a long poll, which CEF hands
+    // to the page as it arrives
+    if (! range.empty() || ! resources->cacheable(url))
+    {
+        return nullptr;
+    }
+    return new FetchHandler(resources);
+}
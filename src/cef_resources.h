@@ -0,0 +1,26 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _CEF_RESOURCES_H_
+#define _CEF_RESOURCES_H_
+
+#include "cef_client.h"
+
+#include "resource_cache.h"
+
+/////////////////////////////////////////////////////////////////////////////////
+// requests answered without going to the network - what both apps return from
+// CefRequestHandler::GetResourceHandler() (on CEF's IO thread). A GET we have
+// in the asset pack or the cache (see LocalResources) is served straight from
+// memory, Range requests included. Any other GET is fetched with a
+// CefURLRequest and kept in the cache on the way through so the next load
+// doesn't have to. nullptr - CEF does what it always does - for everything
+// else: other methods, and Range requests for things we don't have (media
+// streams), which we'd otherwise have to fetch all of to answer
+CefRefPtr<CefResourceHandler> localResourceHandler(LocalResources* resources, CefRefPtr<CefRequest> request);
+
+#endif // _CEF_RESOURCES_H_
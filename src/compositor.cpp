@@ -0,0 +1,435 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "compositor.h"
+#include "instrument.h"
+#include "job_system.h"
+#include "pixel_kernels.h"
+#include "tile_hasher.h"
+
+#include <algorithm>
+#include <cstring>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+Rect intersectRect(const Rect& a, const Rect& b)
+{
+    int x = std::max(a.x, b.x);
+    int y = std::max(a.y, b.y);
+    int right = std::min(a.x + a.width, b.x + b.width);
+    int bottom = std::min(a.y + a.height, b.y + b.height);
+
+    if (right <= x || bottom <= y)
+    {
+        return Rect();
+    }
+
+    return Rect(x, y, right - x, bottom - y);
+}
+
+Rect unionRect(const Rect& a, const Rect& b)
+{
+    int x = std::min(a.x, b.x);
+    int y = std::min(a.y, b.y);
+    int right = std::max(a.x + a.width, b.x + b.width);
+    int bottom = std::max(a.y + a.height, b.y + b.height);
+
+    return Rect(x, y, right - x, bottom - y);
+}
+
+// every rect costs an upload call so a few slightly bigger rects are cheaper than lots of small ones
+RectList coalesceDamage(const RectList& dirty_rects, const Rect& bounds, double merge_slack, size_t max_rects)
+{
+    RectList rects;
+    for (const Rect& rect : dirty_rects)
+    {
+        Rect clipped = intersectRect(rect, bounds);
+        if (! clipped.isEmpty())
+        {
+            rects.push_back(clipped);
+        }
+    }
+
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (size_t i = 0; i < rects.size() && ! merged; ++i)
+        {
+            for (size_t j = i + 1; j < rects.size(); ++j)
+            {
+                Rect combined = unionRect(rects[i], rects[j]);
+                double separate_area = (double)rects[i].area() + (double)rects[j].area();
+                if ((double)combined.area() <= separate_area * (1.0 + merge_slack))
+                {
+                    rects[i] = combined;
+                    rects.erase(rects.begin() + j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (rects.size() > max_rects)
+    {
+        Rect bounding = rects[0];
+        for (const Rect& rect : rects)
+        {
+            bounding = unionRect(bounding, rect);
+        }
+        rects.clear();
+        rects.push_back(bounding);
+    }
+
+    return rects;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+void SoftwareUploadBackend::resize(int width, int height)
+{
+    if (growSurface(width, height, mCapacityWidth, mCapacityHeight))
+    {
+        mPixels.assign((size_t)mCapacityWidth * mCapacityHeight * kDepth, 0);
+        mPixels.shrink_to_fit();
+        ++mReallocations;
+    }
+}
+
+void SoftwareUploadBackend::upload(const Rect& rect, const unsigned char* pixels, int stride)
+{
+    unsigned char* dst = mPixels.data() + ((size_t)rect.y * mCapacityWidth + rect.x) * kDepth;
+    for (int row = 0; row < rect.height; ++row)
+    {
+        memcpy(dst, pixels, (size_t)rect.width * kDepth);
+        pixels += (size_t)stride * kDepth;
+        dst += (size_t)mCapacityWidth * kDepth;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+Compositor::Compositor(UploadBackend* upload) :
+    mUpload(upload),
+    mPopupUpload(nullptr),
+    mPool(&defaultPixelPool()),
+    mJobs(nullptr),
+    mUploadTarget(upload),
+    mUploadSource(nullptr),
+    mUploadStride(0),
+    mWidth(0),
+    mHeight(0),
+    mPopupVisible(false),
+    mPopupLayerWidth(0),
+    mPopupLayerHeight(0),
+    mPopupBlending(false),
+    mDamageMergeSlack(0.25),
+    mMaxDamageRects(8)
+{
+}
+
+Compositor::~Compositor()
+{
+}
+
+void Compositor::setTileHashing(int tile_size)
+{
+    mTileHasher.reset(tile_size > 0 ? new TileHasher(tile_size) : nullptr);
+}
+
+const TileHasherStats& Compositor::tileStats() const
+{
+    static const TileHasherStats none;
+    return mTileHasher ? mTileHasher->stats() : none;
+}
+
+RectList Compositor::paintView(const RectList& dirty_rects, const unsigned char* buffer, int width, int height)
+{
+    INSTRUMENT_SCOPE("paint.view");
+
+    RectList damage;
+
+    // first paint or page changed size - nothing we have is valid any more
+    if (width != mWidth || height != mHeight)
+    {
+        mWidth = width;
+        mHeight = height;
+        // the whole page is damaged so there's no need to clear it - a size in the same size class
+        // keeps the same memory
+        if (! isLayered())
+        {
+            mPool->resize(mPagePixels, (size_t)width * height * kDepth);
+        }
+        mUpload->resize(width, height);
+        if (mTileHasher)
+        {
+            mTileHasher->resize(width, height);
+        }
+
+        damage.push_back(Rect(0, 0, width, height));
+    }
+    else
+    {
+        damage = coalesceDamage(dirty_rects, Rect(0, 0, width, height), mDamageMergeSlack, mMaxDamageRects);
+    }
+
+    // only the tiles whose pixels changed - the pieces that are left are merged again the same way
+    if (mTileHasher)
+    {
+        damage = coalesceDamage(mTileHasher->changedRects(damage, buffer), Rect(0, 0, width, height), mDamageMergeSlack, mMaxDamageRects);
+    }
+
+    // the popup isn't in the page so there's nothing to put back - upload straight from CEF's buffer
+    if (isLayered())
+    {
+        mUploadTarget = mUpload;
+        mUploadSource = buffer;
+        mUploadStride = width;
+        return damage;
+    }
+
+    mUploadTarget = mUpload;
+    mUploadSource = mPagePixels.data();
+    mUploadStride = mWidth;
+
+    // only copy the regions that changed - CEF leaves the rest of the buffer as it was
+    for (const Rect& rect : damage)
+    {
+        copyRect(buffer, width, rect.x, rect.y, mPagePixels.data(), mWidth, rect.x, rect.y, rect.width, rect.height);
+    }
+
+    // if there is still a popup open, write it back into the page where the page was just
+    // overwritten (it's pixels will have been copied into it's buffer by paintPopup() earlier)
+    if (! mPopupPixels.empty())
+    {
+        for (const Rect& rect : damage)
+        {
+            Rect overlap = intersectRect(rect, mPopupRect);
+            if (! overlap.isEmpty())
+            {
+                // the page under the popup just changed - remember it before the popup goes on top
+                if (! mPopupBacking.empty())
+                {
+                    copyRect(mPagePixels.data(), mWidth, overlap.x, overlap.y,
+                             mPopupBacking.data(), mPopupRect.width, overlap.x - mPopupRect.x, overlap.y - mPopupRect.y,
+                             overlap.width, overlap.height);
+                }
+
+                compositePopup(Rect(overlap.x - mPopupRect.x, overlap.y - mPopupRect.y, overlap.width, overlap.height));
+            }
+        }
+    }
+
+    return damage;
+}
+
+RectList Compositor::paintPopup(const RectList& dirty_rects, const unsigned char* buffer, int width, int height)
+{
+    INSTRUMENT_SCOPE("paint.popup");
+
+    RectList damage;
+
+    if (isLayered())
+    {
+        if (mPopupRect.isEmpty())
+        {
+            return damage;
+        }
+
+        // the popup layer only changes size when the popup does
+        if (width != mPopupLayerWidth || height != mPopupLayerHeight)
+        {
+            mPopupLayerWidth = width;
+            mPopupLayerHeight = height;
+            mPopupUpload->resize(width, height);
+
+            damage.push_back(Rect(0, 0, width, height));
+        }
+        else
+        {
+            damage = coalesceDamage(dirty_rects, Rect(0, 0, width, height), mDamageMergeSlack, mMaxDamageRects);
+        }
+
+        mUploadTarget = mPopupUpload;
+        mUploadSource = buffer;
+        mUploadStride = width;
+        return damage;
+    }
+
+    // popup buffer is created in popupSize() as we know the size there
+    if (mPopupPixels.empty() || mPagePixels.empty())
+    {
+        return damage;
+    }
+
+    mUploadTarget = mUpload;
+    mUploadSource = mPagePixels.data();
+    mUploadStride = mWidth;
+
+    // dirty rects for a popup are relative to the popup itself
+    Rect popup_bounds(0, 0, std::min(width, mPopupRect.width), std::min(height, mPopupRect.height));
+    RectList popup_damage = coalesceDamage(dirty_rects, popup_bounds, mDamageMergeSlack, mMaxDamageRects);
+
+    // copy over the changed popup pixels into it's buffer and then into the page pixels. We need this for
+    // when popup is changing (e.g. highlighting or scrolling) when the containing page is not changing and
+    // therefore doesn't get a paintView() update
+    for (const Rect& rect : popup_damage)
+    {
+        copyRect(buffer, width, rect.x, rect.y, mPopupPixels.data(), mPopupRect.width, rect.x, rect.y, rect.width, rect.height);
+
+        // the popup can hang off the edge of the page
+        Rect on_page = compositePopup(rect);
+        if (! on_page.isEmpty())
+        {
+            damage.push_back(on_page);
+        }
+    }
+
+    return damage;
+}
+
+void Compositor::popupShow(bool show)
+{
+    mPopupVisible = show;
+    if (! show)
+    {
+        // CEF repaints the page where the popup was with the same pixels it had before - they still need
+        // copying over the popup
+        if (mTileHasher && ! isLayered())
+        {
+            mTileHasher->invalidate(mPopupRect);
+        }
+
+        mPopupPixels.clear();
+        mPopupBacking.clear();
+        mPopupRect = Rect();
+    }
+}
+
+void Compositor::popupSize(const Rect& rect)
+{
+    // same again for wherever the popup moved away from
+    if (mTileHasher && ! isLayered())
+    {
+        mTileHasher->invalidate(mPopupRect);
+    }
+
+    mPopupRect = rect;
+
+    // a popup layer gets its pixels straight from CEF
+    if (isLayered())
+    {
+        return;
+    }
+
+    // a popup that changes size while it's open keeps its buffer if the new size fits the same size class
+    mPool->resize(mPopupPixels, rect.area() * kDepth);
+    memset(mPopupPixels.data(), 0, mPopupPixels.size());
+
+    // start from whatever the page has there now - CEF repaints the page under a popup as it opens anyway
+    if (mPopupBlending)
+    {
+        mPool->resize(mPopupBacking, rect.area() * kDepth);
+        blitRect(mPagePixels.data(), mWidth, mHeight, rect, mPopupBacking.data(), rect.width, rect.height, 0, 0, BLIT_COPY);
+    }
+}
+
+void Compositor::upload(const RectList& damage)
+{
+    if (damage.empty() || mUploadSource == nullptr)
+    {
+        return;
+    }
+
+    INSTRUMENT_SCOPE("paint.upload");
+
+    mUploadTarget->beginUpload();
+    for (const Rect& rect : damage)
+    {
+        const unsigned char* src = mUploadSource + ((size_t)rect.y * mUploadStride + rect.x) * kDepth;
+        mUploadTarget->upload(rect, src, mUploadStride);
+
+        mStats.frameBytesUploaded += rect.area() * kDepth;
+    }
+    mUploadTarget->endUpload();
+
+    INSTRUMENT_COUNTER("paint.bytes_uploaded", mStats.frameBytesUploaded);
+}
+
+void Compositor::endFrame()
+{
+    ++mStats.frames;
+    mStats.totalBytesCopied += mStats.frameBytesCopied;
+    mStats.totalBytesUploaded += mStats.frameBytesUploaded;
+
+    mStats.frameBytesCopied = 0;
+    mStats.frameBytesUploaded = 0;
+
+    // CEF's buffer is only valid during the paint
+    mUploadSource = nullptr;
+}
+
+void Compositor::copyRect(const unsigned char* src, int src_stride, int src_x, int src_y,
+                          unsigned char* dst, int dst_stride, int dst_x, int dst_y,
+                          int width, int height)
+{
+    forEachBand(width, height, [=](int first_row, int last_row)
+    {
+        const unsigned char* src_row = src + ((size_t)(src_y + first_row) * src_stride + src_x) * kDepth;
+        unsigned char* dst_row = dst + ((size_t)(dst_y + first_row) * dst_stride + dst_x) * kDepth;
+        for (int row = first_row; row < last_row; ++row)
+        {
+            memcpy(dst_row, src_row, (size_t)width * kDepth);
+            src_row += (size_t)src_stride * kDepth;
+            dst_row += (size_t)dst_stride * kDepth;
+        }
+    });
+
+    mStats.frameBytesCopied += (size_t)width * height * kDepth;
+}
+
+void Compositor::forEachBand(int width, int height, const std::function<void(int, int)>& band)
+{
+    size_t row_bytes = (size_t)(width > 0 ? width : 1) * kDepth;
+    if (mJobs == nullptr || row_bytes * height < kParallelCopyBytes)
+    {
+        band(0, height);
+        return;
+    }
+
+    INSTRUMENT_SCOPE("paint.parallel_copy");
+    mJobs->parallelFor(0, height, (int)((kParallelBandBytes + row_bytes - 1) / row_bytes), band);
+}
+
+Rect Compositor::compositePopup(const Rect& rect)
+{
+    INSTRUMENT_SCOPE("paint.popup_blit");
+
+    // blending is switched on for a popup when it opens
+    bool blend = ! mPopupBacking.empty();
+
+    // blitRect() clips each band on its own - the bands' rows on the page add up to the whole
+    Rect on_page = intersectRect(Rect(mPopupRect.x + rect.x, mPopupRect.y + rect.y, rect.width, rect.height), Rect(0, 0, mWidth, mHeight));
+    forEachBand(rect.width, rect.height, [=](int first_row, int last_row)
+    {
+        Rect band(rect.x, rect.y + first_row, rect.width, last_row - first_row);
+        if (blend)
+        {
+            // blending over what's there already would blend the popup over itself - put the page back first
+            blitRect(mPopupBacking.data(), mPopupRect.width, mPopupRect.height, band,
+                     mPagePixels.data(), mWidth, mHeight, mPopupRect.x + band.x, mPopupRect.y + band.y, BLIT_COPY);
+        }
+
+        blitRect(mPopupPixels.data(), mPopupRect.width, mPopupRect.height, band,
+                 mPagePixels.data(), mWidth, mHeight, mPopupRect.x + band.x, mPopupRect.y + band.y,
+                 blend ? BLIT_BLEND : BLIT_COPY);
+    });
+
+    mStats.frameBytesCopied += on_page.area() * kDepth;
+    return on_page;
+}
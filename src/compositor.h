@@ -0,0 +1,323 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _COMPOSITOR_H_
+#define _COMPOSITOR_H_
+
+#include "pixel_pool.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class JobSystem;
+
+/////////////////////////////////////////////////////////////////////////////////
+// the compositor has no CEF, OS or OpenGL dependencies so it can be driven
+// by the app (from RenderHandler::OnPaint) or by the headless benchmarks
+const int kDepth = 4;
+
+struct Rect
+{
+    Rect() : x(0), y(0), width(0), height(0) {}
+    Rect(int x_, int y_, int width_, int height_) : x(x_), y(y_), width(width_), height(height_) {}
+
+    bool isEmpty() const
+    {
+        return width <= 0 || height <= 0;
+    }
+
+    size_t area() const
+    {
+        return isEmpty() ? 0 : (size_t)width * height;
+    }
+
+    int x;
+    int y;
+    int width;
+    int height;
+};
+typedef std::vector<Rect> RectList;
+
+Rect intersectRect(const Rect& a, const Rect& b);
+Rect unionRect(const Rect& a, const Rect& b);
+
+// clip rects to bounds and merge the ones whose union doesn't waste more than merge_slack of their
+// combined area - if there are still more than max_rects left, return their bounding box instead
+RectList coalesceDamage(const RectList& dirty_rects, const Rect& bounds, double merge_slack, size_t max_rects);
+
+// a copy smaller than this isn't worth splitting across threads (see Compositor::setJobSystem()) - and bands
+// are no smaller than kParallelBandBytes
+const size_t kParallelCopyBytes = 512 * 1024;
+const size_t kParallelBandBytes = 128 * 1024;
+
+/////////////////////////////////////////////////////////////////////////////////
+// where the composited page ends up - an OpenGL texture in the app, nothing or
+// a plain memory buffer in the benchmarks
+class UploadBackend
+{
+    public:
+        virtual ~UploadBackend() {}
+
+        // the page changed size - (re)create whatever storage is needed
+        virtual void resize(int width, int height) = 0;
+
+        // bracket the upload() calls for one paint so backends can batch them up
+        virtual void beginUpload() {}
+        virtual void endUpload() {}
+
+        // upload a block of the page - pixels points at the top left of rect and stride is in pixels
+        virtual void upload(const Rect& rect, const unsigned char* pixels, int stride) = 0;
+
+        // bytes held on to by the backend (texture, staging buffers etc.)
+        virtual size_t memoryUsage() const
+        {
+            return 0;
+        }
+};
+
+// discards everything - measures the cost of compositing on its own
+class NullUploadBackend :
+    public UploadBackend
+{
+    public:
+        void resize(int /*width*/, int /*height*/) override {}
+        void upload(const Rect& /*rect*/, const unsigned char* /*pixels*/, int /*stride*/) override {}
+};
+
+// copies into a buffer the size of the page - stands in for the copy a GL driver makes. The
+// buffer grows the way the app's textures do (see growSurface())
+class SoftwareUploadBackend :
+    public UploadBackend
+{
+    public:
+        SoftwareUploadBackend() : mCapacityWidth(0), mCapacityHeight(0), mReallocations(0) {}
+
+        void resize(int width, int height) override;
+        void upload(const Rect& rect, const unsigned char* pixels, int stride) override;
+
+        size_t memoryUsage() const override
+        {
+            return mPixels.capacity();
+        }
+
+        // rows are capacityWidth() pixels apart
+        const unsigned char* pixels() const
+        {
+            return mPixels.data();
+        }
+
+        int capacityWidth() const
+        {
+            return mCapacityWidth;
+        }
+
+        // times the buffer had to be made again
+        size_t reallocations() const
+        {
+            return mReallocations;
+        }
+
+    private:
+        int mCapacityWidth;
+        int mCapacityHeight;
+        size_t mReallocations;
+        std::vector<unsigned char> mPixels;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+struct CompositorStats
+{
+    CompositorStats() :
+        frameBytesCopied(0),
+        frameBytesUploaded(0),
+        frames(0),
+        totalBytesCopied(0),
+        totalBytesUploaded(0)
+    {
+    }
+
+    size_t frameBytesCopied;
+    size_t frameBytesUploaded;
+
+    size_t frames;
+    size_t totalBytesCopied;
+    size_t totalBytesUploaded;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// holds the page pixels and the popup (e.g. <select> dropdown) pixels CEF hands
+// us separately, keeps the popup composited on top of the page and pushes the
+// parts that changed to the upload backend
+class TileHasher;
+struct TileHasherStats;
+
+class Compositor
+{
+    public:
+        Compositor(UploadBackend* upload);
+        ~Compositor();
+
+        // dirty rects that are within this fraction of their combined area are merged
+        void setDamageMergeSlack(double slack)
+        {
+            mDamageMergeSlack = slack;
+        }
+
+        // past this many rects after merging, use the bounding box
+        void setMaxDamageRects(size_t max_rects)
+        {
+            mMaxDamageRects = max_rects;
+        }
+
+        // blend the popup over the page instead of copying it - for translucent popups. Keeps a copy
+        // of the page under the popup so the popup can be blended again when only it changes. Takes
+        // effect from the next popup that opens
+        void setPopupBlending(bool blend)
+        {
+            mPopupBlending = blend;
+        }
+
+        // keep the popup as a layer of its own instead of compositing it into the page - popup paints
+        // go to popup_upload and the caller draws the popup over the page (see popupRect()). Both layers
+        // upload straight from CEF's buffer so nothing is copied and pixels() has nothing in it. Set it
+        // before the first paint - null composites the popup into the page as before
+        void setPopupLayer(UploadBackend* popup_upload)
+        {
+            mPopupUpload = popup_upload;
+        }
+
+        // where page and popup buffers come from - defaultPixelPool() unless this is called before the first paint
+        void setPixelPool(PixelPool* pool)
+        {
+            mPool = pool;
+        }
+
+        // split copies and popup blits of kParallelCopyBytes and up into bands of rows on jobs - null
+        // (the default) does everything on the calling thread. The compositor can only be used from
+        // one thread at a time either way
+        void setJobSystem(JobSystem* jobs)
+        {
+            mJobs = jobs;
+        }
+
+        // hash the page in tile_size x tile_size tiles (see tile_hasher.h) and only copy and upload the
+        // tiles CEF's pixels actually changed in - a page paint that changed nothing has no damage. Set it
+        // before the first paint - 0 (the default) copies everything CEF says is dirty
+        void setTileHashing(int tile_size);
+
+        // all zeros when tile hashing is off
+        const TileHasherStats& tileStats() const;
+
+        bool isLayered() const
+        {
+            return mPopupUpload != nullptr;
+        }
+
+        // the equivalents of CefRenderHandler::OnPaint for PET_VIEW and PET_POPUP - both return
+        // the regions that need uploading, in page coordinates (popup coordinates for a popup layer)
+        RectList paintView(const RectList& dirty_rects, const unsigned char* buffer, int width, int height);
+        RectList paintPopup(const RectList& dirty_rects, const unsigned char* buffer, int width, int height);
+
+        // the equivalents of CefRenderHandler::OnPopupShow and OnPopupSize
+        void popupShow(bool show);
+        void popupSize(const Rect& rect);
+
+        // push the regions returned by the last paintView() or paintPopup() to their upload backend -
+        // call it before the buffer CEF passed in goes away
+        void upload(const RectList& damage);
+
+        // where the popup goes on the page and whether it's open
+        const Rect& popupRect() const
+        {
+            return mPopupRect;
+        }
+
+        bool popupVisible() const
+        {
+            return mPopupVisible;
+        }
+
+        // roll the per-frame counters into the totals
+        void endFrame();
+
+        const unsigned char* pixels() const
+        {
+            return mPagePixels.data();
+        }
+
+        int width() const
+        {
+            return mWidth;
+        }
+
+        int height() const
+        {
+            return mHeight;
+        }
+
+        const CompositorStats& stats() const
+        {
+            return mStats;
+        }
+
+        // bytes held for page and popup pixels
+        size_t memoryUsage() const
+        {
+            return mPagePixels.capacity() + mPopupPixels.capacity() + mPopupBacking.capacity();
+        }
+
+    private:
+        // copy a width x height block of pixels from one buffer to another - strides are in pixels
+        void copyRect(const unsigned char* src, int src_stride, int src_x, int src_y,
+                      unsigned char* dst, int dst_stride, int dst_x, int dst_y,
+                      int width, int height);
+
+        // copy or blend part of the popup (in popup coordinates) onto the page, clipped to the page
+        Rect compositePopup(const Rect& rect);
+
+        // band(first_row, last_row) over the rows of a width x height block, on the job system if it's big enough
+        void forEachBand(int width, int height, const std::function<void(int, int)>& band);
+
+        UploadBackend* mUpload;
+        UploadBackend* mPopupUpload;
+        PixelPool* mPool;
+        JobSystem* mJobs;
+
+        // what the next upload() reads from and where it goes
+        UploadBackend* mUploadTarget;
+        const unsigned char* mUploadSource;
+        int mUploadStride;
+
+        int mWidth;
+        int mHeight;
+        PixelBuffer mPagePixels;
+
+        Rect mPopupRect;
+        bool mPopupVisible;
+        PixelBuffer mPopupPixels;
+
+        // size of the popup layer's texture
+        int mPopupLayerWidth;
+        int mPopupLayerHeight;
+
+        // the page pixels under the popup (only when blending)
+        bool mPopupBlending;
+        PixelBuffer mPopupBacking;
+
+        double mDamageMergeSlack;
+        size_t mMaxDamageRects;
+
+        // null unless tile hashing is on
+        std::unique_ptr<TileHasher> mTileHasher;
+
+        CompositorStats mStats;
+};
+
+#endif // _COMPOSITOR_H_
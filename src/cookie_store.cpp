@@ -0,0 +1,737 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "cookie_store.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+    double nowMilliseconds()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // no batch size is no batching, and no post function runs everything where it's called from
+    CookieTransferSettings checkedSettings(const CookieTransferSettings& settings)
+    {
+        CookieTransferSettings checked = settings;
+        checked.batchSize = (checked.batchSize < 1) ? 1 : checked.batchSize;
+        if (! checked.post)
+        {
+            checked.post = [](const std::function<void()>& task)
+            {
+                task();
+            };
+        }
+        return checked;
+    }
+
+    /////////////////////////////////////////////////////////////////////////////////
+    // just enough JSON for a line of a cookie file
+    void appendString(std::string& json, const std::string& text)
+    {
+        json += '"';
+        for (unsigned char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                json += '\\';
+                json += (char)c;
+            }
+            else if (c < 0x20)
+            {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                json += escaped;
+            }
+            else
+            {
+                json += (char)c;
+            }
+        }
+        json += '"';
+    }
+
+    void appendNumber(std::string& json, double value)
+    {
+        char number[32];
+        snprintf(number, sizeof(number), "%.17g", value);
+        json += number;
+    }
+
+    void appendUTF8(std::string& text, unsigned int code)
+    {
+        if (code < 0x80)
+        {
+            text += (char)code;
+        }
+        else if (code < 0x800)
+        {
+            text += (char)(0xc0 | (code >> 6));
+            text += (char)(0x80 | (code & 0x3f));
+        }
+        else if (code < 0x10000)
+        {
+            text += (char)(0xe0 | (code >> 12));
+            text += (char)(0x80 | ((code >> 6) & 0x3f));
+            text += (char)(0x80 | (code & 0x3f));
+        }
+        else
+        {
+            text += (char)(0xf0 | (code >> 18));
+            text += (char)(0x80 | ((code >> 12) & 0x3f));
+            text += (char)(0x80 | ((code >> 6) & 0x3f));
+            text += (char)(0x80 | (code & 0x3f));
+        }
+    }
+
+    class JsonLine
+    {
+        public:
+            JsonLine(const std::string& line) :
+                mText(line),
+                mPos(0)
+            {
+            }
+
+            void skipSpace()
+            {
+                while (mPos < mText.size() && (mText[mPos] == ' ' || mText[mPos] == '\t' || mText[mPos] == '\r'))
+                {
+                    ++mPos;
+                }
+            }
+
+            bool consume(char c)
+            {
+                skipSpace();
+                if (mPos < mText.size() && mText[mPos] == c)
+                {
+                    ++mPos;
+                    return true;
+                }
+                return false;
+            }
+
+            bool atEnd()
+            {
+                skipSpace();
+                return mPos == mText.size();
+            }
+
+            bool parseHex(unsigned int& code)
+            {
+                if (mPos + 4 > mText.size())
+                {
+                    return false;
+                }
+                code = (unsigned int)strtoul(mText.substr(mPos, 4).c_str(), nullptr, 16);
+                mPos += 4;
+                return true;
+            }
+
+            bool parseString(std::string& text)
+            {
+                if (! consume('"'))
+                {
+                    return false;
+                }
+
+                text.clear();
+                while (mPos < mText.size())
+                {
+                    char c = mText[mPos++];
+                    if (c == '"')
+                    {
+                        return true;
+                    }
+                    if (c != '\\')
+                    {
+                        text += c;
+                        continue;
+                    }
+                    if (mPos >= mText.size())
+                    {
+                        return false;
+                    }
+
+                    char escaped = mText[mPos++];
+                    unsigned int code = 0;
+                    switch (escaped)
+                    {
+                        case 'b': text += '\b'; break;
+                        case 'f': text += '\f'; break;
+                        case 'n': text += '\n'; break;
+                        case 'r': text += '\r'; break;
+                        case 't': text += '\t'; break;
+                        case 'u':
+                            if (! parseHex(code))
+                            {
+                                return false;
+                            }
+                            // the second half of a surrogate pair follows the first
+                            if (code >= 0xd800 && code < 0xdc00)
+                            {
+                                if (mText.compare(mPos, 2, "\\u") != 0)
+                                {
+                                    return false;
+                                }
+                                mPos += 2;
+
+                                unsigned int low = 0;
+                                if (! parseHex(low) || low < 0xdc00 || low >= 0xe000)
+                                {
+                                    return false;
+                                }
+                                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                            }
+                            appendUTF8(text, code);
+                            break;
+                        default: text += escaped; break;
+                    }
+                }
+                return false;
+            }
+
+            // a number, true, false or null - null is 0
+            bool parseValue(double& value)
+            {
+                skipSpace();
+                if (mText.compare(mPos, 4, "true") == 0 || mText.compare(mPos, 4, "null") == 0)
+                {
+                    value = (mText[mPos] == 't') ? 1.0 : 0.0;
+                    mPos += 4;
+                    return true;
+                }
+                if (mText.compare(mPos, 5, "false") == 0)
+                {
+                    value = 0.0;
+                    mPos += 5;
+                    return true;
+                }
+
+                const char* start = mText.c_str() + mPos;
+                char* end = nullptr;
+                value = strtod(start, &end);
+                if (end == start)
+                {
+                    return false;
+                }
+                mPos += end - start;
+                return true;
+            }
+
+            bool peekString()
+            {
+                skipSpace();
+                return mPos < mText.size() && mText[mPos] == '"';
+            }
+
+        private:
+            const std::string& mText;
+            size_t mPos;
+    };
+
+    /////////////////////////////////////////////////////////////////////////////////
+    //
+    class Import :
+        public std::enable_shared_from_this<Import>
+    {
+        public:
+            Import(CookieStore& store, const CookieTransferSettings& settings) :
+                mStore(store),
+                mSettings(checkedSettings(settings)),
+                mOutstanding(0),
+                mFailed(0),
+                mStart(nowMilliseconds())
+            {
+            }
+
+            bool start(const std::string& file_name)
+            {
+                double start = nowMilliseconds();
+                if (! mReader.open(file_name))
+                {
+                    return false;
+                }
+
+                mReader.read(mBatch, mSettings.batchSize);
+                mStats.ownerMilliseconds += nowMilliseconds() - start;
+                issue();
+                return true;
+            }
+
+        private:
+            // set this batch and read the next one while it's being set - on the owner's thread
+            void issue()
+            {
+                if (mBatch.empty())
+                {
+                    finish();
+                    return;
+                }
+
+                double start = nowMilliseconds();
+                std::shared_ptr<Import> self = shared_from_this();
+
+                // one more than the batch so it isn't finished until we've finished sending it
+                mOutstanding = mBatch.size() + 1;
+                for (const CookieRecord& cookie : mBatch)
+                {
+                    mStore.setCookie(cookie, [self](bool success)
+                    {
+                        if (! success)
+                        {
+                            ++self->mFailed;
+                        }
+                        self->release();
+                    });
+                }
+                mStats.cookies += mBatch.size();
+
+                mNext.clear();
+                mReader.read(mNext, mSettings.batchSize);
+                mStats.ownerMilliseconds += nowMilliseconds() - start;
+
+                release();
+            }
+
+            // any thread - flushes once the whole batch has been set
+            void release()
+            {
+                if (--mOutstanding != 0)
+                {
+                    return;
+                }
+
+                std::shared_ptr<Import> self = shared_from_this();
+                mStore.flush([self]()
+                {
+                    self->mSettings.post([self]()
+                    {
+                        self->flushed();
+                    });
+                });
+            }
+
+            void flushed()
+            {
+                double start = nowMilliseconds();
+                ++mStats.batches;
+                ++mStats.flushes;
+                mStats.failed = mFailed;
+                mStats.skipped = mReader.skipped();
+                mStats.milliseconds = nowMilliseconds() - mStart;
+                if (mSettings.progress)
+                {
+                    mSettings.progress(mStats);
+                }
+
+                mBatch.swap(mNext);
+                mStats.ownerMilliseconds += nowMilliseconds() - start;
+                issue();
+            }
+
+            void finish()
+            {
+                mReader.close();
+                mStats.failed = mFailed;
+                mStats.skipped = mReader.skipped();
+                mStats.milliseconds = nowMilliseconds() - mStart;
+                mStats.finished = true;
+                if (mSettings.done)
+                {
+                    mSettings.done(mStats);
+                }
+            }
+
+            CookieStore& mStore;
+            CookieTransferSettings mSettings;
+            CookieReader mReader;
+
+            std::vector<CookieRecord> mBatch;
+            std::vector<CookieRecord> mNext;
+            std::atomic<size_t> mOutstanding;
+            std::atomic<size_t> mFailed;
+
+            // the owner's thread only
+            CookieTransferStats mStats;
+            double mStart;
+    };
+
+    /////////////////////////////////////////////////////////////////////////////////
+    //
+    class Export :
+        public std::enable_shared_from_this<Export>
+    {
+        public:
+            Export(CookieStore& store, const CookieTransferSettings& settings) :
+                mStore(store),
+                mSettings(checkedSettings(settings)),
+                mStart(nowMilliseconds())
+            {
+            }
+
+            bool start(const std::string& file_name)
+            {
+                if (! mWriter.open(file_name))
+                {
+                    return false;
+                }
+
+                std::shared_ptr<Export> self = shared_from_this();
+                bool ok = mStore.visitAll([self](const CookieRecord& cookie)
+                {
+                    self->visited(cookie);
+                },
+                [self]()
+                {
+                    self->visitDone();
+                });
+
+                if (! ok)
+                {
+                    mWriter.close();
+                }
+                return ok;
+            }
+
+        private:
+            typedef std::shared_ptr<std::vector<CookieRecord>> Batch;
+
+            // the store's thread - handed to the owner's thread to write a batch at a time
+            void visited(const CookieRecord& cookie)
+            {
+                Batch full;
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    if (! mPending)
+                    {
+                        mPending = std::make_shared<std::vector<CookieRecord>>();
+                        mPending->reserve(mSettings.batchSize);
+                    }
+                    mPending->push_back(cookie);
+                    if (mPending->size() >= mSettings.batchSize)
+                    {
+                        full.swap(mPending);
+                    }
+                }
+
+                if (full)
+                {
+                    std::shared_ptr<Export> self = shared_from_this();
+                    mSettings.post([self, full]()
+                    {
+                        self->write(*full);
+                    });
+                }
+            }
+
+            void visitDone()
+            {
+                Batch rest;
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    rest.swap(mPending);
+                }
+
+                std::shared_ptr<Export> self = shared_from_this();
+                mSettings.post([self, rest]()
+                {
+                    if (rest)
+                    {
+                        self->write(*rest);
+                    }
+                    self->finish();
+                });
+            }
+
+            void write(const std::vector<CookieRecord>& batch)
+            {
+                double start = nowMilliseconds();
+                for (const CookieRecord& cookie : batch)
+                {
+                    mWriter.write(cookie);
+                }
+                mStats.cookies += batch.size();
+                ++mStats.batches;
+                mStats.milliseconds = nowMilliseconds() - mStart;
+                mStats.ownerMilliseconds += nowMilliseconds() - start;
+                if (mSettings.progress)
+                {
+                    mSettings.progress(mStats);
+                }
+            }
+
+            void finish()
+            {
+                double start = nowMilliseconds();
+                mStats.ok = mWriter.close();
+                mStats.ownerMilliseconds += nowMilliseconds() - start;
+                mStats.milliseconds = nowMilliseconds() - mStart;
+                mStats.finished = true;
+                if (mSettings.done)
+                {
+                    mSettings.done(mStats);
+                }
+            }
+
+            CookieStore& mStore;
+            CookieTransferSettings mSettings;
+            CookieWriter mWriter;
+
+            std::mutex mMutex;
+            Batch mPending;
+
+            // the owner's thread only
+            CookieTransferStats mStats;
+            double mStart;
+    };
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+bool operator==(const CookieRecord& a, const CookieRecord& b)
+{
+    return a.name == b.name && a.value == b.value && a.domain == b.domain && a.path == b.path &&
+           a.secure == b.secure && a.httpOnly == b.httpOnly && a.hasExpires == b.hasExpires &&
+           (! a.hasExpires || a.expires == b.expires) && a.creation == b.creation && a.lastAccess == b.lastAccess;
+}
+
+std::string cookieToJson(const CookieRecord& cookie)
+{
+    std::string json;
+    json.reserve(128 + cookie.name.size() + cookie.value.size() + cookie.domain.size() + cookie.path.size());
+
+    json += "{\"name\":";
+    appendString(json, cookie.name);
+    json += ",\"value\":";
+    appendString(json, cookie.value);
+    json += ",\"domain\":";
+    appendString(json, cookie.domain);
+    json += ",\"path\":";
+    appendString(json, cookie.path);
+    json += cookie.secure ? ",\"secure\":true" : ",\"secure\":false";
+    json += cookie.httpOnly ? ",\"httponly\":true" : ",\"httponly\":false";
+    if (cookie.hasExpires)
+    {
+        json += ",\"expires\":";
+        appendNumber(json, cookie.expires);
+    }
+    json += ",\"creation\":";
+    appendNumber(json, cookie.creation);
+    json += ",\"last_access\":";
+    appendNumber(json, cookie.lastAccess);
+    json += "}";
+    return json;
+}
+
+bool cookieFromJson(const std::string& line, CookieRecord& cookie)
+{
+    JsonLine json(line);
+    if (! json.consume('{'))
+    {
+        return false;
+    }
+
+    cookie = CookieRecord();
+    bool have_name = false;
+    bool have_domain = false;
+    bool first = true;
+    while (! json.consume('}'))
+    {
+        std::string key;
+        if ((! first && ! json.consume(',')) || ! json.parseString(key) || ! json.consume(':'))
+        {
+            return false;
+        }
+        first = false;
+
+        std::string* text = (key == "name") ? &cookie.name : (key == "value") ? &cookie.value :
+                            (key == "domain") ? &cookie.domain : (key == "path") ? &cookie.path : nullptr;
+        if (json.peekString())
+        {
+            std::string value;
+            if (! json.parseString(value))
+            {
+                return false;
+            }
+            if (text != nullptr)
+            {
+                *text = value;
+            }
+            have_name = have_name || key == "name";
+            have_domain = have_domain || key == "domain";
+            continue;
+        }
+
+        double value = 0.0;
+        if (text != nullptr || ! json.parseValue(value))
+        {
+            return false;
+        }
+
+        if (key == "secure")
+        {
+            cookie.secure = value != 0.0;
+        }
+        else if (key == "httponly")
+        {
+            cookie.httpOnly = value != 0.0;
+        }
+        else if (key == "expires")
+        {
+            cookie.hasExpires = true;
+            cookie.expires = value;
+        }
+        else if (key == "creation")
+        {
+            cookie.creation = value;
+        }
+        else if (key == "last_access")
+        {
+            cookie.lastAccess = value;
+        }
+    }
+
+    return json.atEnd() && have_name && have_domain;
+}
+
+std::string cookieURL(const CookieRecord& cookie)
+{
+    std::string host = cookie.domain;
+    if (! host.empty() && host[0] == '.')
+    {
+        host.erase(0, 1);
+    }
+    std::string path = cookie.path.empty() ? "/" : cookie.path;
+    return (cookie.secure ? "https://" : "http://") + host + (path[0] == '/' ? "" : "/") + path;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+CookieReader::CookieReader() :
+    mFile(nullptr),
+    mSkipped(0)
+{
+}
+
+CookieReader::~CookieReader()
+{
+    close();
+}
+
+bool CookieReader::open(const std::string& file_name)
+{
+    close();
+    mFile = fopen(file_name.c_str(), "rb");
+    mSkipped = 0;
+    return mFile != nullptr;
+}
+
+void CookieReader::close()
+{
+    if (mFile)
+    {
+        fclose(mFile);
+        mFile = nullptr;
+    }
+}
+
+size_t CookieReader::read(std::vector<CookieRecord>& cookies, size_t count)
+{
+    size_t added = 0;
+    char chunk[4096];
+    while (mFile && added < count && fgets(chunk, sizeof(chunk), mFile))
+    {
+        mLine += chunk;
+        if (mLine.empty() || (mLine[mLine.size() - 1] != '\n' && ! feof(mFile)))
+        {
+            // the rest of a long line is still to come
+            continue;
+        }
+
+        while (! mLine.empty() && (mLine[mLine.size() - 1] == '\n' || mLine[mLine.size() - 1] == '\r'))
+        {
+            mLine.erase(mLine.size() - 1);
+        }
+        if (! mLine.empty())
+        {
+            CookieRecord cookie;
+            if (cookieFromJson(mLine, cookie))
+            {
+                cookies.push_back(cookie);
+                ++added;
+            }
+            else
+            {
+                ++mSkipped;
+            }
+        }
+        mLine.clear();
+    }
+    return added;
+}
+
+CookieWriter::CookieWriter() :
+    mFile(nullptr),
+    mFailed(false)
+{
+}
+
+CookieWriter::~CookieWriter()
+{
+    close();
+}
+
+bool CookieWriter::open(const std::string& file_name)
+{
+    close();
+    mFile = fopen(file_name.c_str(), "wb");
+    mFailed = false;
+    return mFile != nullptr;
+}
+
+bool CookieWriter::close()
+{
+    bool ok = ! mFailed;
+    if (mFile)
+    {
+        ok = (fclose(mFile) == 0) && ok;
+        mFile = nullptr;
+    }
+    return ok;
+}
+
+void CookieWriter::write(const CookieRecord& cookie)
+{
+    std::string line = cookieToJson(cookie);
+    line += '\n';
+    if (mFile == nullptr || fwrite(line.data(), 1, line.size(), mFile) != line.size())
+    {
+        mFailed = true;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+bool importCookies(const std::string& file_name, CookieStore& store, const CookieTransferSettings& settings)
+{
+    std::shared_ptr<Import> transfer = std::make_shared<Import>(store, settings);
+    return transfer->start(file_name);
+}
+
+bool exportCookies(const std::string& file_name, CookieStore& store, const CookieTransferSettings& settings)
+{
+    std::shared_ptr<Export> transfer = std::make_shared<Export>(store, settings);
+    return transfer->start(file_name);
+}
@@ -0,0 +1,185 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _COOKIE_STORE_H_
+#define _COOKIE_STORE_H_
+
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// cookies in bulk - thousands of session cookies restored at startup and saved
+// again later, without waiting on the cookie store one cookie at a time. Files
+// are JSON lines, one cookie per line:
+//
+//   {"name":"session","value":"abc","domain":".example.com","path":"/","secure":true,
+//    "httponly":true,"expires":2217974400,"creation":1546300800,"last_access":1546300800}
+//
+// times are seconds since 1970 and "expires" is left out for cookies that go
+// at the end of the session
+struct CookieRecord
+{
+    CookieRecord() :
+        secure(false),
+        httpOnly(false),
+        hasExpires(false),
+        expires(0.0),
+        creation(0.0),
+        lastAccess(0.0)
+    {
+    }
+
+    std::string name;
+    std::string value;
+    std::string domain;
+    std::string path;
+    bool secure;
+    bool httpOnly;
+    bool hasExpires;
+    double expires;
+    double creation;
+    double lastAccess;
+};
+
+bool operator==(const CookieRecord& a, const CookieRecord& b);
+
+// one line of a cookie file, without the newline - false if it isn't a cookie
+std::string cookieToJson(const CookieRecord& cookie);
+bool cookieFromJson(const std::string& line, CookieRecord& cookie);
+
+// the URL a cookie is set for - the store wants one as well as the domain
+std::string cookieURL(const CookieRecord& cookie);
+
+/////////////////////////////////////////////////////////////////////////////////
+// reads a cookie file a batch at a time
+class CookieReader
+{
+    public:
+        CookieReader();
+        ~CookieReader();
+
+        bool open(const std::string& file_name);
+        void close();
+
+        // up to count cookies onto the end of cookies - 0 at the end of the file. Lines that aren't cookies
+        // are skipped and counted
+        size_t read(std::vector<CookieRecord>& cookies, size_t count);
+
+        size_t skipped() const
+        {
+            return mSkipped;
+        }
+
+    private:
+        CookieReader(const CookieReader&);
+        CookieReader& operator=(const CookieReader&);
+
+        FILE* mFile;
+        std::string mLine;
+        size_t mSkipped;
+};
+
+class CookieWriter
+{
+    public:
+        CookieWriter();
+        ~CookieWriter();
+
+        bool open(const std::string& file_name);
+        // false if anything failed to write
+        bool close();
+
+        void write(const CookieRecord& cookie);
+
+    private:
+        CookieWriter(const CookieWriter&);
+        CookieWriter& operator=(const CookieWriter&);
+
+        FILE* mFile;
+        bool mFailed;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// what importCookies() and exportCookies() need from a cookie store (CEF's, in
+// the apps - see cef_cookies.h). Everything is asynchronous and the callbacks
+// can come on any thread
+class CookieStore
+{
+    public:
+        virtual ~CookieStore() {}
+
+        virtual void setCookie(const CookieRecord& cookie, const std::function<void(bool success)>& done) = 0;
+
+        // write everything set so far to disk
+        virtual void flush(const std::function<void()>& done) = 0;
+
+        // every cookie one at a time, then done - false (and neither is called) if the store can't be read
+        virtual bool visitAll(const std::function<void(const CookieRecord& cookie)>& visit, const std::function<void()>& done) = 0;
+};
+
+struct CookieTransferStats
+{
+    CookieTransferStats() :
+        cookies(0),
+        failed(0),
+        skipped(0),
+        batches(0),
+        flushes(0),
+        milliseconds(0.0),
+        ownerMilliseconds(0.0),
+        finished(false),
+        ok(true)
+    {
+    }
+
+    // set or written, the ones the store wouldn't take and lines in the file that weren't cookies
+    size_t cookies;
+    size_t failed;
+    size_t skipped;
+    size_t batches;
+    size_t flushes;
+    // since the start, and how much of that was spent on the thread that started it
+    double milliseconds;
+    double ownerMilliseconds;
+    bool finished;
+    // false if the file couldn't be written
+    bool ok;
+};
+
+struct CookieTransferSettings
+{
+    CookieTransferSettings() :
+        batchSize(500)
+    {
+    }
+
+    // cookies in flight at once - the store is flushed once per batch on import
+    size_t batchSize;
+
+    // runs a task on the thread that started the transfer (CEF's UI thread in the apps) - file reading
+    // and writing happens there, between batches, and progress and done are called from there. Empty
+    // runs them on whichever thread the store called back on
+    std::function<void(const std::function<void()>& task)> post;
+
+    // after every batch, and when it's finished
+    std::function<void(const CookieTransferStats& stats)> progress;
+    std::function<void(const CookieTransferStats& stats)> done;
+};
+
+// set every cookie in file_name in the store a batch at a time - the next batch is read while the one
+// before it is being set, then it's set once the store has flushed that one. false if the file can't
+// be opened, otherwise it's under way when this returns (or done already, if there was nothing to import)
+bool importCookies(const std::string& file_name, CookieStore& store, const CookieTransferSettings& settings);
+
+// write every cookie in the store to file_name - written in batches as they're visited. false if the
+// file can't be opened or the store can't be read
+bool exportCookies(const std::string& file_name, CookieStore& store, const CookieTransferSettings& settings);
+
+#endif // _COOKIE_STORE_H_
@@ -0,0 +1,172 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "egl_surface.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    // one context for the whole process, the way there's one window on Windows
+    EGLDisplay gDisplay = EGL_NO_DISPLAY;
+    EGLContext gContext = EGL_NO_CONTEXT;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+void* getEGLProcAddress(const char* name)
+{
+    return (void*)eglGetProcAddress(name);
+}
+
+bool createSurfacelessGLContext()
+{
+    if (gContext != EGL_NO_CONTEXT)
+    {
+        return eglMakeCurrent(gDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, gContext) == EGL_TRUE;
+    }
+
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display == nullptr)
+    {
+        fprintf(stderr, "headless GL: eglGetPlatformDisplayEXT not available\n");
+        return false;
+    }
+
+    EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    EGLint major = 0;
+    EGLint minor = 0;
+    if (display == EGL_NO_DISPLAY || ! eglInitialize(display, &major, &minor))
+    {
+        fprintf(stderr, "headless GL: unable to initialize surfaceless display\n");
+        return false;
+    }
+
+    // desktop GL rather than GLES, and a compatibility context so the immediate mode renderer (see
+    // gl_renderer.h) works here as well as the modern one - the same as the Windows app gets
+    eglBindAPI(EGL_OPENGL_API);
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, nullptr);
+    if (context == EGL_NO_CONTEXT || ! eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        fprintf(stderr, "headless GL: unable to create context\n");
+        return false;
+    }
+
+    gDisplay = display;
+    gContext = context;
+    loadGLFunctions(getEGLProcAddress);
+
+    printf("headless GL: %s / %s\n", (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+EGLRenderSurface::EGLRenderSurface() :
+    mWidth(0),
+    mHeight(0),
+    mTarget(0),
+    mFramebuffer(0)
+{
+}
+
+EGLRenderSurface::~EGLRenderSurface()
+{
+    if (mFramebuffer != 0)
+    {
+        gGL.deleteFramebuffers(1, &mFramebuffer);
+    }
+
+    if (mTarget != 0)
+    {
+        glDeleteTextures(1, &mTarget);
+    }
+}
+
+bool EGLRenderSurface::create(int width, int height)
+{
+    if (! createSurfacelessGLContext())
+    {
+        return false;
+    }
+
+    if (! gGL.hasFramebuffers())
+    {
+        fprintf(stderr, "headless GL: framebuffer objects are needed to draw offscreen\n");
+        return false;
+    }
+
+    glGenTextures(1, &mTarget);
+    gGL.genFramebuffers(1, &mFramebuffer);
+    resize(width, height);
+
+    if (gGL.checkFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        fprintf(stderr, "headless GL: offscreen framebuffer is incomplete\n");
+        return false;
+    }
+
+    glEnable(GL_TEXTURE_2D);
+    return true;
+}
+
+void EGLRenderSurface::resize(int width, int height)
+{
+    mWidth = width;
+    mHeight = height;
+
+    // the target is exactly the size of the "window" so readPixels() doesn't need to know about padding
+    glBindTexture(GL_TEXTURE_2D, mTarget);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    gGL.bindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    gGL.framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mTarget, 0);
+
+    glViewport(0, 0, width, height);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0.0f, width, height, 0.0f, -1.0f, 1.0f);
+    glMatrixMode(GL_MODELVIEW);
+}
+
+void EGLRenderSurface::makeCurrent()
+{
+    eglMakeCurrent(gDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, gContext);
+    gGL.bindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+}
+
+void EGLRenderSurface::present()
+{
+    // nothing to swap - waiting for the frame to finish keeps the renderer from queuing up frames
+    // faster than it draws them, which is what a swap with vsync would do
+    glFinish();
+    ++mPresents;
+}
+
+void EGLRenderSurface::readPixels(std::vector<unsigned char>& pixels) const
+{
+    const size_t row_bytes = (size_t)mWidth * 4;
+    pixels.resize(row_bytes * mHeight);
+
+    gGL.bindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, mWidth, mHeight, GL_BGRA_EXT, GL_UNSIGNED_BYTE, pixels.data());
+
+    // GL's first row is the bottom one
+    std::vector<unsigned char> row(row_bytes);
+    for (int y = 0; y < mHeight / 2; ++y)
+    {
+        unsigned char* top = pixels.data() + (size_t)y * row_bytes;
+        unsigned char* bottom = pixels.data() + (size_t)(mHeight - 1 - y) * row_bytes;
+        memcpy(row.data(), top, row_bytes);
+        memcpy(top, bottom, row_bytes);
+        memcpy(bottom, row.data(), row_bytes);
+    }
+}
@@ -0,0 +1,74 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _EGL_SURFACE_H_
+#define _EGL_SURFACE_H_
+
+#include "gl_functions.h"
+#include "render_surface.h"
+
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// an OpenGL context with no window or display (EGL_MESA_platform_surfaceless)
+// made current - with no GPU Mesa gives us llvmpipe. Loads the GL functions
+// (see gl_functions.h) and returns false if there's no surfaceless platform
+bool createSurfacelessGLContext();
+
+void* getEGLProcAddress(const char* name);
+
+/////////////////////////////////////////////////////////////////////////////////
+// draws into a texture attached to a framebuffer object in a surfaceless
+// context - nothing ever reaches a screen but the frame can be read back
+class EGLRenderSurface :
+    public RenderSurface
+{
+    public:
+        EGLRenderSurface();
+        ~EGLRenderSurface();
+
+        // false if there's no surfaceless EGL or no framebuffer objects
+        bool create(int width, int height);
+
+        const char* name() const override
+        {
+            return "egl";
+        }
+
+        bool hasGL() const override
+        {
+            return true;
+        }
+
+        void resize(int width, int height) override;
+        void makeCurrent() override;
+        void present() override;
+
+        int width() const override
+        {
+            return mWidth;
+        }
+
+        int height() const override
+        {
+            return mHeight;
+        }
+
+        // the last frame drawn, top row first (BGRA)
+        void readPixels(std::vector<unsigned char>& pixels) const;
+
+    private:
+        EGLRenderSurface(const EGLRenderSurface&);
+        EGLRenderSurface& operator=(const EGLRenderSurface&);
+
+        int mWidth;
+        int mHeight;
+        GLuint mTarget;
+        GLuint mFramebuffer;
+};
+
+#endif // _EGL_SURFACE_H_
@@ -0,0 +1,162 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "frame_mailbox.h"
+#include "instrument.h"
+
+#include <cstring>
+
+namespace
+{
+    // the low bits of mMiddle are the frame index
+    const unsigned int kIndexMask = 3;
+    const unsigned int kFresh = 4;
+
+    // how many frames of damage the writer keeps - a frame (or a reader) further behind than this gets a full copy
+    const size_t kHistoryFrames = 8;
+
+    // damage carried over several frames is merged the way the compositor merges CEF's dirty rects
+    const double kDamageMergeSlack = 0.25;
+    const size_t kMaxDamageRects = 8;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+FrameMailbox::FrameMailbox(PixelPool* pool) :
+    mMiddle(1),
+    mLastTaken(0),
+    mPool(pool ? pool : &defaultPixelPool()),
+    mBack(0),
+    mSequence(0),
+    mHistory(kHistoryFrames),
+    mFront(2),
+    mPublished(0),
+    mTaken(0),
+    mSkipped(0),
+    mBytesCopied(0),
+    mMemoryUsage(0)
+{
+}
+
+void FrameMailbox::publish(const unsigned char* pixels, int width, int height, const RectList& damage, double time)
+{
+    INSTRUMENT_SCOPE("mailbox.publish");
+
+    ++mSequence;
+    History& history = mHistory[mSequence % kHistoryFrames];
+    history.sequence = mSequence;
+    history.width = width;
+    history.height = height;
+    history.damage = damage;
+
+    // bring the back frame up to date - it's missing everything since it was last published
+    MailboxFrame& frame = mFrames[mBack];
+    RectList stale;
+    size_t bytes_copied = 0;
+    if (frame.width != width || frame.height != height || ! damageSince(frame.sequence, stale))
+    {
+        size_t bytes = (size_t)width * height * kDepth;
+        if (frame.buffer.size() != bytes)
+        {
+            size_t capacity = frame.buffer.capacity();
+            mPool->resize(frame.buffer, bytes);
+            mMemoryUsage.fetch_add(frame.buffer.capacity() - capacity, std::memory_order_relaxed);
+        }
+        memcpy(frame.buffer.data(), pixels, bytes);
+        bytes_copied = bytes;
+    }
+    else
+    {
+        for (const Rect& rect : stale)
+        {
+            size_t offset = ((size_t)rect.y * width + rect.x) * kDepth;
+            size_t row_bytes = (size_t)rect.width * kDepth;
+            for (int y = 0; y < rect.height; ++y)
+            {
+                memcpy(frame.buffer.data() + offset, pixels + offset, row_bytes);
+                offset += (size_t)width * kDepth;
+            }
+            bytes_copied += row_bytes * rect.height;
+        }
+    }
+
+    frame.width = width;
+    frame.height = height;
+    frame.sequence = mSequence;
+    frame.time = time;
+
+    // what the reader needs to upload to get from its newest frame to this one - if it takes a newer
+    // frame before this one gets to it, this is more than it needs, never less
+    if (! damageSince(mLastTaken.load(std::memory_order_acquire), frame.damage))
+    {
+        frame.damage.assign(1, Rect(0, 0, width, height));
+    }
+
+    unsigned int previous = mMiddle.exchange(mBack | kFresh, std::memory_order_acq_rel);
+    mBack = previous & kIndexMask;
+    if (previous & kFresh)
+    {
+        mSkipped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    mPublished.fetch_add(1, std::memory_order_relaxed);
+    mBytesCopied.fetch_add(bytes_copied, std::memory_order_relaxed);
+}
+
+const MailboxFrame* FrameMailbox::take()
+{
+    if ((mMiddle.load(std::memory_order_relaxed) & kFresh) == 0)
+    {
+        return nullptr;
+    }
+
+    unsigned int previous = mMiddle.exchange(mFront, std::memory_order_acq_rel);
+    mFront = previous & kIndexMask;
+
+    const MailboxFrame* frame = &mFrames[mFront];
+    mLastTaken.store(frame->sequence, std::memory_order_release);
+    mTaken.fetch_add(1, std::memory_order_relaxed);
+    return frame;
+}
+
+MailboxStats FrameMailbox::stats() const
+{
+    MailboxStats stats;
+    stats.published = mPublished.load(std::memory_order_relaxed);
+    stats.taken = mTaken.load(std::memory_order_relaxed);
+    stats.skipped = mSkipped.load(std::memory_order_relaxed);
+    stats.bytesCopied = mBytesCopied.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool FrameMailbox::damageSince(uint64_t since, RectList& damage) const
+{
+    damage.clear();
+    if (since == 0 || since > mSequence || mSequence - since >= kHistoryFrames)
+    {
+        return false;
+    }
+
+    // frame since has to still be in the history too, so a size change straight after it shows up
+    const History& newest = mHistory[mSequence % kHistoryFrames];
+    for (uint64_t sequence = since; sequence <= mSequence; ++sequence)
+    {
+        const History& history = mHistory[sequence % kHistoryFrames];
+        if (history.sequence != sequence || history.width != newest.width || history.height != newest.height)
+        {
+            return false;
+        }
+
+        if (sequence > since)
+        {
+            damage.insert(damage.end(), history.damage.begin(), history.damage.end());
+        }
+    }
+
+    damage = coalesceDamage(damage, Rect(0, 0, newest.width, newest.height), kDamageMergeSlack, kMaxDamageRects);
+    return true;
+}
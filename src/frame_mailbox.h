@@ -0,0 +1,140 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _FRAME_MAILBOX_H_
+#define _FRAME_MAILBOX_H_
+
+#include "compositor.h"
+#include "pixel_pool.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// hands whole frames from the thread that paints them (CEF's UI thread when it
+// runs its own message loop) to the thread that draws them, with no locks and
+// no waiting on either side. It's a triple buffer - the writer fills the back
+// frame and swaps it for the middle one with a single atomic exchange, and the
+// reader swaps the middle one for its front one when there's a newer frame
+// there. The reader only ever sees whole frames and the writer never waits for
+// it - frames the reader doesn't get to in time are replaced by newer ones and
+// their damage is carried over, so the damage take() returns is everything that
+// changed since the reader's previous frame.
+//
+// One writer thread and one reader thread. Only the parts that changed are
+// copied - each of the three frames remembers which frame it last held and
+// catches up from there using the last few frames' damage
+struct MailboxFrame
+{
+    MailboxFrame() :
+        width(0),
+        height(0),
+        sequence(0),
+        time(0.0)
+    {
+    }
+
+    // width x height, tightly packed
+    const unsigned char* pixels() const
+    {
+        return buffer.data();
+    }
+
+    int width;
+    int height;
+    // what changed since the frame the reader had before this one - the whole frame after a resize
+    RectList damage;
+    // counts up from 1
+    uint64_t sequence;
+    // what the writer passed to publish()
+    double time;
+    PixelBuffer buffer;
+};
+
+struct MailboxStats
+{
+    MailboxStats() :
+        published(0),
+        taken(0),
+        skipped(0),
+        bytesCopied(0)
+    {
+    }
+
+    size_t published;
+    size_t taken;
+    // frames that were replaced before the reader got to them
+    size_t skipped;
+    size_t bytesCopied;
+};
+
+class FrameMailbox
+{
+    public:
+        // frame buffers come from pool - defaultPixelPool() if it's null. They're only (re)allocated when the frame size changes
+        FrameMailbox(PixelPool* pool = nullptr);
+
+        // writer thread - pixels is the whole frame and damage is what changed since the last publish()
+        void publish(const unsigned char* pixels, int width, int height, const RectList& damage, double time);
+
+        // reader thread - the newest frame if one was published since the last take(), null otherwise. It's
+        // the reader's until the next take()
+        const MailboxFrame* take();
+
+        // any thread
+        MailboxStats stats() const;
+
+        // bytes held by the three frames
+        size_t memoryUsage() const
+        {
+            return mMemoryUsage.load(std::memory_order_relaxed);
+        }
+
+    private:
+        FrameMailbox(const FrameMailbox&);
+        FrameMailbox& operator=(const FrameMailbox&);
+
+        // damage from publish() calls, newest last
+        struct History
+        {
+            History() : sequence(0), width(0), height(0) {}
+
+            uint64_t sequence;
+            int width;
+            int height;
+            RectList damage;
+        };
+
+        // writer only - everything that changed after frame since up to the newest one. False if that's
+        // too far back or the size changed on the way, and the whole frame has to be taken instead
+        bool damageSince(uint64_t since, RectList& damage) const;
+
+        MailboxFrame mFrames[3];
+        // which frame is in the middle, plus kFresh if the reader hasn't taken it yet
+        std::atomic<unsigned int> mMiddle;
+        // the sequence of the reader's newest frame
+        std::atomic<uint64_t> mLastTaken;
+
+        // writer only
+        PixelPool* mPool;
+        unsigned int mBack;
+        uint64_t mSequence;
+        std::vector<History> mHistory;
+
+        // reader only
+        unsigned int mFront;
+
+        std::atomic<size_t> mPublished;
+        std::atomic<size_t> mTaken;
+        std::atomic<size_t> mSkipped;
+        std::atomic<size_t> mBytesCopied;
+        std::atomic<size_t> mMemoryUsage;
+};
+
+#endif // _FRAME_MAILBOX_H_
@@ -0,0 +1,524 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "frame_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+// keep windows.h from defining min and max macros that break std::min/std::max
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const size_t kPageSize = 4096;
+
+    size_t roundUp(size_t value, size_t granularity)
+    {
+        return (value + granularity - 1) / granularity * granularity;
+    }
+
+    // clip to the frame - false if nothing is left
+    bool clipRect(FrameRect& rect, int width, int height)
+    {
+        int x0 = std::max(rect.x, 0);
+        int y0 = std::max(rect.y, 0);
+        int x1 = std::min(rect.x + rect.width, width);
+        int y1 = std::min(rect.y + rect.height, height);
+        if (x1 <= x0 || y1 <= y0)
+        {
+            return false;
+        }
+
+        rect.x = x0;
+        rect.y = y0;
+        rect.width = x1 - x0;
+        rect.height = y1 - y0;
+        return true;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+SharedMemory::SharedMemory() :
+    mOwner(false),
+    mData(nullptr),
+    mSize(0),
+    mHandle(nullptr)
+{
+}
+
+SharedMemory::~SharedMemory()
+{
+    close();
+}
+
+#ifdef _WIN32
+bool SharedMemory::create(const std::string& name, size_t bytes)
+{
+    close();
+
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)bytes >> 32), (DWORD)bytes, name.c_str());
+    if (mapping == NULL)
+    {
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+    if (data == NULL)
+    {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    mName = name;
+    mOwner = true;
+    mHandle = mapping;
+    mData = (unsigned char*)data;
+    mSize = bytes;
+    return true;
+}
+
+bool SharedMemory::open(const std::string& name)
+{
+    close();
+
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+    if (mapping == NULL)
+    {
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if (data == NULL || VirtualQuery(data, &info, sizeof(info)) == 0)
+    {
+        if (data)
+        {
+            UnmapViewOfFile(data);
+        }
+        CloseHandle(mapping);
+        return false;
+    }
+
+    mName = name;
+    mOwner = false;
+    mHandle = mapping;
+    mData = (unsigned char*)data;
+    mSize = info.RegionSize;
+    return true;
+}
+
+void SharedMemory::close()
+{
+    if (mData)
+    {
+        UnmapViewOfFile(mData);
+    }
+    if (mHandle)
+    {
+        CloseHandle((HANDLE)mHandle);
+    }
+
+    mOwner = false;
+    mData = nullptr;
+    mSize = 0;
+    mHandle = nullptr;
+}
+#else
+bool SharedMemory::create(const std::string& name, size_t bytes)
+{
+    close();
+
+    // anything with this name is left over from a writer that didn't get to clean up
+    std::string shm_name = "/" + name;
+    shm_unlink(shm_name.c_str());
+
+    int fd = shm_open(shm_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    void* data = MAP_FAILED;
+    if (ftruncate(fd, (off_t)bytes) == 0)
+    {
+        data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        shm_unlink(shm_name.c_str());
+        return false;
+    }
+
+    mName = shm_name;
+    mOwner = true;
+    mData = (unsigned char*)data;
+    mSize = bytes;
+    return true;
+}
+
+bool SharedMemory::open(const std::string& name)
+{
+    close();
+
+    std::string shm_name = "/" + name;
+    int fd = shm_open(shm_name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    mName = shm_name;
+    mOwner = false;
+    mData = (unsigned char*)data;
+    mSize = (size_t)info.st_size;
+    return true;
+}
+
+void SharedMemory::close()
+{
+    if (mData)
+    {
+        munmap(mData, mSize);
+    }
+    // readers that still have it mapped keep it until they let go
+    if (mOwner)
+    {
+        shm_unlink(mName.c_str());
+    }
+
+    mOwner = false;
+    mData = nullptr;
+    mSize = 0;
+}
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+FrameRingWriter::FrameRingWriter() :
+    mSequence(0)
+{
+}
+
+FrameRingWriter::~FrameRingWriter()
+{
+    if (isOpen())
+    {
+        header()->closed.store(1, std::memory_order_release);
+    }
+}
+
+bool FrameRingWriter::create(const std::string& name, int max_width, int max_height, int slot_count)
+{
+    if (max_width <= 0 || max_height <= 0 || slot_count <= 0)
+    {
+        return false;
+    }
+
+    size_t slot_bytes = roundUp(kFrameSlotHeaderSize + (size_t)max_width * max_height * kFrameRingDepth, kPageSize);
+    size_t slot_offset = roundUp(sizeof(FrameRingHeader), kPageSize);
+    if (! mMemory.create(name, slot_offset + slot_bytes * slot_count))
+    {
+        return false;
+    }
+
+    // new shared memory is all zeros - every slot is empty and nothing is published
+    FrameRingHeader* ring = header();
+    ring->version = kFrameRingVersion;
+    ring->slotCount = (uint32_t)slot_count;
+    ring->maxWidth = (uint32_t)max_width;
+    ring->maxHeight = (uint32_t)max_height;
+    ring->slotOffset = slot_offset;
+    ring->slotBytes = slot_bytes;
+
+    // readers look at the magic number before anything else
+    std::atomic_thread_fence(std::memory_order_release);
+    ring->magic = kFrameRingMagic;
+
+    mSequence = 0;
+    mHistory.clear();
+    mStats = FrameRingWriterStats();
+    return true;
+}
+
+unsigned char* FrameRingWriter::slot(uint64_t sequence) const
+{
+    const FrameRingHeader* ring = header();
+    return mMemory.data() + ring->slotOffset + ring->slotBytes * (sequence % ring->slotCount);
+}
+
+uint64_t FrameRingWriter::publish(const unsigned char* pixels, int width, int height, int stride,
+                                  const FrameRect* dirty_rects, size_t dirty_count, uint64_t timestamp)
+{
+    if (! isOpen() || pixels == nullptr || width <= 0 || height <= 0)
+    {
+        return 0;
+    }
+
+    FrameRingHeader* ring = header();
+    if ((uint32_t)width > ring->maxWidth || (uint32_t)height > ring->maxHeight)
+    {
+        ++mStats.oversized;
+        return 0;
+    }
+
+    uint64_t sequence = ++mSequence;
+    FrameSlotHeader* slot_header = (FrameSlotHeader*)slot(sequence);
+    unsigned char* slot_pixels = (unsigned char*)slot_header + kFrameSlotHeaderSize;
+
+    std::vector<FrameRect> dirty;
+    for (size_t i = 0; i < dirty_count; ++i)
+    {
+        FrameRect rect = dirty_rects[i];
+        if (clipRect(rect, width, height))
+        {
+            dirty.push_back(rect);
+        }
+    }
+
+    // the slot has the frame it was last given - it needs everything that changed since then as well as
+    // what changed this time, or the whole frame if it's empty or was a different size
+    bool full = slot_header->sequence == 0 || slot_header->width != width || slot_header->height != height;
+    std::vector<FrameRect> copies = dirty;
+    for (const History& history : mHistory)
+    {
+        if (full || history.sequence <= slot_header->sequence)
+        {
+            continue;
+        }
+
+        if (history.width != width || history.height != height)
+        {
+            full = true;
+        }
+        copies.insert(copies.end(), history.dirty.begin(), history.dirty.end());
+    }
+
+    size_t copy_area = 0;
+    for (const FrameRect& rect : copies)
+    {
+        copy_area += (size_t)rect.width * rect.height;
+    }
+    if (full || copy_area >= (size_t)width * height)
+    {
+        FrameRect whole = { 0, 0, width, height };
+        copies.assign(1, whole);
+    }
+
+    // seqlock - readers that see the odd state, or a different state afterwards, know to leave the slot alone
+    slot_header->state.store(sequence * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    int slot_stride = width * kFrameRingDepth;
+    for (const FrameRect& rect : copies)
+    {
+        size_t row_bytes = (size_t)rect.width * kFrameRingDepth;
+        for (int y = rect.y; y < rect.y + rect.height; ++y)
+        {
+            memcpy(slot_pixels + (size_t)y * slot_stride + (size_t)rect.x * kFrameRingDepth,
+                   pixels + ((size_t)y * stride + rect.x) * kFrameRingDepth, row_bytes);
+        }
+        mStats.bytesCopied += row_bytes * rect.height;
+    }
+
+    slot_header->sequence = sequence;
+    slot_header->timestamp = timestamp;
+    slot_header->width = width;
+    slot_header->height = height;
+    slot_header->stride = slot_stride;
+
+    // more rects than the header has room for - say the whole lot changed
+    if (dirty.size() > kFrameRingMaxDirtyRects)
+    {
+        FrameRect whole = { 0, 0, width, height };
+        dirty.assign(1, whole);
+    }
+    slot_header->dirtyCount = (uint32_t)dirty.size();
+    std::copy(dirty.begin(), dirty.end(), slot_header->dirty);
+
+    slot_header->state.store(sequence * 2, std::memory_order_release);
+    ring->published.store(sequence, std::memory_order_release);
+
+    History history;
+    history.sequence = sequence;
+    history.width = width;
+    history.height = height;
+    history.dirty.swap(dirty);
+    mHistory.push_back(history);
+    while (mHistory.size() > ring->slotCount)
+    {
+        mHistory.pop_front();
+    }
+
+    ++mStats.published;
+    return sequence;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+FrameRingReader::FrameRingReader() :
+    mLastRead(0),
+    mDropped(0)
+{
+}
+
+bool FrameRingReader::open(const std::string& name)
+{
+    mLastRead = 0;
+    mDropped = 0;
+
+    if (! mMemory.open(name) || mMemory.size() < sizeof(FrameRingHeader))
+    {
+        mMemory.close();
+        return false;
+    }
+
+    const FrameRingHeader* ring = header();
+    bool ok = ring->magic == kFrameRingMagic;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    ok = ok && ring->version == kFrameRingVersion && ring->slotCount > 0 &&
+         mMemory.size() >= ring->slotOffset + ring->slotBytes * ring->slotCount;
+    if (! ok)
+    {
+        mMemory.close();
+        return false;
+    }
+
+    return true;
+}
+
+const FrameSlotHeader* FrameRingReader::slot(uint64_t sequence) const
+{
+    const FrameRingHeader* ring = header();
+    return (const FrameSlotHeader*)(mMemory.data() + ring->slotOffset + ring->slotBytes * (sequence % ring->slotCount));
+}
+
+bool FrameRingReader::read(uint64_t sequence, FrameView& view) const
+{
+    const FrameSlotHeader* slot_header = slot(sequence);
+    uint64_t state = slot_header->state.load(std::memory_order_acquire);
+    if (state != sequence * 2)
+    {
+        return false;
+    }
+
+    view.sequence = sequence;
+    view.timestamp = slot_header->timestamp;
+    view.width = slot_header->width;
+    view.height = slot_header->height;
+    view.stride = slot_header->stride;
+    view.dirty.assign(slot_header->dirty, slot_header->dirty + std::min((size_t)slot_header->dirtyCount, kFrameRingMaxDirtyRects));
+    view.pixels = (const unsigned char*)slot_header + kFrameSlotHeaderSize;
+    view.state = state;
+
+    // the header we just read has to be from the same frame
+    return valid(view);
+}
+
+bool FrameRingReader::latest(FrameView& view)
+{
+    if (mMemory.data() == nullptr)
+    {
+        return false;
+    }
+
+    // the newest frame can be overwritten while we look at it if we're very unlucky - try again
+    for (int attempt = 0; attempt < 4; ++attempt)
+    {
+        uint64_t published = header()->published.load(std::memory_order_acquire);
+        if (published == 0)
+        {
+            return false;
+        }
+
+        if (read(published, view))
+        {
+            mLastRead = published;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FrameRingReader::next(FrameView& view)
+{
+    if (mMemory.data() == nullptr)
+    {
+        return false;
+    }
+
+    const FrameRingHeader* ring = header();
+    for (;;)
+    {
+        uint64_t published = ring->published.load(std::memory_order_acquire);
+        if (published <= mLastRead)
+        {
+            return false;
+        }
+
+        // frames older than the ring is long have been overwritten
+        uint64_t want = mLastRead + 1;
+        uint64_t oldest = published >= ring->slotCount ? published - ring->slotCount + 1 : 1;
+        if (want < oldest)
+        {
+            mDropped += oldest - want;
+            want = oldest;
+        }
+
+        if (read(want, view))
+        {
+            mLastRead = want;
+            return true;
+        }
+
+        // overwritten while we were looking - skip it
+        ++mDropped;
+        mLastRead = want;
+    }
+}
+
+bool FrameRingReader::valid(const FrameView& view) const
+{
+    if (mMemory.data() == nullptr || view.sequence == 0)
+    {
+        return false;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot(view.sequence)->state.load(std::memory_order_relaxed) == view.state;
+}
+
+bool FrameRingReader::writerClosed() const
+{
+    return mMemory.data() == nullptr || header()->closed.load(std::memory_order_acquire) != 0;
+}
@@ -0,0 +1,255 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _FRAME_RING_H_
+#define _FRAME_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// browser frames published to other processes through a ring of slots in named
+// shared memory (shm_open + mmap on Linux, a file mapping on Windows). The app
+// writes each composited page into the next slot with a header saying what it
+// is - sequence number, size, when it was painted and which parts changed -
+// and never waits for anyone: a reader that falls behind has its frames
+// overwritten and just picks up from the oldest one still there. Readers map
+// the ring read only and use the pixels where they are, then check the slot
+// wasn't overwritten while they were at it (a seqlock per slot).
+//
+// This file and frame_ring.cpp are all a reader needs - no CEF, OpenGL or
+// anything else from the app
+const uint32_t kFrameRingMagic = 0x46524e47;    // "FRNG"
+const uint32_t kFrameRingVersion = 1;
+const size_t kFrameRingMaxDirtyRects = 16;
+
+// pixels are BGRA like CEF's, rows are width * 4 bytes
+const int kFrameRingDepth = 4;
+
+struct FrameRect
+{
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+};
+
+// at the start of the shared memory
+struct FrameRingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t maxWidth;
+    uint32_t maxHeight;
+    // set when the writer has gone
+    std::atomic<uint32_t> closed;
+    // from the start of the shared memory to the first slot, and from one slot to the next
+    uint64_t slotOffset;
+    uint64_t slotBytes;
+    // the newest complete frame - 0 before the first one
+    std::atomic<uint64_t> published;
+};
+
+// at the start of each slot, the pixels follow at kFrameSlotHeaderSize
+struct FrameSlotHeader
+{
+    // sequence * 2 when the frame is complete, sequence * 2 + 1 while it's being written
+    std::atomic<uint64_t> state;
+    uint64_t sequence;
+    // steady_clock nanoseconds (the same clock in every process on the machine)
+    uint64_t timestamp;
+    int32_t width;
+    int32_t height;
+    int32_t stride;
+    // what changed since the previous frame - a single rect covering the frame if it all did
+    uint32_t dirtyCount;
+    FrameRect dirty[kFrameRingMaxDirtyRects];
+};
+const size_t kFrameSlotHeaderSize = 4096;
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the frame ring needs lock free 64 bit atomics to work across processes");
+static_assert(sizeof(FrameSlotHeader) <= kFrameSlotHeaderSize, "slot header doesn't fit");
+
+/////////////////////////////////////////////////////////////////////////////////
+// a named block of shared memory mapped into this process
+class SharedMemory
+{
+    public:
+        SharedMemory();
+        ~SharedMemory();
+
+        // make a new block (replacing any left over with the same name) - read/write
+        bool create(const std::string& name, size_t bytes);
+
+        // map a block some other process made - read only
+        bool open(const std::string& name);
+
+        void close();
+
+        unsigned char* data() const
+        {
+            return mData;
+        }
+
+        size_t size() const
+        {
+            return mSize;
+        }
+
+    private:
+        SharedMemory(const SharedMemory&);
+        SharedMemory& operator=(const SharedMemory&);
+
+        std::string mName;
+        bool mOwner;
+        unsigned char* mData;
+        size_t mSize;
+        void* mHandle;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+struct FrameRingWriterStats
+{
+    FrameRingWriterStats() :
+        published(0),
+        oversized(0),
+        bytesCopied(0)
+    {
+    }
+
+    size_t published;
+    // frames bigger than the ring was made for - they're not published
+    size_t oversized;
+    size_t bytesCopied;
+};
+
+class FrameRingWriter
+{
+    public:
+        FrameRingWriter();
+        ~FrameRingWriter();
+
+        // frames up to max_width x max_height - slot_count of them can be read before they're overwritten
+        bool create(const std::string& name, int max_width, int max_height, int slot_count);
+
+        // copies what the slot needs from pixels (the whole frame, stride in pixels) to bring it up to date,
+        // which is usually just the dirty rects of the frames since the slot was last written. Returns the
+        // sequence number of the frame, 0 if it wasn't published
+        uint64_t publish(const unsigned char* pixels, int width, int height, int stride,
+                         const FrameRect* dirty_rects, size_t dirty_count, uint64_t timestamp);
+
+        bool isOpen() const
+        {
+            return mMemory.data() != nullptr;
+        }
+
+        const FrameRingWriterStats& stats() const
+        {
+            return mStats;
+        }
+
+    private:
+        struct History
+        {
+            uint64_t sequence;
+            int width;
+            int height;
+            std::vector<FrameRect> dirty;
+        };
+
+        FrameRingHeader* header() const
+        {
+            return (FrameRingHeader*)mMemory.data();
+        }
+
+        unsigned char* slot(uint64_t sequence) const;
+
+        SharedMemory mMemory;
+        uint64_t mSequence;
+        // the dirty rects of the last slotCount frames - what a slot is missing
+        std::deque<History> mHistory;
+        FrameRingWriterStats mStats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// a frame in the ring - pixels point into the shared memory and are only good
+// while FrameRingReader::valid() says so
+struct FrameView
+{
+    FrameView() :
+        sequence(0),
+        timestamp(0),
+        width(0),
+        height(0),
+        stride(0),
+        pixels(nullptr),
+        state(0)
+    {
+    }
+
+    uint64_t sequence;
+    uint64_t timestamp;
+    int width;
+    int height;
+    // bytes
+    int stride;
+    std::vector<FrameRect> dirty;
+    const unsigned char* pixels;
+
+    // what the slot's state was when the view was made
+    uint64_t state;
+};
+
+class FrameRingReader
+{
+    public:
+        FrameRingReader();
+
+        bool open(const std::string& name);
+
+        // the newest frame
+        bool latest(FrameView& view);
+
+        // the frame after the last one read, or the oldest one still in the ring if that has been
+        // overwritten (dropped() counts the ones missed). False if there's nothing newer yet
+        bool next(FrameView& view);
+
+        // check the frame hasn't been overwritten since the view was made - call it after using the pixels,
+        // and if it says no, whatever was read may be a mix of two frames
+        bool valid(const FrameView& view) const;
+
+        // the writer has gone - nothing more will be published
+        bool writerClosed() const;
+
+        uint64_t dropped() const
+        {
+            return mDropped;
+        }
+
+    private:
+        const FrameRingHeader* header() const
+        {
+            return (const FrameRingHeader*)mMemory.data();
+        }
+
+        const FrameSlotHeader* slot(uint64_t sequence) const;
+
+        // fill view from the slot that holds sequence - false if it doesn't (any more)
+        bool read(uint64_t sequence, FrameView& view) const;
+
+        SharedMemory mMemory;
+        uint64_t mLastRead;
+        uint64_t mDropped;
+};
+
+#endif // _FRAME_RING_H_
@@ -0,0 +1,66 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "gl_functions.h"
+
+GLFunctions gGL;
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+template <typename T>
+void loadGLFunction(GLGetProcAddress get_proc_address, T& function, const char* name, const char* alt_name = nullptr)
+{
+    function = (T)get_proc_address(name);
+    if (function == nullptr && alt_name != nullptr)
+    {
+        function = (T)get_proc_address(alt_name);
+    }
+}
+
+void loadGLFunctions(GLGetProcAddress get_proc_address)
+{
+    loadGLFunction(get_proc_address, gGL.genBuffers, "glGenBuffers", "glGenBuffersARB");
+    loadGLFunction(get_proc_address, gGL.deleteBuffers, "glDeleteBuffers", "glDeleteBuffersARB");
+    loadGLFunction(get_proc_address, gGL.bindBuffer, "glBindBuffer", "glBindBufferARB");
+    loadGLFunction(get_proc_address, gGL.bufferData, "glBufferData", "glBufferDataARB");
+    loadGLFunction(get_proc_address, gGL.bufferStorage, "glBufferStorage");
+    loadGLFunction(get_proc_address, gGL.mapBufferRange, "glMapBufferRange");
+    loadGLFunction(get_proc_address, gGL.unmapBuffer, "glUnmapBuffer", "glUnmapBufferARB");
+    loadGLFunction(get_proc_address, gGL.flushMappedBufferRange, "glFlushMappedBufferRange");
+    loadGLFunction(get_proc_address, gGL.fenceSync, "glFenceSync");
+    loadGLFunction(get_proc_address, gGL.clientWaitSync, "glClientWaitSync");
+    loadGLFunction(get_proc_address, gGL.deleteSync, "glDeleteSync");
+    loadGLFunction(get_proc_address, gGL.genFramebuffers, "glGenFramebuffers", "glGenFramebuffersEXT");
+    loadGLFunction(get_proc_address, gGL.deleteFramebuffers, "glDeleteFramebuffers", "glDeleteFramebuffersEXT");
+    loadGLFunction(get_proc_address, gGL.bindFramebuffer, "glBindFramebuffer", "glBindFramebufferEXT");
+    loadGLFunction(get_proc_address, gGL.framebufferTexture2D, "glFramebufferTexture2D", "glFramebufferTexture2DEXT");
+    loadGLFunction(get_proc_address, gGL.checkFramebufferStatus, "glCheckFramebufferStatus", "glCheckFramebufferStatusEXT");
+    loadGLFunction(get_proc_address, gGL.createShader, "glCreateShader");
+    loadGLFunction(get_proc_address, gGL.deleteShader, "glDeleteShader");
+    loadGLFunction(get_proc_address, gGL.shaderSource, "glShaderSource");
+    loadGLFunction(get_proc_address, gGL.compileShader, "glCompileShader");
+    loadGLFunction(get_proc_address, gGL.getShaderiv, "glGetShaderiv");
+    loadGLFunction(get_proc_address, gGL.getShaderInfoLog, "glGetShaderInfoLog");
+    loadGLFunction(get_proc_address, gGL.createProgram, "glCreateProgram");
+    loadGLFunction(get_proc_address, gGL.deleteProgram, "glDeleteProgram");
+    loadGLFunction(get_proc_address, gGL.attachShader, "glAttachShader");
+    loadGLFunction(get_proc_address, gGL.linkProgram, "glLinkProgram");
+    loadGLFunction(get_proc_address, gGL.getProgramiv, "glGetProgramiv");
+    loadGLFunction(get_proc_address, gGL.getProgramInfoLog, "glGetProgramInfoLog");
+    loadGLFunction(get_proc_address, gGL.useProgram, "glUseProgram");
+    loadGLFunction(get_proc_address, gGL.getUniformLocation, "glGetUniformLocation");
+    loadGLFunction(get_proc_address, gGL.uniform1i, "glUniform1i");
+    loadGLFunction(get_proc_address, gGL.uniform2f, "glUniform2f");
+    loadGLFunction(get_proc_address, gGL.genVertexArrays, "glGenVertexArrays");
+    loadGLFunction(get_proc_address, gGL.deleteVertexArrays, "glDeleteVertexArrays");
+    loadGLFunction(get_proc_address, gGL.bindVertexArray, "glBindVertexArray");
+    loadGLFunction(get_proc_address, gGL.enableVertexAttribArray, "glEnableVertexAttribArray");
+    loadGLFunction(get_proc_address, gGL.vertexAttribPointer, "glVertexAttribPointer");
+    loadGLFunction(get_proc_address, gGL.vertexAttribDivisor, "glVertexAttribDivisor", "glVertexAttribDivisorARB");
+    loadGLFunction(get_proc_address, gGL.drawArraysInstanced, "glDrawArraysInstanced", "glDrawArraysInstancedARB");
+    loadGLFunction(get_proc_address, gGL.texStorage2D, "glTexStorage2D");
+}
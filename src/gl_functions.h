@@ -0,0 +1,222 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _GL_FUNCTIONS_H_
+#define _GL_FUNCTIONS_H_
+
+#ifdef _WIN32
+// keep windows.h from defining min and max macros that break std::min/std::max
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////////
+// the Windows OpenGL headers stop at 1.1 so anything newer we use is declared
+// here and loaded at runtime once a context exists
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+#ifndef GL_VERSION_1_5
+typedef ptrdiff_t GLsizeiptr;
+typedef ptrdiff_t GLintptr;
+#define GL_ARRAY_BUFFER 0x8892
+#define GL_STREAM_DRAW 0x88E0
+#define GL_WRITE_ONLY 0x88B9
+#endif
+
+#ifndef GL_VERSION_2_0
+typedef char GLchar;
+#define GL_FRAGMENT_SHADER 0x8B30
+#define GL_VERTEX_SHADER 0x8B31
+#define GL_COMPILE_STATUS 0x8B81
+#define GL_LINK_STATUS 0x8B82
+#define GL_INFO_LOG_LENGTH 0x8B84
+#endif
+
+#ifndef GL_VERSION_2_1
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+
+#ifndef GL_VERSION_3_0
+#define GL_MAP_WRITE_BIT 0x0002
+#define GL_MAP_INVALIDATE_RANGE_BIT 0x0004
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
+#define GL_MAP_FLUSH_EXPLICIT_BIT 0x0010
+#define GL_MAP_UNSYNCHRONIZED_BIT 0x0020
+#define GL_FRAMEBUFFER 0x8D40
+#define GL_READ_FRAMEBUFFER 0x8CA8
+#define GL_DRAW_FRAMEBUFFER 0x8CA9
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#define GL_FRAMEBUFFER_BINDING 0x8CA6
+#endif
+
+#ifndef GL_VERSION_3_2
+typedef struct __GLsync* GLsync;
+typedef uint64_t GLuint64;
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_ALREADY_SIGNALED 0x911A
+#define GL_TIMEOUT_EXPIRED 0x911B
+#define GL_CONDITION_SATISFIED 0x911C
+#define GL_WAIT_FAILED 0x911D
+#endif
+
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+#ifndef GL_BGRA_EXT
+#define GL_BGRA_EXT 0x80E1
+#endif
+
+struct GLFunctions
+{
+    typedef void (APIENTRY* GenBuffers)(GLsizei n, GLuint* buffers);
+    typedef void (APIENTRY* DeleteBuffers)(GLsizei n, const GLuint* buffers);
+    typedef void (APIENTRY* BindBuffer)(GLenum target, GLuint buffer);
+    typedef void (APIENTRY* BufferData)(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+    typedef void (APIENTRY* BufferStorage)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+    typedef void* (APIENTRY* MapBufferRange)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+    typedef GLboolean (APIENTRY* UnmapBuffer)(GLenum target);
+    typedef void (APIENTRY* FlushMappedBufferRange)(GLenum target, GLintptr offset, GLsizeiptr length);
+    typedef GLsync (APIENTRY* FenceSync)(GLenum condition, GLbitfield flags);
+    typedef GLenum (APIENTRY* ClientWaitSync)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+    typedef void (APIENTRY* DeleteSync)(GLsync sync);
+    typedef void (APIENTRY* GenFramebuffers)(GLsizei n, GLuint* framebuffers);
+    typedef void (APIENTRY* DeleteFramebuffers)(GLsizei n, const GLuint* framebuffers);
+    typedef void (APIENTRY* BindFramebuffer)(GLenum target, GLuint framebuffer);
+    typedef void (APIENTRY* FramebufferTexture2D)(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+    typedef GLenum (APIENTRY* CheckFramebufferStatus)(GLenum target);
+    typedef GLuint (APIENTRY* CreateShader)(GLenum type);
+    typedef void (APIENTRY* DeleteShader)(GLuint shader);
+    typedef void (APIENTRY* ShaderSource)(GLuint shader, GLsizei count, const GLchar* const* string, const GLint* length);
+    typedef void (APIENTRY* CompileShader)(GLuint shader);
+    typedef void (APIENTRY* GetShaderiv)(GLuint shader, GLenum pname, GLint* params);
+    typedef void (APIENTRY* GetShaderInfoLog)(GLuint shader, GLsizei max_length, GLsizei* length, GLchar* log);
+    typedef GLuint (APIENTRY* CreateProgram)();
+    typedef void (APIENTRY* DeleteProgram)(GLuint program);
+    typedef void (APIENTRY* AttachShader)(GLuint program, GLuint shader);
+    typedef void (APIENTRY* LinkProgram)(GLuint program);
+    typedef void (APIENTRY* GetProgramiv)(GLuint program, GLenum pname, GLint* params);
+    typedef void (APIENTRY* GetProgramInfoLog)(GLuint program, GLsizei max_length, GLsizei* length, GLchar* log);
+    typedef void (APIENTRY* UseProgram)(GLuint program);
+    typedef GLint (APIENTRY* GetUniformLocation)(GLuint program, const GLchar* name);
+    typedef void (APIENTRY* Uniform1i)(GLint location, GLint v0);
+    typedef void (APIENTRY* Uniform2f)(GLint location, GLfloat v0, GLfloat v1);
+    typedef void (APIENTRY* GenVertexArrays)(GLsizei n, GLuint* arrays);
+    typedef void (APIENTRY* DeleteVertexArrays)(GLsizei n, const GLuint* arrays);
+    typedef void (APIENTRY* BindVertexArray)(GLuint array);
+    typedef void (APIENTRY* EnableVertexAttribArray)(GLuint index);
+    typedef void (APIENTRY* VertexAttribPointer)(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer);
+    typedef void (APIENTRY* VertexAttribDivisor)(GLuint index, GLuint divisor);
+    typedef void (APIENTRY* DrawArraysInstanced)(GLenum mode, GLint first, GLsizei count, GLsizei instances);
+    typedef void (APIENTRY* TexStorage2D)(GLenum target, GLsizei levels, GLenum internal_format, GLsizei width, GLsizei height);
+
+    GenBuffers genBuffers = nullptr;
+    DeleteBuffers deleteBuffers = nullptr;
+    BindBuffer bindBuffer = nullptr;
+    BufferData bufferData = nullptr;
+    BufferStorage bufferStorage = nullptr;
+    MapBufferRange mapBufferRange = nullptr;
+    UnmapBuffer unmapBuffer = nullptr;
+    FlushMappedBufferRange flushMappedBufferRange = nullptr;
+    FenceSync fenceSync = nullptr;
+    ClientWaitSync clientWaitSync = nullptr;
+    DeleteSync deleteSync = nullptr;
+    GenFramebuffers genFramebuffers = nullptr;
+    DeleteFramebuffers deleteFramebuffers = nullptr;
+    BindFramebuffer bindFramebuffer = nullptr;
+    FramebufferTexture2D framebufferTexture2D = nullptr;
+    CheckFramebufferStatus checkFramebufferStatus = nullptr;
+    CreateShader createShader = nullptr;
+    DeleteShader deleteShader = nullptr;
+    ShaderSource shaderSource = nullptr;
+    CompileShader compileShader = nullptr;
+    GetShaderiv getShaderiv = nullptr;
+    GetShaderInfoLog getShaderInfoLog = nullptr;
+    CreateProgram createProgram = nullptr;
+    DeleteProgram deleteProgram = nullptr;
+    AttachShader attachShader = nullptr;
+    LinkProgram linkProgram = nullptr;
+    GetProgramiv getProgramiv = nullptr;
+    GetProgramInfoLog getProgramInfoLog = nullptr;
+    UseProgram useProgram = nullptr;
+    GetUniformLocation getUniformLocation = nullptr;
+    Uniform1i uniform1i = nullptr;
+    Uniform2f uniform2f = nullptr;
+    GenVertexArrays genVertexArrays = nullptr;
+    DeleteVertexArrays deleteVertexArrays = nullptr;
+    BindVertexArray bindVertexArray = nullptr;
+    EnableVertexAttribArray enableVertexAttribArray = nullptr;
+    VertexAttribPointer vertexAttribPointer = nullptr;
+    VertexAttribDivisor vertexAttribDivisor = nullptr;
+    DrawArraysInstanced drawArraysInstanced = nullptr;
+    TexStorage2D texStorage2D = nullptr;
+
+    // GL 2.1 / ARB_pixel_buffer_object plus GL 3.0 / ARB_map_buffer_range
+    bool hasPixelBuffers() const
+    {
+        return genBuffers && deleteBuffers && bindBuffer && bufferData && mapBufferRange && unmapBuffer;
+    }
+
+    // GL 3.2 / ARB_sync
+    bool hasSync() const
+    {
+        return fenceSync && clientWaitSync && deleteSync;
+    }
+
+    // GL 3.0 / ARB_framebuffer_object
+    bool hasFramebuffers() const
+    {
+        return genFramebuffers && deleteFramebuffers && bindFramebuffer && framebufferTexture2D && checkFramebufferStatus;
+    }
+
+    // GL 4.4 / ARB_buffer_storage
+    bool hasBufferStorage() const
+    {
+        return hasPixelBuffers() && bufferStorage;
+    }
+
+    // GL 2.0 shaders, GL 3.0 / ARB_vertex_array_object and GL 3.3 / ARB_instanced_arrays - everything
+    // ModernQuadRenderer (see gl_renderer.h) needs
+    bool hasShaders() const
+    {
+        return createShader && deleteShader && shaderSource && compileShader && getShaderiv && getShaderInfoLog &&
+               createProgram && deleteProgram && attachShader && linkProgram && getProgramiv && getProgramInfoLog &&
+               useProgram && getUniformLocation && uniform1i && uniform2f;
+    }
+
+    bool hasInstancing() const
+    {
+        return hasPixelBuffers() && hasShaders() && genVertexArrays && deleteVertexArrays && bindVertexArray &&
+               enableVertexAttribArray && vertexAttribPointer && vertexAttribDivisor && drawArraysInstanced;
+    }
+
+    // GL 4.2 / ARB_texture_storage
+    bool hasTextureStorage() const
+    {
+        return texStorage2D != nullptr;
+    }
+};
+extern GLFunctions gGL;
+
+// wglGetProcAddress, eglGetProcAddress etc. depending on the platform
+typedef void* (*GLGetProcAddress)(const char* name);
+
+// call with the context current - entry points that aren't there are left null
+void loadGLFunctions(GLGetProcAddress get_proc_address);
+
+#endif // _GL_FUNCTIONS_H_
@@ -0,0 +1,497 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "gl_renderer.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    // frames of quads the persistently mapped buffer holds - the GPU can be this many behind before we wait
+    const size_t kBufferFrames = 3;
+
+    // enough for a window full of browsers and their popups before the buffer has to grow
+    const size_t kInitialCapacity = 256;
+
+    // how long to block for a fence before giving up and checking again (nanoseconds)
+    const GLuint64 kFenceTimeout = 100000000;
+
+    // a quad is a 4 vertex triangle strip whose corners come from gl_VertexID, stretched over the instance's
+    // rectangle - there's no per vertex data at all
+    const char* kVertexShader =
+        "#version 330 core\n"
+        "layout(location = 0) in vec4 rect;\n"
+        "layout(location = 1) in vec4 texCoords;\n"
+        "uniform vec2 viewport;\n"
+        "out vec2 uv;\n"
+        "void main()\n"
+        "{\n"
+        "    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+        "    vec2 position = rect.xy + corner * rect.zw;\n"
+        "    uv = mix(texCoords.xy, texCoords.zw, corner);\n"
+        "    gl_Position = vec4(position.x / viewport.x * 2.0 - 1.0, 1.0 - position.y / viewport.y * 2.0, 0.0, 1.0);\n"
+        "}\n";
+
+    // the texture holds CEF's BGRA bytes as they are (TEXTURE_SWIZZLED) - swap them back here
+    const char* kFragmentShader =
+        "#version 330 core\n"
+        "uniform sampler2D page;\n"
+        "in vec2 uv;\n"
+        "out vec4 color;\n"
+        "void main()\n"
+        "{\n"
+        "    color = texture(page, uv).bgra;\n"
+        "}\n";
+
+    GLuint compileShader(GLenum type, const char* source)
+    {
+        GLuint shader = gGL.createShader(type);
+        gGL.shaderSource(shader, 1, &source, nullptr);
+        gGL.compileShader(shader);
+
+        GLint compiled = 0;
+        gGL.getShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (! compiled)
+        {
+            GLchar log[1024] = { 0 };
+            gGL.getShaderInfoLog(shader, sizeof(log), nullptr, log);
+            std::cout << "ModernQuadRenderer: unable to compile shader - " << log << std::endl;
+            gGL.deleteShader(shader);
+            return 0;
+        }
+        return shader;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+GLuint createPageTexture(int width, int height, TextureLayout layout)
+{
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    if (layout == TEXTURE_SWIZZLED && gGL.hasTextureStorage())
+    {
+        gGL.texStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+    }
+    else if (layout == TEXTURE_SWIZZLED)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    }
+    else
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_BGRA_EXT, GL_UNSIGNED_BYTE, 0);
+    }
+    return texture;
+}
+
+GLenum pageUploadFormat(TextureLayout layout)
+{
+    return (layout == TEXTURE_SWIZZLED) ? GL_RGBA : GL_BGRA_EXT;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+void QuadRenderer::add(const TexturedQuad& quad)
+{
+    if (quad.clip.isEmpty())
+    {
+        if (! quad.rect.isEmpty())
+        {
+            ++mStats.quads;
+            addQuad(quad);
+        }
+        return;
+    }
+
+    Rect rect = intersectRect(quad.rect, quad.clip);
+    if (rect.isEmpty())
+    {
+        return;
+    }
+
+    // texture coordinates move in proportion to the edges
+    TexturedQuad clipped = quad;
+    float u_scale = (quad.u1 - quad.u0) / quad.rect.width;
+    float v_scale = (quad.v1 - quad.v0) / quad.rect.height;
+    clipped.rect = rect;
+    clipped.u0 = quad.u0 + (rect.x - quad.rect.x) * u_scale;
+    clipped.v0 = quad.v0 + (rect.y - quad.rect.y) * v_scale;
+    clipped.u1 = quad.u0 + (rect.x + rect.width - quad.rect.x) * u_scale;
+    clipped.v1 = quad.v0 + (rect.y + rect.height - quad.rect.y) * v_scale;
+
+    ++mStats.quads;
+    addQuad(clipped);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+LegacyQuadRenderer::LegacyQuadRenderer() :
+    mBlending(false)
+{
+}
+
+void LegacyQuadRenderer::begin(int /*width*/, int /*height*/)
+{
+    glColor3f(1.0f, 1.0f, 1.0f);
+}
+
+void LegacyQuadRenderer::addQuad(const TexturedQuad& quad)
+{
+    // CEF's pixels are premultiplied
+    if (quad.blend != mBlending)
+    {
+        if (quad.blend)
+        {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        }
+        else
+        {
+            glDisable(GL_BLEND);
+        }
+        mBlending = quad.blend;
+    }
+
+    const Rect& rect = quad.rect;
+    glBindTexture(GL_TEXTURE_2D, quad.texture);
+    glBegin(GL_QUADS);
+    {
+        glTexCoord2f(quad.u1, quad.v0);
+        glVertex2d(rect.x + rect.width, rect.y);
+        glTexCoord2f(quad.u0, quad.v0);
+        glVertex2d(rect.x, rect.y);
+        glTexCoord2f(quad.u0, quad.v1);
+        glVertex2d(rect.x, rect.y + rect.height);
+        glTexCoord2f(quad.u1, quad.v1);
+        glVertex2d(rect.x + rect.width, rect.y + rect.height);
+    }
+    glEnd();
+    ++mStats.drawCalls;
+}
+
+void LegacyQuadRenderer::end()
+{
+    if (mBlending)
+    {
+        glDisable(GL_BLEND);
+        mBlending = false;
+    }
+    ++mStats.frames;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+ModernQuadRenderer::ModernQuadRenderer(bool allow_persistent) :
+    mAllowPersistent(allow_persistent),
+    mWidth(0),
+    mHeight(0),
+    mProgram(0),
+    mViewportLocation(-1),
+    mVertexArray(0),
+    mBuffer(0),
+    mPersistent(false),
+    mCapacity(0),
+    mFrame(0),
+    mMapped(nullptr)
+{
+}
+
+ModernQuadRenderer::~ModernQuadRenderer()
+{
+    destroyBuffer();
+
+    if (mVertexArray != 0)
+    {
+        gGL.deleteVertexArrays(1, &mVertexArray);
+    }
+
+    if (mProgram != 0)
+    {
+        gGL.deleteProgram(mProgram);
+    }
+}
+
+bool ModernQuadRenderer::create()
+{
+    if (! gGL.hasInstancing())
+    {
+        std::cout << "ModernQuadRenderer: shaders and instanced arrays not available" << std::endl;
+        return false;
+    }
+
+    GLuint vertex_shader = compileShader(GL_VERTEX_SHADER, kVertexShader);
+    GLuint fragment_shader = compileShader(GL_FRAGMENT_SHADER, kFragmentShader);
+    if (vertex_shader == 0 || fragment_shader == 0)
+    {
+        if (vertex_shader != 0)
+        {
+            gGL.deleteShader(vertex_shader);
+        }
+        if (fragment_shader != 0)
+        {
+            gGL.deleteShader(fragment_shader);
+        }
+        return false;
+    }
+
+    mProgram = gGL.createProgram();
+    gGL.attachShader(mProgram, vertex_shader);
+    gGL.attachShader(mProgram, fragment_shader);
+    gGL.linkProgram(mProgram);
+
+    // the program keeps them alive for as long as it needs them
+    gGL.deleteShader(vertex_shader);
+    gGL.deleteShader(fragment_shader);
+
+    GLint linked = 0;
+    gGL.getProgramiv(mProgram, GL_LINK_STATUS, &linked);
+    if (! linked)
+    {
+        GLchar log[1024] = { 0 };
+        gGL.getProgramInfoLog(mProgram, sizeof(log), nullptr, log);
+        std::cout << "ModernQuadRenderer: unable to link shader - " << log << std::endl;
+        return false;
+    }
+
+    mViewportLocation = gGL.getUniformLocation(mProgram, "viewport");
+    gGL.useProgram(mProgram);
+    gGL.uniform1i(gGL.getUniformLocation(mProgram, "page"), 0);
+    gGL.useProgram(0);
+
+    // both attributes step once per quad - where they are in the buffer is set per batch in end()
+    gGL.genVertexArrays(1, &mVertexArray);
+    gGL.bindVertexArray(mVertexArray);
+    gGL.enableVertexAttribArray(0);
+    gGL.enableVertexAttribArray(1);
+    gGL.vertexAttribDivisor(0, 1);
+    gGL.vertexAttribDivisor(1, 1);
+    gGL.bindVertexArray(0);
+
+    mPersistent = mAllowPersistent && gGL.hasBufferStorage() && gGL.hasSync();
+    createBuffer(kInitialCapacity);
+
+    std::cout << "ModernQuadRenderer: instanced quads from a" << (mPersistent ? " persistently mapped" : "n orphaned") << " vertex buffer, "
+              << (gGL.hasTextureStorage() ? "immutable" : "mutable") << " textures" << std::endl;
+    return true;
+}
+
+void ModernQuadRenderer::begin(int width, int height)
+{
+    mWidth = width;
+    mHeight = height;
+    mInstances.clear();
+    mBatches.clear();
+}
+
+void ModernQuadRenderer::addQuad(const TexturedQuad& quad)
+{
+    Instance instance;
+    instance.rect[0] = (float)quad.rect.x;
+    instance.rect[1] = (float)quad.rect.y;
+    instance.rect[2] = (float)quad.rect.width;
+    instance.rect[3] = (float)quad.rect.height;
+    instance.texCoords[0] = quad.u0;
+    instance.texCoords[1] = quad.v0;
+    instance.texCoords[2] = quad.u1;
+    instance.texCoords[3] = quad.v1;
+
+    // quads are drawn in the order they came so only a run of them can share a draw
+    if (mBatches.empty() || mBatches.back().texture != quad.texture || mBatches.back().blend != quad.blend)
+    {
+        Batch batch;
+        batch.texture = quad.texture;
+        batch.blend = quad.blend;
+        batch.first = mInstances.size();
+        batch.count = 0;
+        mBatches.push_back(batch);
+    }
+    ++mBatches.back().count;
+    mInstances.push_back(instance);
+}
+
+void ModernQuadRenderer::end()
+{
+    ++mStats.frames;
+    if (mInstances.empty())
+    {
+        return;
+    }
+
+    gGL.bindBuffer(GL_ARRAY_BUFFER, mBuffer);
+    Instance* instances = mapFrame(mInstances.size());
+    memcpy(instances, mInstances.data(), mInstances.size() * sizeof(Instance));
+
+    // the orphaned buffer is the frame, the persistent one has the frame somewhere in it
+    size_t base = 0;
+    if (mPersistent)
+    {
+        base = mFrame * mCapacity;
+    }
+    else
+    {
+        gGL.unmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    gGL.bindVertexArray(mVertexArray);
+    gGL.useProgram(mProgram);
+    gGL.uniform2f(mViewportLocation, (GLfloat)mWidth, (GLfloat)mHeight);
+
+    bool blending = false;
+    for (const Batch& batch : mBatches)
+    {
+        // CEF's pixels are premultiplied
+        if (batch.blend != blending)
+        {
+            if (batch.blend)
+            {
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+            }
+            else
+            {
+                glDisable(GL_BLEND);
+            }
+            blending = batch.blend;
+        }
+
+        // no base instance before GL 4.2 - point the attributes at the batch instead
+        const size_t offset = (base + batch.first) * sizeof(Instance);
+        gGL.vertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (const void*)offset);
+        gGL.vertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (const void*)(offset + sizeof(float) * 4));
+
+        glBindTexture(GL_TEXTURE_2D, batch.texture);
+        gGL.drawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)batch.count);
+        ++mStats.drawCalls;
+    }
+
+    if (blending)
+    {
+        glDisable(GL_BLEND);
+    }
+
+    gGL.useProgram(0);
+    gGL.bindVertexArray(0);
+    gGL.bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (mPersistent)
+    {
+        mFences[mFrame] = gGL.fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        mFrame = (mFrame + 1) % kBufferFrames;
+    }
+}
+
+void ModernQuadRenderer::createBuffer(size_t instances)
+{
+    mCapacity = instances;
+    mFrame = 0;
+
+    gGL.genBuffers(1, &mBuffer);
+    gGL.bindBuffer(GL_ARRAY_BUFFER, mBuffer);
+
+    if (mPersistent)
+    {
+        const GLsizeiptr size = kBufferFrames * mCapacity * sizeof(Instance);
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        gGL.bufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+        mMapped = (unsigned char*)gGL.mapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+        mFences.assign(kBufferFrames, (GLsync)0);
+    }
+    else
+    {
+        gGL.bufferData(GL_ARRAY_BUFFER, mCapacity * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+    }
+
+    gGL.bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ModernQuadRenderer::destroyBuffer()
+{
+    if (mBuffer == 0)
+    {
+        return;
+    }
+
+    for (GLsync fence : mFences)
+    {
+        if (fence != 0)
+        {
+            gGL.deleteSync(fence);
+        }
+    }
+    mFences.clear();
+
+    if (mMapped != nullptr)
+    {
+        gGL.bindBuffer(GL_ARRAY_BUFFER, mBuffer);
+        gGL.unmapBuffer(GL_ARRAY_BUFFER);
+        gGL.bindBuffer(GL_ARRAY_BUFFER, 0);
+        mMapped = nullptr;
+    }
+
+    gGL.deleteBuffers(1, &mBuffer);
+    mBuffer = 0;
+    mCapacity = 0;
+}
+
+ModernQuadRenderer::Instance* ModernQuadRenderer::mapFrame(size_t instances)
+{
+    // more quads than a frame holds - start again with room for twice as many
+    if (instances > mCapacity)
+    {
+        destroyBuffer();
+        createBuffer(instances > mCapacity * 2 ? instances : mCapacity * 2);
+        gGL.bindBuffer(GL_ARRAY_BUFFER, mBuffer);
+    }
+
+    if (! mPersistent)
+    {
+        // orphan last frame's storage so the driver can hand us fresh memory without waiting
+        gGL.bufferData(GL_ARRAY_BUFFER, mCapacity * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+        return (Instance*)gGL.mapBufferRange(GL_ARRAY_BUFFER, 0, mCapacity * sizeof(Instance), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    }
+
+    // the GPU could still be drawing from this frame's part of the buffer kBufferFrames frames ago
+    GLsync& fence = mFences[mFrame];
+    if (fence != 0)
+    {
+        GLenum result = gGL.clientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            ++mStats.bufferStalls;
+            while (result == GL_TIMEOUT_EXPIRED)
+            {
+                result = gGL.clientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, kFenceTimeout);
+            }
+        }
+        gGL.deleteSync(fence);
+        fence = 0;
+    }
+    return (Instance*)(mMapped + mFrame * mCapacity * sizeof(Instance));
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+QuadRenderer* createQuadRenderer(bool modern, bool allow_persistent)
+{
+    if (modern)
+    {
+        ModernQuadRenderer* renderer = new ModernQuadRenderer(allow_persistent);
+        if (renderer->create())
+        {
+            return renderer;
+        }
+
+        std::cout << "QuadRenderer: falling back to immediate mode" << std::endl;
+        delete renderer;
+    }
+    return new LegacyQuadRenderer;
+}
@@ -0,0 +1,232 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _GL_RENDERER_H_
+#define _GL_RENDERER_H_
+
+#include "compositor.h"
+#include "gl_functions.h"
+
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// how page pixels (BGRA in memory, premultiplied) are kept in a texture:
+//
+//   TEXTURE_BGRA      a GL_RGBA texture uploaded as GL_BGRA - the driver swaps
+//                     the channels on the way in (unless it happens to keep
+//                     the texture as BGRA) and fixed function GL draws it
+//
+//   TEXTURE_SWIZZLED  an immutable GL_RGBA8 texture (glTexStorage2D where the
+//                     context has it) the bytes go into as they are, uploaded
+//                     as GL_RGBA - the channels are swapped back in the shader
+//                     when it's drawn, so only ModernQuadRenderer can draw it
+enum TextureLayout
+{
+    TEXTURE_BGRA,
+    TEXTURE_SWIZZLED
+};
+
+// a texture of width x height for page pixels with linear filtering, left bound. An immutable one
+// can't change size - make a new one
+GLuint createPageTexture(int width, int height, TextureLayout layout);
+
+// the format to hand glTexSubImage2D page pixels in
+GLenum pageUploadFormat(TextureLayout layout);
+
+/////////////////////////////////////////////////////////////////////////////////
+// part of a texture drawn into a rectangle of the window (pixels, top left is
+// 0, 0). Anything outside clip (when it isn't empty) is cut off - the quad is
+// trimmed on the CPU so there's no scissor state to break a batch up. Blended
+// quads go over what's there with premultiplied alpha
+struct TexturedQuad
+{
+    TexturedQuad() :
+        texture(0),
+        u0(0.0f),
+        v0(0.0f),
+        u1(1.0f),
+        v1(1.0f),
+        blend(false)
+    {
+    }
+
+    TexturedQuad(GLuint texture_, const Rect& rect_, float u0_, float v0_, float u1_, float v1_) :
+        texture(texture_),
+        rect(rect_),
+        u0(u0_),
+        v0(v0_),
+        u1(u1_),
+        v1(v1_),
+        blend(false)
+    {
+    }
+
+    GLuint texture;
+    Rect rect;
+    float u0;
+    float v0;
+    float u1;
+    float v1;
+    Rect clip;
+    bool blend;
+};
+
+struct QuadRendererStats
+{
+    QuadRendererStats() :
+        frames(0),
+        quads(0),
+        drawCalls(0),
+        bufferStalls(0)
+    {
+    }
+
+    size_t frames;
+    size_t quads;
+    size_t drawCalls;
+    // times the vertex buffer the frame wanted to write was still being read by the GPU
+    size_t bufferStalls;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// draws the browsers' textures into the window - add() everything for the frame
+// between begin() and end(), in the order it should go on screen
+class QuadRenderer
+{
+    public:
+        virtual ~QuadRenderer() {}
+
+        virtual const char* name() const = 0;
+
+        // the textures it can draw
+        virtual TextureLayout layout() const = 0;
+
+        // the size of what's being drawn into
+        virtual void begin(int width, int height) = 0;
+        void add(const TexturedQuad& quad);
+        virtual void end() = 0;
+
+        const QuadRendererStats& stats() const
+        {
+            return mStats;
+        }
+
+    protected:
+        // a quad that's left after clipping
+        virtual void addQuad(const TexturedQuad& quad) = 0;
+
+        QuadRendererStats mStats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// glBegin(GL_QUADS) for every quad, with whatever projection (glOrtho) and
+// state the render surface set up - how the apps have always drawn, kept for
+// contexts that can't do ModernQuadRenderer
+class LegacyQuadRenderer :
+    public QuadRenderer
+{
+    public:
+        LegacyQuadRenderer();
+
+        const char* name() const override
+        {
+            return "legacy";
+        }
+
+        TextureLayout layout() const override
+        {
+            return TEXTURE_BGRA;
+        }
+
+        void begin(int width, int height) override;
+        void end() override;
+
+    protected:
+        void addQuad(const TexturedQuad& quad) override;
+
+    private:
+        bool mBlending;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// a shader and instanced draws - only uses what's in a GL 3.3 core profile.
+// Every quad is an instance (its rectangle and texture coordinates) in a vertex
+// buffer, and runs of quads with the same texture and blending go in one
+// glDrawArraysInstanced call - all the browsers in an atlas page are one draw
+// (see TextureAtlas::quad()). The buffer is orphaned every frame, or if it's
+// allowed and the context has GL 4.4, persistently mapped and split into frames
+// fenced the way GLUploadBackend's pixel buffers are. A fence is a full flush
+// on a software renderer (Mesa llvmpipe) so orphaning is the default - see
+// gl_renderer_bench. Textures have to be TEXTURE_SWIZZLED - the shader swaps
+// BGRA back
+class ModernQuadRenderer :
+    public QuadRenderer
+{
+    public:
+        explicit ModernQuadRenderer(bool allow_persistent = false);
+        ~ModernQuadRenderer();
+
+        // false if the context doesn't have shaders and instancing or the shader doesn't build
+        bool create();
+
+        const char* name() const override
+        {
+            return "modern";
+        }
+
+        TextureLayout layout() const override
+        {
+            return TEXTURE_SWIZZLED;
+        }
+
+        void begin(int width, int height) override;
+        void end() override;
+
+    protected:
+        void addQuad(const TexturedQuad& quad) override;
+
+    private:
+        // what's written into the vertex buffer for a quad
+        struct Instance
+        {
+            float rect[4];
+            float texCoords[4];
+        };
+
+        struct Batch
+        {
+            GLuint texture;
+            bool blend;
+            size_t first;
+            size_t count;
+        };
+
+        void createBuffer(size_t instances);
+        void destroyBuffer();
+        Instance* mapFrame(size_t instances);
+
+        bool mAllowPersistent;
+        int mWidth;
+        int mHeight;
+        GLuint mProgram;
+        GLint mViewportLocation;
+        GLuint mVertexArray;
+        GLuint mBuffer;
+        bool mPersistent;
+        // instances each frame of the buffer can hold, and which frame is next
+        size_t mCapacity;
+        size_t mFrame;
+        unsigned char* mMapped;
+        std::vector<GLsync> mFences;
+        std::vector<Instance> mInstances;
+        std::vector<Batch> mBatches;
+};
+
+// the modern renderer if it's asked for and the context can do it, the legacy one if not
+QuadRenderer* createQuadRenderer(bool modern, bool allow_persistent = false);
+
+#endif // _GL_RENDERER_H_
@@ -0,0 +1,279 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "gl_upload.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    // start of each rect in a pixel buffer is aligned to this many bytes
+    const size_t kBufferAlignment = 64;
+
+    // how long to block for a fence before giving up and checking again (nanoseconds)
+    const GLuint64 kFenceTimeout = 100000000;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+GLUploadBackend::GLUploadBackend(int width, int height, Mode mode, int num_buffers, bool allow_persistent, TextureLayout layout) :
+    mLayout(layout),
+    mFormat(pageUploadFormat(layout)),
+    mTexture(layout == TEXTURE_SWIZZLED ? createPageTexture(width, height, layout) : 0),
+    mWidth(width),
+    mHeight(height),
+    mTextureWidth(width),
+    mTextureHeight(height),
+    mMode(mode),
+    mPersistent(false),
+    mNumBuffers(num_buffers > 0 ? num_buffers : 1),
+    mBufferSize(0),
+    mCurrent(0),
+    mOffset(0)
+{
+    if (mMode == PBO_RING && ! gGL.hasPixelBuffers())
+    {
+        std::cout << "GLUploadBackend: pixel buffer objects not available - using direct uploads" << std::endl;
+        mMode = DIRECT;
+    }
+
+    if (mMode == PBO_RING)
+    {
+        mPersistent = allow_persistent && gGL.hasBufferStorage() && gGL.hasSync();
+        createBuffers((size_t)width * height * kDepth);
+
+        std::cout << "GLUploadBackend: ring of " << mNumBuffers << (mPersistent ? " persistently mapped" : (gGL.hasSync() ? " fenced" : " orphaned")) << " pixel buffers" << std::endl;
+    }
+}
+
+GLUploadBackend::~GLUploadBackend()
+{
+    destroyBuffers();
+
+    if (mTexture != 0)
+    {
+        glDeleteTextures(1, &mTexture);
+    }
+}
+
+void GLUploadBackend::resize(int width, int height)
+{
+    mWidth = width;
+    mHeight = height;
+
+    // texture is created up front - it only needs redoing when the page outgrows it (or shrinks
+    // well inside it) and then it grows in steps so a live resize doesn't redo it on every pixel
+    if (growSurface(width, height, mTextureWidth, mTextureHeight))
+    {
+        // immutable storage can't be resized - it's a new texture (left bound)
+        if (mTexture != 0)
+        {
+            glDeleteTextures(1, &mTexture);
+            mTexture = createPageTexture(mTextureWidth, mTextureHeight, mLayout);
+        }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mTextureWidth, mTextureHeight, 0, GL_BGRA_EXT, GL_UNSIGNED_BYTE, 0);
+        }
+        ++mStats.textureReallocations;
+    }
+    else if (mTexture != 0)
+    {
+        glBindTexture(GL_TEXTURE_2D, mTexture);
+    }
+
+    // pixel buffers only ever need to hold the page but follow the texture so they grow in steps too
+    size_t size = (size_t)mTextureWidth * mTextureHeight * kDepth;
+    if (mMode == PBO_RING && size > mBufferSize)
+    {
+        destroyBuffers();
+        createBuffers(size);
+    }
+}
+
+void GLUploadBackend::beginUpload()
+{
+    if (mTexture != 0)
+    {
+        glBindTexture(GL_TEXTURE_2D, mTexture);
+    }
+
+    if (mMode != PBO_RING)
+    {
+        return;
+    }
+
+    PixelBuffer& buffer = mBuffers[mCurrent];
+    waitForBuffer(buffer);
+
+    if (! mPersistent)
+    {
+        gGL.bindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+        if (gGL.hasSync())
+        {
+            // the fence already told us the GPU is done with it so there's no need for the driver to check
+            buffer.mapped = (unsigned char*)gGL.mapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, mBufferSize, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        }
+        else
+        {
+            // no fences - orphan the old storage so the driver can hand us fresh memory without waiting
+            gGL.bufferData(GL_PIXEL_UNPACK_BUFFER, mBufferSize, nullptr, GL_STREAM_DRAW);
+            buffer.mapped = (unsigned char*)gGL.mapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, mBufferSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        }
+        gGL.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    mOffset = 0;
+    mPending.clear();
+}
+
+void GLUploadBackend::upload(const Rect& rect, const unsigned char* pixels, int stride)
+{
+    ++mStats.uploads;
+
+    size_t row_bytes = (size_t)rect.width * kDepth;
+    size_t bytes = row_bytes * rect.height;
+
+    if (mMode != PBO_RING || mBuffers[mCurrent].mapped == nullptr || mOffset + bytes > mBufferSize)
+    {
+        if (mMode == PBO_RING)
+        {
+            ++mStats.directFallbacks;
+        }
+        uploadDirect(rect, pixels, stride);
+        return;
+    }
+
+    // pack the rect tightly into the buffer - this is the only copy the CPU makes
+    unsigned char* dst = mBuffers[mCurrent].mapped + mOffset;
+    for (int row = 0; row < rect.height; ++row)
+    {
+        memcpy(dst, pixels, row_bytes);
+        pixels += (size_t)stride * kDepth;
+        dst += row_bytes;
+    }
+
+    PendingUpload pending;
+    pending.rect = rect;
+    pending.offset = mOffset;
+    mPending.push_back(pending);
+
+    mOffset += (bytes + kBufferAlignment - 1) & ~(kBufferAlignment - 1);
+}
+
+void GLUploadBackend::endUpload()
+{
+    if (mMode != PBO_RING)
+    {
+        return;
+    }
+
+    PixelBuffer& buffer = mBuffers[mCurrent];
+    gGL.bindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+
+    if (! mPersistent && buffer.mapped != nullptr)
+    {
+        gGL.unmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        buffer.mapped = nullptr;
+    }
+
+    // with a buffer bound the pointer is an offset into it and the call returns without copying
+    for (const PendingUpload& pending : mPending)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, pending.rect.x, pending.rect.y, pending.rect.width, pending.rect.height,
+                        mFormat, GL_UNSIGNED_BYTE, (const void*)pending.offset);
+    }
+
+    gGL.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (gGL.hasSync() && ! mPending.empty())
+    {
+        buffer.fence = gGL.fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    mPending.clear();
+    mCurrent = (mCurrent + 1) % mBuffers.size();
+}
+
+void GLUploadBackend::createBuffers(size_t size)
+{
+    mBufferSize = size;
+    mBuffers.resize(mNumBuffers);
+    mCurrent = 0;
+
+    for (PixelBuffer& buffer : mBuffers)
+    {
+        gGL.genBuffers(1, &buffer.id);
+        gGL.bindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+
+        if (mPersistent)
+        {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            gGL.bufferStorage(GL_PIXEL_UNPACK_BUFFER, mBufferSize, nullptr, flags);
+            buffer.mapped = (unsigned char*)gGL.mapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, mBufferSize, flags);
+        }
+        else
+        {
+            gGL.bufferData(GL_PIXEL_UNPACK_BUFFER, mBufferSize, nullptr, GL_STREAM_DRAW);
+        }
+    }
+
+    gGL.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void GLUploadBackend::destroyBuffers()
+{
+    for (PixelBuffer& buffer : mBuffers)
+    {
+        if (buffer.fence != 0)
+        {
+            gGL.deleteSync(buffer.fence);
+        }
+
+        if (buffer.mapped != nullptr)
+        {
+            gGL.bindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+            gGL.unmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            gGL.bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        gGL.deleteBuffers(1, &buffer.id);
+    }
+
+    mBuffers.clear();
+    mBufferSize = 0;
+}
+
+void GLUploadBackend::waitForBuffer(PixelBuffer& buffer)
+{
+    if (buffer.fence == 0)
+    {
+        return;
+    }
+
+    GLenum result = gGL.clientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (result == GL_TIMEOUT_EXPIRED)
+    {
+        ++mStats.fenceStalls;
+        while (result == GL_TIMEOUT_EXPIRED)
+        {
+            result = gGL.clientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, kFenceTimeout);
+        }
+    }
+
+    gGL.deleteSync(buffer.fence);
+    buffer.fence = 0;
+}
+
+void GLUploadBackend::uploadDirect(const Rect& rect, const unsigned char* pixels, int stride)
+{
+    // setting the row length lets us point straight at the sub-rectangle inside the page buffer
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, stride);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, mFormat, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
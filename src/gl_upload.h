@@ -0,0 +1,178 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _GL_UPLOAD_H_
+#define _GL_UPLOAD_H_
+
+#include "compositor.h"
+#include "gl_functions.h"
+#include "gl_renderer.h"
+#include "pixel_pool.h"
+
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// pushes the parts of the page the compositor says changed into the currently
+// bound GL_TEXTURE_2D. Two ways to do it:
+//
+//    DIRECT   - glTexSubImage2D straight from the page pixels. The driver has to
+//               copy the pixels before the call returns so the caller (the CEF UI
+//               thread) pays for the whole transfer
+//
+//    PBO_RING - the pixels are written into one of a ring of pixel buffer objects
+//               and glTexSubImage2D is sourced from there, so the transfer to the
+//               texture can overlap with the next frame. Buffers are persistently
+//               mapped where GL 4.4 / ARB_buffer_storage is available, otherwise
+//               mapped each frame. A fence per buffer stops us writing into one the
+//               GPU is still reading from (with no fences, buffers are orphaned)
+//
+// PBO_RING falls back to DIRECT if the context doesn't have pixel buffer objects.
+//
+// With TEXTURE_SWIZZLED (see gl_renderer.h) the backend makes the texture and
+// binds it itself, and makes a new one when the page outgrows it since the
+// storage is immutable - texture() is the one to draw.
+//
+// The texture grows in steps (see growSurface()) as the page gets bigger so it
+// can be bigger than the page - draw it with texture coordinates that go up to
+// width() / textureWidth() and height() / textureHeight()
+struct GLUploadStats
+{
+    GLUploadStats() :
+        uploads(0),
+        fenceStalls(0),
+        directFallbacks(0),
+        textureReallocations(0)
+    {
+    }
+
+    size_t uploads;
+    // times we had to wait for the GPU to finish with a buffer before we could reuse it
+    size_t fenceStalls;
+    // rects that didn't fit in the remaining space of the frame's buffer
+    size_t directFallbacks;
+    // times the page outgrew (or shrank well inside) the texture
+    size_t textureReallocations;
+};
+
+class GLUploadBackend :
+    public UploadBackend
+{
+    public:
+        enum Mode
+        {
+            DIRECT,
+            PBO_RING
+        };
+
+        // expects a texture of width x height to be bound already unless the layout is TEXTURE_SWIZZLED -
+        // allow_persistent false forces the orphaning path even where persistent mapping is available
+        // (for comparing the two)
+        GLUploadBackend(int width, int height, Mode mode, int num_buffers, bool allow_persistent = true, TextureLayout layout = TEXTURE_BGRA);
+        ~GLUploadBackend();
+
+        void resize(int width, int height) override;
+        void beginUpload() override;
+        void upload(const Rect& rect, const unsigned char* pixels, int stride) override;
+        void endUpload() override;
+
+        // what we ended up with after falling back
+        Mode mode() const
+        {
+            return mMode;
+        }
+
+        bool isPersistent() const
+        {
+            return mPersistent;
+        }
+
+        TextureLayout layout() const
+        {
+            return mLayout;
+        }
+
+        // the texture it made for itself - 0 with TEXTURE_BGRA, where it's the caller's
+        GLuint texture() const
+        {
+            return mTexture;
+        }
+
+        const GLUploadStats& stats() const
+        {
+            return mStats;
+        }
+
+        // size of the page
+        int width() const
+        {
+            return mWidth;
+        }
+
+        int height() const
+        {
+            return mHeight;
+        }
+
+        // size of the texture it's in
+        int textureWidth() const
+        {
+            return mTextureWidth;
+        }
+
+        int textureHeight() const
+        {
+            return mTextureHeight;
+        }
+
+        // bytes of GPU (or driver) memory for the texture and pixel buffers
+        size_t memoryUsage() const override
+        {
+            return (size_t)mTextureWidth * mTextureHeight * kDepth + mBuffers.size() * mBufferSize;
+        }
+
+    private:
+        struct PixelBuffer
+        {
+            PixelBuffer() : id(0), fence(0), mapped(nullptr) {}
+
+            GLuint id;
+            GLsync fence;
+            unsigned char* mapped;
+        };
+
+        struct PendingUpload
+        {
+            Rect rect;
+            size_t offset;
+        };
+
+        void createBuffers(size_t size);
+        void destroyBuffers();
+        void waitForBuffer(PixelBuffer& buffer);
+        void uploadDirect(const Rect& rect, const unsigned char* pixels, int stride);
+
+        TextureLayout mLayout;
+        GLenum mFormat;
+        GLuint mTexture;
+        int mWidth;
+        int mHeight;
+        int mTextureWidth;
+        int mTextureHeight;
+
+        Mode mMode;
+        bool mPersistent;
+        int mNumBuffers;
+        std::vector<PixelBuffer> mBuffers;
+        size_t mBufferSize;
+        size_t mCurrent;
+        size_t mOffset;
+        std::vector<PendingUpload> mPending;
+
+        GLUploadStats mStats;
+};
+
+#endif // _GL_UPLOAD_H_
@@ -0,0 +1,291 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "image_encoder.h"
+#include "pixel_kernels.h"
+
+#include <cstring>
+
+namespace
+{
+    // the stored blocks of a deflate stream can't be any longer
+    const size_t kMaxStoredBlock = 65535;
+
+    void putBigEndian(std::vector<unsigned char>& out, unsigned int value)
+    {
+        out.push_back((unsigned char)(value >> 24));
+        out.push_back((unsigned char)(value >> 16));
+        out.push_back((unsigned char)(value >> 8));
+        out.push_back((unsigned char)value);
+    }
+
+    unsigned int crc32(const unsigned char* data, size_t size)
+    {
+        // made once - initialising a local static is thread safe
+        struct Table
+        {
+            Table()
+            {
+                for (unsigned int i = 0; i < 256; ++i)
+                {
+                    unsigned int c = i;
+                    for (int bit = 0; bit < 8; ++bit)
+                    {
+                        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                    }
+                    entries[i] = c;
+                }
+            }
+
+            unsigned int entries[256];
+        };
+        static const Table table;
+
+        unsigned int crc = 0xffffffffu;
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    // a chunk's CRC covers its type and data but not its length
+    void putChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data)
+    {
+        putBigEndian(out, (unsigned int)data.size());
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        putBigEndian(out, crc32(&out[start], out.size() - start));
+    }
+
+    // one row at a time, unpremultiplied and in RGBA order
+    class RowConverter
+    {
+        public:
+            RowConverter(const unsigned char* bgra, int width) :
+                mKernels(pixelKernels()),
+                mBGRA(bgra),
+                mWidth(width),
+                mRow((size_t)width * kDepth)
+            {
+            }
+
+            const unsigned char* row(int y)
+            {
+                mKernels.unpremultiplyRow(mRow.data(), mBGRA + (size_t)y * mWidth * kDepth, mWidth);
+                mKernels.swizzleRow(mRow.data(), mRow.data(), mWidth);
+                return mRow.data();
+            }
+
+        private:
+            const PixelKernels& mKernels;
+            const unsigned char* mBGRA;
+            int mWidth;
+            std::vector<unsigned char> mRow;
+    };
+
+    void encodePNG(const unsigned char* bgra, int width, int height, std::vector<unsigned char>& out)
+    {
+        static const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        out.assign(signature, signature + sizeof(signature));
+
+        std::vector<unsigned char> header;
+        putBigEndian(header, (unsigned int)width);
+        putBigEndian(header, (unsigned int)height);
+        // 8 bits per channel, RGBA, deflate, adaptive filtering, not interlaced
+        const unsigned char format[] = { 8, 6, 0, 0, 0 };
+        header.insert(header.end(), format, format + sizeof(format));
+        putChunk(out, "IHDR", header);
+
+        // every row starts with its filter type - 0 is none
+        const size_t row_bytes = (size_t)width * kDepth + 1;
+        std::vector<unsigned char> raw(row_bytes * height);
+        RowConverter converter(bgra, width);
+        for (int y = 0; y < height; ++y)
+        {
+            raw[y * row_bytes] = 0;
+            memcpy(&raw[y * row_bytes + 1], converter.row(y), row_bytes - 1);
+        }
+
+        // a zlib stream of stored blocks - header, blocks, then the Adler-32 of the raw bytes
+        std::vector<unsigned char> data;
+        data.reserve(raw.size() + raw.size() / kMaxStoredBlock * 5 + 16);
+        data.push_back(0x78);
+        data.push_back(0x01);
+        for (size_t offset = 0; offset < raw.size(); offset += kMaxStoredBlock)
+        {
+            size_t length = raw.size() - offset < kMaxStoredBlock ? raw.size() - offset : kMaxStoredBlock;
+            bool last = (offset + length == raw.size());
+            data.push_back(last ? 1 : 0);
+            data.push_back((unsigned char)length);
+            data.push_back((unsigned char)(length >> 8));
+            data.push_back((unsigned char)~length);
+            data.push_back((unsigned char)(~length >> 8));
+            data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + length);
+        }
+
+        unsigned int a = 1;
+        unsigned int b = 0;
+        for (size_t i = 0; i < raw.size(); ++i)
+        {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        putBigEndian(data, (b << 16) | a);
+
+        putChunk(out, "IDAT", data);
+        putChunk(out, "IEND", std::vector<unsigned char>());
+    }
+
+    void encodeQOI(const unsigned char* bgra, int width, int height, std::vector<unsigned char>& out)
+    {
+        const unsigned char QOI_OP_INDEX = 0x00;
+        const unsigned char QOI_OP_DIFF = 0x40;
+        const unsigned char QOI_OP_LUMA = 0x80;
+        const unsigned char QOI_OP_RUN = 0xc0;
+        const unsigned char QOI_OP_RGB = 0xfe;
+        const unsigned char QOI_OP_RGBA = 0xff;
+
+        out.clear();
+        out.reserve((size_t)width * height * 2 + 22);
+        out.push_back('q');
+        out.push_back('o');
+        out.push_back('i');
+        out.push_back('f');
+        putBigEndian(out, (unsigned int)width);
+        putBigEndian(out, (unsigned int)height);
+        // RGBA, sRGB with linear alpha
+        out.push_back(4);
+        out.push_back(0);
+
+        unsigned char index[64][4] = {};
+        unsigned char previous[4] = { 0, 0, 0, 255 };
+        int run = 0;
+
+        RowConverter converter(bgra, width);
+        for (int y = 0; y < height; ++y)
+        {
+            const unsigned char* row = converter.row(y);
+            for (int x = 0; x < width; ++x)
+            {
+                const unsigned char* pixel = row + x * kDepth;
+                bool last = (y == height - 1 && x == width - 1);
+
+                if (memcmp(pixel, previous, kDepth) == 0)
+                {
+                    if (++run == 62 || last)
+                    {
+                        out.push_back((unsigned char)(QOI_OP_RUN | (run - 1)));
+                        run = 0;
+                    }
+                    continue;
+                }
+
+                if (run > 0)
+                {
+                    out.push_back((unsigned char)(QOI_OP_RUN | (run - 1)));
+                    run = 0;
+                }
+
+                int hash = (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+                if (memcmp(index[hash], pixel, kDepth) == 0)
+                {
+                    out.push_back((unsigned char)(QOI_OP_INDEX | hash));
+                }
+                else
+                {
+                    memcpy(index[hash], pixel, kDepth);
+
+                    if (pixel[3] == previous[3])
+                    {
+                        int dr = (signed char)(pixel[0] - previous[0]);
+                        int dg = (signed char)(pixel[1] - previous[1]);
+                        int db = (signed char)(pixel[2] - previous[2]);
+                        int dr_dg = dr - dg;
+                        int db_dg = db - dg;
+
+                        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                        {
+                            out.push_back((unsigned char)(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                        }
+                        else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7)
+                        {
+                            out.push_back((unsigned char)(QOI_OP_LUMA | (dg + 32)));
+                            out.push_back((unsigned char)((dr_dg + 8) << 4 | (db_dg + 8)));
+                        }
+                        else
+                        {
+                            out.push_back(QOI_OP_RGB);
+                            out.insert(out.end(), pixel, pixel + 3);
+                        }
+                    }
+                    else
+                    {
+                        out.push_back(QOI_OP_RGBA);
+                        out.insert(out.end(), pixel, pixel + 4);
+                    }
+                }
+
+                memcpy(previous, pixel, kDepth);
+            }
+        }
+
+        // the end marker
+        static const unsigned char padding[] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+        out.insert(out.end(), padding, padding + sizeof(padding));
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+const char* imageFormatName(ImageFormat format)
+{
+    switch (format)
+    {
+        case IMAGE_PNG:
+            return "png";
+        case IMAGE_QOI:
+            return "qoi";
+        default:
+            return "none";
+    }
+}
+
+ImageFormat imageFormatFromName(const char* name)
+{
+    if (strcmp(name, "png") == 0)
+    {
+        return IMAGE_PNG;
+    }
+    if (strcmp(name, "qoi") == 0)
+    {
+        return IMAGE_QOI;
+    }
+    return IMAGE_NONE;
+}
+
+bool encodeImage(ImageFormat format, const unsigned char* bgra, int width, int height, std::vector<unsigned char>& out)
+{
+    out.clear();
+    if (width <= 0 || height <= 0)
+    {
+        return false;
+    }
+
+    switch (format)
+    {
+        case IMAGE_PNG:
+            encodePNG(bgra, width, height, out);
+            return true;
+        case IMAGE_QOI:
+            encodeQOI(bgra, width, height, out);
+            return true;
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,37 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _IMAGE_ENCODER_H_
+#define _IMAGE_ENCODER_H_
+
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// writes CEF's pixels (premultiplied BGRA, width pixels to a row) out as an
+// image file in memory - they're unpremultiplied and swizzled to RGBA with the
+// pixel kernels on the way. Neither needs a library:
+//
+//   IMAGE_PNG  8 bit RGBA PNG with no filtering, its deflate stream made of
+//              stored blocks - any PNG reader takes it but it isn't compressed
+//   IMAGE_QOI  the Quite OK Image format (qoiformat.org) - compresses about as
+//              well as a fast PNG and takes a fraction of the time
+enum ImageFormat
+{
+    IMAGE_NONE,
+    IMAGE_PNG,
+    IMAGE_QOI
+};
+
+// "png", "qoi" or "none"
+const char* imageFormatName(ImageFormat format);
+// IMAGE_NONE for anything it doesn't know
+ImageFormat imageFormatFromName(const char* name);
+
+// out is replaced - false for IMAGE_NONE or an empty image
+bool encodeImage(ImageFormat format, const unsigned char* bgra, int width, int height, std::vector<unsigned char>& out);
+
+#endif // _IMAGE_ENCODER_H_
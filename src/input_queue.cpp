@@ -0,0 +1,153 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "input_queue.h"
+#include "pump_scheduler.h"
+
+#include <algorithm>
+#include <limits>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+InputQueue::InputQueue(double interval) :
+    mInterval(interval),
+    mLastSent(-1.0),
+    mPainted(false),
+    mPendingButtons(0)
+{
+}
+
+void InputQueue::push(const InputEvent& event)
+{
+    ++mStats.received;
+
+    if (event.type == InputEvent::MOUSE_BUTTON)
+    {
+        ++mPendingButtons;
+        mEvents.push_back(event);
+        return;
+    }
+
+    // merge into the last event of the same kind as long as no button comes after it - the
+    // position is the latest one and the time is the earliest so latency counts from the first move
+    for (auto it = mEvents.rbegin(); it != mEvents.rend(); ++it)
+    {
+        if (it->type == InputEvent::MOUSE_BUTTON)
+        {
+            break;
+        }
+
+        if (it->type == event.type)
+        {
+            it->x = event.x;
+            it->y = event.y;
+            it->deltaX += event.deltaX;
+            it->deltaY += event.deltaY;
+            it->count += event.count;
+            return;
+        }
+    }
+
+    mEvents.push_back(event);
+}
+
+bool InputQueue::take(double now, std::vector<InputEvent>& events)
+{
+    if (timeUntilDue(now) > 0.0)
+    {
+        return false;
+    }
+
+    // everything queued goes - anything left after the last button was merged already
+    for (const InputEvent& event : mEvents)
+    {
+        events.push_back(event);
+    }
+    mStats.sent += mEvents.size();
+
+    mEvents.clear();
+    mPendingButtons = 0;
+    mLastSent = now;
+    mPainted = false;
+    return true;
+}
+
+double InputQueue::timeUntilDue(double now) const
+{
+    if (mEvents.empty())
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    if (mPendingButtons > 0 || mPainted || mInterval <= 0.0 || mLastSent < 0.0)
+    {
+        return 0.0;
+    }
+
+    return std::max(mLastSent + mInterval - now, 0.0);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+InputLatencyMatcher::InputLatencyMatcher(double max_wait) :
+    mMaxWait(max_wait)
+{
+}
+
+void InputLatencyMatcher::sent(const InputEvent& event, int id)
+{
+    std::vector<Pending>& pending = mPending[id];
+
+    // events that never got a paint (nothing changed) are dropped before they pile up
+    size_t expired = 0;
+    while (expired < pending.size() && event.timestamp - pending[expired].timestamp > mMaxWait)
+    {
+        ++expired;
+    }
+    pending.erase(pending.begin(), pending.begin() + expired);
+
+    Pending entry;
+    entry.type = event.type;
+    entry.timestamp = event.timestamp;
+    pending.push_back(entry);
+}
+
+void InputLatencyMatcher::painted(int id, double now)
+{
+    auto it = mPending.find(id);
+    if (it == mPending.end())
+    {
+        return;
+    }
+
+    for (const Pending& pending : it->second)
+    {
+        if (now - pending.timestamp <= mMaxWait)
+        {
+            mSamples[pending.type].push_back(now - pending.timestamp);
+        }
+    }
+    mPending.erase(it);
+}
+
+size_t InputLatencyMatcher::count(InputEvent::Type type) const
+{
+    return mSamples[type].size();
+}
+
+double InputLatencyMatcher::percentile(InputEvent::Type type, double percent) const
+{
+    return samplePercentile(mSamples[type], percent);
+}
+
+void InputLatencyMatcher::reset()
+{
+    for (std::vector<double>& samples : mSamples)
+    {
+        samples.clear();
+    }
+}
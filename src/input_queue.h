@@ -0,0 +1,154 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _INPUT_QUEUE_H_
+#define _INPUT_QUEUE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// mouse input on its way from the window to the browsers. A fast drag makes
+// Windows send far more WM_MOUSEMOVEs than a browser can paint, and every one
+// sent to CEF is work for the renderer - so moves (and wheel deltas) wait in
+// the queue and are merged until the browser has painted since the last send
+// (it's ready for more) or the send interval is up, while button presses and
+// releases go straight out in the order they happened, taking any moves
+// before them along first. Times are in milliseconds
+// (PumpScheduler::now()) and everything happens on the main thread
+struct InputEvent
+{
+    enum Type
+    {
+        MOUSE_MOVE,
+        MOUSE_BUTTON,
+        MOUSE_WHEEL
+    };
+
+    InputEvent() :
+        type(MOUSE_MOVE),
+        x(0),
+        y(0),
+        isUp(false),
+        deltaX(0),
+        deltaY(0),
+        timestamp(0.0),
+        count(1)
+    {
+    }
+
+    Type type;
+    // window coordinates
+    int x;
+    int y;
+    // MOUSE_BUTTON
+    bool isUp;
+    // MOUSE_WHEEL
+    int deltaX;
+    int deltaY;
+    // when the (first) event arrived from the window
+    double timestamp;
+    // how many window events were merged into this one
+    size_t count;
+};
+
+struct InputQueueStats
+{
+    InputQueueStats() :
+        received(0),
+        sent(0)
+    {
+    }
+
+    size_t received;
+    size_t sent;
+};
+
+class InputQueue
+{
+    public:
+        // the longest moves and wheel deltas wait to be sent if no browser paints - 0 sends everything as it arrives
+        InputQueue(double interval);
+
+        void push(const InputEvent& event);
+
+        // a browser painted - whatever is waiting can go now
+        void painted()
+        {
+            mPainted = true;
+        }
+
+        // appends whatever is due to be sent by now to events - returns false if there's nothing
+        bool take(double now, std::vector<InputEvent>& events);
+
+        // how long until something is due - infinity if the queue is empty
+        double timeUntilDue(double now) const;
+
+        bool empty() const
+        {
+            return mEvents.empty();
+        }
+
+        const InputQueueStats& stats() const
+        {
+            return mStats;
+        }
+
+        void resetStats()
+        {
+            mStats = InputQueueStats();
+        }
+
+    private:
+        double mInterval;
+        double mLastSent;
+        bool mPainted;
+        // buttons queued that haven't been sent yet - everything up to the last one is due now
+        size_t mPendingButtons;
+        std::deque<InputEvent> mEvents;
+        InputQueueStats mStats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// time from input arriving at the window to the paint of the browser it was
+// sent to. Every event sent to a browser waits for that browser's next paint -
+// an event that doesn't get one within max_wait didn't change anything and is
+// forgotten about
+class InputLatencyMatcher
+{
+    public:
+        InputLatencyMatcher(double max_wait = 1000.0);
+
+        // event went to browser id
+        void sent(const InputEvent& event, int id);
+
+        // browser id painted
+        void painted(int id, double now);
+
+        size_t count(InputEvent::Type type) const;
+
+        // milliseconds - percent from 0 to 100
+        double percentile(InputEvent::Type type, double percent) const;
+
+        void reset();
+
+    private:
+        struct Pending
+        {
+            InputEvent::Type type;
+            double timestamp;
+        };
+
+        double mMaxWait;
+        std::map<int, std::vector<Pending>> mPending;
+        std::vector<double> mSamples[InputEvent::MOUSE_WHEEL + 1];
+};
+
+#endif // _INPUT_QUEUE_H_
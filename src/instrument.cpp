@@ -0,0 +1,376 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "instrument.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+std::atomic<bool> gInstrumentEnabled(true);
+
+namespace
+{
+    // events each thread can hold between collections - must be a power of two
+    const size_t kRingCapacity = 32768;
+
+    /////////////////////////////////////////////////////////////////////////////////
+    // single producer (the thread it belongs to), single consumer (whoever collects)
+    class InstrumentRing
+    {
+        public:
+            InstrumentRing(uint32_t thread) :
+                mEvents(kRingCapacity),
+                mHead(0),
+                mTail(0),
+                mThread(thread)
+            {
+            }
+
+            bool push(InstrumentEvent& event)
+            {
+                size_t head = mHead.load(std::memory_order_relaxed);
+                if (head - mTail.load(std::memory_order_acquire) >= kRingCapacity)
+                {
+                    return false;
+                }
+
+                event.thread = mThread;
+                mEvents[head & (kRingCapacity - 1)] = event;
+                mHead.store(head + 1, std::memory_order_release);
+                return true;
+            }
+
+            size_t drain(std::vector<InstrumentEvent>& events)
+            {
+                size_t tail = mTail.load(std::memory_order_relaxed);
+                size_t head = mHead.load(std::memory_order_acquire);
+                for (size_t i = tail; i != head; ++i)
+                {
+                    events.push_back(mEvents[i & (kRingCapacity - 1)]);
+                }
+                mTail.store(head, std::memory_order_release);
+                return head - tail;
+            }
+
+            uint32_t thread() const
+            {
+                return mThread;
+            }
+
+            // set by the owning thread, read when writing a trace
+            std::string name;
+
+        private:
+            std::vector<InstrumentEvent> mEvents;
+            // padded onto cache lines of their own so the writer and reader don't fight over them
+            char mPadding0[64];
+            std::atomic<size_t> mHead;
+            char mPadding1[64];
+            std::atomic<size_t> mTail;
+            char mPadding2[64];
+            uint32_t mThread;
+    };
+
+    // every ring ever made - a thread's ring outlives the thread so whatever it
+    // recorded last can still be collected
+    struct RingRegistry
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<InstrumentRing>> rings;
+    };
+
+    RingRegistry& registry()
+    {
+        static RingRegistry registry;
+        return registry;
+    }
+
+    std::atomic<size_t> gDroppedEvents(0);
+
+    thread_local InstrumentRing* tRing = nullptr;
+
+    InstrumentRing* threadRing()
+    {
+        if (! tRing)
+        {
+            RingRegistry& rings = registry();
+            std::lock_guard<std::mutex> lock(rings.mutex);
+            rings.rings.emplace_back(new InstrumentRing((uint32_t)rings.rings.size() + 1));
+            tRing = rings.rings.back().get();
+        }
+        return tRing;
+    }
+
+    void push(InstrumentEvent& event)
+    {
+        if (! threadRing()->push(event))
+        {
+            gDroppedEvents.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void writeJsonString(FILE* file, const char* text)
+    {
+        fputc('"', file);
+        for (const char* c = text; *c; ++c)
+        {
+            if (*c == '"' || *c == '\\')
+            {
+                fputc('\\', file);
+            }
+            if ((unsigned char)*c >= 0x20)
+            {
+                fputc(*c, file);
+            }
+        }
+        fputc('"', file);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+uint64_t instrumentNow()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void setInstrumentEnabled(bool enabled)
+{
+    gInstrumentEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void setInstrumentThreadName(const char* name)
+{
+    InstrumentRing* ring = threadRing();
+
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    ring->name = name;
+}
+
+void instrumentScope(const char* name, uint64_t start, uint64_t end)
+{
+    InstrumentEvent event;
+    event.name = name;
+    event.start = start;
+    event.duration = end - start;
+    event.value = 0.0;
+    event.type = InstrumentEvent::SCOPE;
+    push(event);
+}
+
+void instrumentCounter(const char* name, double value)
+{
+    InstrumentEvent event;
+    event.name = name;
+    event.start = instrumentNow();
+    event.duration = 0;
+    event.value = value;
+    event.type = InstrumentEvent::COUNTER;
+    push(event);
+}
+
+size_t collectInstrumentEvents(std::vector<InstrumentEvent>& events)
+{
+    RingRegistry& rings = registry();
+    std::lock_guard<std::mutex> lock(rings.mutex);
+
+    size_t count = 0;
+    for (auto& ring : rings.rings)
+    {
+        count += ring->drain(events);
+    }
+    return count;
+}
+
+size_t instrumentDroppedEvents()
+{
+    return gDroppedEvents.load(std::memory_order_relaxed);
+}
+
+bool writeChromeTrace(const std::string& filename, const std::vector<InstrumentEvent>& events)
+{
+    FILE* file = fopen(filename.c_str(), "w");
+    if (! file)
+    {
+        return false;
+    }
+
+    // chrome://tracing wants microseconds - start the trace at the first event
+    uint64_t origin = events.empty() ? 0 : events.front().start;
+    for (const InstrumentEvent& event : events)
+    {
+        origin = std::min(origin, event.start);
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+
+    bool first = true;
+    {
+        RingRegistry& rings = registry();
+        std::lock_guard<std::mutex> lock(rings.mutex);
+        for (auto& ring : rings.rings)
+        {
+            if (ring->name.empty())
+            {
+                continue;
+            }
+
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", ring->thread());
+            writeJsonString(file, ring->name.c_str());
+            fprintf(file, "}}");
+            first = false;
+        }
+    }
+
+    for (const InstrumentEvent& event : events)
+    {
+        fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+        writeJsonString(file, event.name);
+
+        double ts = (event.start - origin) / 1000.0;
+        if (event.type == InstrumentEvent::SCOPE)
+        {
+            fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", event.thread, ts, event.duration / 1000.0);
+        }
+        else
+        {
+            fprintf(file, ",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%g}}", event.thread, ts, event.value);
+        }
+        first = false;
+    }
+
+    fprintf(file, "\n]}\n");
+
+    bool ok = ! ferror(file);
+    fclose(file);
+    return ok;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+DurationHistogram::DurationHistogram() :
+    mBuckets(kBuckets, 0),
+    mCount(0),
+    mTotal(0),
+    mMax(0)
+{
+}
+
+void DurationHistogram::add(uint64_t nanoseconds)
+{
+    int bucket;
+    if (nanoseconds < (uint64_t)kSubBuckets)
+    {
+        bucket = (int)nanoseconds;
+    }
+    else
+    {
+        // top bit picks the power of two, the 3 bits under it pick the sub bucket
+        int exponent = 0;
+        while ((nanoseconds >> exponent) > 1)
+        {
+            ++exponent;
+        }
+        int sub = (int)((nanoseconds >> (exponent - 3)) & (kSubBuckets - 1));
+        bucket = (exponent - 2) * kSubBuckets + sub;
+    }
+
+    ++mBuckets[bucket];
+    ++mCount;
+    mTotal += nanoseconds;
+    mMax = std::max(mMax, nanoseconds);
+}
+
+double DurationHistogram::mean() const
+{
+    return mCount ? (double)mTotal / mCount / 1.0e3 : 0.0;
+}
+
+double DurationHistogram::maximum() const
+{
+    return mMax / 1.0e3;
+}
+
+double DurationHistogram::percentile(double percent) const
+{
+    if (mCount == 0)
+    {
+        return 0.0;
+    }
+
+    size_t target = (size_t)(percent / 100.0 * mCount + 0.5);
+    target = std::max(target, (size_t)1);
+
+    size_t seen = 0;
+    for (int bucket = 0; bucket < kBuckets; ++bucket)
+    {
+        seen += mBuckets[bucket];
+        if (seen >= target)
+        {
+            if (bucket < kSubBuckets)
+            {
+                return bucket / 1.0e3;
+            }
+
+            // middle of the bucket
+            int exponent = bucket / kSubBuckets + 2;
+            int sub = bucket % kSubBuckets;
+            double low = (double)((uint64_t)(kSubBuckets + sub) << (exponent - 3));
+            double width = (double)((uint64_t)1 << (exponent - 3));
+            return std::min((low + width / 2.0) / 1.0e3, maximum());
+        }
+    }
+
+    return maximum();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+void InstrumentSummary::add(const std::vector<InstrumentEvent>& events)
+{
+    for (const InstrumentEvent& event : events)
+    {
+        if (event.type == InstrumentEvent::SCOPE)
+        {
+            mScopes[event.name].add(event.duration);
+        }
+        else
+        {
+            mCounters[event.name] = event.value;
+        }
+    }
+}
+
+void InstrumentSummary::write(std::ostream& stream) const
+{
+    std::ios::fmtflags flags = stream.flags();
+    std::streamsize precision = stream.precision();
+    stream << std::fixed << std::setprecision(1);
+
+    for (const auto& scope : mScopes)
+    {
+        const DurationHistogram& histogram = scope.second;
+        stream << std::left << std::setw(24) << scope.first << std::right
+               << " count " << std::setw(7) << histogram.count()
+               << " mean " << std::setw(8) << histogram.mean()
+               << " p50 " << std::setw(8) << histogram.percentile(50)
+               << " p99 " << std::setw(8) << histogram.percentile(99)
+               << " max " << std::setw(8) << histogram.maximum() << " us" << std::endl;
+    }
+
+    stream.flags(flags);
+    stream.precision(precision);
+
+    for (const auto& counter : mCounters)
+    {
+        stream << std::left << std::setw(24) << counter.first << std::right << " " << counter.second << std::endl;
+    }
+}
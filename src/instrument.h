@@ -0,0 +1,173 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _INSTRUMENT_H_
+#define _INSTRUMENT_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// timers and counters for the hot parts of the app (paint, upload, the message
+// loop, drawing, input). Each thread writes into a ring buffer of its own with
+// no locks - if the ring fills up before anyone collects it, new events are
+// dropped and counted. Somebody (the main loop) calls collectInstrumentEvents()
+// now and again to drain every ring, then feeds the events to an
+// InstrumentSummary for histograms and/or writes them out as Chrome trace
+// event JSON (load it in chrome://tracing or https://ui.perfetto.dev).
+//
+// Building with INSTRUMENTATION_ENABLED set to 0 (the INSTRUMENTATION CMake
+// option) turns the INSTRUMENT_ macros into nothing. Otherwise
+// setInstrumentEnabled(false) leaves each one costing a relaxed load and a branch.
+//
+// Names must be string literals (or otherwise live forever) - only the pointer is kept
+#ifndef INSTRUMENTATION_ENABLED
+#define INSTRUMENTATION_ENABLED 1
+#endif
+
+struct InstrumentEvent
+{
+    enum Type
+    {
+        SCOPE,
+        COUNTER
+    };
+
+    const char* name;
+    // nanoseconds from instrumentNow()
+    uint64_t start;
+    // nanoseconds for a SCOPE
+    uint64_t duration;
+    // the value of a COUNTER
+    double value;
+    uint32_t thread;
+    Type type;
+};
+
+// nanoseconds on the steady clock
+uint64_t instrumentNow();
+
+extern std::atomic<bool> gInstrumentEnabled;
+
+inline bool instrumentEnabled()
+{
+    return gInstrumentEnabled.load(std::memory_order_relaxed);
+}
+
+void setInstrumentEnabled(bool enabled);
+
+// shows up as the thread name in the trace - call from the thread itself
+void setInstrumentThreadName(const char* name);
+
+void instrumentScope(const char* name, uint64_t start, uint64_t end);
+void instrumentCounter(const char* name, double value);
+
+// moves everything recorded so far (by every thread) onto the end of events and
+// returns how many - call from one thread at a time
+size_t collectInstrumentEvents(std::vector<InstrumentEvent>& events);
+
+// events lost because a ring was full
+size_t instrumentDroppedEvents();
+
+// Chrome trace event JSON ("X" events for scopes, "C" for counters)
+bool writeChromeTrace(const std::string& filename, const std::vector<InstrumentEvent>& events);
+
+/////////////////////////////////////////////////////////////////////////////////
+// times the enclosing scope
+class ScopedTimer
+{
+    public:
+        ScopedTimer(const char* name) :
+            mName(instrumentEnabled() ? name : nullptr),
+            mStart(mName ? instrumentNow() : 0)
+        {
+        }
+
+        ~ScopedTimer()
+        {
+            if (mName)
+            {
+                instrumentScope(mName, mStart, instrumentNow());
+            }
+        }
+
+    private:
+        ScopedTimer(const ScopedTimer&);
+        ScopedTimer& operator=(const ScopedTimer&);
+
+        const char* mName;
+        uint64_t mStart;
+};
+
+#define INSTRUMENT_CONCAT_INNER(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_INNER(a, b)
+
+#if INSTRUMENTATION_ENABLED
+#define INSTRUMENT_SCOPE(name) ScopedTimer INSTRUMENT_CONCAT(instrument_scope_, __LINE__)(name)
+#define INSTRUMENT_COUNTER(name, value) do { if (instrumentEnabled()) instrumentCounter(name, (double)(value)); } while (0)
+#else
+#define INSTRUMENT_SCOPE(name) do {} while (0)
+#define INSTRUMENT_COUNTER(name, value) do {} while (0)
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////
+// log-linear histogram of durations in nanoseconds - 8 buckets for each power of
+// two so percentiles come back within about 6%
+class DurationHistogram
+{
+    public:
+        DurationHistogram();
+
+        void add(uint64_t nanoseconds);
+
+        size_t count() const
+        {
+            return mCount;
+        }
+
+        // all in microseconds
+        double mean() const;
+        double maximum() const;
+        double percentile(double percent) const;
+
+    private:
+        static const int kSubBuckets = 8;
+        static const int kBuckets = 64 * kSubBuckets;
+
+        std::vector<uint32_t> mBuckets;
+        size_t mCount;
+        uint64_t mTotal;
+        uint64_t mMax;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// a histogram per scope name and the latest value of each counter
+class InstrumentSummary
+{
+    public:
+        void add(const std::vector<InstrumentEvent>& events);
+
+        // one line per scope: count, mean, p50, p99, max in microseconds
+        void write(std::ostream& stream) const;
+
+        void reset()
+        {
+            mScopes.clear();
+            mCounters.clear();
+        }
+
+    private:
+        std::map<std::string, DurationHistogram> mScopes;
+        std::map<std::string, double> mCounters;
+};
+
+#endif // _INSTRUMENT_H_
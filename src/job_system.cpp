@@ -0,0 +1,213 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "job_system.h"
+#include "instrument.h"
+
+#include <string>
+
+namespace
+{
+    // which JobSystem this thread works for and which queue is its own
+    thread_local const JobSystem* tJobSystem = nullptr;
+    thread_local int tQueueIndex = -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+JobSystem::JobSystem(int threads) :
+    mQueued(0),
+    mQuit(false)
+{
+    if (threads <= 0)
+    {
+        threads = (int)std::thread::hardware_concurrency();
+        threads = threads < 1 ? 1 : threads;
+    }
+
+    for (int i = 0; i < threads; ++i)
+    {
+        mQueues.push_back(std::unique_ptr<Queue>(new Queue));
+    }
+
+    for (int i = 0; i < threads - 1; ++i)
+    {
+        mWorkers.push_back(std::thread(&JobSystem::workerThread, this, i));
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mQuit = true;
+    }
+    mWake.notify_all();
+
+    for (std::thread& worker : mWorkers)
+    {
+        worker.join();
+    }
+}
+
+void JobSystem::run(JobGroup& group, const Job& job)
+{
+    group.mOutstanding.fetch_add(1, std::memory_order_relaxed);
+
+    // no one to hand it to
+    if (mWorkers.empty())
+    {
+        job();
+        group.mOutstanding.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+
+    Queue& queue = *mQueues[queueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        QueuedJob queued = { job, &group };
+        queue.jobs.push_back(queued);
+    }
+    mQueued.fetch_add(1, std::memory_order_release);
+
+    // the lock makes sure a worker that just found nothing to do is asleep (and hears this) rather
+    // than about to go to sleep
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+    }
+    mWake.notify_one();
+}
+
+void JobSystem::wait(JobGroup& group)
+{
+    INSTRUMENT_SCOPE("jobs.wait");
+
+    int index = queueIndex();
+    while (! group.done())
+    {
+        // the rest of the group is running on other threads
+        if (! runOne(index))
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::parallelFor(int begin, int end, int min_band, const std::function<void(int, int)>& body)
+{
+    int count = end - begin;
+    if (count <= 0)
+    {
+        return;
+    }
+
+    // a couple of bands per thread so a thread that gets going late doesn't hold everyone up
+    min_band = min_band < 1 ? 1 : min_band;
+    int bands = numThreads() * 2;
+    if (bands > count / min_band)
+    {
+        bands = count / min_band;
+    }
+    if (bands <= 1)
+    {
+        body(begin, end);
+        return;
+    }
+
+    JobGroup group;
+    for (int band = 1; band < bands; ++band)
+    {
+        int first = begin + (int)((long long)count * band / bands);
+        int last = begin + (int)((long long)count * (band + 1) / bands);
+        run(group, [&body, first, last]()
+        {
+            body(first, last);
+        });
+    }
+
+    // the first band is ours
+    body(begin, begin + count / bands);
+    wait(group);
+}
+
+void JobSystem::workerThread(int index)
+{
+    tJobSystem = this;
+    tQueueIndex = index;
+    setInstrumentThreadName(("job worker " + std::to_string(index)).c_str());
+
+    while (true)
+    {
+        if (runOne(index))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mSleepMutex);
+        mWake.wait(lock, [this]()
+        {
+            return mQuit || mQueued.load(std::memory_order_acquire) > 0;
+        });
+        if (mQuit)
+        {
+            return;
+        }
+    }
+}
+
+bool JobSystem::runOne(int index)
+{
+    QueuedJob queued;
+    if (! pop(index, queued) && ! steal(index, queued))
+    {
+        return false;
+    }
+
+    mQueued.fetch_sub(1, std::memory_order_relaxed);
+    {
+        INSTRUMENT_SCOPE("jobs.run");
+        queued.job();
+    }
+    queued.group->mOutstanding.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+bool JobSystem::pop(int index, QueuedJob& queued)
+{
+    Queue& queue = *mQueues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty())
+    {
+        return false;
+    }
+
+    queued = std::move(queue.jobs.back());
+    queue.jobs.pop_back();
+    return true;
+}
+
+bool JobSystem::steal(int index, QueuedJob& queued)
+{
+    // start with the next queue along so thieves spread out
+    for (size_t i = 1; i < mQueues.size(); ++i)
+    {
+        Queue& queue = *mQueues[(index + i) % mQueues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (! queue.jobs.empty())
+        {
+            queued = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+int JobSystem::queueIndex() const
+{
+    return (tJobSystem == this) ? tQueueIndex : (int)mQueues.size() - 1;
+}
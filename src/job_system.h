@@ -0,0 +1,119 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _JOB_SYSTEM_H_
+#define _JOB_SYSTEM_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// jobs started together that are waited for together - e.g. the row bands of
+// one big copy, or every browser's compositing for one frame
+class JobGroup
+{
+    public:
+        JobGroup() :
+            mOutstanding(0)
+        {
+        }
+
+        bool done() const
+        {
+            return mOutstanding.load(std::memory_order_acquire) == 0;
+        }
+
+    private:
+        friend class JobSystem;
+
+        JobGroup(const JobGroup&);
+        JobGroup& operator=(const JobGroup&);
+
+        std::atomic<int> mOutstanding;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// a pool of worker threads for the compositing that can be split up. Each
+// worker has a queue of its own - it takes the newest job off the back of it
+// and, when it's empty, steals the oldest job off the front of someone else's,
+// so a worker that splits its job up (a browser's compositing splitting a big
+// copy into bands) keeps the pieces close by while idle workers share them
+// out. Threads that aren't workers (CEF's UI thread) queue their jobs on a
+// queue of their own that everyone steals from.
+//
+// wait() doesn't just block - the waiting thread runs jobs until its group is
+// done, so jobs can start and wait for jobs of their own without running out
+// of threads. Idle workers sleep
+class JobSystem
+{
+    public:
+        typedef std::function<void()> Job;
+
+        // threads is how many threads work on a group, counting the one waiting for it - 0 for one per
+        // core. 1 runs every job on the thread that waits for it
+        explicit JobSystem(int threads = 0);
+        ~JobSystem();
+
+        int numThreads() const
+        {
+            return (int)mWorkers.size() + 1;
+        }
+
+        // any thread - the job counts against group until it has finished
+        void run(JobGroup& group, const Job& job);
+
+        // runs jobs (group's or anyone else's) until group is done
+        void wait(JobGroup& group);
+
+        // body(first, last) over [begin, end) in bands of at least min_band, spread over the threads
+        // and waited for
+        void parallelFor(int begin, int end, int min_band, const std::function<void(int, int)>& body);
+
+    private:
+        JobSystem(const JobSystem&);
+        JobSystem& operator=(const JobSystem&);
+
+        struct QueuedJob
+        {
+            Job job;
+            JobGroup* group;
+        };
+
+        struct Queue
+        {
+            std::mutex mutex;
+            std::deque<QueuedJob> jobs;
+        };
+
+        void workerThread(int index);
+
+        // run one job - our own newest first, then the oldest one we can steal. False if there were none
+        bool runOne(int index);
+        bool pop(int index, QueuedJob& job);
+        bool steal(int index, QueuedJob& job);
+
+        // this thread's queue - the shared queue unless it's one of our workers
+        int queueIndex() const;
+
+        // one per worker plus the shared one for everyone else at the end
+        std::vector<std::unique_ptr<Queue>> mQueues;
+        std::vector<std::thread> mWorkers;
+
+        // jobs sitting in the queues - workers sleep while it's 0
+        std::atomic<int> mQueued;
+        std::mutex mSleepMutex;
+        std::condition_variable mWake;
+        bool mQuit;
+};
+
+#endif // _JOB_SYSTEM_H_
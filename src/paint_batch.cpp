@@ -0,0 +1,65 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "paint_batch.h"
+#include "instrument.h"
+#include "job_system.h"
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+void PaintBatch::add(Compositor* compositor, const PaintEvent& event, const unsigned char* buffer)
+{
+    Paint paint;
+    paint.compositor = compositor;
+    paint.event = event;
+    paint.buffer = buffer;
+    mPaints.push_back(paint);
+}
+
+void PaintBatch::composite(JobSystem* jobs)
+{
+    INSTRUMENT_SCOPE("paint.batch_composite");
+
+    JobGroup group;
+    for (Paint& paint : mPaints)
+    {
+        Paint* job_paint = &paint;
+        auto composite_one = [job_paint]()
+        {
+            const PaintEvent& event = job_paint->event;
+            job_paint->damage = (event.type == PaintEvent::VIEW) ?
+                                job_paint->compositor->paintView(event.dirtyRects, job_paint->buffer, event.width, event.height) :
+                                job_paint->compositor->paintPopup(event.dirtyRects, job_paint->buffer, event.width, event.height);
+        };
+
+        if (jobs)
+        {
+            jobs->run(group, composite_one);
+        }
+        else
+        {
+            composite_one();
+        }
+    }
+
+    if (jobs)
+    {
+        jobs->wait(group);
+    }
+}
+
+void PaintBatch::upload()
+{
+    INSTRUMENT_SCOPE("paint.batch_upload");
+
+    for (Paint& paint : mPaints)
+    {
+        paint.compositor->upload(paint.damage);
+        paint.compositor->endFrame();
+    }
+    mPaints.clear();
+}
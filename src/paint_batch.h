@@ -0,0 +1,59 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _PAINT_BATCH_H_
+#define _PAINT_BATCH_H_
+
+#include "compositor.h"
+#include "paint_trace.h"
+
+#include <vector>
+
+class JobSystem;
+
+/////////////////////////////////////////////////////////////////////////////////
+// one frame's worth of paints for several browsers. Each browser's compositor
+// is independent of the others, so composite() runs them all at once on a
+// JobSystem (each one can split its big copies up further on the same jobs),
+// then upload() pushes what changed to each upload backend one after another
+// on the calling thread - the one with the GL context. The buffers have to
+// stay put until upload() has been called, so this is for paints that are
+// already in memory (a paint trace being replayed, the benchmarks) - CEF calls
+// OnPaint for one browser at a time and its buffer goes away when it returns,
+// so in the app it's the bands of each big copy that are shared out instead
+// (see Compositor::setJobSystem())
+class PaintBatch
+{
+    public:
+        // a view or popup paint for compositor - a compositor can only be in a batch once (it only holds
+        // on to what to upload for its last paint), popup shows and sizes go straight to the compositor
+        void add(Compositor* compositor, const PaintEvent& event, const unsigned char* buffer);
+
+        // composite everything - on jobs if it isn't null
+        void composite(JobSystem* jobs);
+
+        // upload what changed and end the frame for every paint, in the order they were added, then empty the batch
+        void upload();
+
+        size_t size() const
+        {
+            return mPaints.size();
+        }
+
+    private:
+        struct Paint
+        {
+            Compositor* compositor;
+            PaintEvent event;
+            const unsigned char* buffer;
+            RectList damage;
+        };
+
+        std::vector<Paint> mPaints;
+};
+
+#endif // _PAINT_BATCH_H_
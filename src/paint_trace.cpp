@@ -0,0 +1,113 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "paint_trace.h"
+
+#include <sstream>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+bool PaintTraceWriter::open(const std::string& filename)
+{
+    mFile.open(filename.c_str(), std::ios::out | std::ios::trunc);
+    return mFile.is_open();
+}
+
+void PaintTraceWriter::write(const PaintEvent& event)
+{
+    if (! mFile.is_open())
+    {
+        return;
+    }
+
+    switch (event.type)
+    {
+        case PaintEvent::VIEW:
+        case PaintEvent::POPUP:
+            mFile << (event.type == PaintEvent::VIEW ? "view " : "popup ") << event.width << " " << event.height << " " << event.dirtyRects.size();
+            for (const Rect& rect : event.dirtyRects)
+            {
+                mFile << " " << rect.x << " " << rect.y << " " << rect.width << " " << rect.height;
+            }
+            break;
+
+        case PaintEvent::POPUP_SIZE:
+            mFile << "popup_size " << event.popupRect.x << " " << event.popupRect.y << " " << event.popupRect.width << " " << event.popupRect.height;
+            break;
+
+        case PaintEvent::POPUP_SHOW:
+            mFile << "popup_show " << (event.show ? 1 : 0);
+            break;
+    }
+    mFile << "\n";
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+bool PaintTraceReader::open(const std::string& filename)
+{
+    mFile.open(filename.c_str());
+    return mFile.is_open();
+}
+
+bool PaintTraceReader::read(PaintEvent& event)
+{
+    std::string line;
+    while (std::getline(mFile, line))
+    {
+        std::istringstream in(line);
+        std::string type;
+        if (! (in >> type))
+        {
+            continue;
+        }
+
+        event = PaintEvent();
+
+        if (type == "view" || type == "popup")
+        {
+            event.type = (type == "view") ? PaintEvent::VIEW : PaintEvent::POPUP;
+
+            size_t num_rects = 0;
+            if (! (in >> event.width >> event.height >> num_rects))
+            {
+                continue;
+            }
+
+            Rect rect;
+            while (event.dirtyRects.size() < num_rects && (in >> rect.x >> rect.y >> rect.width >> rect.height))
+            {
+                event.dirtyRects.push_back(rect);
+            }
+
+            if (event.dirtyRects.size() == num_rects)
+            {
+                return true;
+            }
+        }
+        else if (type == "popup_size")
+        {
+            event.type = PaintEvent::POPUP_SIZE;
+            if (in >> event.popupRect.x >> event.popupRect.y >> event.popupRect.width >> event.popupRect.height)
+            {
+                return true;
+            }
+        }
+        else if (type == "popup_show")
+        {
+            event.type = PaintEvent::POPUP_SHOW;
+            int show = 0;
+            if (in >> show)
+            {
+                event.show = (show != 0);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
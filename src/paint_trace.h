@@ -0,0 +1,73 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _PAINT_TRACE_H_
+#define _PAINT_TRACE_H_
+
+#include "compositor.h"
+
+#include <fstream>
+#include <string>
+
+/////////////////////////////////////////////////////////////////////////////////
+// a recording of the calls CEF makes to the render handler - only the geometry
+// is kept (not the pixels) so a trace of a long session stays small. One event
+// per line:
+//
+//     view <width> <height> <num rects> <x> <y> <w> <h> ...
+//     popup <width> <height> <num rects> <x> <y> <w> <h> ...
+//     popup_size <x> <y> <w> <h>
+//     popup_show <0|1>
+//
+struct PaintEvent
+{
+    enum Type
+    {
+        VIEW,
+        POPUP,
+        POPUP_SIZE,
+        POPUP_SHOW
+    };
+
+    PaintEvent() : type(VIEW), width(0), height(0), show(false) {}
+
+    Type type;
+    int width;
+    int height;
+    RectList dirtyRects;
+    Rect popupRect;
+    bool show;
+};
+
+class PaintTraceWriter
+{
+    public:
+        bool open(const std::string& filename);
+        bool isOpen() const
+        {
+            return mFile.is_open();
+        }
+
+        void write(const PaintEvent& event);
+
+    private:
+        std::ofstream mFile;
+};
+
+class PaintTraceReader
+{
+    public:
+        bool open(const std::string& filename);
+
+        // returns false at the end of the trace - malformed lines are skipped
+        bool read(PaintEvent& event);
+
+    private:
+        std::ifstream mFile;
+};
+
+#endif // _PAINT_TRACE_H_
@@ -0,0 +1,286 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "pixel_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+// in pixel_kernels_<isa>.cpp - null when that file was built for a CPU that can't use them
+const PixelKernels* sse2PixelKernels();
+const PixelKernels* avx2PixelKernels();
+const PixelKernels* neonPixelKernels();
+
+namespace
+{
+    inline unsigned int div255(unsigned int x)
+    {
+        x += 128;
+        return (x + (x >> 8)) >> 8;
+    }
+
+    inline unsigned char lumaY(int r, int g, int b)
+    {
+        return (unsigned char)((66 * r + 129 * g + 25 * b + 4224) >> 8);
+    }
+
+    inline unsigned char chromaU(int r, int g, int b)
+    {
+        return (unsigned char)((-38 * r - 74 * g + 112 * b + 32896) >> 8);
+    }
+
+    inline unsigned char chromaV(int r, int g, int b)
+    {
+        return (unsigned char)((112 * r - 94 * g - 18 * b + 32896) >> 8);
+    }
+
+    bool cpuHasSSE2()
+    {
+#if defined(_M_X64) || defined(__x86_64__)
+        return true;
+#elif defined(_MSC_VER) && defined(_M_IX86)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[3] & (1 << 26)) != 0;
+#elif defined(__i386__)
+        return __builtin_cpu_supports("sse2");
+#else
+        return false;
+#endif
+    }
+
+    bool cpuHasAVX2()
+    {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+        {
+            return false;
+        }
+
+        // the OS has to save the AVX registers too
+        __cpuid(info, 1);
+        bool os_saves_avx = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+
+        __cpuidex(info, 7, 0);
+        return os_saves_avx && (info[1] & (1 << 5)) != 0;
+#elif defined(__x86_64__) || defined(__i386__)
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+
+    const PixelKernels kScalarPixelKernels =
+    {
+        "scalar",
+        blendRowScalar,
+        swizzleRowScalar,
+        premultiplyRowScalar,
+        unpremultiplyRowScalar,
+        bgraToI420RowScalar,
+        hashRowScalar,
+        downsampleRowScalar
+    };
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+void blendRowScalar(unsigned char* dst, const unsigned char* src, int pixels)
+{
+    for (int i = 0; i < pixels; ++i, src += kDepth, dst += kDepth)
+    {
+        unsigned int inverse_alpha = 255 - src[3];
+        for (int c = 0; c < kDepth; ++c)
+        {
+            dst[c] = (unsigned char)std::min(255u, src[c] + div255(dst[c] * inverse_alpha));
+        }
+    }
+}
+
+void swizzleRowScalar(unsigned char* dst, const unsigned char* src, int pixels)
+{
+    for (int i = 0; i < pixels; ++i, src += kDepth, dst += kDepth)
+    {
+        unsigned char first = src[0];
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = first;
+        dst[3] = src[3];
+    }
+}
+
+void premultiplyRowScalar(unsigned char* dst, const unsigned char* src, int pixels)
+{
+    for (int i = 0; i < pixels; ++i, src += kDepth, dst += kDepth)
+    {
+        unsigned int alpha = src[3];
+        dst[0] = (unsigned char)div255(src[0] * alpha);
+        dst[1] = (unsigned char)div255(src[1] * alpha);
+        dst[2] = (unsigned char)div255(src[2] * alpha);
+        dst[3] = (unsigned char)alpha;
+    }
+}
+
+void unpremultiplyRowScalar(unsigned char* dst, const unsigned char* src, int pixels)
+{
+    for (int i = 0; i < pixels; ++i, src += kDepth, dst += kDepth)
+    {
+        unsigned int alpha = src[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            dst[c] = alpha ? (unsigned char)std::min(255u, (src[c] * 255 + alpha / 2) / alpha) : 0;
+        }
+        dst[3] = (unsigned char)alpha;
+    }
+}
+
+void bgraToI420RowScalar(const unsigned char* src0, const unsigned char* src1,
+                         unsigned char* y0, unsigned char* y1, unsigned char* u, unsigned char* v, int pixels)
+{
+    for (int i = 0; i < pixels; i += 2)
+    {
+        const unsigned char* a = src0 + i * kDepth;
+        const unsigned char* b = src1 + i * kDepth;
+        // the last pixel of an odd row pairs up with itself
+        int next = (i + 1 < pixels) ? kDepth : 0;
+
+        y0[i] = lumaY(a[2], a[1], a[0]);
+        y1[i] = lumaY(b[2], b[1], b[0]);
+        if (next)
+        {
+            y0[i + 1] = lumaY(a[next + 2], a[next + 1], a[next]);
+            y1[i + 1] = lumaY(b[next + 2], b[next + 1], b[next]);
+        }
+
+        int blue = (a[0] + a[next] + b[0] + b[next] + 2) >> 2;
+        int green = (a[1] + a[next + 1] + b[1] + b[next + 1] + 2) >> 2;
+        int red = (a[2] + a[next + 2] + b[2] + b[next + 2] + 2) >> 2;
+        u[i / 2] = chromaU(red, green, blue);
+        v[i / 2] = chromaV(red, green, blue);
+    }
+}
+
+void hashRowScalar(unsigned int* lanes, const unsigned char* src, int pixels)
+{
+    for (int i = 0; i < pixels; ++i, src += kDepth)
+    {
+        unsigned int pixel;
+        memcpy(&pixel, src, kDepth);
+
+        unsigned int mixed = (lanes[i % kHashLanes] ^ pixel) * kHashMultiplier;
+        lanes[i % kHashLanes] = (mixed << kHashRotate) | (mixed >> (32 - kHashRotate));
+    }
+}
+
+void downsampleRowScalar(unsigned char* dst, const unsigned char* src0, const unsigned char* src1, int pixels)
+{
+    for (int i = 0; i < pixels; i += 2, dst += kDepth)
+    {
+        const unsigned char* a = src0 + i * kDepth;
+        const unsigned char* b = src1 + i * kDepth;
+        // the last pixel of an odd row pairs up with itself
+        int next = (i + 1 < pixels) ? kDepth : 0;
+
+        for (int c = 0; c < kDepth; ++c)
+        {
+            dst[c] = (unsigned char)((a[c] + a[next + c] + b[c] + b[next + c] + 2) >> 2);
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+const PixelKernels* pixelKernels(PixelKernelLevel level)
+{
+    switch (level)
+    {
+        case PIXEL_KERNELS_SCALAR:
+            return &kScalarPixelKernels;
+
+        case PIXEL_KERNELS_SSE2:
+            return cpuHasSSE2() ? sse2PixelKernels() : nullptr;
+
+        case PIXEL_KERNELS_AVX2:
+            return cpuHasAVX2() ? avx2PixelKernels() : nullptr;
+
+        // always there on 64 bit ARM
+        case PIXEL_KERNELS_NEON:
+            return neonPixelKernels();
+
+        default:
+            return nullptr;
+    }
+}
+
+const PixelKernels& pixelKernels()
+{
+    // picked once - initialising a local static is thread safe
+    static const PixelKernels* best = []()
+    {
+        for (int level = PIXEL_KERNELS_COUNT - 1; level > PIXEL_KERNELS_SCALAR; --level)
+        {
+            if (const PixelKernels* kernels = pixelKernels((PixelKernelLevel)level))
+            {
+                return kernels;
+            }
+        }
+        return &kScalarPixelKernels;
+    }();
+
+    return *best;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+Rect blitRect(const unsigned char* src, int src_width, int src_height, const Rect& src_rect,
+              unsigned char* dst, int dst_width, int dst_height, int dst_x, int dst_y,
+              BlitMode mode)
+{
+    // clip to the source, then to the destination, keeping the two lined up
+    Rect from = intersectRect(src_rect, Rect(0, 0, src_width, src_height));
+    Rect to = intersectRect(Rect(dst_x + from.x - src_rect.x, dst_y + from.y - src_rect.y, from.width, from.height),
+                            Rect(0, 0, dst_width, dst_height));
+    if (from.isEmpty() || to.isEmpty())
+    {
+        return Rect();
+    }
+
+    from.x += to.x - (dst_x + from.x - src_rect.x);
+    from.y += to.y - (dst_y + from.y - src_rect.y);
+
+    const unsigned char* src_row = src + ((size_t)from.y * src_width + from.x) * kDepth;
+    unsigned char* dst_row = dst + ((size_t)to.y * dst_width + to.x) * kDepth;
+
+    if (mode == BLIT_COPY)
+    {
+        // memcpy is already as wide as the CPU allows
+        for (int row = 0; row < to.height; ++row)
+        {
+            memcpy(dst_row, src_row, (size_t)to.width * kDepth);
+            src_row += (size_t)src_width * kDepth;
+            dst_row += (size_t)dst_width * kDepth;
+        }
+    }
+    else
+    {
+        const PixelKernels& kernels = pixelKernels();
+        for (int row = 0; row < to.height; ++row)
+        {
+            kernels.blendRow(dst_row, src_row, to.width);
+            src_row += (size_t)src_width * kDepth;
+            dst_row += (size_t)dst_width * kDepth;
+        }
+    }
+
+    return to;
+}
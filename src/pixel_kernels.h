@@ -0,0 +1,120 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _PIXEL_KERNELS_H_
+#define _PIXEL_KERNELS_H_
+
+#include "compositor.h"
+
+/////////////////////////////////////////////////////////////////////////////////
+// the per-pixel loops used when compositing - each one works on a row of 4 byte
+// pixels and comes in a scalar version and SSE2/AVX2/NEON versions that give
+// exactly the same bytes. The best one the CPU supports is picked the first time
+// pixelKernels() is called
+//
+// CEF hands us premultiplied BGRA so the alpha operations assume premultiplied
+// pixels and all the rounding is done the same way as the scalar versions:
+//
+//     blend:          c = min(255, src_c + div255(dst_c * (255 - src_a)))    (alpha too)
+//     premultiply:    c = div255(c * a)                                      (alpha unchanged)
+//     unpremultiply:  c = a ? min(255, (c * 255 + a / 2) / a) : 0            (alpha unchanged)
+//
+// where div255(x) is x / 255 rounded to nearest
+//
+// BGRA to I420 (for video capture) is BT.601 limited range in 8.8 fixed point, with
+// each chroma sample taken from the rounded average of a 2x2 block of pixels:
+//
+//     Y = ( 66 R + 129 G +  25 B + 4224) >> 8
+//     U = (-38 R -  74 G + 112 B + 32896) >> 8
+//     V = (112 R -  94 G -  18 B + 32896) >> 8
+//
+// every sum stays inside 0..65535 so the SIMD versions can do it on 16 bit lanes
+//
+// halving (for thumbnails) is a box filter - each pixel is the rounded average of
+// a 2x2 block, alpha too, and the last pixel of an odd row pairs up with itself:
+//
+//     c = (c00 + c01 + c10 + c11 + 2) >> 2
+//
+// the tile hash (see tile_hasher.h) keeps kHashLanes 32 bit lanes and pixel i of a
+// row (the 4 bytes as a little endian word) goes into lane i % kHashLanes:
+//
+//     lane = rotl((lane ^ pixel) * 0x9e3779b1, 13)
+//
+// each step can be undone for a given pixel, so a single pixel that's different
+// always gives a different hash. It isn't for anything but spotting changes
+const int kHashLanes = 16;
+const unsigned int kHashMultiplier = 0x9e3779b1u;
+const int kHashRotate = 13;
+
+enum PixelKernelLevel
+{
+    PIXEL_KERNELS_SCALAR,
+    PIXEL_KERNELS_SSE2,
+    PIXEL_KERNELS_AVX2,
+    PIXEL_KERNELS_NEON,
+    PIXEL_KERNELS_COUNT
+};
+
+struct PixelKernels
+{
+    const char* name;
+
+    // premultiplied source over destination, result in dst
+    void (*blendRow)(unsigned char* dst, const unsigned char* src, int pixels);
+
+    // swap the first and third byte of each pixel (BGRA <-> RGBA) - dst can be src
+    void (*swizzleRow)(unsigned char* dst, const unsigned char* src, int pixels);
+
+    // dst can be src for both of these
+    void (*premultiplyRow)(unsigned char* dst, const unsigned char* src, int pixels);
+    void (*unpremultiplyRow)(unsigned char* dst, const unsigned char* src, int pixels);
+
+    // two rows of BGRA to a row of Y each and a row of U and V at half the width. src1 (and y1) can be
+    // src0 (and y0) for the last row of a frame with an odd height - with an odd number of pixels the
+    // last chroma sample comes from the last column on its own
+    void (*bgraToI420Row)(const unsigned char* src0, const unsigned char* src1,
+                          unsigned char* y0, unsigned char* y1, unsigned char* u, unsigned char* v, int pixels);
+
+    // fold a row into kHashLanes lanes of hash - rows of the same width always start at lane 0
+    void (*hashRow)(unsigned int* lanes, const unsigned char* src, int pixels);
+
+    // two rows of pixels to one row of (pixels + 1) / 2. src1 can be src0 for the last row of an odd height
+    void (*downsampleRow)(unsigned char* dst, const unsigned char* src0, const unsigned char* src1, int pixels);
+};
+
+// the best version this CPU can run
+const PixelKernels& pixelKernels();
+
+// a particular version - null if it wasn't built in or the CPU can't run it
+const PixelKernels* pixelKernels(PixelKernelLevel level);
+
+// the reference versions - the SIMD versions use these for the pixels left over at the end of a row
+void blendRowScalar(unsigned char* dst, const unsigned char* src, int pixels);
+void swizzleRowScalar(unsigned char* dst, const unsigned char* src, int pixels);
+void premultiplyRowScalar(unsigned char* dst, const unsigned char* src, int pixels);
+void unpremultiplyRowScalar(unsigned char* dst, const unsigned char* src, int pixels);
+void bgraToI420RowScalar(const unsigned char* src0, const unsigned char* src1,
+                         unsigned char* y0, unsigned char* y1, unsigned char* u, unsigned char* v, int pixels);
+void hashRowScalar(unsigned int* lanes, const unsigned char* src, int pixels);
+void downsampleRowScalar(unsigned char* dst, const unsigned char* src0, const unsigned char* src1, int pixels);
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+enum BlitMode
+{
+    BLIT_COPY,
+    BLIT_BLEND
+};
+
+// copy (or blend) src_rect of src onto dst with its top left corner at dst_x, dst_y. The rect is
+// clipped to both buffers first so it can hang off either of them. Strides are the widths in pixels.
+// Returns the part of dst that was written to - empty if nothing was
+Rect blitRect(const unsigned char* src, int src_width, int src_height, const Rect& src_rect,
+              unsigned char* dst, int dst_width, int dst_height, int dst_x, int dst_y,
+              BlitMode mode);
+
+#endif // _PIXEL_KERNELS_H_
@@ -0,0 +1,263 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "pixel_kernels.h"
+
+// this file is built with AVX2 enabled (see CMakeLists.txt) and is only called when the CPU has it
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+/////////////////////////////////////////////////////////////////////////////////
+// 8 pixels at a time - same maths as the SSE2 versions on registers twice as wide
+namespace
+{
+    inline __m256i div255(__m256i x)
+    {
+        x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+        return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+    }
+
+    // copy the alpha byte of each pixel to all 4 of its 16 bit lanes
+    inline __m256i broadcastAlpha(__m256i pixels16)
+    {
+        return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pixels16, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    }
+
+    inline __m256i blend(__m256i src16, __m256i dst16)
+    {
+        __m256i inverse_alpha = _mm256_sub_epi16(_mm256_set1_epi16(255), broadcastAlpha(src16));
+        return _mm256_add_epi16(src16, div255(_mm256_mullo_epi16(dst16, inverse_alpha)));
+    }
+
+    inline __m256i premultiply(__m256i pixels16)
+    {
+        const __m256i alpha_lanes = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+        return div255(_mm256_mullo_epi16(pixels16, _mm256_or_si256(broadcastAlpha(pixels16), alpha_lanes)));
+    }
+
+    // two pixels in 32 bit lanes - see the SSE2 version
+    inline __m256i unpremultiply(__m256i pixels32)
+    {
+        __m256i alpha = _mm256_shuffle_epi32(pixels32, _MM_SHUFFLE(3, 3, 3, 3));
+        __m256 numerator = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(pixels32), _mm256_set1_ps(255.0f)),
+                                         _mm256_cvtepi32_ps(_mm256_srli_epi32(alpha, 1)));
+        return _mm256_cvttps_epi32(_mm256_div_ps(numerator, _mm256_cvtepi32_ps(alpha)));
+    }
+
+    // the 256 bit packs work on each 128 bit half separately - this puts the 64 bit quarters back in order
+    inline __m256i inOrder(__m256i packed)
+    {
+        return _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+    }
+
+    // 16 pixels (two registers) split into one 16 bit register per channel
+    inline void channels(__m256i p0, __m256i p1, __m256i& blue, __m256i& green, __m256i& red)
+    {
+        const __m256i low_byte = _mm256_set1_epi32(0xff);
+        blue = inOrder(_mm256_packs_epi32(_mm256_and_si256(p0, low_byte), _mm256_and_si256(p1, low_byte)));
+        green = inOrder(_mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), low_byte), _mm256_and_si256(_mm256_srli_epi32(p1, 8), low_byte)));
+        red = inOrder(_mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), low_byte), _mm256_and_si256(_mm256_srli_epi32(p1, 16), low_byte)));
+    }
+
+    // see the SSE2 version
+    inline __m256i weigh(__m256i red, __m256i green, __m256i blue, short cr, short cg, short cb, short offset)
+    {
+        __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(red, _mm256_set1_epi16(cr)), _mm256_mullo_epi16(green, _mm256_set1_epi16(cg)));
+        sum = _mm256_add_epi16(sum, _mm256_add_epi16(_mm256_mullo_epi16(blue, _mm256_set1_epi16(cb)), _mm256_set1_epi16(offset)));
+        return _mm256_srli_epi16(sum, 8);
+    }
+
+    inline __m256i luma(__m256i red, __m256i green, __m256i blue)
+    {
+        return weigh(red, green, blue, 66, 129, 25, 4224);
+    }
+
+    inline __m256i average2x2(__m256i row0, __m256i row1)
+    {
+        __m256i sum = _mm256_add_epi16(row0, row1);
+        __m256i pairs = _mm256_add_epi32(_mm256_and_si256(sum, _mm256_set1_epi32(0xffff)), _mm256_srli_epi32(sum, 16));
+        return _mm256_srli_epi32(_mm256_add_epi32(pairs, _mm256_set1_epi32(2)), 2);
+    }
+
+    void bgraToI420RowAVX2(const unsigned char* src0, const unsigned char* src1,
+                           unsigned char* y0, unsigned char* y1, unsigned char* u, unsigned char* v, int pixels)
+    {
+        int i = 0;
+        for (; i + 32 <= pixels; i += 32)
+        {
+            __m256i b0[2], g0[2], r0[2], b1[2], g1[2], r1[2];
+            for (int half = 0; half < 2; ++half)
+            {
+                const unsigned char* s0 = src0 + (i + half * 16) * kDepth;
+                const unsigned char* s1 = src1 + (i + half * 16) * kDepth;
+                channels(_mm256_loadu_si256((const __m256i*)s0), _mm256_loadu_si256((const __m256i*)(s0 + 32)), b0[half], g0[half], r0[half]);
+                channels(_mm256_loadu_si256((const __m256i*)s1), _mm256_loadu_si256((const __m256i*)(s1 + 32)), b1[half], g1[half], r1[half]);
+            }
+
+            _mm256_storeu_si256((__m256i*)(y0 + i), inOrder(_mm256_packus_epi16(luma(r0[0], g0[0], b0[0]), luma(r0[1], g0[1], b0[1]))));
+            _mm256_storeu_si256((__m256i*)(y1 + i), inOrder(_mm256_packus_epi16(luma(r1[0], g1[0], b1[0]), luma(r1[1], g1[1], b1[1]))));
+
+            __m256i blue = inOrder(_mm256_packs_epi32(average2x2(b0[0], b1[0]), average2x2(b0[1], b1[1])));
+            __m256i green = inOrder(_mm256_packs_epi32(average2x2(g0[0], g1[0]), average2x2(g0[1], g1[1])));
+            __m256i red = inOrder(_mm256_packs_epi32(average2x2(r0[0], r1[0]), average2x2(r0[1], r1[1])));
+
+            __m256i chroma_u = inOrder(_mm256_packus_epi16(weigh(red, green, blue, -38, -74, 112, (short)32896), _mm256_setzero_si256()));
+            __m256i chroma_v = inOrder(_mm256_packus_epi16(weigh(red, green, blue, 112, -94, -18, (short)32896), _mm256_setzero_si256()));
+            _mm_storeu_si128((__m128i*)(u + i / 2), _mm256_castsi256_si128(chroma_u));
+            _mm_storeu_si128((__m128i*)(v + i / 2), _mm256_castsi256_si128(chroma_v));
+        }
+
+        bgraToI420RowScalar(src0 + i * kDepth, src1 + i * kDepth, y0 + i, y1 + i, u + i / 2, v + i / 2, pixels - i);
+    }
+
+    void blendRowAVX2(unsigned char* dst, const unsigned char* src, int pixels)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+
+        int i = 0;
+        for (; i + 8 <= pixels; i += 8)
+        {
+            __m256i s = _mm256_loadu_si256((const __m256i*)(src + i * kDepth));
+            __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i * kDepth));
+
+            // unpack and pack both work within each 128 bit half so the pixels end up back where they started
+            __m256i low = blend(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero));
+            __m256i high = blend(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero));
+
+            _mm256_storeu_si256((__m256i*)(dst + i * kDepth), _mm256_packus_epi16(low, high));
+        }
+
+        blendRowScalar(dst + i * kDepth, src + i * kDepth, pixels - i);
+    }
+
+    void premultiplyRowAVX2(unsigned char* dst, const unsigned char* src, int pixels)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+
+        int i = 0;
+        for (; i + 8 <= pixels; i += 8)
+        {
+            __m256i s = _mm256_loadu_si256((const __m256i*)(src + i * kDepth));
+
+            __m256i low = premultiply(_mm256_unpacklo_epi8(s, zero));
+            __m256i high = premultiply(_mm256_unpackhi_epi8(s, zero));
+
+            _mm256_storeu_si256((__m256i*)(dst + i * kDepth), _mm256_packus_epi16(low, high));
+        }
+
+        premultiplyRowScalar(dst + i * kDepth, src + i * kDepth, pixels - i);
+    }
+
+    void unpremultiplyRowAVX2(unsigned char* dst, const unsigned char* src, int pixels)
+    {
+        const __m256i alpha_bytes = _mm256_set1_epi32((int)0xff000000);
+
+        // the packs below leave the pixels in the order 0 2 4 6 1 3 5 7
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+        int i = 0;
+        for (; i + 8 <= pixels; i += 8)
+        {
+            const unsigned char* s = src + i * kDepth;
+
+            __m256i p01 = unpremultiply(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(s + 0))));
+            __m256i p23 = unpremultiply(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(s + 8))));
+            __m256i p45 = unpremultiply(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(s + 16))));
+            __m256i p67 = unpremultiply(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(s + 24))));
+
+            __m256i colour = _mm256_packus_epi16(_mm256_packs_epi32(p01, p23), _mm256_packs_epi32(p45, p67));
+            colour = _mm256_permutevar8x32_epi32(colour, order);
+
+            __m256i original = _mm256_loadu_si256((const __m256i*)s);
+            __m256i result = _mm256_or_si256(_mm256_andnot_si256(alpha_bytes, colour), _mm256_and_si256(alpha_bytes, original));
+            _mm256_storeu_si256((__m256i*)(dst + i * kDepth), result);
+        }
+
+        unpremultiplyRowScalar(dst + i * kDepth, src + i * kDepth, pixels - i);
+    }
+
+    inline __m256i hashStep(__m256i lanes, __m256i pixels)
+    {
+        __m256i mixed = _mm256_mullo_epi32(_mm256_xor_si256(lanes, pixels), _mm256_set1_epi32((int)kHashMultiplier));
+        return _mm256_or_si256(_mm256_slli_epi32(mixed, kHashRotate), _mm256_srli_epi32(mixed, 32 - kHashRotate));
+    }
+
+    // the 16 lanes in two registers
+    void hashRowAVX2(unsigned int* lanes, const unsigned char* src, int pixels)
+    {
+        __m256i low = _mm256_loadu_si256((const __m256i*)lanes);
+        __m256i high = _mm256_loadu_si256((const __m256i*)(lanes + 8));
+
+        int i = 0;
+        for (; i + kHashLanes <= pixels; i += kHashLanes)
+        {
+            low = hashStep(low, _mm256_loadu_si256((const __m256i*)(src + i * kDepth)));
+            high = hashStep(high, _mm256_loadu_si256((const __m256i*)(src + (i + 8) * kDepth)));
+        }
+
+        _mm256_storeu_si256((__m256i*)lanes, low);
+        _mm256_storeu_si256((__m256i*)(lanes + 8), high);
+        hashRowScalar(lanes, src + i * kDepth, pixels - i);
+    }
+
+    // 16 pixels of each row to 8 - the unpacks work within each 128 bit half so the pack leaves
+    // the pixels in the order 0 1 4 5 2 3 6 7
+    void downsampleRowAVX2(unsigned char* dst, const unsigned char* src0, const unsigned char* src1, int pixels)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i two = _mm256_set1_epi16(2);
+
+        int i = 0;
+        for (; i + 16 <= pixels; i += 16)
+        {
+            __m256i q[2];
+            for (int half = 0; half < 2; ++half)
+            {
+                __m256i a = _mm256_loadu_si256((const __m256i*)(src0 + (i + half * 8) * kDepth));
+                __m256i b = _mm256_loadu_si256((const __m256i*)(src1 + (i + half * 8) * kDepth));
+
+                __m256i low = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+                __m256i high = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+                __m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi64(low, high), _mm256_unpackhi_epi64(low, high));
+                q[half] = _mm256_srli_epi16(_mm256_add_epi16(sum, two), 2);
+            }
+
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(q[0], q[1]), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_si256((__m256i*)(dst + i / 2 * kDepth), packed);
+        }
+
+        downsampleRowScalar(dst + i / 2 * kDepth, src0 + i * kDepth, src1 + i * kDepth, pixels - i);
+    }
+
+    const PixelKernels kAVX2PixelKernels =
+    {
+        "avx2",
+        blendRowAVX2,
+        // a shuffle is no faster than the loop the compiler vectorizes itself - it's all memory bandwidth
+        swizzleRowScalar,
+        premultiplyRowAVX2,
+        unpremultiplyRowAVX2,
+        bgraToI420RowAVX2,
+        hashRowAVX2,
+        downsampleRowAVX2
+    };
+}
+
+const PixelKernels* avx2PixelKernels()
+{
+    return &kAVX2PixelKernels;
+}
+
+#else
+
+const PixelKernels* avx2PixelKernels()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,253 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "pixel_kernels.h"
+
+// 64 bit ARM only - NEON is always there and it has a vector divide for unpremultiply
+#if defined(__aarch64__) || defined(_M_ARM64)
+
+#include <arm_neon.h>
+
+/////////////////////////////////////////////////////////////////////////////////
+// 16 pixels at a time - the loads split the pixels into one register per channel
+namespace
+{
+    inline uint8x16_t div255(uint16x8_t low, uint16x8_t high)
+    {
+        low = vaddq_u16(low, vdupq_n_u16(128));
+        high = vaddq_u16(high, vdupq_n_u16(128));
+        return vcombine_u8(vshrn_n_u16(vaddq_u16(low, vshrq_n_u16(low, 8)), 8),
+                           vshrn_n_u16(vaddq_u16(high, vshrq_n_u16(high, 8)), 8));
+    }
+
+    inline uint8x16_t multiply(uint8x16_t a, uint8x16_t b)
+    {
+        return div255(vmull_u8(vget_low_u8(a), vget_low_u8(b)), vmull_high_u8(a, b));
+    }
+
+    // 4 channel values in float - see the SSE2 version for why this is exact
+    inline uint32x4_t unpremultiply(uint32x4_t colour, uint32x4_t alpha)
+    {
+        float32x4_t numerator = vaddq_f32(vmulq_n_f32(vcvtq_f32_u32(colour), 255.0f), vcvtq_f32_u32(vshrq_n_u32(alpha, 1)));
+        uint32x4_t result = vcvtq_u32_f32(vdivq_f32(numerator, vcvtq_f32_u32(alpha)));
+
+        // divide by zero saturates the conversion rather than giving 0
+        return vbicq_u32(result, vceqq_u32(alpha, vdupq_n_u32(0)));
+    }
+
+    inline uint8x16_t unpremultiply(uint8x16_t colour, uint8x16_t alpha)
+    {
+        uint16x8_t colour_low = vmovl_u8(vget_low_u8(colour));
+        uint16x8_t colour_high = vmovl_high_u8(colour);
+        uint16x8_t alpha_low = vmovl_u8(vget_low_u8(alpha));
+        uint16x8_t alpha_high = vmovl_high_u8(alpha);
+
+        uint32x4_t r0 = unpremultiply(vmovl_u16(vget_low_u16(colour_low)), vmovl_u16(vget_low_u16(alpha_low)));
+        uint32x4_t r1 = unpremultiply(vmovl_high_u16(colour_low), vmovl_high_u16(alpha_low));
+        uint32x4_t r2 = unpremultiply(vmovl_u16(vget_low_u16(colour_high)), vmovl_u16(vget_low_u16(alpha_high)));
+        uint32x4_t r3 = unpremultiply(vmovl_high_u16(colour_high), vmovl_high_u16(alpha_high));
+
+        // saturating narrows are the min(255, ...)
+        uint16x8_t low = vcombine_u16(vqmovn_u32(r0), vqmovn_u32(r1));
+        uint16x8_t high = vcombine_u16(vqmovn_u32(r2), vqmovn_u32(r3));
+        return vcombine_u8(vqmovn_u16(low), vqmovn_u16(high));
+    }
+
+    // (r * cr + g * cg + b * cb + offset) >> 8 - wraps around in 16 bits but the answer doesn't (see pixel_kernels.h)
+    inline uint8x8_t weigh(uint16x8_t red, uint16x8_t green, uint16x8_t blue, uint16_t cr, uint16_t cg, uint16_t cb, uint16_t offset)
+    {
+        uint16x8_t sum = vmlaq_n_u16(vmlaq_n_u16(vmlaq_n_u16(vdupq_n_u16(offset), red, cr), green, cg), blue, cb);
+        return vshrn_n_u16(sum, 8);
+    }
+
+    inline uint8x16_t luma(uint8x16_t red, uint8x16_t green, uint8x16_t blue)
+    {
+        return vcombine_u8(weigh(vmovl_u8(vget_low_u8(red)), vmovl_u8(vget_low_u8(green)), vmovl_u8(vget_low_u8(blue)), 66, 129, 25, 4224),
+                           weigh(vmovl_high_u8(red), vmovl_high_u8(green), vmovl_high_u8(blue), 66, 129, 25, 4224));
+    }
+
+    // rounded averages of each 2x2 block - the pairwise adds do the horizontal half
+    inline uint16x8_t average2x2(uint8x16_t row0, uint8x16_t row1)
+    {
+        return vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(row0), row1), 2);
+    }
+
+    void bgraToI420RowNEON(const unsigned char* src0, const unsigned char* src1,
+                           unsigned char* y0, unsigned char* y1, unsigned char* u, unsigned char* v, int pixels)
+    {
+        int i = 0;
+        for (; i + 16 <= pixels; i += 16)
+        {
+            uint8x16x4_t s0 = vld4q_u8(src0 + i * kDepth);
+            uint8x16x4_t s1 = vld4q_u8(src1 + i * kDepth);
+
+            vst1q_u8(y0 + i, luma(s0.val[2], s0.val[1], s0.val[0]));
+            vst1q_u8(y1 + i, luma(s1.val[2], s1.val[1], s1.val[0]));
+
+            uint16x8_t blue = average2x2(s0.val[0], s1.val[0]);
+            uint16x8_t green = average2x2(s0.val[1], s1.val[1]);
+            uint16x8_t red = average2x2(s0.val[2], s1.val[2]);
+
+            vst1_u8(u + i / 2, weigh(red, green, blue, (uint16_t)-38, (uint16_t)-74, 112, 32896));
+            vst1_u8(v + i / 2, weigh(red, green, blue, 112, (uint16_t)-94, (uint16_t)-18, 32896));
+        }
+
+        bgraToI420RowScalar(src0 + i * kDepth, src1 + i * kDepth, y0 + i, y1 + i, u + i / 2, v + i / 2, pixels - i);
+    }
+
+    void blendRowNEON(unsigned char* dst, const unsigned char* src, int pixels)
+    {
+        int i = 0;
+        for (; i + 16 <= pixels; i += 16)
+        {
+            uint8x16x4_t s = vld4q_u8(src + i * kDepth);
+            uint8x16x4_t d = vld4q_u8(dst + i * kDepth);
+
+            uint8x16_t inverse_alpha = vmvnq_u8(s.val[3]);
+            for (int c = 0; c < kDepth; ++c)
+            {
+                d.val[c] = vqaddq_u8(s.val[c], multiply(d.val[c], inverse_alpha));
+            }
+
+            vst4q_u8(dst + i * kDepth, d);
+        }
+
+        blendRowScalar(dst + i * kDepth, src + i * kDepth, pixels - i);
+    }
+
+    void swizzleRowNEON(unsigned char* dst, const unsigned char* src, int pixels)
+    {
+        int i = 0;
+        for (; i + 16 <= pixels; i += 16)
+        {
+            uint8x16x4_t s = vld4q_u8(src + i * kDepth);
+
+            uint8x16_t first = s.val[0];
+            s.val[0] = s.val[2];
+            s.val[2] = first;
+
+            vst4q_u8(dst + i * kDepth, s);
+        }
+
+        swizzleRowScalar(dst + i * kDepth, src + i * kDepth, pixels - i);
+    }
+
+    void premultiplyRowNEON(unsigned char* dst, const unsigned char* src, int pixels)
+    {
+        int i = 0;
+        for (; i + 16 <= pixels; i += 16)
+        {
+            uint8x16x4_t s = vld4q_u8(src + i * kDepth);
+
+            for (int c = 0; c < 3; ++c)
+            {
+                s.val[c] = multiply(s.val[c], s.val[3]);
+            }
+
+            vst4q_u8(dst + i * kDepth, s);
+        }
+
+        premultiplyRowScalar(dst + i * kDepth, src + i * kDepth, pixels - i);
+    }
+
+    void unpremultiplyRowNEON(unsigned char* dst, const unsigned char* src, int pixels)
+    {
+        int i = 0;
+        for (; i + 16 <= pixels; i += 16)
+        {
+            uint8x16x4_t s = vld4q_u8(src + i * kDepth);
+
+            for (int c = 0; c < 3; ++c)
+            {
+                s.val[c] = unpremultiply(s.val[c], s.val[3]);
+            }
+
+            vst4q_u8(dst + i * kDepth, s);
+        }
+
+        unpremultiplyRowScalar(dst + i * kDepth, src + i * kDepth, pixels - i);
+    }
+
+    inline uint32x4_t hashStep(uint32x4_t lanes, uint32x4_t pixels)
+    {
+        uint32x4_t mixed = vmulq_u32(veorq_u32(lanes, pixels), vdupq_n_u32(kHashMultiplier));
+        return vorrq_u32(vshlq_n_u32(mixed, kHashRotate), vshrq_n_u32(mixed, 32 - kHashRotate));
+    }
+
+    // the 16 lanes in 4 registers
+    void hashRowNEON(unsigned int* lanes, const unsigned char* src, int pixels)
+    {
+        uint32x4_t hash[4];
+        for (int j = 0; j < 4; ++j)
+        {
+            hash[j] = vld1q_u32(lanes + j * 4);
+        }
+
+        int i = 0;
+        for (; i + kHashLanes <= pixels; i += kHashLanes)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                hash[j] = hashStep(hash[j], vreinterpretq_u32_u8(vld1q_u8(src + (i + j * 4) * kDepth)));
+            }
+        }
+
+        for (int j = 0; j < 4; ++j)
+        {
+            vst1q_u32(lanes + j * 4, hash[j]);
+        }
+        hashRowScalar(lanes, src + i * kDepth, pixels - i);
+    }
+
+    // 16 pixels of each row to 8 - a channel per register, neighbours added pairwise
+    void downsampleRowNEON(unsigned char* dst, const unsigned char* src0, const unsigned char* src1, int pixels)
+    {
+        int i = 0;
+        for (; i + 16 <= pixels; i += 16)
+        {
+            uint8x16x4_t a = vld4q_u8(src0 + i * kDepth);
+            uint8x16x4_t b = vld4q_u8(src1 + i * kDepth);
+
+            uint8x8x4_t d;
+            for (int c = 0; c < kDepth; ++c)
+            {
+                // vrshrn adds the 2 before it shifts
+                d.val[c] = vrshrn_n_u16(vaddq_u16(vpaddlq_u8(a.val[c]), vpaddlq_u8(b.val[c])), 2);
+            }
+
+            vst4_u8(dst + i / 2 * kDepth, d);
+        }
+
+        downsampleRowScalar(dst + i / 2 * kDepth, src0 + i * kDepth, src1 + i * kDepth, pixels - i);
+    }
+
+    const PixelKernels kNEONPixelKernels =
+    {
+        "neon",
+        blendRowNEON,
+        swizzleRowNEON,
+        premultiplyRowNEON,
+        unpremultiplyRowNEON,
+        bgraToI420RowNEON,
+        hashRowNEON,
+        downsampleRowNEON
+    };
+}
+
+const PixelKernels* neonPixelKernels()
+{
+    return &kNEONPixelKernels;
+}
+
+#else
+
+const PixelKernels* neonPixelKernels()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,279 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "pixel_kernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+/////////////////////////////////////////////////////////////////////////////////
+// 4 pixels at a time - the colour maths is done on 16 bit lanes, 2 pixels per register
+namespace
+{
+    // x / 255 rounded to nearest for x up to 255 * 255
+    inline __m128i div255(__m128i x)
+    {
+        x = _mm_add_epi16(x, _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    }
+
+    // copy the alpha of each pixel to all 4 of its lanes
+    inline __m128i broadcastAlpha(__m128i pixels16)
+    {
+        return _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels16, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    }
+
+    inline __m128i blend(__m128i src16, __m128i dst16)
+    {
+        __m128i inverse_alpha = _mm_sub_epi16(_mm_set1_epi16(255), broadcastAlpha(src16));
+        return _mm_add_epi16(src16, div255(_mm_mullo_epi16(dst16, inverse_alpha)));
+    }
+
+    inline __m128i premultiply(__m128i pixels16)
+    {
+        // multiply the alpha lane by 255 so it comes back out unchanged
+        const __m128i alpha_lanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+        __m128i multiplier = _mm_or_si128(broadcastAlpha(pixels16), _mm_and_si128(alpha_lanes, _mm_set1_epi16(255)));
+        return div255(_mm_mullo_epi16(pixels16, multiplier));
+    }
+
+    // one pixel in 32 bit lanes - division is done in float, which is exact for these ranges once the
+    // result is clamped to 255. Alpha 0 divides by zero and the pack below turns that into 0
+    inline __m128i unpremultiply(__m128i pixel32)
+    {
+        __m128i alpha = _mm_shuffle_epi32(pixel32, _MM_SHUFFLE(3, 3, 3, 3));
+        __m128 numerator = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(pixel32), _mm_set1_ps(255.0f)),
+                                      _mm_cvtepi32_ps(_mm_srli_epi32(alpha, 1)));
+        return _mm_cvttps_epi32(_mm_div_ps(numerator, _mm_cvtepi32_ps(alpha)));
+    }
+
+    // 8 pixels (two registers) split into one 16 bit register per channel
+    inline void channels(__m128i p0, __m128i p1, __m128i& blue, __m128i& green, __m128i& red)
+    {
+        const __m128i low_byte = _mm_set1_epi32(0xff);
+        blue = _mm_packs_epi32(_mm_and_si128(p0, low_byte), _mm_and_si128(p1, low_byte));
+        green = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), low_byte), _mm_and_si128(_mm_srli_epi32(p1, 8), low_byte));
+        red = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), low_byte), _mm_and_si128(_mm_srli_epi32(p1, 16), low_byte));
+    }
+
+    // (r * cr + g * cg + b * cb + offset) >> 8 - wraps around in 16 bits but the answer doesn't (see pixel_kernels.h)
+    inline __m128i weigh(__m128i red, __m128i green, __m128i blue, short cr, short cg, short cb, short offset)
+    {
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(red, _mm_set1_epi16(cr)), _mm_mullo_epi16(green, _mm_set1_epi16(cg)));
+        sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_mullo_epi16(blue, _mm_set1_epi16(cb)), _mm_set1_epi16(offset)));
+        return _mm_srli_epi16(sum, 8);
+    }
+
+    inline __m128i luma(__m128i red, __m128i green, __m128i blue)
+    {
+        return weigh(red, green, blue, 66, 129, 25, 4224);
+    }
+
+    // 8 channel values from each of two rows to 4 rounded 2x2 averages in the low 4 lanes of each half
+    inline __m128i average2x2(__m128i row0, __m128i row1)
+    {
+        __m128i sum = _mm_add_epi16(row0, row1);
+        __m128i pairs = _mm_add_epi32(_mm_and_si128(sum, _mm_set1_epi32(0xffff)), _mm_srli_epi32(sum, 16));
+        return _mm_srli_epi32(_mm_add_epi32(pairs, _mm_set1_epi32(2)), 2);
+    }
+
+    void bgraToI420RowSSE2(const unsigned char* src0, const unsigned char* src1,
+                           unsigned char* y0, unsigned char* y1, unsigned char* u, unsigned char* v, int pixels)
+    {
+        int i = 0;
+        for (; i + 16 <= pixels; i += 16)
+        {
+            __m128i b0[2], g0[2], r0[2], b1[2], g1[2], r1[2];
+            for (int half = 0; half < 2; ++half)
+            {
+                const unsigned char* s0 = src0 + (i + half * 8) * kDepth;
+                const unsigned char* s1 = src1 + (i + half * 8) * kDepth;
+                channels(_mm_loadu_si128((const __m128i*)s0), _mm_loadu_si128((const __m128i*)(s0 + 16)), b0[half], g0[half], r0[half]);
+                channels(_mm_loadu_si128((const __m128i*)s1), _mm_loadu_si128((const __m128i*)(s1 + 16)), b1[half], g1[half], r1[half]);
+            }
+
+            _mm_storeu_si128((__m128i*)(y0 + i), _mm_packus_epi16(luma(r0[0], g0[0], b0[0]), luma(r0[1], g0[1], b0[1])));
+            _mm_storeu_si128((__m128i*)(y1 + i), _mm_packus_epi16(luma(r1[0], g1[0], b1[0]), luma(r1[1], g1[1], b1[1])));
+
+            __m128i blue = _mm_packs_epi32(average2x2(b0[0], b1[0]), average2x2(b0[1], b1[1]));
+            __m128i green = _mm_packs_epi32(average2x2(g0[0], g1[0]), average2x2(g0[1], g1[1]));
+            __m128i red = _mm_packs_epi32(average2x2(r0[0], r1[0]), average2x2(r0[1], r1[1]));
+
+            __m128i chroma_u = weigh(red, green, blue, -38, -74, 112, (short)32896);
+            __m128i chroma_v = weigh(red, green, blue, 112, -94, -18, (short)32896);
+            _mm_storel_epi64((__m128i*)(u + i / 2), _mm_packus_epi16(chroma_u, chroma_u));
+            _mm_storel_epi64((__m128i*)(v + i / 2), _mm_packus_epi16(chroma_v, chroma_v));
+        }
+
+        bgraToI420RowScalar(src0 + i * kDepth, src1 + i * kDepth, y0 + i, y1 + i, u + i / 2, v + i / 2, pixels - i);
+    }
+
+    void blendRowSSE2(unsigned char* dst, const unsigned char* src, int pixels)
+    {
+        const __m128i zero = _mm_setzero_si128();
+
+        int i = 0;
+        for (; i + 4 <= pixels; i += 4)
+        {
+            __m128i s = _mm_loadu_si128((const __m128i*)(src + i * kDepth));
+            __m128i d = _mm_loadu_si128((const __m128i*)(dst + i * kDepth));
+
+            __m128i low = blend(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+            __m128i high = blend(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+
+            // the pack saturates, which is the min(255, ...)
+            _mm_storeu_si128((__m128i*)(dst + i * kDepth), _mm_packus_epi16(low, high));
+        }
+
+        blendRowScalar(dst + i * kDepth, src + i * kDepth, pixels - i);
+    }
+
+    void premultiplyRowSSE2(unsigned char* dst, const unsigned char* src, int pixels)
+    {
+        const __m128i zero = _mm_setzero_si128();
+
+        int i = 0;
+        for (; i + 4 <= pixels; i += 4)
+        {
+            __m128i s = _mm_loadu_si128((const __m128i*)(src + i * kDepth));
+
+            __m128i low = premultiply(_mm_unpacklo_epi8(s, zero));
+            __m128i high = premultiply(_mm_unpackhi_epi8(s, zero));
+
+            _mm_storeu_si128((__m128i*)(dst + i * kDepth), _mm_packus_epi16(low, high));
+        }
+
+        premultiplyRowScalar(dst + i * kDepth, src + i * kDepth, pixels - i);
+    }
+
+    void unpremultiplyRowSSE2(unsigned char* dst, const unsigned char* src, int pixels)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i alpha_bytes = _mm_set1_epi32((int)0xff000000);
+
+        int i = 0;
+        for (; i + 4 <= pixels; i += 4)
+        {
+            __m128i s = _mm_loadu_si128((const __m128i*)(src + i * kDepth));
+
+            __m128i low = _mm_unpacklo_epi8(s, zero);
+            __m128i high = _mm_unpackhi_epi8(s, zero);
+
+            __m128i p0 = unpremultiply(_mm_unpacklo_epi16(low, zero));
+            __m128i p1 = unpremultiply(_mm_unpackhi_epi16(low, zero));
+            __m128i p2 = unpremultiply(_mm_unpacklo_epi16(high, zero));
+            __m128i p3 = unpremultiply(_mm_unpackhi_epi16(high, zero));
+
+            // the signed pack turns divide by zero (0x80000000) negative and the unsigned pack turns that into 0
+            __m128i colour = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+
+            __m128i result = _mm_or_si128(_mm_andnot_si128(alpha_bytes, colour), _mm_and_si128(alpha_bytes, s));
+            _mm_storeu_si128((__m128i*)(dst + i * kDepth), result);
+        }
+
+        unpremultiplyRowScalar(dst + i * kDepth, src + i * kDepth, pixels - i);
+    }
+
+    // SSE2 can only multiply the even 32 bit lanes (into 64 bits) - do the odd ones shifted down
+    // and put the low halves back together
+    inline __m128i mullo32(__m128i a, __m128i b)
+    {
+        __m128i even = _mm_mul_epu32(a, b);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+
+    inline __m128i hashStep(__m128i lanes, __m128i pixels)
+    {
+        __m128i mixed = mullo32(_mm_xor_si128(lanes, pixels), _mm_set1_epi32((int)kHashMultiplier));
+        return _mm_or_si128(_mm_slli_epi32(mixed, kHashRotate), _mm_srli_epi32(mixed, 32 - kHashRotate));
+    }
+
+    // the 16 lanes in 4 registers - 4 multiplies on the go at once
+    void hashRowSSE2(unsigned int* lanes, const unsigned char* src, int pixels)
+    {
+        __m128i hash[4];
+        for (int j = 0; j < 4; ++j)
+        {
+            hash[j] = _mm_loadu_si128((const __m128i*)(lanes + j * 4));
+        }
+
+        int i = 0;
+        for (; i + kHashLanes <= pixels; i += kHashLanes)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                hash[j] = hashStep(hash[j], _mm_loadu_si128((const __m128i*)(src + (i + j * 4) * kDepth)));
+            }
+        }
+
+        for (int j = 0; j < 4; ++j)
+        {
+            _mm_storeu_si128((__m128i*)(lanes + j * 4), hash[j]);
+        }
+        hashRowScalar(lanes, src + i * kDepth, pixels - i);
+    }
+
+    // 8 pixels of each row to 4 - the rows are added on 16 bit lanes, then each pixel to its neighbour
+    void downsampleRowSSE2(unsigned char* dst, const unsigned char* src0, const unsigned char* src1, int pixels)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+
+        int i = 0;
+        for (; i + 8 <= pixels; i += 8)
+        {
+            __m128i a0 = _mm_loadu_si128((const __m128i*)(src0 + i * kDepth));
+            __m128i a1 = _mm_loadu_si128((const __m128i*)(src0 + (i + 4) * kDepth));
+            __m128i b0 = _mm_loadu_si128((const __m128i*)(src1 + i * kDepth));
+            __m128i b1 = _mm_loadu_si128((const __m128i*)(src1 + (i + 4) * kDepth));
+
+            // 2 pixels per register, summed down the two rows
+            __m128i s01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+            __m128i s23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+            __m128i s45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+            __m128i s67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+
+            __m128i q01 = _mm_add_epi16(_mm_unpacklo_epi64(s01, s23), _mm_unpackhi_epi64(s01, s23));
+            __m128i q23 = _mm_add_epi16(_mm_unpacklo_epi64(s45, s67), _mm_unpackhi_epi64(s45, s67));
+            q01 = _mm_srli_epi16(_mm_add_epi16(q01, two), 2);
+            q23 = _mm_srli_epi16(_mm_add_epi16(q23, two), 2);
+
+            _mm_storeu_si128((__m128i*)(dst + i / 2 * kDepth), _mm_packus_epi16(q01, q23));
+        }
+
+        downsampleRowScalar(dst + i / 2 * kDepth, src0 + i * kDepth, src1 + i * kDepth, pixels - i);
+    }
+
+    const PixelKernels kSSE2PixelKernels =
+    {
+        "sse2",
+        blendRowSSE2,
+        // masks and shifts are no faster than the loop the compiler vectorizes itself - it's all memory bandwidth
+        swizzleRowScalar,
+        premultiplyRowSSE2,
+        unpremultiplyRowSSE2,
+        bgraToI420RowSSE2,
+        hashRowSSE2,
+        downsampleRowSSE2
+    };
+}
+
+const PixelKernels* sse2PixelKernels()
+{
+    return &kSSE2PixelKernels;
+}
+
+#else
+
+const PixelKernels* sse2PixelKernels()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,363 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "pixel_pool.h"
+
+#include <algorithm>
+#include <new>
+
+#ifdef _WIN32
+// keep windows.h from defining min and max macros that break std::min/std::max
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+    // nothing smaller than this is worth a size class of its own
+    const size_t kMinClass = 4096;
+
+    // surface capacities are rounded up to this many pixels
+    const int kSurfaceGranularity = 64;
+
+#ifndef _WIN32
+    // what transparent huge pages are on x86-64 and ARM64 Linux
+    const size_t kHugePageSize = 2 * 1024 * 1024;
+#endif
+
+    int roundUp(int value, int granularity)
+    {
+        return (value + granularity - 1) / granularity * granularity;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+PixelBuffer::PixelBuffer(PixelBuffer&& other) :
+    mPool(other.mPool),
+    mData(other.mData),
+    mSize(other.mSize),
+    mCapacity(other.mCapacity)
+{
+    other.mPool = nullptr;
+    other.mData = nullptr;
+    other.mSize = 0;
+    other.mCapacity = 0;
+}
+
+PixelBuffer& PixelBuffer::operator=(PixelBuffer&& other)
+{
+    if (this != &other)
+    {
+        clear();
+
+        mPool = other.mPool;
+        mData = other.mData;
+        mSize = other.mSize;
+        mCapacity = other.mCapacity;
+
+        other.mPool = nullptr;
+        other.mData = nullptr;
+        other.mSize = 0;
+        other.mCapacity = 0;
+    }
+    return *this;
+}
+
+PixelBuffer::~PixelBuffer()
+{
+    clear();
+}
+
+void PixelBuffer::clear()
+{
+    if (mPool && mData)
+    {
+        mPool->release(mData, mCapacity);
+    }
+
+    mPool = nullptr;
+    mData = nullptr;
+    mSize = 0;
+    mCapacity = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+PixelPool::PixelPool(size_t max_cached_bytes) :
+    mMaxCachedBytes(max_cached_bytes),
+    mHugePages(false)
+{
+}
+
+PixelPool::~PixelPool()
+{
+    trim();
+}
+
+PixelBuffer PixelPool::acquire(size_t bytes)
+{
+    PixelBuffer buffer;
+    if (bytes == 0)
+    {
+        return buffer;
+    }
+
+    size_t capacity = sizeClass(bytes);
+    unsigned char* data = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        ++mStats.acquires;
+
+        auto it = mFree.find(capacity);
+        if (it != mFree.end() && ! it->second.empty())
+        {
+            data = it->second.back();
+            it->second.pop_back();
+            mStats.cachedBytes -= capacity;
+        }
+        else
+        {
+            ++mStats.allocations;
+        }
+
+        mStats.liveBytes += capacity;
+        mStats.peakBytes = std::max(mStats.peakBytes, mStats.liveBytes + mStats.cachedBytes);
+    }
+
+    if (data == nullptr)
+    {
+        bool huge = false;
+        data = systemAllocate(capacity, mHugePages && capacity >= kHugePageAllocationSize, huge);
+        if (huge)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            ++mStats.hugePageAllocations;
+        }
+    }
+
+    buffer.mPool = this;
+    buffer.mData = data;
+    buffer.mSize = bytes;
+    buffer.mCapacity = capacity;
+    return buffer;
+}
+
+void PixelPool::resize(PixelBuffer& buffer, size_t bytes)
+{
+    if (buffer.mPool == this && bytes > 0 && sizeClass(bytes) == buffer.mCapacity)
+    {
+        buffer.mSize = bytes;
+        return;
+    }
+
+    buffer.clear();
+    buffer = acquire(bytes);
+}
+
+void PixelPool::release(unsigned char* data, size_t capacity)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.liveBytes -= capacity;
+
+        if (mStats.cachedBytes + capacity <= mMaxCachedBytes)
+        {
+            mFree[capacity].push_back(data);
+            mStats.cachedBytes += capacity;
+            return;
+        }
+
+        ++mStats.frees;
+    }
+
+    systemFree(data, capacity);
+}
+
+void PixelPool::trim()
+{
+    std::map<size_t, std::vector<unsigned char*>> free_lists;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        free_lists.swap(mFree);
+        for (const auto& free_list : free_lists)
+        {
+            mStats.frees += free_list.second.size();
+        }
+        mStats.cachedBytes = 0;
+    }
+
+    for (const auto& free_list : free_lists)
+    {
+        for (unsigned char* data : free_list.second)
+        {
+            systemFree(data, free_list.first);
+        }
+    }
+}
+
+PixelPoolStats PixelPool::stats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+unsigned char* PixelPool::systemAllocate(size_t capacity, bool want_huge, bool& huge)
+{
+    huge = false;
+
+    // size classes this big are whole pages already (see sizeClass())
+    if (capacity >= kPageAllocationSize)
+    {
+#ifdef _WIN32
+        size_t large_page = GetLargePageMinimum();
+        if (want_huge && large_page > 0)
+        {
+            size_t length = (capacity + large_page - 1) / large_page * large_page;
+            void* data = VirtualAlloc(nullptr, length, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (data)
+            {
+                huge = true;
+                return (unsigned char*)data;
+            }
+        }
+
+        void* data = VirtualAlloc(nullptr, capacity, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (data == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return (unsigned char*)data;
+#else
+        // transparent huge pages only back 2MB aligned ranges - map a bit extra and trim it to line up
+        size_t extra = want_huge ? kHugePageSize : 0;
+        void* mapping = mmap(nullptr, capacity + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+
+        unsigned char* data = (unsigned char*)mapping;
+        if (want_huge)
+        {
+            unsigned char* end = data + capacity + extra;
+            unsigned char* aligned = (unsigned char*)(((size_t)data + kHugePageSize - 1) & ~(kHugePageSize - 1));
+            if (aligned > data)
+            {
+                munmap(data, aligned - data);
+            }
+            if (aligned + capacity < end)
+            {
+                munmap(aligned + capacity, end - (aligned + capacity));
+            }
+            data = aligned;
+
+#ifdef MADV_HUGEPAGE
+            huge = madvise(data, capacity, MADV_HUGEPAGE) == 0;
+#endif
+        }
+        return data;
+#endif
+    }
+
+#ifdef _WIN32
+    void* data = _aligned_malloc(capacity, kPixelAlignment);
+#else
+    void* data = nullptr;
+    if (posix_memalign(&data, kPixelAlignment, capacity) != 0)
+    {
+        data = nullptr;
+    }
+#endif
+    if (data == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return (unsigned char*)data;
+}
+
+void PixelPool::systemFree(unsigned char* data, size_t capacity)
+{
+    if (capacity >= kPageAllocationSize)
+    {
+#ifdef _WIN32
+        VirtualFree(data, 0, MEM_RELEASE);
+#else
+        munmap(data, capacity);
+#endif
+        return;
+    }
+
+#ifdef _WIN32
+    _aligned_free(data);
+#else
+    free(data);
+#endif
+}
+
+size_t PixelPool::sizeClass(size_t bytes)
+{
+    if (bytes <= kMinClass)
+    {
+        return kMinClass;
+    }
+
+    // the power of two below bytes, then the first quarter step past it that fits
+    size_t power = kMinClass;
+    while (power * 2 < bytes)
+    {
+        power *= 2;
+    }
+
+    size_t step = power / 4;
+    return (bytes + step - 1) / step * step;
+}
+
+PixelPool& defaultPixelPool()
+{
+    static PixelPool pool;
+    return pool;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+bool growSurface(int width, int height, int& capacity_width, int& capacity_height)
+{
+    bool fits = width <= capacity_width && height <= capacity_height;
+    bool mostly_empty = (double)width * height < (double)capacity_width * capacity_height / 4.0;
+    if (fits && ! mostly_empty)
+    {
+        return false;
+    }
+
+    int new_width, new_height;
+    if (! fits && capacity_width > 0 && capacity_height > 0)
+    {
+        // only grow the directions that ran out
+        new_width = width <= capacity_width ? capacity_width : std::max(width, capacity_width + capacity_width / 2);
+        new_height = height <= capacity_height ? capacity_height : std::max(height, capacity_height + capacity_height / 2);
+    }
+    else
+    {
+        new_width = width;
+        new_height = height;
+    }
+
+    new_width = roundUp(new_width, kSurfaceGranularity);
+    new_height = roundUp(new_height, kSurfaceGranularity);
+
+    bool changed = new_width != capacity_width || new_height != capacity_height;
+    capacity_width = new_width;
+    capacity_height = new_height;
+    return changed;
+}
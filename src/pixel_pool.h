@@ -0,0 +1,186 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _PIXEL_POOL_H_
+#define _PIXEL_POOL_H_
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+
+class PixelPool;
+
+/////////////////////////////////////////////////////////////////////////////////
+// a block of pixel memory from a PixelPool - goes back to the pool (not the
+// system) when it's cleared or destroyed. Move only
+class PixelBuffer
+{
+    public:
+        PixelBuffer() :
+            mPool(nullptr),
+            mData(nullptr),
+            mSize(0),
+            mCapacity(0)
+        {
+        }
+
+        PixelBuffer(PixelBuffer&& other);
+        PixelBuffer& operator=(PixelBuffer&& other);
+        ~PixelBuffer();
+
+        unsigned char* data()
+        {
+            return mData;
+        }
+
+        const unsigned char* data() const
+        {
+            return mData;
+        }
+
+        // what was asked for
+        size_t size() const
+        {
+            return mSize;
+        }
+
+        // what the size class gave us
+        size_t capacity() const
+        {
+            return mCapacity;
+        }
+
+        bool empty() const
+        {
+            return mSize == 0;
+        }
+
+        // hand the memory back to the pool
+        void clear();
+
+    private:
+        friend class PixelPool;
+
+        PixelBuffer(const PixelBuffer&);
+        PixelBuffer& operator=(const PixelBuffer&);
+
+        PixelPool* mPool;
+        unsigned char* mData;
+        size_t mSize;
+        size_t mCapacity;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+struct PixelPoolStats
+{
+    PixelPoolStats() :
+        acquires(0),
+        allocations(0),
+        frees(0),
+        hugePageAllocations(0),
+        liveBytes(0),
+        cachedBytes(0),
+        peakBytes(0)
+    {
+    }
+
+    size_t acquires;
+    // times we had to go to the system for memory (the rest came from the free lists)
+    size_t allocations;
+    size_t frees;
+    // allocations that got huge pages (see PixelPool::setHugePages())
+    size_t hugePageAllocations;
+    // handed out right now / sitting in the free lists / the most of both together there has been
+    size_t liveBytes;
+    size_t cachedBytes;
+    size_t peakBytes;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// page and popup buffers come and go at lots of different sizes while a window
+// or panel is being resized. Sizes are rounded up to a size class - four steps
+// between each power of two, so at most 25% is wasted - and freed buffers
+// wait on a free list for their class, so a resize that stays in the same
+// class (or goes back to one it has been in) doesn't touch the system
+// allocator. Anything past max_cached_bytes is given back to the system.
+//
+// Every buffer starts on a cache line so the pixel kernels can use aligned
+// loads. Buffers of kPageAllocationSize and up come straight from the OS
+// (page aligned, and the pages really go back when they're freed) and, with
+// huge pages turned on, buffers of kHugePageAllocationSize and up ask for
+// 2MB pages - a 1080p page is over 2000 4K pages, which is a lot of TLB
+// misses for every full frame copy
+const size_t kPixelAlignment = 64;
+const size_t kPageAllocationSize = 64 * 1024;
+const size_t kHugePageAllocationSize = 4 * 1024 * 1024;
+
+class PixelPool
+{
+    public:
+        PixelPool(size_t max_cached_bytes = 32 * 1024 * 1024);
+        ~PixelPool();
+
+        PixelBuffer acquire(size_t bytes);
+
+        // make buffer hold bytes - it keeps its memory if bytes is in the same size class,
+        // otherwise it goes back to the pool and buffer gets a new one. The contents are undefined
+        void resize(PixelBuffer& buffer, size_t bytes);
+
+        // ask for huge pages for big buffers from now on (transparent huge pages on Linux, large
+        // pages on Windows - they need the "Lock pages in memory" privilege). Falls back to normal
+        // pages if the system says no
+        void setHugePages(bool enable)
+        {
+            mHugePages = enable;
+        }
+
+        bool hugePages() const
+        {
+            return mHugePages;
+        }
+
+        // give everything on the free lists back to the system
+        void trim();
+
+        PixelPoolStats stats() const;
+
+        // the size class bytes rounds up to
+        static size_t sizeClass(size_t bytes);
+
+    private:
+        friend class PixelBuffer;
+
+        PixelPool(const PixelPool&);
+        PixelPool& operator=(const PixelPool&);
+
+        void release(unsigned char* data, size_t capacity);
+
+        // where the memory really comes from and goes back to - huge is set if huge pages were used
+        static unsigned char* systemAllocate(size_t capacity, bool want_huge, bool& huge);
+        static void systemFree(unsigned char* data, size_t capacity);
+
+        size_t mMaxCachedBytes;
+        bool mHugePages;
+
+        mutable std::mutex mMutex;
+        std::map<size_t, std::vector<unsigned char*>> mFree;
+        PixelPoolStats mStats;
+};
+
+// shared by every compositor unless it's given one of its own
+PixelPool& defaultPixelPool();
+
+/////////////////////////////////////////////////////////////////////////////////
+// how big to make a texture (or anything else that holds a surface) that has
+// to hold width x height - grows by half again in each direction that runs
+// out, so a drag doesn't reallocate on every pixel, and shrinks back once it
+// would be less than a quarter used. Returns true if the capacity changed
+bool growSurface(int width, int height, int& capacity_width, int& capacity_height);
+
+#endif // _PIXEL_POOL_H_
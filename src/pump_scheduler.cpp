@@ -0,0 +1,225 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "pump_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+#ifdef _WIN32
+// keep windows.h from defining min and max macros that break std::min/std::max
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace
+{
+    const double kNever = std::numeric_limits<double>::infinity();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+PumpScheduler::PumpScheduler(double frame_interval, double max_delay) :
+    mFrameInterval(frame_interval),
+    mMaxDelay(max_delay),
+    mWorkDueAt(0.0),
+    mRequestCount(0),
+    mLastWork(now()),
+    mWorkStart(0.0),
+    mLastFrame(now())
+{
+}
+
+void PumpScheduler::scheduleWork(int64_t delay_ms)
+{
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        double due = now() + (double)std::max<int64_t>(delay_ms, 0);
+        ++mRequestCount;
+
+        // only the earliest request matters - CEF asks again after each piece of work
+        if (due < mWorkDueAt)
+        {
+            mWorkDueAt = due;
+            wake = true;
+        }
+    }
+
+    if (wake && mWake)
+    {
+        mWake();
+    }
+}
+
+double PumpScheduler::timeUntilDue(double now) const
+{
+    double due = mLastWork + mMaxDelay;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        due = std::min(due, mWorkDueAt);
+    }
+
+    if (mFrameInterval > 0.0)
+    {
+        due = std::min(due, mLastFrame + mFrameInterval);
+    }
+
+    return std::max(due - now, 0.0);
+}
+
+bool PumpScheduler::workDue(double now) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return now >= mWorkDueAt || now >= mLastWork + mMaxDelay;
+}
+
+bool PumpScheduler::frameDue(double now) const
+{
+    return mFrameInterval > 0.0 && now >= mLastFrame + mFrameInterval;
+}
+
+double PumpScheduler::timeUntilFrame(double now) const
+{
+    if (mFrameInterval <= 0.0)
+    {
+        return kNever;
+    }
+    return std::max(mLastFrame + mFrameInterval - now, 0.0);
+}
+
+void PumpScheduler::beginWork(double now)
+{
+    // this work covers everything asked for so far - anything CEF asks for while it runs (it
+    // often asks for more straight away) is new
+    std::lock_guard<std::mutex> lock(mMutex);
+    mWorkDueAt = kNever;
+    mWorkStart = now;
+}
+
+void PumpScheduler::endWork(double now)
+{
+    ++mStats.workCalls;
+    mStats.workTime += now - mWorkStart;
+    mLastWork = now;
+}
+
+void PumpScheduler::frameDone(double now)
+{
+    ++mStats.frames;
+
+    // stay on the frame grid unless we've fallen a whole frame behind
+    mLastFrame += mFrameInterval;
+    if (mLastFrame + mFrameInterval < now)
+    {
+        mLastFrame = now;
+    }
+}
+
+PumpStats PumpScheduler::stats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    PumpStats stats = mStats;
+    stats.scheduleRequests = mRequestCount;
+    return stats;
+}
+
+double PumpScheduler::now()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+InputLatencyTracker::InputLatencyTracker(double max_wait) :
+    mMaxWait(max_wait),
+    mInputTime(-1.0)
+{
+}
+
+void InputLatencyTracker::inputSent(double now)
+{
+    if (mInputTime < 0.0 || now - mInputTime > mMaxWait)
+    {
+        mInputTime = now;
+    }
+}
+
+void InputLatencyTracker::painted(double now)
+{
+    if (mInputTime >= 0.0 && now - mInputTime <= mMaxWait)
+    {
+        mSamples.push_back(now - mInputTime);
+    }
+    mInputTime = -1.0;
+}
+
+double InputLatencyTracker::percentile(double percent) const
+{
+    return samplePercentile(mSamples, percent);
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+double processCpuTime()
+{
+#ifdef _WIN32
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (! GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+    {
+        return 0.0;
+    }
+
+    // 100ns units
+    unsigned long long kernel = ((unsigned long long)kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime;
+    unsigned long long user = ((unsigned long long)user_time.dwHighDateTime << 32) | user_time.dwLowDateTime;
+    return (double)(kernel + user) / 10000.0;
+#else
+    timespec cpu_time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_time);
+    return cpu_time.tv_sec * 1000.0 + cpu_time.tv_nsec / 1.0e6;
+#endif
+}
+
+double threadCpuTime()
+{
+#ifdef _WIN32
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (! GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time))
+    {
+        return 0.0;
+    }
+
+    unsigned long long kernel = ((unsigned long long)kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime;
+    unsigned long long user = ((unsigned long long)user_time.dwHighDateTime << 32) | user_time.dwLowDateTime;
+    return (double)(kernel + user) / 10000.0;
+#else
+    timespec cpu_time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time);
+    return cpu_time.tv_sec * 1000.0 + cpu_time.tv_nsec / 1.0e6;
+#endif
+}
+
+double samplePercentile(const std::vector<double>& samples, double percent)
+{
+    if (samples.empty())
+    {
+        return 0.0;
+    }
+
+    std::vector<double> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+
+    size_t index = (size_t)(percent / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
@@ -0,0 +1,143 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _PUMP_SCHEDULER_H_
+#define _PUMP_SCHEDULER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// decides when the main loop should call CefDoMessageLoopWork() and redraw
+// when CEF runs with an external message pump, so the loop can sleep the rest
+// of the time instead of spinning. CEF asks for work through
+// CefBrowserProcessHandler::OnScheduleMessagePumpWork (from any thread) which
+// ends up in scheduleWork() - if that makes work due sooner than the main loop
+// thought, the wake callback is called so it can stop waiting. All times are
+// in milliseconds from now()
+struct PumpStats
+{
+    PumpStats() :
+        scheduleRequests(0),
+        wakeups(0),
+        workCalls(0),
+        frames(0),
+        workTime(0.0)
+    {
+    }
+
+    size_t scheduleRequests;
+    size_t wakeups;
+    size_t workCalls;
+    size_t frames;
+    // milliseconds spent inside CefDoMessageLoopWork() - CEF's share of the main thread
+    double workTime;
+};
+
+class PumpScheduler
+{
+    public:
+        // frame_interval is how often to redraw (0 to never wake up just to redraw) and max_delay is
+        // the longest to go without calling CEF even if it hasn't asked
+        PumpScheduler(double frame_interval, double max_delay);
+
+        // called from whichever thread asked for the work
+        void setWakeCallback(const std::function<void()>& wake)
+        {
+            mWake = wake;
+        }
+
+        // CefBrowserProcessHandler::OnScheduleMessagePumpWork - any thread
+        void scheduleWork(int64_t delay_ms);
+
+        // how long the main loop can sleep for - 0 if something is due now
+        double timeUntilDue(double now) const;
+
+        bool workDue(double now) const;
+        bool frameDue(double now) const;
+
+        // how long until the next redraw - infinity if there's no frame interval
+        double timeUntilFrame(double now) const;
+
+        // bracket the call to CefDoMessageLoopWork() - work CEF asks for while it runs isn't lost
+        void beginWork(double now);
+        void endWork(double now);
+
+        void frameDone(double now);
+
+        // the main loop woke up (for the stats)
+        void wokeUp()
+        {
+            ++mStats.wakeups;
+        }
+
+        PumpStats stats() const;
+
+        // steady clock in milliseconds
+        static double now();
+
+    private:
+        double mFrameInterval;
+        double mMaxDelay;
+        std::function<void()> mWake;
+
+        mutable std::mutex mMutex;
+        // guarded by mMutex - touched by whichever thread CEF calls scheduleWork() on
+        double mWorkDueAt;
+        size_t mRequestCount;
+
+        // main thread only
+        double mLastWork;
+        double mWorkStart;
+        double mLastFrame;
+        PumpStats mStats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// time from an input event being sent to CEF to the next paint - an input that
+// doesn't cause a paint within max_wait is forgotten about
+class InputLatencyTracker
+{
+    public:
+        InputLatencyTracker(double max_wait = 1000.0);
+
+        // only the first input while we're waiting for a paint counts
+        void inputSent(double now);
+        void painted(double now);
+
+        size_t count() const
+        {
+            return mSamples.size();
+        }
+
+        // milliseconds - percent from 0 to 100
+        double percentile(double percent) const;
+
+        void reset()
+        {
+            mSamples.clear();
+        }
+
+    private:
+        double mMaxWait;
+        double mInputTime;
+        std::vector<double> mSamples;
+};
+
+// CPU time used by the whole process so far in milliseconds
+double processCpuTime();
+
+// CPU time used by the calling thread so far in milliseconds
+double threadCpuTime();
+
+// percent from 0 to 100 - 0 if there are no samples
+double samplePercentile(const std::vector<double>& samples, double percent);
+
+#endif // _PUMP_SCHEDULER_H_
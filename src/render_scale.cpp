@@ -0,0 +1,62 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "render_scale.h"
+
+#include <cmath>
+
+namespace
+{
+    // never less than a pixel (or a DIP) - CEF won't paint an empty view
+    int atLeastOne(double value)
+    {
+        int rounded = (int)std::floor(value + 0.5);
+        return rounded > 1 ? rounded : 1;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+RenderScale::RenderScale(float scale, float device_scale_factor, bool keep_layout) :
+    mScale(scale > 0.0f ? scale : 1.0f),
+    mDeviceScaleFactor(device_scale_factor > 0.0f ? device_scale_factor : 1.0f),
+    mKeepLayout(keep_layout)
+{
+}
+
+Rect RenderScale::viewRect(int shown_width, int shown_height) const
+{
+    const double factor = (mKeepLayout ? 1.0 : mScale) / mDeviceScaleFactor;
+    return Rect(0, 0, atLeastOne(shown_width * factor), atLeastOne(shown_height * factor));
+}
+
+float RenderScale::screenScaleFactor() const
+{
+    return mKeepLayout ? mDeviceScaleFactor * mScale : mDeviceScaleFactor;
+}
+
+void RenderScale::paintSize(int shown_width, int shown_height, int& width, int& height) const
+{
+    const Rect view = viewRect(shown_width, shown_height);
+    width = (int)std::ceil(view.width * (double)screenScaleFactor());
+    height = (int)std::ceil(view.height * (double)screenScaleFactor());
+}
+
+void RenderScale::toView(int shown_width, int shown_height, int x, int y, int& view_x, int& view_y) const
+{
+    const Rect view = viewRect(shown_width, shown_height);
+    view_x = shown_width > 0 ? (int)((long long)x * view.width / shown_width) : x;
+    view_y = shown_height > 0 ? (int)((long long)y * view.height / shown_height) : y;
+}
+
+Rect RenderScale::toPaint(const Rect& view_rect) const
+{
+    const double factor = screenScaleFactor();
+    const int x = (int)std::floor(view_rect.x * factor);
+    const int y = (int)std::floor(view_rect.y * factor);
+    return Rect(x, y, (int)std::ceil((view_rect.x + view_rect.width) * factor) - x, (int)std::ceil((view_rect.y + view_rect.height) * factor) - y);
+}
@@ -0,0 +1,61 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _RENDER_SCALE_H_
+#define _RENDER_SCALE_H_
+
+#include "compositor.h"
+
+/////////////////////////////////////////////////////////////////////////////////
+// what to tell CEF so a browser shown at one size paints fewer pixels - a
+// browser drawn as a small tile doesn't need a full size page for the GPU to
+// shrink. CEF paints GetViewRect() (in DIPs) times the device_scale_factor
+// GetScreenInfo() reports, and scale is how much of the shown size, in each
+// direction, that comes to. There are two ways to get there:
+//
+//   keepLayout false  the view rect shrinks and the device scale factor is
+//                     left alone - the page lays out as if its window were
+//                     smaller, so text stays sharp but there's less of it
+//   keepLayout true   the view rect is left alone and the device scale
+//                     factor shrinks - the page lays out as it would at full
+//                     size and comes out at a lower resolution
+//
+// either way mouse events, which are in DIPs, and popup rects, which CEF gives
+// in DIPs and paints in pixels, have to be converted with toView() and
+// toPaint(). deviceScaleFactor is the screen's own (1 when it isn't high DPI)
+class RenderScale
+{
+    public:
+        RenderScale(float scale = 1.0f, float device_scale_factor = 1.0f, bool keep_layout = false);
+
+        float scale() const
+        {
+            return mScale;
+        }
+
+        // what GetViewRect() returns for a browser shown width x height pixels
+        Rect viewRect(int shown_width, int shown_height) const;
+
+        // what GetScreenInfo() reports as device_scale_factor
+        float screenScaleFactor() const;
+
+        // the size CEF paints the page at - Chromium rounds the view rect times the scale factor up
+        void paintSize(int shown_width, int shown_height, int& width, int& height) const;
+
+        // a point in the shown page, in pixels from its top left, as DIPs in the view
+        void toView(int shown_width, int shown_height, int x, int y, int& view_x, int& view_y) const;
+
+        // a rect in the view's DIPs (OnPopupSize()) in the pixels CEF paints
+        Rect toPaint(const Rect& view_rect) const;
+
+    private:
+        float mScale;
+        float mDeviceScaleFactor;
+        bool mKeepLayout;
+};
+
+#endif // _RENDER_SCALE_H_
@@ -0,0 +1,82 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "render_scheduler.h"
+
+#include <algorithm>
+#include <limits>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+RenderScheduler::RenderScheduler(double min_interval) :
+    mMinInterval(min_interval),
+    mDirty(true),
+    mFirstDamage(-1.0),
+    mLastPresent(-1.0)
+{
+}
+
+void RenderScheduler::damage(double now)
+{
+    mDirty = true;
+    if (mFirstDamage < 0.0)
+    {
+        mFirstDamage = now;
+    }
+}
+
+void RenderScheduler::invalidate()
+{
+    mDirty = true;
+}
+
+bool RenderScheduler::presentDue(double now) const
+{
+    return timeUntilPresent(now) <= 0.0;
+}
+
+double RenderScheduler::timeUntilPresent(double now) const
+{
+    if (! mDirty)
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    if (mLastPresent < 0.0 || mMinInterval <= 0.0)
+    {
+        return 0.0;
+    }
+
+    return std::max(mLastPresent + mMinInterval - now, 0.0);
+}
+
+void RenderScheduler::presented(double now)
+{
+    ++mStats.presents;
+
+    if (mLastPresent >= 0.0)
+    {
+        mStats.presentIntervals.push_back(now - mLastPresent);
+    }
+
+    if (mFirstDamage >= 0.0)
+    {
+        double wait = now - mFirstDamage;
+        mStats.paintToPresent.push_back(wait);
+
+        // waiting up to one interval for the cap is expected and so is a little wake up jitter on top -
+        // every whole interval past that is a frame we missed
+        if (mMinInterval > 0.0 && wait > mMinInterval * 1.5)
+        {
+            mStats.droppedFrames += (size_t)((wait - mMinInterval * 0.5) / mMinInterval);
+        }
+    }
+
+    mDirty = false;
+    mFirstDamage = -1.0;
+    mLastPresent = now;
+}
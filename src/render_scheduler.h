@@ -0,0 +1,78 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _RENDER_SCHEDULER_H_
+#define _RENDER_SCHEDULER_H_
+
+#include <cstddef>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// decides when the window needs drawing and presenting - only when a browser
+// surface has changed (damage()) or the window itself needs repainting
+// (invalidate()), and no more often than the target rate. A mostly static page
+// then costs nothing to display. Times are in milliseconds (PumpScheduler::now())
+// and everything happens on the main thread
+struct RenderStats
+{
+    RenderStats() :
+        presents(0),
+        droppedFrames(0)
+    {
+    }
+
+    size_t presents;
+
+    // frame slots that went by while there was damage waiting to be presented
+    size_t droppedFrames;
+
+    // time between presents and from the first damage to the present that showed it
+    std::vector<double> presentIntervals;
+    std::vector<double> paintToPresent;
+};
+
+class RenderScheduler
+{
+    public:
+        // min_interval caps the present rate - 0 for no cap
+        RenderScheduler(double min_interval);
+
+        // a surface changed - it needs presenting
+        void damage(double now);
+
+        // the window needs drawing again (resized, exposed, a browser came or went etc.)
+        void invalidate();
+
+        bool presentDue(double now) const;
+
+        // how long until the next present is due - infinity if there is nothing to present
+        double timeUntilPresent(double now) const;
+
+        void presented(double now);
+
+        const RenderStats& stats() const
+        {
+            return mStats;
+        }
+
+        void resetStats()
+        {
+            mStats = RenderStats();
+        }
+
+    private:
+        double mMinInterval;
+        bool mDirty;
+        // -1 if no surface damage is waiting
+        double mFirstDamage;
+        // -1 before the first present
+        double mLastPresent;
+
+        RenderStats mStats;
+};
+
+#endif // _RENDER_SCHEDULER_H_
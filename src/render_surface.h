@@ -0,0 +1,106 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _RENDER_SURFACE_H_
+#define _RENDER_SURFACE_H_
+
+#include <cstddef>
+
+/////////////////////////////////////////////////////////////////////////////////
+// what the browsers are drawn onto - a window with a WGL context on Windows, an
+// offscreen framebuffer in a surfaceless EGL context on a Linux box with no
+// display (Mesa's llvmpipe when there's no GPU either) or nothing at all. With
+// no GL (hasGL() false) browsers use a NullUploadBackend and keep their frames
+// in the compositor's pixels, which is all a server that only exports or
+// captures frames needs
+class RenderSurface
+{
+    public:
+        virtual ~RenderSurface() {}
+
+        virtual const char* name() const = 0;
+
+        // false when there's no context - nothing is drawn and there are no textures to upload to
+        virtual bool hasGL() const = 0;
+
+        // the window (or offscreen target) changed size - sets up the viewport and a 2D projection
+        // with the origin at the top left when there's GL
+        virtual void resize(int width, int height) = 0;
+
+        // make the context and target current before drawing
+        virtual void makeCurrent() = 0;
+
+        // the frame is drawn - swap buffers, or wait for an offscreen target to finish
+        virtual void present() = 0;
+
+        virtual int width() const = 0;
+        virtual int height() const = 0;
+
+        size_t presents() const
+        {
+            return mPresents;
+        }
+
+    protected:
+        RenderSurface() :
+            mPresents(0)
+        {
+        }
+
+        size_t mPresents;
+};
+
+// no GL and nothing drawn - presents just count
+class NullRenderSurface :
+    public RenderSurface
+{
+    public:
+        NullRenderSurface(int width, int height) :
+            mWidth(width),
+            mHeight(height)
+        {
+        }
+
+        const char* name() const override
+        {
+            return "null";
+        }
+
+        bool hasGL() const override
+        {
+            return false;
+        }
+
+        void resize(int width, int height) override
+        {
+            mWidth = width;
+            mHeight = height;
+        }
+
+        void makeCurrent() override {}
+
+        void present() override
+        {
+            ++mPresents;
+        }
+
+        int width() const override
+        {
+            return mWidth;
+        }
+
+        int height() const override
+        {
+            return mHeight;
+        }
+
+    private:
+        int mWidth;
+        int mHeight;
+};
+
+#endif // _RENDER_SURFACE_H_
@@ -0,0 +1,52 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "resize_debouncer.h"
+
+#include <algorithm>
+#include <limits>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+ResizeDebouncer::ResizeDebouncer(double quiet_time, double max_delay) :
+    mQuietTime(quiet_time),
+    mMaxDelay(max_delay),
+    mFirstChange(-1.0),
+    mLastChange(-1.0)
+{
+}
+
+void ResizeDebouncer::resized(double now)
+{
+    if (mFirstChange < 0.0)
+    {
+        mFirstChange = now;
+    }
+    mLastChange = now;
+}
+
+bool ResizeDebouncer::due(double now) const
+{
+    return pending() && timeUntilDue(now) <= 0.0;
+}
+
+double ResizeDebouncer::timeUntilDue(double now) const
+{
+    if (! pending())
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    double due = std::min(mLastChange + mQuietTime, mFirstChange + mMaxDelay);
+    return std::max(due - now, 0.0);
+}
+
+void ResizeDebouncer::done()
+{
+    mFirstChange = -1.0;
+    mLastChange = -1.0;
+}
@@ -0,0 +1,48 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _RESIZE_DEBOUNCER_H_
+#define _RESIZE_DEBOUNCER_H_
+
+/////////////////////////////////////////////////////////////////////////////////
+// decides when to tell CEF a browser changed size (WasResized()) while its
+// window or panel is being dragged about. Every WasResized() makes the
+// renderer lay out and paint the whole page again, so a resize waits until
+// the size has stopped changing for quiet_time - but never more than
+// max_delay after the first change so the page keeps up during a long drag.
+// In between, the old page is stretched to fit. Times are in milliseconds
+// (PumpScheduler::now())
+class ResizeDebouncer
+{
+    public:
+        ResizeDebouncer(double quiet_time, double max_delay);
+
+        // the size changed
+        void resized(double now);
+
+        bool pending() const
+        {
+            return mFirstChange >= 0.0;
+        }
+
+        bool due(double now) const;
+
+        // how long until due() - infinity if nothing is pending
+        double timeUntilDue(double now) const;
+
+        // WasResized() was called
+        void done();
+
+    private:
+        double mQuietTime;
+        double mMaxDelay;
+        // -1 when nothing is pending
+        double mFirstChange;
+        double mLastChange;
+};
+
+#endif // _RESIZE_DEBOUNCER_H_
@@ -0,0 +1,547 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "resource_cache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+
+namespace
+{
+    // digits only, and no more than fit - false otherwise
+    bool parseNumber(const std::string& text, uint64_t& value)
+    {
+        if (text.empty() || text.size() > 19)
+        {
+            return false;
+        }
+
+        value = 0;
+        for (char c : text)
+        {
+            if (c < '0' || c > '9')
+            {
+                return false;
+            }
+            value = value * 10 + (uint64_t)(c - '0');
+        }
+        return true;
+    }
+
+    std::string trim(const std::string& text)
+    {
+        size_t first = text.find_first_not_of(" \t");
+        size_t last = text.find_last_not_of(" \t");
+        return (first == std::string::npos) ? std::string() : text.substr(first, last - first + 1);
+    }
+
+    int hexDigit(char c)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f')
+        {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F')
+        {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    // %20 and friends back to what they stand for
+    std::string unescape(const std::string& text)
+    {
+        std::string result;
+        result.reserve(text.size());
+        for (size_t i = 0; i < text.size(); ++i)
+        {
+            int high = (text[i] == '%' && i + 2 < text.size()) ? hexDigit(text[i + 1]) : -1;
+            int low = (high >= 0) ? hexDigit(text[i + 2]) : -1;
+            if (low >= 0)
+            {
+                result += (char)(high * 16 + low);
+                i += 2;
+            }
+            else
+            {
+                result += text[i];
+            }
+        }
+        return result;
+    }
+
+    std::string lowerCase(const std::string& text)
+    {
+        std::string result(text);
+        for (char& c : result)
+        {
+            c = (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+        }
+        return result;
+    }
+
+    // the first header called name (any case) - false if there isn't one
+    bool findHeader(const ResourceHeaders& headers, const char* name, std::string& value)
+    {
+        for (const auto& header : headers)
+        {
+            if (lowerCase(header.first) == name)
+            {
+                value = header.second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // "a, B ,c" as "a", "b" and "c"
+    std::vector<std::string> headerItems(const std::string& value)
+    {
+        std::vector<std::string> items;
+        size_t start = 0;
+        while (start <= value.size())
+        {
+            size_t comma = value.find(',', start);
+            std::string item = trim(value.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+            if (! item.empty())
+            {
+                items.push_back(lowerCase(item));
+            }
+            if (comma == std::string::npos)
+            {
+                break;
+            }
+            start = comma + 1;
+        }
+        return items;
+    }
+
+    // days from 1970-01-01 to year-month-day
+    int64_t daysFromCivil(int64_t year, int month, int day)
+    {
+        year -= (month <= 2) ? 1 : 0;
+        const int64_t era = (year >= 0 ? year : year - 399) / 400;
+        const int64_t year_of_era = year - era * 400;
+        const int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        const int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+        return era * 146097 + day_of_era - 719468;
+    }
+
+    // the same resource whatever fragment the page asked for it with
+    std::string withoutFragment(const std::string& url)
+    {
+        size_t hash = url.find('#');
+        return (hash == std::string::npos) ? url : url.substr(0, hash);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+ResourceCache::ResourceCache(size_t capacity, size_t max_entry) :
+    mCapacity(capacity),
+    mMaxEntry(max_entry),
+    mBytes(0)
+{
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+std::shared_ptr<const CachedResource> ResourceCache::find(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto found = mIndex.find(key);
+    if (found == mIndex.end())
+    {
+        ++mStats.misses;
+        return std::shared_ptr<const CachedResource>();
+    }
+
+    // to the front - it's the most recently used now
+    mEntries.splice(mEntries.begin(), mEntries, found->second);
+    ++mStats.hits;
+    return found->second->second;
+}
+
+void ResourceCache::remove(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto found = mIndex.find(key);
+    if (found != mIndex.end())
+    {
+        mBytes -= found->second->second->data.size();
+        mEntries.erase(found->second);
+        mIndex.erase(found);
+    }
+}
+
+bool ResourceCache::insert(const std::string& key, const std::shared_ptr<const CachedResource>& resource)
+{
+    size_t bytes = resource->data.size();
+    if (bytes > mMaxEntry || bytes > mCapacity)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    auto found = mIndex.find(key);
+    if (found != mIndex.end())
+    {
+        mBytes -= found->second->second->data.size();
+        mEntries.erase(found->second);
+        mIndex.erase(found);
+    }
+
+    while (mBytes + bytes > mCapacity && ! mEntries.empty())
+    {
+        evict(std::prev(mEntries.end()));
+    }
+
+    mEntries.push_front(std::make_pair(key, resource));
+    mIndex[key] = mEntries.begin();
+    mBytes += bytes;
+    ++mStats.inserts;
+    return true;
+}
+
+void ResourceCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mEntries.clear();
+    mIndex.clear();
+    mBytes = 0;
+}
+
+ResourceCacheStats ResourceCache::stats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    ResourceCacheStats stats = mStats;
+    stats.entries = mEntries.size();
+    stats.bytes = mBytes;
+    return stats;
+}
+
+void ResourceCache::evict(Entries::iterator entry)
+{
+    mBytes -= entry->second->data.size();
+    mIndex.erase(entry->first);
+    mEntries.erase(entry);
+    ++mStats.evictions;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+ByteRangeResult parseByteRange(const std::string& header, uint64_t size, uint64_t& first, uint64_t& length)
+{
+    std::string range = trim(header);
+    if (range.compare(0, 6, "bytes=") != 0 || range.find(',') != std::string::npos)
+    {
+        return RANGE_NONE;
+    }
+
+    range = trim(range.substr(6));
+    size_t dash = range.find('-');
+    if (dash == std::string::npos)
+    {
+        return RANGE_NONE;
+    }
+
+    std::string start_text = trim(range.substr(0, dash));
+    std::string end_text = trim(range.substr(dash + 1));
+    uint64_t start = 0;
+    uint64_t end = 0;
+
+    // the last n bytes
+    if (start_text.empty())
+    {
+        if (! parseNumber(end_text, end))
+        {
+            return RANGE_NONE;
+        }
+        if (end == 0 || size == 0)
+        {
+            return RANGE_UNSATISFIABLE;
+        }
+        length = (end < size) ? end : size;
+        first = size - length;
+        return RANGE_OK;
+    }
+
+    if (! parseNumber(start_text, start) || (! end_text.empty() && (! parseNumber(end_text, end) || end < start)))
+    {
+        return RANGE_NONE;
+    }
+    if (start >= size)
+    {
+        return RANGE_UNSATISFIABLE;
+    }
+
+    // an end past the end of the body (or none at all) means up to the end
+    end = (end_text.empty() || end >= size) ? size - 1 : end;
+    first = start;
+    length = end - start + 1;
+    return RANGE_OK;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+bool cacheLifetime(const ResourceHeaders& headers, double& seconds)
+{
+    bool has_max_age = false;
+    uint64_t max_age = 0;
+    for (const auto& header : headers)
+    {
+        const std::string name = lowerCase(header.first);
+        if (name == "cache-control" || name == "pragma")
+        {
+            for (const std::string& item : headerItems(header.second))
+            {
+                // no-cache="Set-Cookie" and private="..." are as good as the plain ones for us
+                if (item == "no-store" || item.compare(0, 8, "no-cache") == 0 || item.compare(0, 7, "private") == 0)
+                {
+                    return false;
+                }
+                if (item.compare(0, 8, "max-age=") == 0 && parseNumber(trim(item.substr(8)), max_age))
+                {
+                    has_max_age = true;
+                }
+            }
+        }
+        else if (name == "vary")
+        {
+            for (const std::string& item : headerItems(header.second))
+            {
+                if (item != "accept-encoding")
+                {
+                    return false;
+                }
+            }
+        }
+        else if (name == "set-cookie")
+        {
+            return false;
+        }
+    }
+
+    if (has_max_age)
+    {
+        seconds = (double)max_age;
+        return max_age > 0;
+    }
+
+    // Expires is against the server's clock - an Expires of "0" or anything else that isn't a date is in the past
+    std::string expires_text;
+    std::string date_text;
+    int64_t expires = 0;
+    int64_t date = 0;
+    if (! findHeader(headers, "expires", expires_text) || ! parseHttpDate(expires_text, expires))
+    {
+        return false;
+    }
+    if (! findHeader(headers, "date", date_text) || ! parseHttpDate(date_text, date))
+    {
+        date = (int64_t)time(nullptr);
+    }
+    seconds = (double)(expires - date);
+    return expires > date;
+}
+
+bool parseHttpDate(const std::string& text, int64_t& seconds)
+{
+    char weekday[4] = { 0 };
+    char month_name[4] = { 0 };
+    char zone[4] = { 0 };
+    int day = 0;
+    int year = 0;
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+    if (sscanf(text.c_str(), " %3[A-Za-z], %d %3[A-Za-z] %d %d:%d:%d %3s", weekday, &day, month_name, &year, &hour, &minute, &second, zone) != 8 ||
+        strcmp(zone, "GMT") != 0)
+    {
+        return false;
+    }
+
+    static const char* const kMonths[] = { "jan", "feb", "mar", "apr", "may", "jun", "jul", "aug", "sep", "oct", "nov", "dec" };
+    int month = 0;
+    while (month < 12 && lowerCase(month_name) != kMonths[month])
+    {
+        ++month;
+    }
+    if (month == 12 || day < 1 || day > 31 || year < 1970 || hour > 23 || minute > 59 || second > 60 || hour < 0 || minute < 0 || second < 0)
+    {
+        return false;
+    }
+
+    seconds = daysFromCivil(year, month + 1, day) * 86400 + hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+double resourceClock()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+LocalResources::LocalResources(size_t cache_bytes, size_t max_cached_response) :
+    mCache(cache_bytes, max_cached_response),
+    mPackHits(0),
+    mRangeRequests(0),
+    mExpired(0)
+{
+}
+
+bool LocalResources::openPack(const std::string& file_name, const std::string& origin)
+{
+    mPackOrigin = origin;
+    return mPack.open(file_name);
+}
+
+void LocalResources::setCacheOrigin(const std::string& origin)
+{
+    mCacheOrigin = origin;
+}
+
+bool LocalResources::cacheable(const std::string& url) const
+{
+    return mCache.capacity() > 0 && ! mCacheOrigin.empty() && url.compare(0, mCacheOrigin.size(), mCacheOrigin) == 0;
+}
+
+bool LocalResources::find(const std::string& url, const std::string& range_header, LocalResponse& response)
+{
+    std::string path;
+    Asset asset;
+    if (packPath(url, path) && mPack.find(path, asset))
+    {
+        ++mPackHits;
+        response.mimeType = asset.mimeType;
+        response.headers.clear();
+        response.keepAlive.reset();
+        response.fromPack = true;
+        respond(asset.data, asset.size, range_header, response);
+        return true;
+    }
+
+    if (! cacheable(url))
+    {
+        return false;
+    }
+
+    const std::string key = withoutFragment(url);
+    std::shared_ptr<const CachedResource> cached = mCache.find(key);
+    if (cached && cached->expires > 0.0 && cached->expires <= resourceClock())
+    {
+        mCache.remove(key);
+        ++mExpired;
+        cached.reset();
+    }
+    if (cached)
+    {
+        response.mimeType = cached->mimeType;
+        response.headers = cached->headers;
+        response.keepAlive = cached;
+        response.fromPack = false;
+        respond(cached->data.data(), cached->data.size(), range_header, response);
+        return true;
+    }
+
+    return false;
+}
+
+void LocalResources::store(const std::string& url, const std::string& mime_type, const ResourceHeaders& headers, double lifetime,
+                           std::vector<unsigned char>&& data)
+{
+    if (! cacheable(url) || lifetime <= 0.0)
+    {
+        return;
+    }
+
+    std::shared_ptr<CachedResource> resource = std::make_shared<CachedResource>();
+    resource->mimeType = mime_type;
+    resource->headers = headers;
+    resource->expires = resourceClock() + lifetime;
+    resource->data.swap(data);
+    mCache.insert(withoutFragment(url), resource);
+}
+
+bool LocalResources::packPath(const std::string& url, std::string& path) const
+{
+    if (! mPack.isOpen() || mPackOrigin.empty() || url.compare(0, mPackOrigin.size(), mPackOrigin) != 0)
+    {
+        return false;
+    }
+
+    // the query and fragment aren't part of the file's name
+    path = url.substr(mPackOrigin.size());
+    path = path.substr(0, path.find_first_of("?#"));
+    path = unescape(path);
+    while (! path.empty() && path[0] == '/')
+    {
+        path.erase(0, 1);
+    }
+    if (path.empty() || path[path.size() - 1] == '/')
+    {
+        path += "index.html";
+    }
+    return true;
+}
+
+LocalResourceStats LocalResources::stats() const
+{
+    LocalResourceStats stats;
+    stats.packHits = mPackHits.load();
+    stats.rangeRequests = mRangeRequests.load();
+    stats.expired = mExpired.load();
+    stats.cache = mCache.stats();
+    return stats;
+}
+
+void LocalResources::respond(const unsigned char* data, uint64_t size, const std::string& range_header, LocalResponse& response)
+{
+    response.totalSize = size;
+    response.contentRange.clear();
+
+    uint64_t first = 0;
+    uint64_t length = size;
+    ByteRangeResult range = range_header.empty() ? RANGE_NONE : parseByteRange(range_header, size, first, length);
+    if (range != RANGE_NONE)
+    {
+        ++mRangeRequests;
+    }
+
+    if (range == RANGE_UNSATISFIABLE)
+    {
+        response.status = 416;
+        response.data = data;
+        response.length = 0;
+        response.contentRange = "bytes */" + std::to_string(size);
+    }
+    else if (range == RANGE_OK)
+    {
+        response.status = 206;
+        response.data = data + first;
+        response.length = length;
+        response.contentRange = "bytes " + std::to_string(first) + "-" + std::to_string(first + length - 1) + "/" + std::to_string(size);
+    }
+    else
+    {
+        response.status = 200;
+        response.data = data;
+        response.length = size;
+    }
+}
@@ -0,0 +1,201 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _RESOURCE_CACHE_H_
+#define _RESOURCE_CACHE_H_
+
+#include "asset_pack.h"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// a response's headers, name and value, as they came
+typedef std::vector<std::pair<std::string, std::string>> ResourceHeaders;
+
+/////////////////////////////////////////////////////////////////////////////////
+// a response that came from the network, kept in memory - headers are sent
+// again with the body so CORS, charsets and the like survive the cache
+struct CachedResource
+{
+    std::string mimeType;
+    ResourceHeaders headers;
+    // when it goes stale, in resourceClock() seconds - 0 never does
+    double expires;
+    std::vector<unsigned char> data;
+};
+
+struct ResourceCacheStats
+{
+    size_t hits;
+    size_t misses;
+    size_t inserts;
+    size_t evictions;
+    size_t entries;
+    size_t bytes;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// the most recently used responses, up to a number of bytes - the least
+// recently used ones go to make room. Anything can call it from any thread.
+// What find() hands out stays good after it's been evicted for as long as
+// someone holds on to it
+class ResourceCache
+{
+    public:
+        // capacity 0 keeps nothing, responses bigger than max_entry aren't kept
+        ResourceCache(size_t capacity, size_t max_entry);
+
+        std::shared_ptr<const CachedResource> find(const std::string& key);
+
+        // nothing if key isn't there
+        void remove(const std::string& key);
+
+        // false if it's too big to keep - replaces whatever was there for key
+        bool insert(const std::string& key, const std::shared_ptr<const CachedResource>& resource);
+
+        void clear();
+
+        size_t capacity() const
+        {
+            return mCapacity;
+        }
+
+        ResourceCacheStats stats() const;
+
+    private:
+        typedef std::list<std::pair<std::string, std::shared_ptr<const CachedResource>>> Entries;
+
+        void evict(Entries::iterator entry);
+
+        const size_t mCapacity;
+        const size_t mMaxEntry;
+
+        mutable std::mutex mMutex;
+        // most recently used at the front
+        Entries mEntries;
+        std::unordered_map<std::string, Entries::iterator> mIndex;
+        size_t mBytes;
+        ResourceCacheStats mStats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// a Range header ("bytes=100-199", "bytes=100-", "bytes=-100") against a body of
+// size bytes. Anything we don't handle - more than one range, other units,
+// nonsense - is RANGE_NONE and gets the whole body, which HTTP allows
+enum ByteRangeResult
+{
+    RANGE_NONE,
+    RANGE_OK,
+    RANGE_UNSATISFIABLE
+};
+
+ByteRangeResult parseByteRange(const std::string& header, uint64_t size, uint64_t& first, uint64_t& length);
+
+/////////////////////////////////////////////////////////////////////////////////
+// how many seconds a 200 response can be served from the cache for, going by
+// its headers. Only what says it can be - Cache-Control max-age, or Expires -
+// is kept; false for anything else, and for no-store, no-cache, private,
+// Set-Cookie and a Vary on anything but Accept-Encoding (the body we keep is
+// already decoded)
+bool cacheLifetime(const ResourceHeaders& headers, double& seconds);
+
+// an HTTP date ("Sun, 06 Nov 1994 08:49:37 GMT") in seconds since 1970 - false
+// if it isn't one
+bool parseHttpDate(const std::string& text, int64_t& seconds);
+
+// seconds, from a clock that only goes forwards
+double resourceClock();
+
+/////////////////////////////////////////////////////////////////////////////////
+// the answer to a GET we had locally
+struct LocalResponse
+{
+    // 200, 206 for part of the body or 416 for a range past the end
+    int status;
+    std::string mimeType;
+    // the cached response's own headers - none from the pack
+    ResourceHeaders headers;
+    // the part of the body to send - good while the pack is open and keepAlive is held
+    const unsigned char* data;
+    uint64_t length;
+    // the whole body's size, and "bytes 100-199/1000" or "bytes */1000" for 206 and 416
+    uint64_t totalSize;
+    std::string contentRange;
+    std::shared_ptr<const CachedResource> keepAlive;
+    bool fromPack;
+};
+
+struct LocalResourceStats
+{
+    size_t packHits;
+    size_t rangeRequests;
+    // cache hits that had gone stale and were fetched again
+    size_t expired;
+    ResourceCacheStats cache;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// where requests are answered from before they go to the network. URLs under
+// the asset pack's origin are served from the pack; URLs under the cache's
+// origin from responses we've fetched before that said they could be kept (see
+// cacheLifetime()). Everything else goes to the network as it always would -
+// the cache needs the whole body before it can answer, which a stream or a long
+// poll never finishes
+class LocalResources
+{
+    public:
+        LocalResources(size_t cache_bytes, size_t max_cached_response);
+
+        // origin is what the pack's paths are relative to, e.g. "https://example.com/app/" - false if the
+        // pack can't be opened
+        bool openPack(const std::string& file_name, const std::string& origin);
+
+        // what the cache keeps responses for, e.g. "https://example.com/static/" - empty (the default) for
+        // nothing
+        void setCacheOrigin(const std::string& origin);
+
+        // url is one the cache fetches and keeps (see store())
+        bool cacheable(const std::string& url) const;
+
+        // a GET of url - range_header is its Range header, empty for none. False if we don't have it
+        bool find(const std::string& url, const std::string& range_header, LocalResponse& response);
+
+        // a complete 200 response fetched from the network, to be served for the next lifetime seconds
+        // (see cacheLifetime())
+        void store(const std::string& url, const std::string& mime_type, const ResourceHeaders& headers, double lifetime,
+                   std::vector<unsigned char>&& data);
+
+        // url's path in the pack - false if it isn't under the pack's origin
+        bool packPath(const std::string& url, std::string& path) const;
+
+        const AssetPack& pack() const
+        {
+            return mPack;
+        }
+
+        LocalResourceStats stats() const;
+
+    private:
+        void respond(const unsigned char* data, uint64_t size, const std::string& range_header, LocalResponse& response);
+
+        AssetPack mPack;
+        std::string mPackOrigin;
+        std::string mCacheOrigin;
+        ResourceCache mCache;
+
+        std::atomic<size_t> mPackHits;
+        std::atomic<size_t> mRangeRequests;
+        std::atomic<size_t> mExpired;
+};
+
+#endif // _RESOURCE_CACHE_H_
@@ -0,0 +1,359 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "texture_atlas.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    // empty texels around each surface so linear filtering doesn't pick up the neighbours
+    const int kPadding = 1;
+
+    // only repack if everything would fit in this fraction of the pages we already have -
+    // otherwise we'd repack on every allocation once the pages are genuinely full
+    const double kRepackOccupancy = 0.85;
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+TextureAtlas::TextureAtlas(int page_size, TextureLayout layout) :
+    mPageSize(page_size),
+    mLayout(layout),
+    mCopyFramebuffer(0)
+{
+    GLint max_texture_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    if (max_texture_size > 0 && mPageSize > max_texture_size)
+    {
+        mPageSize = max_texture_size;
+    }
+}
+
+TextureAtlas::~TextureAtlas()
+{
+    for (Page& page : mPages)
+    {
+        glDeleteTextures(1, &page.texture);
+    }
+
+    if (mCopyFramebuffer != 0)
+    {
+        gGL.deleteFramebuffers(1, &mCopyFramebuffer);
+    }
+}
+
+int TextureAtlas::allocate(int width, int height)
+{
+    // reuse a released slot if there is one
+    size_t handle = 0;
+    while (handle < mEntries.size() && mEntries[handle].live)
+    {
+        ++handle;
+    }
+    if (handle == mEntries.size())
+    {
+        mEntries.push_back(Entry());
+    }
+
+    Entry& entry = mEntries[handle];
+    entry.live = true;
+    entry.page = -1;
+    entry.rect = Rect(0, 0, width, height);
+    entry.capacityWidth = width;
+    entry.capacityHeight = height;
+
+    resize((int)handle, width, height);
+    return (int)handle;
+}
+
+void TextureAtlas::resize(int handle, int width, int height)
+{
+    Entry& entry = mEntries[handle];
+
+    // still fits in the space we have - nothing moves
+    if (entry.page >= 0 && width <= entry.capacityWidth && height <= entry.capacityHeight)
+    {
+        entry.rect.width = width;
+        entry.rect.height = height;
+        return;
+    }
+
+    // the old space is lost until the next repack - the surface is repainted at the new size so there's nothing to copy
+    entry.page = -1;
+    entry.rect = Rect(0, 0, width, height);
+    entry.capacityWidth = std::max(width, entry.capacityWidth);
+    entry.capacityHeight = std::max(height, entry.capacityHeight);
+
+    for (size_t i = 0; i < mPages.size(); ++i)
+    {
+        int x = 0;
+        int y = 0;
+        if (mPages[i].packer.pack(entry.capacityWidth + kPadding, entry.capacityHeight + kPadding, x, y))
+        {
+            entry.page = (int)i;
+            entry.rect.x = x;
+            entry.rect.y = y;
+            return;
+        }
+    }
+
+    // no room - see if packing everything again would make some, otherwise start a new page
+    size_t live_area = 0;
+    for (const Entry& other : mEntries)
+    {
+        if (other.live)
+        {
+            live_area += (size_t)(other.capacityWidth + kPadding) * (other.capacityHeight + kPadding);
+        }
+    }
+
+    size_t page_area = 0;
+    for (const Page& page : mPages)
+    {
+        page_area += (size_t)page.packer.width() * page.packer.height();
+    }
+
+    if (! mPages.empty() && live_area <= page_area * kRepackOccupancy)
+    {
+        repack();
+    }
+    else
+    {
+        place(entry, mPages);
+    }
+}
+
+void TextureAtlas::release(int handle)
+{
+    mEntries[handle].live = false;
+    mEntries[handle].page = -1;
+}
+
+void TextureAtlas::addQuad(int handle, const Rect& screen_rect)
+{
+    const Entry& entry = mEntries[handle];
+    if (entry.page < 0)
+    {
+        return;
+    }
+
+    Page& page = mPages[entry.page];
+    float page_width = (float)page.packer.width();
+    float page_height = (float)page.packer.height();
+
+    float u0 = entry.rect.x / page_width;
+    float v0 = entry.rect.y / page_height;
+    float u1 = (entry.rect.x + entry.rect.width) / page_width;
+    float v1 = (entry.rect.y + entry.rect.height) / page_height;
+
+    float left = (float)screen_rect.x;
+    float top = (float)screen_rect.y;
+    float right = (float)(screen_rect.x + screen_rect.width);
+    float bottom = (float)(screen_rect.y + screen_rect.height);
+
+    // same winding and texture orientation as the single texture quad
+    const float quad[] =
+    {
+        right, top, u1, v0,
+        left, top, u0, v0,
+        left, bottom, u0, v1,
+        right, bottom, u1, v1
+    };
+    page.vertices.insert(page.vertices.end(), quad, quad + sizeof(quad) / sizeof(quad[0]));
+}
+
+TexturedQuad TextureAtlas::quad(int handle, const Rect& screen_rect) const
+{
+    const Entry& entry = mEntries[handle];
+    if (entry.page < 0)
+    {
+        return TexturedQuad();
+    }
+
+    const Page& page = mPages[entry.page];
+    float page_width = (float)page.packer.width();
+    float page_height = (float)page.packer.height();
+
+    return TexturedQuad(page.texture, screen_rect, entry.rect.x / page_width, entry.rect.y / page_height,
+                        (entry.rect.x + entry.rect.width) / page_width, (entry.rect.y + entry.rect.height) / page_height);
+}
+
+void TextureAtlas::draw()
+{
+    const GLsizei stride = 4 * sizeof(float);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    for (Page& page : mPages)
+    {
+        if (page.vertices.empty())
+        {
+            continue;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, page.texture);
+        glVertexPointer(2, GL_FLOAT, stride, &page.vertices[0]);
+        glTexCoordPointer(2, GL_FLOAT, stride, &page.vertices[2]);
+        glDrawArrays(GL_QUADS, 0, (GLsizei)(page.vertices.size() / 4));
+        ++mStats.drawCalls;
+
+        page.vertices.clear();
+    }
+
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+size_t TextureAtlas::memoryUsage() const
+{
+    size_t bytes = 0;
+    for (const Page& page : mPages)
+    {
+        bytes += (size_t)page.packer.width() * page.packer.height() * kDepth;
+    }
+    return bytes;
+}
+
+void TextureAtlas::place(Entry& entry, std::vector<Page>& pages)
+{
+    int width = entry.capacityWidth + kPadding;
+    int height = entry.capacityHeight + kPadding;
+
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        int x = 0;
+        int y = 0;
+        if (pages[i].packer.pack(width, height, x, y))
+        {
+            entry.page = (int)i;
+            entry.rect.x = x;
+            entry.rect.y = y;
+            return;
+        }
+    }
+
+    addPage(pages, width, height);
+
+    int x = 0;
+    int y = 0;
+    pages.back().packer.pack(width, height, x, y);
+    entry.page = (int)pages.size() - 1;
+    entry.rect.x = x;
+    entry.rect.y = y;
+}
+
+void TextureAtlas::addPage(std::vector<Page>& pages, int min_width, int min_height)
+{
+    Page page;
+    page.packer = AtlasPacker(std::max(mPageSize, min_width), std::max(mPageSize, min_height));
+
+    page.texture = createPageTexture(page.packer.width(), page.packer.height(), mLayout);
+
+    pages.push_back(page);
+}
+
+void TextureAtlas::repack()
+{
+    ++mStats.repacks;
+
+    std::vector<Page> old_pages;
+    old_pages.swap(mPages);
+
+    // tallest first packs best with a skyline
+    std::vector<size_t> order;
+    for (size_t i = 0; i < mEntries.size(); ++i)
+    {
+        if (mEntries[i].live)
+        {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b)
+    {
+        return mEntries[a].capacityHeight > mEntries[b].capacityHeight;
+    });
+
+    bool can_copy = gGL.hasFramebuffers();
+    GLint previous_framebuffer = 0;
+    if (can_copy)
+    {
+        if (mCopyFramebuffer == 0)
+        {
+            gGL.genFramebuffers(1, &mCopyFramebuffer);
+        }
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_framebuffer);
+        gGL.bindFramebuffer(GL_FRAMEBUFFER, mCopyFramebuffer);
+    }
+    else
+    {
+        std::cout << "TextureAtlas: no framebuffer objects - surfaces will be blank until they next repaint" << std::endl;
+    }
+
+    for (size_t index : order)
+    {
+        Entry& entry = mEntries[index];
+        int old_page = entry.page;
+        Rect old_rect = entry.rect;
+
+        place(entry, mPages);
+
+        // move what is already on the GPU across so the surface doesn't have to be uploaded again
+        if (can_copy && old_page >= 0)
+        {
+            gGL.framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, old_pages[old_page].texture, 0);
+            glBindTexture(GL_TEXTURE_2D, mPages[entry.page].texture);
+            glCopyTexSubImage2D(GL_TEXTURE_2D, 0, entry.rect.x, entry.rect.y, old_rect.x, old_rect.y, old_rect.width, old_rect.height);
+        }
+    }
+
+    if (can_copy)
+    {
+        gGL.framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        gGL.bindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer);
+    }
+
+    for (Page& page : old_pages)
+    {
+        glDeleteTextures(1, &page.texture);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+AtlasUploadBackend::AtlasUploadBackend(TextureAtlas* atlas, int width, int height) :
+    mAtlas(atlas),
+    mHandle(atlas->allocate(width, height))
+{
+}
+
+AtlasUploadBackend::~AtlasUploadBackend()
+{
+    mAtlas->release(mHandle);
+}
+
+void AtlasUploadBackend::resize(int width, int height)
+{
+    mAtlas->resize(mHandle, width, height);
+}
+
+void AtlasUploadBackend::upload(const Rect& rect, const unsigned char* pixels, int stride)
+{
+    const Rect& slot = mAtlas->rect(mHandle);
+
+    glBindTexture(GL_TEXTURE_2D, mAtlas->pageTexture(mAtlas->page(mHandle)));
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, stride);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, slot.x + rect.x, slot.y + rect.y, rect.width, rect.height, pageUploadFormat(mAtlas->layout()), GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+size_t AtlasUploadBackend::memoryUsage() const
+{
+    return mAtlas->rect(mHandle).area() * kDepth;
+}
@@ -0,0 +1,153 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _TEXTURE_ATLAS_H_
+#define _TEXTURE_ATLAS_H_
+
+#include "atlas_packer.h"
+#include "compositor.h"
+#include "gl_functions.h"
+#include "gl_renderer.h"
+
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// packs lots of browser surfaces into a few big textures (pages) so they can
+// all be drawn with one draw call per page instead of a texture bind and a
+// draw call per surface. When a surface grows and there's no room for it, every
+// surface is packed again from scratch and the pixels already on the GPU are
+// copied across to their new home (needs framebuffer objects)
+struct AtlasStats
+{
+    AtlasStats() :
+        repacks(0),
+        drawCalls(0)
+    {
+    }
+
+    size_t repacks;
+    size_t drawCalls;
+};
+
+class TextureAtlas
+{
+    public:
+        // page_size is capped at GL_MAX_TEXTURE_SIZE - surfaces bigger than a page get a page to themselves.
+        // Pages never change size once they're made so they can be immutable (TEXTURE_SWIZZLED)
+        TextureAtlas(int page_size, TextureLayout layout = TEXTURE_BGRA);
+        ~TextureAtlas();
+
+        // returns a handle used to refer to the surface from now on
+        int allocate(int width, int height);
+        void resize(int handle, int width, int height);
+        void release(int handle);
+
+        // where the surface lives - page index and the texels it occupies
+        int page(int handle) const
+        {
+            return mEntries[handle].page;
+        }
+
+        const Rect& rect(int handle) const
+        {
+            return mEntries[handle].rect;
+        }
+
+        GLuint pageTexture(int page) const
+        {
+            return mPages[page].texture;
+        }
+
+        size_t numPages() const
+        {
+            return mPages.size();
+        }
+
+        TextureLayout layout() const
+        {
+            return mLayout;
+        }
+
+        // queue a surface to be drawn at screen_rect - nothing is drawn until draw()
+        void addQuad(int handle, const Rect& screen_rect);
+
+        // one draw call per page that has quads queued - fixed function GL, so TEXTURE_BGRA pages only
+        void draw();
+
+        // the surface at screen_rect for a QuadRenderer instead - surfaces next to each other on a page
+        // go in the same batch
+        TexturedQuad quad(int handle, const Rect& screen_rect) const;
+
+        // bytes of texture memory for all the pages
+        size_t memoryUsage() const;
+
+        const AtlasStats& stats() const
+        {
+            return mStats;
+        }
+
+    private:
+        struct Entry
+        {
+            Entry() : live(false), page(-1), capacityWidth(0), capacityHeight(0) {}
+
+            bool live;
+            int page;
+            Rect rect;
+            // the space reserved for the surface - it can shrink without moving
+            int capacityWidth;
+            int capacityHeight;
+        };
+
+        struct Page
+        {
+            Page() : texture(0), packer(0, 0) {}
+
+            GLuint texture;
+            AtlasPacker packer;
+            std::vector<float> vertices;
+        };
+
+        // find room for an entry in the existing pages, adding a page if needed
+        void place(Entry& entry, std::vector<Page>& pages);
+        void addPage(std::vector<Page>& pages, int min_width, int min_height);
+        void repack();
+
+        int mPageSize;
+        TextureLayout mLayout;
+        std::vector<Entry> mEntries;
+        std::vector<Page> mPages;
+        GLuint mCopyFramebuffer;
+
+        AtlasStats mStats;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// a browser's upload backend when it lives in an atlas - uploads go into the
+// surface's rectangle of the page texture
+class AtlasUploadBackend :
+    public UploadBackend
+{
+    public:
+        AtlasUploadBackend(TextureAtlas* atlas, int width, int height);
+        ~AtlasUploadBackend();
+
+        void resize(int width, int height) override;
+        void upload(const Rect& rect, const unsigned char* pixels, int stride) override;
+        size_t memoryUsage() const override;
+
+        int handle() const
+        {
+            return mHandle;
+        }
+
+    private:
+        TextureAtlas* mAtlas;
+        int mHandle;
+};
+
+#endif // _TEXTURE_ATLAS_H_
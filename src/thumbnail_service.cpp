@@ -0,0 +1,258 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "thumbnail_service.h"
+#include "instrument.h"
+#include "pixel_kernels.h"
+
+#include <cstring>
+#include <limits>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+ThumbnailService::ThumbnailService(const ThumbnailSettings& settings) :
+    mSettings(settings),
+    mNextSequence(0),
+    mStopping(false)
+{
+    mWorker = std::thread(&ThumbnailService::workerThread, this);
+}
+
+ThumbnailService::~ThumbnailService()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mJobReady.notify_all();
+    mWorker.join();
+}
+
+void ThumbnailService::damage(int id, const unsigned char* pixels, int width, int height, const RectList& dirty_rects)
+{
+    if (pixels == nullptr || width <= 0 || height <= 0)
+    {
+        return;
+    }
+
+    INSTRUMENT_SCOPE("thumbnail.damage");
+    Source& source = mSources[id];
+
+    // a new size is a new page - all of it is taken whatever CEF says is dirty
+    if (width != source.width || height != source.height)
+    {
+        source.width = width;
+        source.height = height;
+        source.pixels.assign(pixels, pixels + (size_t)width * height * kDepth);
+        source.changed = true;
+        return;
+    }
+
+    for (const Rect& dirty_rect : dirty_rects)
+    {
+        Rect rect = intersectRect(dirty_rect, Rect(0, 0, width, height));
+        if (rect.isEmpty())
+        {
+            continue;
+        }
+
+        for (int y = rect.y; y < rect.y + rect.height; ++y)
+        {
+            size_t offset = ((size_t)y * width + rect.x) * kDepth;
+            memcpy(source.pixels.data() + offset, pixels + offset, (size_t)rect.width * kDepth);
+        }
+        source.changed = true;
+    }
+}
+
+void ThumbnailService::tick(double now)
+{
+    for (std::map<int, Source>::iterator it = mSources.begin(); it != mSources.end(); ++it)
+    {
+        Source& source = it->second;
+        if (! source.changed || now - source.lastSnapshot < mSettings.interval)
+        {
+            continue;
+        }
+
+        Job job;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mBusy.count(it->first) != 0)
+            {
+                ++mStats.deferred;
+                continue;
+            }
+            mBusy.insert(it->first);
+
+            if (! mFreeBuffers.empty())
+            {
+                job.pixels.swap(mFreeBuffers.back());
+                mFreeBuffers.pop_back();
+            }
+        }
+
+        // the copy is made without the lock so the worker can carry on
+        INSTRUMENT_SCOPE("thumbnail.snapshot");
+        job.id = it->first;
+        job.sequence = mNextSequence++;
+        job.time = now;
+        job.width = source.width;
+        job.height = source.height;
+        job.pixels.assign(source.pixels.begin(), source.pixels.end());
+
+        source.changed = false;
+        source.lastSnapshot = now;
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mJobs.push_back(Job());
+            mJobs.back().id = job.id;
+            mJobs.back().sequence = job.sequence;
+            mJobs.back().time = job.time;
+            mJobs.back().width = job.width;
+            mJobs.back().height = job.height;
+            mJobs.back().pixels.swap(job.pixels);
+        }
+        mJobReady.notify_one();
+    }
+}
+
+double ThumbnailService::timeUntilDue(double now) const
+{
+    double wait = std::numeric_limits<double>::infinity();
+    for (std::map<int, Source>::const_iterator it = mSources.begin(); it != mSources.end(); ++it)
+    {
+        if (it->second.changed)
+        {
+            double due = it->second.lastSnapshot + mSettings.interval - now;
+            wait = (due < wait) ? due : wait;
+        }
+    }
+    return (wait < 0.0) ? 0.0 : wait;
+}
+
+void ThumbnailService::remove(int id)
+{
+    mSources.erase(id);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mLatest.erase(id);
+    mRemovedBefore[id] = mNextSequence;
+}
+
+std::shared_ptr<const Thumbnail> ThumbnailService::latest(int id) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::map<int, std::shared_ptr<const Thumbnail> >::const_iterator it = mLatest.find(id);
+    return (it != mLatest.end()) ? it->second : std::shared_ptr<const Thumbnail>();
+}
+
+ThumbnailStats ThumbnailService::stats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+void ThumbnailService::workerThread()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mJobReady.wait(lock, [this]()
+            {
+                return mStopping || ! mJobs.empty();
+            });
+            if (mStopping)
+            {
+                return;
+            }
+
+            job.id = mJobs.front().id;
+            job.sequence = mJobs.front().sequence;
+            job.time = mJobs.front().time;
+            job.width = mJobs.front().width;
+            job.height = mJobs.front().height;
+            job.pixels.swap(mJobs.front().pixels);
+            mJobs.pop_front();
+        }
+
+        uint64_t start = instrumentNow();
+        std::shared_ptr<Thumbnail> thumbnail = makeThumbnail(job);
+        uint64_t downsampled = instrumentNow();
+
+        if (mSettings.format != IMAGE_NONE && ! thumbnail->levels.empty())
+        {
+            INSTRUMENT_SCOPE("thumbnail.encode");
+            int level = (mSettings.encodeLevel < 0 || mSettings.encodeLevel >= (int)thumbnail->levels.size()) ? (int)thumbnail->levels.size() - 1 : mSettings.encodeLevel;
+            const ThumbnailLevel& encoded = thumbnail->levels[level];
+            thumbnail->format = encodeImage(mSettings.format, encoded.pixels.data(), encoded.width, encoded.height, thumbnail->encoded) ? mSettings.format : IMAGE_NONE;
+        }
+        uint64_t encoded = instrumentNow();
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBusy.erase(job.id);
+        mFreeBuffers.push_back(std::vector<unsigned char>());
+        mFreeBuffers.back().swap(job.pixels);
+
+        // the browser went while this was being made
+        std::map<int, uint64_t>::const_iterator removed = mRemovedBefore.find(job.id);
+        if (removed == mRemovedBefore.end() || job.sequence >= removed->second)
+        {
+            mLatest[job.id] = thumbnail;
+        }
+
+        ++mStats.thumbnails;
+        mStats.downsampleSeconds += (downsampled - start) / 1.0e9;
+        mStats.encodeSeconds += (encoded - downsampled) / 1.0e9;
+        mStats.pixelsDownsampled += (uint64_t)job.width * job.height;
+        mStats.bytesEncoded += thumbnail->encoded.size();
+    }
+}
+
+std::shared_ptr<Thumbnail> ThumbnailService::makeThumbnail(const Job& job)
+{
+    INSTRUMENT_SCOPE("thumbnail.downsample");
+    const PixelKernels& kernels = pixelKernels();
+
+    std::shared_ptr<Thumbnail> thumbnail(new Thumbnail);
+    thumbnail->id = job.id;
+    thumbnail->sequence = job.sequence;
+    thumbnail->time = job.time;
+    thumbnail->width = job.width;
+    thumbnail->height = job.height;
+    thumbnail->format = IMAGE_NONE;
+
+    // each level is half of the one before
+    const unsigned char* src = job.pixels.data();
+    int width = job.width;
+    int height = job.height;
+    for (int level = 0; level < mSettings.levels && (width > 1 || height > 1); ++level)
+    {
+        ThumbnailLevel half;
+        half.width = (width + 1) / 2;
+        half.height = (height + 1) / 2;
+        half.pixels.resize((size_t)half.width * half.height * kDepth);
+
+        for (int y = 0; y < half.height; ++y)
+        {
+            const unsigned char* row0 = src + (size_t)y * 2 * width * kDepth;
+            // the last row of an odd height pairs up with itself
+            const unsigned char* row1 = (y * 2 + 1 < height) ? row0 + (size_t)width * kDepth : row0;
+            kernels.downsampleRow(half.pixels.data() + (size_t)y * half.width * kDepth, row0, row1, width);
+        }
+
+        thumbnail->levels.push_back(std::move(half));
+        src = thumbnail->levels.back().pixels.data();
+        width = thumbnail->levels.back().width;
+        height = thumbnail->levels.back().height;
+    }
+
+    return thumbnail;
+}
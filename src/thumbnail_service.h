@@ -0,0 +1,192 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _THUMBNAIL_SERVICE_H_
+#define _THUMBNAIL_SERVICE_H_
+
+#include "compositor.h"
+#include "image_encoder.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+struct ThumbnailSettings
+{
+    ThumbnailSettings() :
+        levels(3),
+        interval(250.0),
+        format(IMAGE_NONE),
+        encodeLevel(-1)
+    {
+    }
+
+    // how many times the page is halved - 3 gives a half, a quarter and an eighth (fewer if it gets
+    // down to a single pixel first)
+    int levels;
+    // milliseconds between thumbnails of a browser however often it paints
+    double interval;
+    // a level can be encoded as well (see image_encoder.h) - encodeLevel is which one, -1 for the smallest
+    ImageFormat format;
+    int encodeLevel;
+};
+
+// premultiplied BGRA like the page it came from
+struct ThumbnailLevel
+{
+    int width;
+    int height;
+    std::vector<unsigned char> pixels;
+};
+
+struct Thumbnail
+{
+    int id;
+    // thumbnails of the same browser are made in this order
+    uint64_t sequence;
+    // when the page looked like this (the now passed to tick())
+    double time;
+    // the size of the page
+    int width;
+    int height;
+    // biggest first
+    std::vector<ThumbnailLevel> levels;
+    // empty when the format is IMAGE_NONE
+    ImageFormat format;
+    std::vector<unsigned char> encoded;
+};
+
+struct ThumbnailStats
+{
+    ThumbnailStats() :
+        thumbnails(0),
+        deferred(0),
+        downsampleSeconds(0.0),
+        encodeSeconds(0.0),
+        pixelsDownsampled(0),
+        bytesEncoded(0)
+    {
+    }
+
+    size_t thumbnails;
+    // times a browser's thumbnail was due while the worker still had its last one - it's made on a later tick()
+    size_t deferred;
+    double downsampleSeconds;
+    double encodeSeconds;
+    // page pixels the levels were made from
+    uint64_t pixelsDownsampled;
+    uint64_t bytesEncoded;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// small copies of each browser's page for showing lots of browsers as tiles,
+// made on a worker thread of its own. The paint path hands over the parts of
+// a page that changed with damage(), which keeps a copy of the page up to date
+// (the way VideoCapture does), and the main loop calls tick() - a browser
+// that changed, and hasn't had a thumbnail for interval, gets a snapshot of
+// its copy sent to the worker. The worker halves it levels times with the
+// SIMD box filter (see downsampleRow() in pixel_kernels.h), encodes a level if
+// there's a format and makes it the browser's latest(). damage() and tick()
+// never wait for the worker - a browser whose last snapshot is still being
+// worked on waits for a later tick() - and latest() only holds a lock long
+// enough to copy a pointer. damage(), tick() and remove() have to be called
+// from one thread, latest() and stats() from any. Times are in milliseconds
+// (PumpScheduler::now())
+class ThumbnailService
+{
+    public:
+        ThumbnailService(const ThumbnailSettings& settings = ThumbnailSettings());
+        ~ThumbnailService();
+
+        // the page changed - pixels is the whole page, width pixels to a row
+        void damage(int id, const unsigned char* pixels, int width, int height, const RectList& dirty_rects);
+
+        // snapshot the browsers that are due
+        void tick(double now);
+
+        // how long until a browser is due - infinity if none has changed
+        double timeUntilDue(double now) const;
+
+        // forget a browser - its thumbnails go, including one the worker's still making
+        void remove(int id);
+
+        // the newest thumbnail of a browser - null if it doesn't have one yet
+        std::shared_ptr<const Thumbnail> latest(int id) const;
+
+        const ThumbnailSettings& settings() const
+        {
+            return mSettings;
+        }
+
+        ThumbnailStats stats() const;
+
+    private:
+        ThumbnailService(const ThumbnailService&);
+        ThumbnailService& operator=(const ThumbnailService&);
+
+        // the copy of a page damage() keeps up to date
+        struct Source
+        {
+            Source() :
+                width(0),
+                height(0),
+                changed(false),
+                lastSnapshot(0.0)
+            {
+            }
+
+            int width;
+            int height;
+            std::vector<unsigned char> pixels;
+            bool changed;
+            double lastSnapshot;
+        };
+
+        struct Job
+        {
+            int id;
+            uint64_t sequence;
+            double time;
+            int width;
+            int height;
+            std::vector<unsigned char> pixels;
+        };
+
+        void workerThread();
+        std::shared_ptr<Thumbnail> makeThumbnail(const Job& job);
+
+        ThumbnailSettings mSettings;
+
+        // only touched by the thread calling damage() and tick()
+        std::map<int, Source> mSources;
+        uint64_t mNextSequence;
+
+        mutable std::mutex mMutex;
+        std::condition_variable mJobReady;
+        bool mStopping;
+        std::deque<Job> mJobs;
+        // browsers with a snapshot queued or being worked on
+        std::set<int> mBusy;
+        // the first sequence that's still wanted for a browser that was removed
+        std::map<int, uint64_t> mRemovedBefore;
+        // snapshot buffers the worker is done with
+        std::vector<std::vector<unsigned char> > mFreeBuffers;
+        std::map<int, std::shared_ptr<const Thumbnail> > mLatest;
+        ThumbnailStats mStats;
+
+        std::thread mWorker;
+};
+
+#endif // _THUMBNAIL_SERVICE_H_
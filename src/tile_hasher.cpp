@@ -0,0 +1,176 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "tile_hasher.h"
+#include "instrument.h"
+#include "pixel_kernels.h"
+
+#include <algorithm>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+TileHasher::TileHasher(int tile_size) :
+    mTileSize(tile_size),
+    mWidth(0),
+    mHeight(0),
+    mColumns(0),
+    mRows(0),
+    mGeneration(0)
+{
+}
+
+void TileHasher::resize(int width, int height)
+{
+    mWidth = width;
+    mHeight = height;
+    mColumns = (width + mTileSize - 1) / mTileSize;
+    mRows = (height + mTileSize - 1) / mTileSize;
+
+    size_t tiles = (size_t)mColumns * mRows;
+    mHashes.assign(tiles, 0);
+    mKnown.assign(tiles, false);
+    mVisited.assign(tiles, 0);
+    mChanged.assign(tiles, false);
+    mGeneration = 0;
+}
+
+void TileHasher::invalidate(const Rect& rect)
+{
+    Rect clipped = intersectRect(rect, Rect(0, 0, mWidth, mHeight));
+    if (clipped.isEmpty())
+    {
+        return;
+    }
+
+    for (int row = clipped.y / mTileSize; row <= (clipped.y + clipped.height - 1) / mTileSize; ++row)
+    {
+        for (int column = clipped.x / mTileSize; column <= (clipped.x + clipped.width - 1) / mTileSize; ++column)
+        {
+            mKnown[(size_t)row * mColumns + column] = false;
+        }
+    }
+}
+
+RectList TileHasher::changedRects(const RectList& dirty_rects, const unsigned char* buffer)
+{
+    INSTRUMENT_SCOPE("paint.hash");
+    uint64_t start = instrumentNow();
+
+    // a new generation marks every tile as not hashed yet this time without touching them all
+    if (++mGeneration == 0)
+    {
+        std::fill(mVisited.begin(), mVisited.end(), 0);
+        mGeneration = 1;
+    }
+
+    RectList changed;
+    std::vector<size_t> previous_runs;
+    std::vector<size_t> runs;
+    for (const Rect& dirty_rect : dirty_rects)
+    {
+        Rect dirty = intersectRect(dirty_rect, Rect(0, 0, mWidth, mHeight));
+        if (dirty.isEmpty())
+        {
+            continue;
+        }
+
+        // runs of changed tiles along each row of tiles, cut down to the dirty rect - a run that lines
+        // up with one in the row above makes that one taller so a dirty rect that all changed stays one rect
+        previous_runs.clear();
+        for (int row = dirty.y / mTileSize; row <= (dirty.y + dirty.height - 1) / mTileSize; ++row)
+        {
+            runs.clear();
+            int run_start = -1;
+            const int last_column = (dirty.x + dirty.width - 1) / mTileSize;
+            for (int column = dirty.x / mTileSize; column <= last_column + 1; ++column)
+            {
+                bool tile_changed = false;
+                if (column <= last_column)
+                {
+                    size_t tile = (size_t)row * mColumns + column;
+                    if (mVisited[tile] != mGeneration)
+                    {
+                        uint64_t hash = hashTile(column, row, buffer);
+                        mChanged[tile] = ! mKnown[tile] || hash != mHashes[tile];
+                        mHashes[tile] = hash;
+                        mKnown[tile] = true;
+                        mVisited[tile] = mGeneration;
+
+                        ++mStats.tilesHashed;
+                        mStats.tilesChanged += mChanged[tile] ? 1 : 0;
+                    }
+                    tile_changed = mChanged[tile];
+                }
+
+                if (tile_changed && run_start < 0)
+                {
+                    run_start = column;
+                }
+                else if (! tile_changed && run_start >= 0)
+                {
+                    Rect run = intersectRect(dirty, Rect(run_start * mTileSize, row * mTileSize, (column - run_start) * mTileSize, mTileSize));
+                    run_start = -1;
+
+                    bool extended = false;
+                    for (size_t index : previous_runs)
+                    {
+                        Rect& above = changed[index];
+                        if (above.x == run.x && above.width == run.width && above.y + above.height == run.y)
+                        {
+                            above.height += run.height;
+                            runs.push_back(index);
+                            extended = true;
+                            break;
+                        }
+                    }
+                    if (! extended)
+                    {
+                        runs.push_back(changed.size());
+                        changed.push_back(run);
+                    }
+                }
+            }
+            previous_runs.swap(runs);
+        }
+    }
+
+    ++mStats.frames;
+    mStats.skippedFrames += changed.empty() ? 1 : 0;
+    mStats.hashNanoseconds += instrumentNow() - start;
+
+    return changed;
+}
+
+uint64_t TileHasher::hashTile(int column, int row, const unsigned char* buffer) const
+{
+    const PixelKernels& kernels = pixelKernels();
+
+    int x = column * mTileSize;
+    int y = row * mTileSize;
+    int width = std::min(mTileSize, mWidth - x);
+    int height = std::min(mTileSize, mHeight - y);
+
+    unsigned int lanes[kHashLanes];
+    for (int lane = 0; lane < kHashLanes; ++lane)
+    {
+        lanes[lane] = (unsigned int)lane;
+    }
+
+    for (int line = 0; line < height; ++line)
+    {
+        kernels.hashRow(lanes, buffer + ((size_t)(y + line) * mWidth + x) * kDepth, width);
+    }
+
+    // fold the lanes into 64 bits
+    uint64_t hash = 0;
+    for (int lane = 0; lane < kHashLanes; ++lane)
+    {
+        hash = (hash ^ lanes[lane]) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
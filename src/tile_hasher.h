@@ -0,0 +1,93 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _TILE_HASHER_H_
+#define _TILE_HASHER_H_
+
+#include "compositor.h"
+
+#include <cstdint>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// CEF often paints PET_VIEW with pixels that are the same as the ones it sent
+// last time - a paused animation that keeps asking for frames, the page
+// repainting because the cursor changed and so on. This splits the page into
+// tiles (64 x 64 by default) and keeps a hash of each (see hashRow() in
+// pixel_kernels.h), and cuts the dirty rects of a paint down to the tiles
+// whose hash changed. Only the tiles the dirty rects touch are hashed - CEF's
+// buffer is always the whole page so a tile can be hashed even if only part
+// of it is dirty. Hashing instead of comparing with the last frame means it
+// works for popup layers too, where the compositor doesn't keep the pixels
+const int kDefaultTileSize = 64;
+
+struct TileHasherStats
+{
+    TileHasherStats() :
+        frames(0),
+        skippedFrames(0),
+        tilesHashed(0),
+        tilesChanged(0),
+        hashNanoseconds(0)
+    {
+    }
+
+    size_t frames;
+    // frames where nothing that was dirty had changed
+    size_t skippedFrames;
+    size_t tilesHashed;
+    size_t tilesChanged;
+    uint64_t hashNanoseconds;
+};
+
+class TileHasher
+{
+    public:
+        explicit TileHasher(int tile_size = kDefaultTileSize);
+
+        // forget every hash - every tile counts as changed the next time it's hashed
+        void resize(int width, int height);
+
+        // the tiles rect touches count as changed the next time they're hashed - for when what's on
+        // screen there changed without CEF's pixels changing (e.g. a popup composited into the page went away)
+        void invalidate(const Rect& rect);
+
+        // dirty_rects cut down to the tiles whose pixels are different from the last time they were
+        // hashed - empty if none are. buffer is the whole width x height page
+        RectList changedRects(const RectList& dirty_rects, const unsigned char* buffer);
+
+        int tileSize() const
+        {
+            return mTileSize;
+        }
+
+        const TileHasherStats& stats() const
+        {
+            return mStats;
+        }
+
+    private:
+        uint64_t hashTile(int column, int row, const unsigned char* buffer) const;
+
+        int mTileSize;
+        int mWidth;
+        int mHeight;
+        int mColumns;
+        int mRows;
+        std::vector<uint64_t> mHashes;
+        // false until a tile has been hashed (or after it's invalidated)
+        std::vector<bool> mKnown;
+        // which changedRects() call last hashed each tile and whether it had changed then - so a tile
+        // under two dirty rects is only hashed once
+        std::vector<unsigned int> mVisited;
+        std::vector<bool> mChanged;
+        unsigned int mGeneration;
+
+        TileHasherStats mStats;
+};
+
+#endif // _TILE_HASHER_H_
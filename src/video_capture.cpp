@@ -0,0 +1,451 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "video_capture.h"
+
+#include "instrument.h"
+#include "pixel_kernels.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace
+{
+    const double kNever = std::numeric_limits<double>::infinity();
+
+    // a chroma plane of an I420 frame
+    int chromaSize(int size)
+    {
+        return (size + 1) / 2;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+VideoCapture::VideoCapture(const VideoCaptureSettings& settings) :
+    mSettings(settings),
+    mOutput(nullptr),
+    mPipe(false),
+    mWriteFailed(false),
+    mWidth(0),
+    mHeight(0),
+    mVersion(0),
+    mFirstFrameTime(kNever),
+    mNextFrameTime(kNever),
+    mFrameNumber(0),
+    mNextSequence(0),
+    mStopping(false),
+    mNextToWrite(0),
+    mInFlight(0)
+{
+}
+
+VideoCapture::~VideoCapture()
+{
+    close();
+}
+
+bool VideoCapture::open(const std::string& target)
+{
+    close();
+
+    if (target == "-")
+    {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        mOutput = stdout;
+    }
+    else if (! target.empty() && target[0] == '|')
+    {
+#ifdef _WIN32
+        mOutput = popen(target.c_str() + 1, "wb");
+#else
+        mOutput = popen(target.c_str() + 1, "w");
+#endif
+        mPipe = true;
+    }
+    else
+    {
+        mOutput = fopen(target.c_str(), "wb");
+    }
+
+    if (mOutput == nullptr)
+    {
+        mPipe = false;
+        return false;
+    }
+
+    mWriteFailed = false;
+    mStopping = false;
+    mStats = VideoCaptureStats();
+
+    int workers = mSettings.workers;
+    if (workers <= 0)
+    {
+        workers = (int)std::thread::hardware_concurrency() - 1;
+        workers = workers < 1 ? 1 : workers;
+    }
+    for (int i = 0; i < workers; ++i)
+    {
+        mWorkers.push_back(std::thread(&VideoCapture::workerThread, this));
+    }
+    mWriter = std::thread(&VideoCapture::writerThread, this);
+
+    return true;
+}
+
+void VideoCapture::close()
+{
+    if (mOutput == nullptr)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mJobReady.notify_all();
+    mFrameReady.notify_all();
+
+    for (std::thread& worker : mWorkers)
+    {
+        worker.join();
+    }
+    mWorkers.clear();
+    mWriter.join();
+
+    if (mPipe)
+    {
+        pclose(mOutput);
+    }
+    else if (mOutput != stdout)
+    {
+        fclose(mOutput);
+    }
+    else
+    {
+        fflush(mOutput);
+    }
+
+    mOutput = nullptr;
+    mPipe = false;
+    mStaging.clear();
+    mPendingDirty.clear();
+    mHistory.clear();
+    mFreeSnapshots.clear();
+    mVersion = 0;
+    mWidth = 0;
+    mHeight = 0;
+    mFirstFrameTime = kNever;
+    mNextFrameTime = kNever;
+    mFrameNumber = 0;
+    mNextSequence = 0;
+    mNextToWrite = 0;
+}
+
+void VideoCapture::damage(const unsigned char* pixels, int width, int height, const RectList& dirty_rects)
+{
+    if (mOutput == nullptr || pixels == nullptr || width <= 0 || height <= 0)
+    {
+        return;
+    }
+
+    // the stream is the size of the first frame
+    if (mStaging.empty())
+    {
+        mWidth = width;
+        mHeight = height;
+        mStaging = mPool.acquire((size_t)width * height * kDepth);
+        memset(mStaging.data(), 0, mStaging.size());
+        // the first snapshot has all of it
+        mPendingDirty.assign(1, Rect(0, 0, width, height));
+
+        char header[128];
+        snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1000 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n",
+                 width, height, (int)std::lround(mSettings.frameRate * 1000.0));
+        mWriteFailed = fwrite(header, strlen(header), 1, mOutput) != 1;
+
+        // the first frame goes out on the next tick()
+        mNextFrameTime = -kNever;
+    }
+
+    INSTRUMENT_SCOPE("capture.damage");
+    const Rect bounds(0, 0, width < mWidth ? width : mWidth, height < mHeight ? height : mHeight);
+    for (const Rect& dirty_rect : dirty_rects)
+    {
+        Rect rect = intersectRect(dirty_rect, bounds);
+        if (rect.isEmpty())
+        {
+            continue;
+        }
+
+        mPendingDirty.push_back(rect);
+        for (int y = rect.y; y < rect.y + rect.height; ++y)
+        {
+            memcpy(mStaging.data() + ((size_t)y * mWidth + rect.x) * kDepth,
+                   pixels + ((size_t)y * width + rect.x) * kDepth, (size_t)rect.width * kDepth);
+        }
+    }
+}
+
+void VideoCapture::tick(double now)
+{
+    if (mOutput == nullptr || mStaging.empty())
+    {
+        return;
+    }
+
+    if (mNextFrameTime == -kNever)
+    {
+        mFirstFrameTime = now;
+        mNextFrameTime = now;
+    }
+
+    const double interval = 1000.0 / mSettings.frameRate;
+    while (now >= mNextFrameTime)
+    {
+        // from the first frame rather than adding up intervals, which would drift
+        mNextFrameTime = mFirstFrameTime + ++mFrameNumber * interval;
+
+        bool convert = false;
+        uint64_t sequence = 0;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mInFlight >= mSettings.maxQueuedFrames)
+            {
+                // the change (if there was one) goes out with the next frame that fits
+                ++mStats.dropped;
+                continue;
+            }
+
+            ++mInFlight;
+            sequence = mNextSequence++;
+            convert = ! mPendingDirty.empty();
+            if (! convert)
+            {
+                mFrames[sequence] = Frame();
+            }
+        }
+
+        if (! convert)
+        {
+            mFrameReady.notify_one();
+            continue;
+        }
+
+        // the workers get a snapshot so damage() can carry on changing the staging copy
+        Job job;
+        job.sequence = sequence;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (! mFreeSnapshots.empty())
+            {
+                job.snapshot = std::move(mFreeSnapshots.back());
+                mFreeSnapshots.pop_back();
+            }
+        }
+        takeSnapshot(job.snapshot);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mJobs.push_back(std::move(job));
+        }
+        mJobReady.notify_one();
+    }
+}
+
+void VideoCapture::takeSnapshot(Snapshot& snapshot)
+{
+    INSTRUMENT_SCOPE("capture.snapshot");
+
+    // a reused buffer needs everything that changed since it was last used as well as what changed this time,
+    // or all of it if it's new or further behind than the history goes
+    bool full = snapshot.bgra.empty() || mHistory.empty() || mHistory.front().version > snapshot.version + 1;
+    RectList copies = mPendingDirty;
+    size_t copy_area = 0;
+    for (const History& history : mHistory)
+    {
+        if (! full && history.version > snapshot.version)
+        {
+            copies.insert(copies.end(), history.dirty.begin(), history.dirty.end());
+        }
+    }
+    for (const Rect& rect : copies)
+    {
+        copy_area += (size_t)rect.width * rect.height;
+    }
+
+    if (full || copy_area >= (size_t)mWidth * mHeight)
+    {
+        if (snapshot.bgra.empty())
+        {
+            snapshot.bgra = mPool.acquire(mStaging.size());
+        }
+        memcpy(snapshot.bgra.data(), mStaging.data(), mStaging.size());
+    }
+    else
+    {
+        for (const Rect& rect : copies)
+        {
+            for (int y = rect.y; y < rect.y + rect.height; ++y)
+            {
+                size_t offset = ((size_t)y * mWidth + rect.x) * kDepth;
+                memcpy(snapshot.bgra.data() + offset, mStaging.data() + offset, (size_t)rect.width * kDepth);
+            }
+        }
+    }
+
+    History history;
+    history.version = ++mVersion;
+    history.dirty.swap(mPendingDirty);
+    mHistory.push_back(history);
+    while (mHistory.size() > mSettings.maxQueuedFrames + 2)
+    {
+        mHistory.pop_front();
+    }
+
+    snapshot.version = mVersion;
+}
+
+double VideoCapture::timeUntilFrame(double now) const
+{
+    if (mOutput == nullptr || mStaging.empty())
+    {
+        return kNever;
+    }
+
+    return mNextFrameTime <= now ? 0.0 : mNextFrameTime - now;
+}
+
+VideoCaptureStats VideoCapture::stats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+size_t VideoCapture::frameBytes() const
+{
+    return (size_t)mWidth * mHeight + (size_t)chromaSize(mWidth) * chromaSize(mHeight) * 2;
+}
+
+void VideoCapture::convert(const unsigned char* bgra, unsigned char* i420) const
+{
+    const PixelKernels& kernels = pixelKernels();
+
+    int chroma_width = chromaSize(mWidth);
+    unsigned char* y = i420;
+    unsigned char* u = y + (size_t)mWidth * mHeight;
+    unsigned char* v = u + (size_t)chroma_width * chromaSize(mHeight);
+
+    for (int row = 0; row < mHeight; row += 2)
+    {
+        // the last row of an odd height frame is its own pair
+        int next = row + 1 < mHeight ? row + 1 : row;
+        kernels.bgraToI420Row(bgra + (size_t)row * mWidth * kDepth, bgra + (size_t)next * mWidth * kDepth,
+                              y + (size_t)row * mWidth, y + (size_t)next * mWidth,
+                              u + (size_t)(row / 2) * chroma_width, v + (size_t)(row / 2) * chroma_width, mWidth);
+    }
+}
+
+void VideoCapture::workerThread()
+{
+    setInstrumentThreadName("capture worker");
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;)
+    {
+        mJobReady.wait(lock, [this]()
+        {
+            return mStopping || ! mJobs.empty();
+        });
+        if (mJobs.empty())
+        {
+            return;
+        }
+
+        Job job = std::move(mJobs.front());
+        mJobs.erase(mJobs.begin());
+        lock.unlock();
+
+        Frame frame;
+        auto start = std::chrono::steady_clock::now();
+        {
+            INSTRUMENT_SCOPE("capture.convert");
+            frame.i420 = mPool.acquire(frameBytes());
+            convert(job.snapshot.bgra.data(), frame.i420.data());
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        lock.lock();
+        mFreeSnapshots.push_back(std::move(job.snapshot));
+        mFrames[job.sequence] = std::move(frame);
+        mStats.convertSeconds += seconds;
+        mStats.pixelsConverted += (uint64_t)mWidth * mHeight;
+        ++mStats.converted;
+        mFrameReady.notify_one();
+    }
+}
+
+void VideoCapture::writerThread()
+{
+    setInstrumentThreadName("capture writer");
+
+    // what a repeat writes - the last frame that was converted
+    PixelBuffer last;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;)
+    {
+        mFrameReady.wait(lock, [this]()
+        {
+            return mFrames.count(mNextToWrite) != 0 || (mStopping && mInFlight == 0);
+        });
+
+        auto it = mFrames.find(mNextToWrite);
+        if (it == mFrames.end())
+        {
+            return;
+        }
+
+        Frame frame = std::move(it->second);
+        mFrames.erase(it);
+        ++mNextToWrite;
+        bool repeat = frame.i420.empty();
+        lock.unlock();
+
+        if (! repeat)
+        {
+            last = std::move(frame.i420);
+        }
+
+        // a repeat before anything has been converted can't happen - the first frame always has changes
+        if (! mWriteFailed && ! last.empty())
+        {
+            INSTRUMENT_SCOPE("capture.write");
+            mWriteFailed = fwrite("FRAME\n", 6, 1, mOutput) != 1 || fwrite(last.data(), frameBytes(), 1, mOutput) != 1;
+        }
+
+        lock.lock();
+        --mInFlight;
+        ++mStats.framesWritten;
+        if (repeat)
+        {
+            ++mStats.duplicated;
+        }
+    }
+}
@@ -0,0 +1,187 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _VIDEO_CAPTURE_H_
+#define _VIDEO_CAPTURE_H_
+
+#include "compositor.h"
+#include "pixel_pool.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+struct VideoCaptureSettings
+{
+    VideoCaptureSettings() :
+        frameRate(30.0),
+        workers(0),
+        maxQueuedFrames(8)
+    {
+    }
+
+    // frames per second in the stream
+    double frameRate;
+    // threads converting BGRA to I420 - 0 for one less than there are cores (at least one)
+    int workers;
+    // frames waiting to be converted or written - past this, new frames are dropped
+    size_t maxQueuedFrames;
+};
+
+struct VideoCaptureStats
+{
+    VideoCaptureStats() :
+        framesWritten(0),
+        converted(0),
+        duplicated(0),
+        dropped(0),
+        convertSeconds(0.0),
+        pixelsConverted(0)
+    {
+    }
+
+    size_t framesWritten;
+    // frames that had changed and were converted
+    size_t converted;
+    // frames that hadn't changed - the last one was written again without converting it
+    size_t duplicated;
+    // frames that didn't make it into the stream because the queue was full
+    size_t dropped;
+    // worker time spent converting - converted / convertSeconds is the frames per second one core manages
+    double convertSeconds;
+    uint64_t pixelsConverted;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// streams a browser to a Y4M file (raw I420 with a small header - ffmpeg, VLC
+// and most encoders read it) or a pipe at a steady frame rate. The paint path
+// hands over the parts of the page that changed with damage(), which keeps an
+// up to date copy of the page, and the main loop calls tick() - each frame
+// that's due takes a snapshot of the copy if it changed, or writes the last
+// frame again if it didn't. Snapshot buffers are reused, so taking one only
+// copies what changed since that buffer was last used. Snapshots are converted on a pool of worker
+// threads with the SIMD pixel kernels and a writer thread puts them back in
+// order and writes them out. Neither damage() nor tick() ever waits for the
+// workers or the writer: when maxQueuedFrames are already on their way the
+// frame is dropped. The size of the stream is the size of the first frame -
+// bigger frames are cropped and smaller ones leave what was there before.
+// Times are in milliseconds (PumpScheduler::now())
+class VideoCapture
+{
+    public:
+        VideoCapture(const VideoCaptureSettings& settings = VideoCaptureSettings());
+        ~VideoCapture();
+
+        // target is a file name, "-" for stdout or "|command" to pipe to a command (e.g.
+        // "|ffmpeg -i - capture.mp4") - false if it can't be opened
+        bool open(const std::string& target);
+
+        // the page changed - pixels is the whole page, width pixels to a row
+        void damage(const unsigned char* pixels, int width, int height, const RectList& dirty_rects);
+
+        // queue up the frames that are due by now
+        void tick(double now);
+
+        // how long until the next frame is due - infinity before the first damage()
+        double timeUntilFrame(double now) const;
+
+        // write out everything still queued and close the output
+        void close();
+
+        bool isOpen() const
+        {
+            return mOutput != nullptr;
+        }
+
+        VideoCaptureStats stats() const;
+
+    private:
+        VideoCapture(const VideoCapture&);
+        VideoCapture& operator=(const VideoCapture&);
+
+        struct Snapshot
+        {
+            Snapshot() :
+                version(0)
+            {
+            }
+
+            PixelBuffer bgra;
+            // which snapshot of the staging copy it has
+            uint64_t version;
+        };
+
+        struct Job
+        {
+            uint64_t sequence;
+            Snapshot snapshot;
+        };
+
+        struct History
+        {
+            uint64_t version;
+            RectList dirty;
+        };
+
+        struct Frame
+        {
+            // empty for a repeat of the last frame
+            PixelBuffer i420;
+        };
+
+        void workerThread();
+        void writerThread();
+        void takeSnapshot(Snapshot& snapshot);
+        void convert(const unsigned char* bgra, unsigned char* i420) const;
+        size_t frameBytes() const;
+
+        VideoCaptureSettings mSettings;
+        PixelPool mPool;
+
+        FILE* mOutput;
+        bool mPipe;
+        bool mWriteFailed;
+
+        // only touched by the thread calling damage() and tick()
+        int mWidth;
+        int mHeight;
+        PixelBuffer mStaging;
+        // what changed since the last snapshot
+        RectList mPendingDirty;
+        uint64_t mVersion;
+        // what changed between each of the last few snapshots - what a reused snapshot buffer is missing
+        std::deque<History> mHistory;
+        double mFirstFrameTime;
+        double mNextFrameTime;
+        uint64_t mFrameNumber;
+        uint64_t mNextSequence;
+
+        mutable std::mutex mMutex;
+        std::condition_variable mJobReady;
+        std::condition_variable mFrameReady;
+        bool mStopping;
+        std::vector<Job> mJobs;
+        // snapshot buffers the workers are done with
+        std::vector<Snapshot> mFreeSnapshots;
+        std::map<uint64_t, Frame> mFrames;
+        uint64_t mNextToWrite;
+        size_t mInFlight;
+        VideoCaptureStats mStats;
+
+        std::vector<std::thread> mWorkers;
+        std::thread mWriter;
+};
+
+#endif // _VIDEO_CAPTURE_H_
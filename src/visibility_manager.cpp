@@ -0,0 +1,188 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#include "visibility_manager.h"
+
+#include <limits>
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+const char* visibilityName(VisibilityState state)
+{
+    switch (state)
+    {
+        case VISIBILITY_VISIBLE:
+            return "visible";
+        case VISIBILITY_BACKGROUND:
+            return "background";
+        case VISIBILITY_HIDDEN:
+            return "hidden";
+    }
+    return "unknown";
+}
+
+/////////////////////////////////////////////////////////////////////////////////
+//
+VisibilityManager::VisibilityManager(const VisibilitySettings& settings) :
+    mSettings(settings),
+    mWidth(0),
+    mHeight(0),
+    mMinimized(false),
+    mActive(true),
+    mChanges(0)
+{
+}
+
+void VisibilityManager::setWindow(int width, int height, bool minimized, bool active)
+{
+    mWidth = width;
+    mHeight = height;
+    mMinimized = minimized;
+    mActive = active;
+}
+
+void VisibilityManager::add(int id, const Rect& rect)
+{
+    Browser browser;
+    browser.rect = rect;
+    browser.state = VISIBILITY_VISIBLE;
+    browser.wanted = VISIBILITY_VISIBLE;
+    browser.wantedSince = -1.0;
+    mBrowsers[id] = browser;
+}
+
+void VisibilityManager::move(int id, const Rect& rect)
+{
+    std::map<int, Browser>::iterator it = mBrowsers.find(id);
+    if (it != mBrowsers.end())
+    {
+        it->second.rect = rect;
+    }
+}
+
+void VisibilityManager::remove(int id)
+{
+    mBrowsers.erase(id);
+}
+
+bool VisibilityManager::update(double now, std::vector<VisibilityChange>& changes)
+{
+    size_t count = changes.size();
+    for (std::map<int, Browser>::iterator it = mBrowsers.begin(); it != mBrowsers.end(); ++it)
+    {
+        Browser& browser = it->second;
+        VisibilityState wanted = wantedState(browser);
+        if (wanted == browser.state)
+        {
+            browser.wantedSince = -1.0;
+            continue;
+        }
+
+        // less visible only once it's wanted to be for long enough - and the clock starts again if what it
+        // wants changes on the way
+        if (wanted > browser.state)
+        {
+            if (browser.wantedSince < 0.0 || browser.wanted != wanted)
+            {
+                browser.wanted = wanted;
+                browser.wantedSince = now;
+            }
+            if (now - browser.wantedSince < delay(wanted))
+            {
+                continue;
+            }
+        }
+
+        VisibilityChange change;
+        change.id = it->first;
+        change.from = browser.state;
+        change.to = wanted;
+        changes.push_back(change);
+
+        browser.state = wanted;
+        browser.wantedSince = -1.0;
+        ++mChanges;
+    }
+    return changes.size() > count;
+}
+
+double VisibilityManager::timeUntilUpdate(double now) const
+{
+    double wait = std::numeric_limits<double>::infinity();
+    for (std::map<int, Browser>::const_iterator it = mBrowsers.begin(); it != mBrowsers.end(); ++it)
+    {
+        const Browser& browser = it->second;
+        if (browser.wantedSince >= 0.0)
+        {
+            double due = browser.wantedSince + delay(browser.wanted) - now;
+            wait = (due < wait) ? due : wait;
+        }
+    }
+    return (wait < 0.0) ? 0.0 : wait;
+}
+
+VisibilityState VisibilityManager::state(int id) const
+{
+    std::map<int, Browser>::const_iterator it = mBrowsers.find(id);
+    return (it != mBrowsers.end()) ? it->second.state : VISIBILITY_HIDDEN;
+}
+
+int VisibilityManager::frameRate(VisibilityState state) const
+{
+    return (state == VISIBILITY_VISIBLE) ? mSettings.visibleFrameRate :
+           (state == VISIBILITY_BACKGROUND) ? mSettings.backgroundFrameRate : 0;
+}
+
+VisibilityStats VisibilityManager::stats() const
+{
+    VisibilityStats stats;
+    for (std::map<int, Browser>::const_iterator it = mBrowsers.begin(); it != mBrowsers.end(); ++it)
+    {
+        switch (it->second.state)
+        {
+            case VISIBILITY_VISIBLE:
+                ++stats.visible;
+                break;
+            case VISIBILITY_BACKGROUND:
+                ++stats.background;
+                break;
+            case VISIBILITY_HIDDEN:
+                ++stats.hidden;
+                break;
+        }
+    }
+    stats.changes = mChanges;
+    return stats;
+}
+
+VisibilityState VisibilityManager::wantedState(const Browser& browser) const
+{
+    if (mMinimized || browser.rect.isEmpty())
+    {
+        return VISIBILITY_HIDDEN;
+    }
+
+    Rect on_screen = intersectRect(browser.rect, Rect(0, 0, mWidth, mHeight));
+    double fraction = (double)on_screen.area() / browser.rect.area();
+    if (fraction <= 0.0)
+    {
+        return VISIBILITY_HIDDEN;
+    }
+
+    if (! mActive)
+    {
+        return VISIBILITY_BACKGROUND;
+    }
+
+    double needed = (browser.state == VISIBILITY_VISIBLE) ? mSettings.leaveVisibleFraction : mSettings.enterVisibleFraction;
+    return (fraction >= needed) ? VISIBILITY_VISIBLE : VISIBILITY_BACKGROUND;
+}
+
+double VisibilityManager::delay(VisibilityState state) const
+{
+    return (state == VISIBILITY_HIDDEN) ? mSettings.hiddenDelay : (state == VISIBILITY_BACKGROUND) ? mSettings.backgroundDelay : 0.0;
+}
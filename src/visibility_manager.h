@@ -0,0 +1,139 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see cef_opengl_win.cpp for full text
+*/
+
+#ifndef _VISIBILITY_MANAGER_H_
+#define _VISIBILITY_MANAGER_H_
+
+#include "compositor.h"
+
+#include <map>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////////
+// how much rendering a browser gets:
+//
+//   visible     on screen in a window that's in front - full frame rate
+//   background  the window is behind something else, or only a sliver of the
+//               browser is on screen - a low frame rate, the page keeps going
+//   hidden      off screen, or the window is minimized - suspended with
+//               WasHidden(), no painting at all until it's back
+enum VisibilityState
+{
+    VISIBILITY_VISIBLE,
+    VISIBILITY_BACKGROUND,
+    VISIBILITY_HIDDEN
+};
+
+const char* visibilityName(VisibilityState state);
+
+struct VisibilitySettings
+{
+    VisibilitySettings() :
+        visibleFrameRate(60),
+        backgroundFrameRate(5),
+        enterVisibleFraction(0.3),
+        leaveVisibleFraction(0.2),
+        backgroundDelay(500.0),
+        hiddenDelay(2000.0)
+    {
+    }
+
+    int visibleFrameRate;
+    int backgroundFrameRate;
+
+    // how much of a browser has to be on screen to become visible, and how little before it stops
+    // being visible - the gap stops a browser at the edge of the window flipping back and forth
+    double enterVisibleFraction;
+    double leaveVisibleFraction;
+
+    // how long (milliseconds) a browser has to have wanted to be less visible before it is - a browser
+    // that wants to be more visible gets it straight away
+    double backgroundDelay;
+    double hiddenDelay;
+};
+
+struct VisibilityChange
+{
+    int id;
+    VisibilityState from;
+    VisibilityState to;
+};
+
+struct VisibilityStats
+{
+    VisibilityStats() :
+        visible(0),
+        background(0),
+        hidden(0),
+        changes(0)
+    {
+    }
+
+    // browsers in each state now, and state changes so far
+    size_t visible;
+    size_t background;
+    size_t hidden;
+    size_t changes;
+};
+
+/////////////////////////////////////////////////////////////////////////////////
+// decides the state of every browser from where it is in the window and what
+// the window is doing - the caller applies the changes update() hands back
+// (WasHidden(), SetWindowlessFrameRate()). Times are in milliseconds
+// (PumpScheduler::now()). Main thread only
+class VisibilityManager
+{
+    public:
+        explicit VisibilityManager(const VisibilitySettings& settings);
+
+        const VisibilitySettings& settings() const
+        {
+            return mSettings;
+        }
+
+        // the window's client area, whether it's minimized and whether it's the window in front
+        void setWindow(int width, int height, bool minimized, bool active);
+
+        // new browsers start off visible - rect is in window coordinates
+        void add(int id, const Rect& rect);
+        void move(int id, const Rect& rect);
+        void remove(int id);
+
+        // browsers whose state has changed since last time onto the end of changes - false if none have
+        bool update(double now, std::vector<VisibilityChange>& changes);
+
+        // how long until a browser waiting to be less visible is - infinity if none is waiting
+        double timeUntilUpdate(double now) const;
+
+        VisibilityState state(int id) const;
+        int frameRate(VisibilityState state) const;
+
+        VisibilityStats stats() const;
+
+    private:
+        struct Browser
+        {
+            Rect rect;
+            VisibilityState state;
+            // what it would be if it weren't for the delays, and since when (-1 when it's what it is)
+            VisibilityState wanted;
+            double wantedSince;
+        };
+
+        VisibilityState wantedState(const Browser& browser) const;
+        double delay(VisibilityState state) const;
+
+        VisibilitySettings mSettings;
+        int mWidth;
+        int mHeight;
+        bool mMinimized;
+        bool mActive;
+        std::map<int, Browser> mBrowsers;
+        size_t mChanges;
+};
+
+#endif // _VISIBILITY_MANAGER_H_
@@ -0,0 +1,52 @@
+/*
+    CEF and OpenGL simple test
+    Copyright(c) 2018 Callum Prentice (callum@gmail.com)
+
+    MIT License - see src/cef_opengl_win.cpp for full text
+*/
+
+/////////////////////////////////////////////////////////////////////////////////
+// packs a directory of pages and everything they use into an asset pack (see
+// src/asset_pack.h) for the apps to serve them from - gAssetPackFile in the
+// Windows app, --asset-pack for the headless one. Paths in the pack are
+// relative to the directory, so with the origin set to where the directory
+// would be on the web, <origin>js/app.js is served from <directory>/js/app.js
+//
+//     make_asset_pack <directory> <pack file>
+
+#include "asset_pack.h"
+
+#include <cstdio>
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        printf("usage: make_asset_pack <directory> <pack file>\n");
+        return 1;
+    }
+
+    AssetPackWriter writer;
+    if (! writer.addDirectory(argv[1]))
+    {
+        printf("make_asset_pack: unable to read everything in %s\n", argv[1]);
+        return 1;
+    }
+
+    if (! writer.write(argv[2]))
+    {
+        printf("make_asset_pack: unable to write %s\n", argv[2]);
+        return 1;
+    }
+
+    // check it reads back
+    AssetPack pack;
+    if (! pack.open(argv[2]))
+    {
+        printf("make_asset_pack: %s doesn't read back\n", argv[2]);
+        return 1;
+    }
+
+    printf("make_asset_pack: %zu files from %s in %s\n", pack.size(), argv[1], argv[2]);
+    return 0;
+}